@@ -0,0 +1,113 @@
+// 应用层分帧器微基准：只测解析本身，不涉及 socket / TCPConnection
+// 用法: ./bench_app_framing [消息数] [每次喂入字节数]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "app_framing.h"
+#include "tcp_protocol.h"
+
+namespace {
+
+// 构造一段连续的应用层字节流：大部分是 1KB 的 OP_DATA，夹杂少量短 OP_MSG
+std::vector<char> build_stream(size_t messages, size_t& payloadBytes) {
+    std::vector<char> stream;
+    std::vector<char> payload(1024, 'x');
+    payloadBytes = 0;
+    for (size_t i = 0; i < messages; ++i) {
+        uint8_t op = (i % 16 == 0) ? OP_MSG : OP_DATA;
+        size_t len = (op == OP_MSG) ? 32 : payload.size();
+        size_t off = stream.size();
+        stream.resize(off + sizeof(AppHeader) + len);
+        encode_app_header(stream.data() + off, op, len);
+        memcpy(stream.data() + off + sizeof(AppHeader), payload.data(), len);
+        payloadBytes += len;
+    }
+    return stream;
+}
+
+// 旧实现：拷进 vector -> 每帧构造 std::string -> std::function 回调 -> 从头部 erase
+size_t legacy_parse(std::vector<char>& appBuffer, const char* data, size_t n,
+                    const std::function<void(uint8_t, const std::string&)>& handler) {
+    appBuffer.insert(appBuffer.end(), data, data + n);
+    char* ptr = appBuffer.data();
+    size_t remaining = appBuffer.size();
+    size_t consumed = 0;
+    size_t frames = 0;
+    while (remaining >= sizeof(AppHeader)) {
+        uint8_t op;
+        uint32_t length;
+        decode_app_header(ptr, op, length);
+        size_t totalLen = sizeof(AppHeader) + length;
+        if (remaining < totalLen) break;
+        std::string payload(ptr + sizeof(AppHeader), length);
+        handler(op, payload);
+        ptr += totalLen;
+        remaining -= totalLen;
+        consumed += totalLen;
+        ++frames;
+    }
+    if (consumed > 0) appBuffer.erase(appBuffer.begin(), appBuffer.begin() + consumed);
+    return frames;
+}
+
+void report(const char* name, size_t frames, size_t bytes, double seconds, uint64_t checksum) {
+    printf("%-10s %10.0f msg/s  %9.1f MB/s  (%zu msgs, %.3f s, checksum %llu)\n", name, frames / seconds,
+           bytes / seconds / (1024.0 * 1024.0), frames, seconds, (unsigned long long)checksum);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    size_t messages = (argc >= 2) ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    size_t feed = (argc >= 3) ? std::strtoull(argv[2], nullptr, 10) : MAX_PACKET_SIZE * 2;
+    if (feed == 0) feed = MAX_PACKET_SIZE * 2;
+
+    size_t payloadBytes = 0;
+    std::vector<char> stream = build_stream(messages, payloadBytes);
+    printf("stream: %zu msgs, %zu payload bytes, feed %zu bytes/call\n", messages, payloadBytes, feed);
+
+    // 1. 旧实现
+    {
+        std::vector<char> appBuffer;
+        uint64_t checksum = 0;
+        size_t frames = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t off = 0; off < stream.size(); off += feed) {
+            size_t n = std::min(feed, stream.size() - off);
+            frames += legacy_parse(appBuffer, stream.data() + off, n, [&](uint8_t op, const std::string& payload) {
+                checksum += op + payload.size() + (unsigned char)payload[0];
+            });
+        }
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        report("legacy", frames, payloadBytes, sec, checksum);
+    }
+
+    // 2. AppFrameParser：数据直接写进 parser 的尾部 (模拟 conn.receive(parser.write_ptr(), ...))
+    {
+        AppFrameParser parser;
+        uint64_t checksum = 0;
+        size_t frames = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t off = 0; off < stream.size();) {
+            char* dst = parser.write_ptr();
+            size_t n = std::min({feed, stream.size() - off, parser.writable()});
+            memcpy(dst, stream.data() + off, n);
+            parser.commit(n);
+            off += n;
+            frames += parser.dispatch([&](uint8_t op, std::string_view payload) {
+                checksum += op + payload.size() + (unsigned char)payload[0];
+            });
+        }
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        report("parser", frames, payloadBytes, sec, checksum);
+    }
+
+    return 0;
+}
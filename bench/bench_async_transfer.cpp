@@ -0,0 +1,148 @@
+// 协程传输 vs 轮询传输：比较客户端每传输 1GB 消耗的 CPU 时间
+// 用法: ./bench_async_transfer [文件MB] [并发连接数] [起始端口]
+//
+// 每个连接对应一个 fork 出来的 run_server 子进程 (服务端同一时间只服务一个连接)。
+// - loop：现有的轮询实现，一个线程只能依次上传
+// - coro：协程实现，一个线程上同时跑所有上传
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "file_transfer.h"
+#include "tcp_async.h"
+
+namespace {
+
+double cpu_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double wall_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+pid_t spawn_server(int port) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        freopen("/dev/null", "w", stdout);
+        freopen("/dev/null", "w", stderr);
+        run_server(port);
+        _exit(0);
+    }
+    return pid;
+}
+
+bool wait_established(TCPConnection& conn) {
+    for (int i = 0; i < 500 && conn.get_state() != ESTABLISHED; ++i) {
+        conn.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return conn.get_state() == ESTABLISHED;
+}
+
+Task<void> upload_one(AsyncTCPConnection& conn, std::string path, int port, long long& bytes) {
+    if (!co_await conn.async_connect("127.0.0.1", port)) co_return;
+    TransferStats st = co_await upload_file_async(conn, path);
+    bytes += st.bytes;
+}
+
+void report(const char* name, long long bytes, double wall, double cpu) {
+    double gb = bytes / (1024.0 * 1024.0 * 1024.0);
+    printf("%-5s %8.1f MB  wall %7.3f s  %8.1f MB/s  cpu %7.3f s  cpu/GB %7.3f s\n", name, bytes / 1048576.0, wall,
+           bytes / 1048576.0 / wall, cpu, gb > 0 ? cpu / gb : 0);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    long long fileMB = (argc >= 2) ? std::atoll(argv[1]) : 32;
+    int conns = (argc >= 3) ? std::atoi(argv[2]) : 4;
+    int basePort = (argc >= 4) ? std::atoi(argv[3]) : 19000;
+
+    // 在临时目录里工作：服务端收到的文件和 benchmark.log 都落在这里
+    char dirTemplate[] = "/tmp/bench_async_XXXXXX";
+    if (!mkdtemp(dirTemplate) || chdir(dirTemplate) != 0) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    std::vector<std::string> files;
+    {
+        std::vector<char> block(1024 * 1024);
+        for (size_t i = 0; i < block.size(); ++i) block[i] = (char)(rand() & 0xFF);
+        std::ofstream out("payload.bin", std::ios::binary);
+        for (long long i = 0; i < fileMB; ++i) out.write(block.data(), block.size());
+    }
+    for (int i = 0; i < conns; ++i) {
+        files.push_back("payload_" + std::to_string(i) + ".bin");
+        link("payload.bin", files.back().c_str());
+    }
+
+    // loop 阶段用 [base, base+conns)，coro 阶段用 [base+conns, base+2*conns)
+    std::vector<pid_t> servers;
+    for (int i = 0; i < 2 * conns; ++i) servers.push_back(spawn_server(basePort + i));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    printf("file %lld MB x %d connections\n", fileMB, conns);
+
+    // 屏蔽传输过程中的进度输出
+    std::ofstream devnull("/dev/null");
+    std::streambuf* coutBuf = std::cout.rdbuf(devnull.rdbuf());
+
+    // 1. 轮询版本：依次上传
+    double loopWall, loopCpu;
+    long long loopBytes = 0;
+    {
+        double w0 = wall_seconds(), c0 = cpu_seconds();
+        for (int i = 0; i < conns; ++i) {
+            TCPConnection conn;
+            conn.connect("127.0.0.1", basePort + i);
+            if (!wait_established(conn)) continue;
+            upload_file(conn, files[i]);
+            loopBytes += fileMB * 1024 * 1024;
+        }
+        loopWall = wall_seconds() - w0;
+        loopCpu = cpu_seconds() - c0;
+    }
+
+    // 2. 协程版本：单线程并发上传
+    double coroWall, coroCpu;
+    long long coroBytes = 0;
+    {
+        Scheduler sched;
+        std::vector<std::unique_ptr<AsyncTCPConnection>> cs;
+        double w0 = wall_seconds(), c0 = cpu_seconds();
+        for (int i = 0; i < conns; ++i) {
+            cs.push_back(std::make_unique<AsyncTCPConnection>(sched));
+            sched.spawn(upload_one(*cs.back(), files[i], basePort + conns + i, coroBytes));
+        }
+        sched.run();
+        coroWall = wall_seconds() - w0;
+        coroCpu = cpu_seconds() - c0;
+    }
+
+    std::cout.rdbuf(coutBuf);
+    report("loop", loopBytes, loopWall, loopCpu);
+    report("coro", coroBytes, coroWall, coroCpu);
+
+    for (pid_t pid : servers) kill(pid, SIGTERM);
+    for (pid_t pid : servers) waitpid(pid, nullptr, 0);
+
+    // 清理临时目录
+    std::string cmd = std::string("rm -rf ") + dirTemplate;
+    if (system(cmd.c_str()) != 0) fprintf(stderr, "failed to remove %s\n", dirTemplate);
+    return 0;
+}
@@ -0,0 +1,139 @@
+// 小文件吞吐：逐个 upload vs 批量 upload_dir，输出 files/s
+// 用法: ./bench_batch_transfer [文件数] [每个文件字节数] [逐个上传的样本数] [端口]
+//
+// 默认在临时目录生成 100k 个小文件。逐个上传每个文件都要付出 UPLOAD_REQ / END / 等待确认的往返，
+// 全量跑太慢，只取前若干个文件计时 (files/s 与文件总数无关)；批量模式跑完整个语料。
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "file_transfer.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+double wall_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+pid_t spawn_server(int port) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        freopen("/dev/null", "w", stdout);
+        freopen("/dev/null", "w", stderr);
+        run_server(port);
+        _exit(0);
+    }
+    return pid;
+}
+
+bool wait_established(TCPConnection& conn) {
+    for (int i = 0; i < 500 && conn.get_state() != ESTABLISHED; ++i) {
+        conn.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return conn.get_state() == ESTABLISHED;
+}
+
+// 生成语料：每个子目录 1000 个文件，避免单目录过大
+std::vector<std::string> make_corpus(const fs::path& root, long long count, size_t fileSize) {
+    std::vector<std::string> paths;
+    std::vector<char> content(fileSize);
+    for (long long i = 0; i < count; ++i) {
+        fs::path dir = root / "d";
+        dir += std::to_string(i / 1000);
+        if (i % 1000 == 0) fs::create_directories(dir);
+        for (size_t j = 0; j < content.size(); ++j) content[j] = (char)(rand() & 0xFF);
+        fs::path p = dir / "f";
+        p += std::to_string(i) + ".bin";
+        std::ofstream(p, std::ios::binary).write(content.data(), content.size());
+        paths.push_back(p.string());
+    }
+    return paths;
+}
+
+long long count_files(const fs::path& root) {
+    long long n = 0;
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->is_regular_file(ec)) ++n;
+    }
+    return n;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    long long fileCount = (argc >= 2) ? std::atoll(argv[1]) : 100000;
+    size_t fileSize = (argc >= 3) ? std::atoll(argv[2]) : 512;
+    long long sampleCount = (argc >= 4) ? std::atoll(argv[3]) : 500;
+    int port = (argc >= 5) ? std::atoi(argv[4]) : 19100;
+    sampleCount = std::min(sampleCount, fileCount);
+
+    char dirTemplate[] = "/tmp/bench_batch_XXXXXX";
+    if (!mkdtemp(dirTemplate) || chdir(dirTemplate) != 0) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    printf("corpus: %lld files x %zu bytes\n", fileCount, fileSize);
+    std::vector<std::string> paths = make_corpus("corpus", fileCount, fileSize);
+
+    // 两个阶段各用一个服务端进程，互不影响 (fork 前先 flush，避免子进程重复输出缓冲区里的内容)
+    fflush(stdout);
+    pid_t servers[2] = {spawn_server(port), spawn_server(port + 1)};
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::ofstream devnull("/dev/null");
+    std::streambuf* coutBuf = std::cout.rdbuf(devnull.rdbuf());
+
+    // 1. 逐个上传 (只计时前 sampleCount 个文件)
+    double perFileWall = 0;
+    {
+        TCPConnection conn;
+        conn.connect("127.0.0.1", port);
+        if (wait_established(conn)) {
+            double w0 = wall_seconds();
+            for (long long i = 0; i < sampleCount; ++i) upload_file(conn, paths[i]);
+            perFileWall = wall_seconds() - w0;
+        }
+    }
+
+    // 2. 批量上传整个目录
+    double batchWall = 0;
+    {
+        TCPConnection conn;
+        conn.connect("127.0.0.1", port + 1);
+        if (wait_established(conn)) {
+            double w0 = wall_seconds();
+            upload_dir(conn, "corpus");
+            batchWall = wall_seconds() - w0;
+        }
+    }
+
+    std::cout.rdbuf(coutBuf);
+
+    for (pid_t pid : servers) kill(pid, SIGTERM);
+    for (pid_t pid : servers) waitpid(pid, nullptr, 0);
+
+    long long received = count_files("received_corpus");
+    printf("per-file  %8lld files  wall %8.3f s  %10.1f files/s\n", sampleCount, perFileWall,
+           perFileWall > 0 ? sampleCount / perFileWall : 0);
+    printf("batch     %8lld files  wall %8.3f s  %10.1f files/s  (server stored %lld)\n", fileCount, batchWall,
+           batchWall > 0 ? fileCount / batchWall : 0, received);
+
+    std::string cmd = std::string("rm -rf ") + dirTemplate;
+    if (system(cmd.c_str()) != 0) fprintf(stderr, "failed to remove %s\n", dirTemplate);
+    return received == fileCount ? 0 : 1;
+}
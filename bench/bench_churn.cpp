@@ -0,0 +1,126 @@
+// 连接周转 (churn)：大量短传输背靠背地跑，每个都新建连接、下载一个小文件、再完整关闭
+// 用法: ./bench_churn [连接数] [文件字节数] [丢包%] [RTT毫秒] [起始端口] [--engine]
+//
+// 拓扑: client → 中继 (fork，丢包 / 延迟，见 udp_relay.h) → server (fork, run_server)
+// 每条连接的耗时从发起连接算到本端关闭完成 (fetch_file 返回)，包括挥手；服务端在挥手期间
+// 能不能立即接受下一个连接，直接决定每秒能完成多少次传输。--engine 时服务端用 TCPEngine。
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "file_transfer.h"
+#include "udp_relay.h"
+
+namespace {
+
+const char* FILE_NAME = "churn_bench.bin";
+
+pid_t spawn_server(int port, bool engine) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        freopen("/dev/null", "w", stdout);
+        freopen("/dev/null", "w", stderr);
+        run_server(port, engine);
+        _exit(0);
+    }
+    return pid;
+}
+
+pid_t spawn_relay(int listenPort, int serverPort, double loss, int delayMs) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        run_relay(listenPort, serverPort, loss, delayMs);
+        _exit(0);
+    }
+    return pid;
+}
+
+double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    size_t idx = std::min(v.size() - 1, (size_t)(p / 100.0 * v.size()));
+    std::nth_element(v.begin(), v.begin() + idx, v.end());
+    return v[idx];
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args;
+    bool engine = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--engine") == 0) {
+            engine = true;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    int count = args.size() >= 1 ? std::atoi(args[0].c_str()) : 200;
+    size_t fileSize = args.size() >= 2 ? std::atoll(args[1].c_str()) : 4096;
+    double loss = args.size() >= 3 ? std::atof(args[2].c_str()) : 0;
+    int rttMs = args.size() >= 4 ? std::atoi(args[3].c_str()) : 0;
+    int basePort = args.size() >= 5 ? std::atoi(args[4].c_str()) : 19400;
+
+    char dirTemplate[] = "/tmp/bench_churn_XXXXXX";
+    if (!mkdtemp(dirTemplate) || chdir(dirTemplate) != 0) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::vector<char> content(fileSize, 'x');
+    std::ofstream(FILE_NAME, std::ios::binary).write(content.data(), content.size());
+
+    printf("%d sequential fetches of %zu bytes, new connection each, loss %.1f%%, rtt %d ms, %s server\n", count,
+           fileSize, loss, rttMs, engine ? "engine" : "single-thread");
+    fflush(stdout);
+
+    // 没有丢包和延迟时直连服务端，省掉中继的转发开销
+    bool relay = loss > 0 || rttMs > 0;
+    int serverPort = relay ? basePort + 1 : basePort;
+    std::vector<pid_t> children;
+    children.push_back(spawn_server(serverPort, engine));
+    if (relay) children.push_back(spawn_relay(basePort, serverPort, loss, rttMs / 2));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::ofstream devnull("/dev/null");
+    std::streambuf* coutBuf = std::cout.rdbuf(devnull.rdbuf());
+
+    std::vector<double> ms;
+    int failures = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        auto t0 = std::chrono::steady_clock::now();
+        TransferStats stats = fetch_file("127.0.0.1", basePort, FILE_NAME, false);
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        if (stats.ok) {
+            ms.push_back(elapsed);
+        } else {
+            ++failures;
+        }
+    }
+    double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout.rdbuf(coutBuf);
+
+    for (pid_t pid : children) kill(pid, SIGTERM);
+    for (pid_t pid : children) waitpid(pid, nullptr, 0);
+
+    double sum = 0;
+    for (double v : ms) sum += v;
+    printf("fetches %4zu  failed %3d  %8.1f conn/s  mean %7.2f ms  p50 %7.2f ms  p99 %7.2f ms  max %7.2f ms\n",
+           ms.size(), failures, total > 0 ? ms.size() / total : 0, ms.empty() ? 0 : sum / ms.size(),
+           percentile(ms, 50), percentile(ms, 99), ms.empty() ? 0 : *std::max_element(ms.begin(), ms.end()));
+
+    std::string cmd = std::string("rm -rf ") + dirTemplate;
+    if (system(cmd.c_str()) != 0) fprintf(stderr, "failed to remove %s\n", dirTemplate);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,210 @@
+// 去重上传：同一个构建产物的多个版本，逐版本 upload vs upload_dedup
+// 用法: ./bench_dedup [产物MB] [版本数] [RTT毫秒] [起始端口]
+//
+// 语料模拟容器镜像层 / 打包产物：由许多随机内容的“文件”拼接而成，每个新版本修改少量文件、
+// 插入几个新文件、删掉一个旧文件，所以后面的内容整体发生偏移 (固定大小分块在这种情况下几乎全部失效)。
+// 两种模式各用一个服务端，普通上传每次都传整个文件；去重上传只传服务器块存储里没有的块。
+// 最后重启去重服务端再传一次最新版本，验证块索引落盘后依然可用。
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "file_transfer.h"
+#include "tcp_connection.h"
+#include "udp_relay.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// 服务端在 dir 下运行 (块存储和收到的文件都落在这里)
+pid_t spawn_server(int port, const std::string& dir) {
+    fs::create_directories(dir);
+    pid_t pid = fork();
+    if (pid == 0) {
+        freopen("/dev/null", "w", stdout);
+        freopen("/dev/null", "w", stderr);
+        if (chdir(dir.c_str()) != 0) _exit(1);
+        run_server(port);
+        _exit(0);
+    }
+    return pid;
+}
+
+pid_t spawn_relay(int listenPort, int serverPort, int delayMs) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        run_relay(listenPort, serverPort, 0, delayMs);
+        _exit(0);
+    }
+    return pid;
+}
+
+void stop(pid_t pid) {
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+}
+
+bool wait_established(TCPConnection& conn) {
+    for (int i = 0; i < 2000 && conn.get_state() != ESTABLISHED; ++i) {
+        conn.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return conn.get_state() == ESTABLISHED;
+}
+
+bool same_content(const std::string& a, const std::string& b) {
+    std::ifstream fa(a, std::ios::binary), fb(b, std::ios::binary);
+    if (!fa || !fb) return false;
+    return std::equal(std::istreambuf_iterator<char>(fa), std::istreambuf_iterator<char>(),
+                      std::istreambuf_iterator<char>(fb), std::istreambuf_iterator<char>());
+}
+
+// 产物里的一个“文件” (4 KB ~ 256 KB 的随机内容)
+std::string random_blob(std::mt19937_64& rng) {
+    std::string blob(4096 + rng() % (252 * 1024), '\0');
+    for (size_t i = 0; i + 8 <= blob.size(); i += 8) {
+        uint64_t v = rng();
+        memcpy(&blob[i], &v, 8);
+    }
+    return blob;
+}
+
+// 生成 versions 个版本，返回各版本的路径
+std::vector<std::string> make_versions(size_t artifactBytes, int versions, std::mt19937_64& rng) {
+    std::vector<std::string> blobs;
+    for (size_t total = 0; total < artifactBytes;) {
+        blobs.push_back(random_blob(rng));
+        total += blobs.back().size();
+    }
+
+    std::vector<std::string> paths;
+    for (int v = 0; v < versions; ++v) {
+        if (v > 0) {
+            // 约 3% 的文件被修改 (改动一小段)、插入 2 个新文件、删除 1 个旧文件
+            for (size_t i = 0; i < blobs.size() / 32 + 1; ++i) {
+                std::string& b = blobs[rng() % blobs.size()];
+                size_t at = rng() % b.size();
+                for (size_t j = at; j < std::min(b.size(), at + 512); ++j) b[j] = char(rng());
+            }
+            for (int i = 0; i < 2; ++i) blobs.insert(blobs.begin() + rng() % blobs.size(), random_blob(rng));
+            blobs.erase(blobs.begin() + rng() % blobs.size());
+        }
+        std::string path = "artifact_v" + std::to_string(v) + ".bin";
+        std::ofstream out(path, std::ios::binary);
+        for (const std::string& b : blobs) out.write(b.data(), b.size());
+        paths.push_back(path);
+    }
+    return paths;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    size_t artifactMB = (argc >= 2) ? std::atoll(argv[1]) : 16;
+    int versions = (argc >= 3) ? std::atoi(argv[2]) : 5;
+    int rttMs = (argc >= 4) ? std::atoi(argv[3]) : 0;
+    int basePort = (argc >= 5) ? std::atoi(argv[4]) : 19400;
+
+    char dirTemplate[] = "/tmp/bench_dedup_XXXXXX";
+    if (!mkdtemp(dirTemplate) || chdir(dirTemplate) != 0) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::mt19937_64 rng(42);
+    std::vector<std::string> paths = make_versions(artifactMB * 1024 * 1024, versions, rng);
+    printf("artifact %zu MB, %d versions, rtt %d ms\n", artifactMB, versions, rttMs);
+
+    // 普通上传: basePort → basePort+1；去重上传: basePort+2 → basePort+3 (RTT 为 0 时不经过中继)
+    fflush(stdout);
+    auto client_port = [&](int i) { return rttMs > 0 ? basePort + 2 * i : basePort + 2 * i + 1; };
+    std::vector<pid_t> relays;
+    pid_t plainServer = spawn_server(basePort + 1, "plain");
+    pid_t dedupServer = spawn_server(basePort + 3, "dedup");
+    if (rttMs > 0) {
+        for (int i = 0; i < 2; ++i) relays.push_back(spawn_relay(basePort + 2 * i, basePort + 2 * i + 1, rttMs / 2));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::ofstream devnull("/dev/null");
+    std::streambuf* coutBuf = std::cout.rdbuf(devnull.rdbuf());
+
+    std::vector<double> plainSeconds(versions, 0);
+    std::vector<DedupStats> dedup(versions);
+    {
+        TCPConnection conn;
+        conn.connect("127.0.0.1", client_port(0));
+        if (wait_established(conn)) {
+            for (int v = 0; v < versions; ++v) {
+                auto t0 = std::chrono::steady_clock::now();
+                upload_file(conn, paths[v]);
+                plainSeconds[v] = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            }
+        }
+    }
+    {
+        TCPConnection conn;
+        conn.connect("127.0.0.1", client_port(1));
+        if (wait_established(conn)) {
+            for (int v = 0; v < versions; ++v) dedup[v] = upload_file_dedup(conn, paths[v]);
+        }
+    }
+
+    // 重启去重服务端 (同一目录)，块存储重新打开后最新版本应当一个块都不用传
+    stop(dedupServer);
+    fflush(stdout);
+    dedupServer = spawn_server(basePort + 3, "dedup");
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    DedupStats restart;
+    {
+        TCPConnection conn;
+        conn.connect("127.0.0.1", client_port(1));
+        if (wait_established(conn)) restart = upload_file_dedup(conn, paths.back());
+    }
+
+    std::cout.rdbuf(coutBuf);
+    for (pid_t pid : relays) stop(pid);
+    stop(plainServer);
+    stop(dedupServer);
+
+    printf("%-8s %10s %10s %10s %10s %8s %8s\n", "version", "size KB", "plain s", "dedup s", "sent KB", "chunks",
+           "ratio");
+    long long totalBytes = 0, totalSent = 0;
+    double plainTotal = 0, dedupTotal = 0;
+    int failures = 0;
+    for (int v = 0; v < versions; ++v) {
+        const DedupStats& s = dedup[v];
+        bool ok = s.ok && same_content(paths[v], "dedup/received_" + paths[v]);
+        if (!ok) ++failures;
+        totalBytes += s.bytes;
+        totalSent += s.sent_bytes;
+        plainTotal += plainSeconds[v];
+        dedupTotal += s.seconds;
+        printf("v%-7d %10lld %10.3f %10.3f %10lld %3lld/%-4lld %7.1fx%s\n", v, s.bytes / 1024, plainSeconds[v],
+               s.seconds, s.sent_bytes / 1024, s.sent_chunks, s.chunks,
+               s.sent_bytes > 0 ? (double)s.bytes / s.sent_bytes : 0.0, ok ? "" : "  FAIL");
+    }
+    printf("total    %10lld %10.3f %10.3f %10lld %17.1fx (cumulative)\n", totalBytes / 1024, plainTotal, dedupTotal,
+           totalSent / 1024, totalSent > 0 ? (double)totalBytes / totalSent : 0.0);
+    bool restartOk = restart.ok && restart.sent_chunks == 0;
+    printf("restart  %10lld %10s %10.3f %10lld %3lld/%-4lld %s\n", restart.bytes / 1024, "-", restart.seconds,
+           restart.sent_bytes / 1024, restart.sent_chunks, restart.chunks, restartOk ? "(index reused)" : "FAIL");
+
+    std::string cmd = std::string("rm -rf ") + dirTemplate;
+    if (system(cmd.c_str()) != 0) fprintf(stderr, "failed to remove %s\n", dirTemplate);
+    return failures == 0 && restartOk ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+// 短连接延迟：每个请求一条新连接，Fast Open (请求随 SYN 发出) vs 普通握手
+// 用法: ./bench_fast_open [RTT毫秒] [请求数] [文件字节数] [起始端口]
+//
+// 拓扑: client → 延迟中继 (fork, 每个方向 RTT/2) → server (fork, run_server)
+// 每次 fetch_file 都新建连接下载同一个小文件，统计从发起连接到收完文件的耗时。
+// 普通握手至少 2 个 RTT (握手 + 请求/响应)，Fast Open 第一次取得 cookie 后只需 1 个 RTT。
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "file_transfer.h"
+#include "udp_relay.h"
+
+namespace {
+
+const char* FILE_NAME = "fetch_bench.bin";
+
+pid_t spawn_server(int port) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        freopen("/dev/null", "w", stdout);
+        freopen("/dev/null", "w", stderr);
+        run_server(port);
+        _exit(0);
+    }
+    return pid;
+}
+
+pid_t spawn_relay(int listenPort, int serverPort, int delayMs) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        run_relay(listenPort, serverPort, 0, delayMs);
+        _exit(0);
+    }
+    return pid;
+}
+
+double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    size_t idx = std::min(v.size() - 1, (size_t)(p / 100.0 * v.size()));
+    std::nth_element(v.begin(), v.begin() + idx, v.end());
+    return v[idx];
+}
+
+// 顺序发 count 个请求，返回每个请求的耗时 (ms)；失败的请求不计入
+std::vector<double> run_fetches(int port, int count, bool fastOpen, int& failures) {
+    std::vector<double> ms;
+    for (int i = 0; i < count; ++i) {
+        TransferStats stats = fetch_file("127.0.0.1", port, FILE_NAME, fastOpen);
+        if (stats.ok) {
+            ms.push_back(stats.seconds * 1000);
+        } else {
+            ++failures;
+        }
+    }
+    return ms;
+}
+
+void report(const char* name, const std::vector<double>& ms, int failures) {
+    double sum = 0;
+    for (double v : ms) sum += v;
+    printf("%-9s fetches %4zu  failed %2d  mean %8.2f ms  p50 %8.2f ms  p90 %8.2f ms\n", name, ms.size(), failures,
+           ms.empty() ? 0 : sum / ms.size(), percentile(ms, 50), percentile(ms, 90));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int rttMs = (argc >= 2) ? std::atoi(argv[1]) : 20;
+    int count = (argc >= 3) ? std::atoi(argv[2]) : 50;
+    size_t fileSize = (argc >= 4) ? std::atoll(argv[3]) : 1000;
+    int basePort = (argc >= 5) ? std::atoi(argv[4]) : 19300;
+
+    char dirTemplate[] = "/tmp/bench_fast_open_XXXXXX";
+    if (!mkdtemp(dirTemplate) || chdir(dirTemplate) != 0) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::vector<char> content(fileSize, 'x');
+    std::ofstream(FILE_NAME, std::ios::binary).write(content.data(), content.size());
+
+    printf("rtt %d ms, %d sequential fetches of %zu bytes, new connection per fetch\n", rttMs, count, fileSize);
+    fflush(stdout);
+
+    // 两种模式各用一个服务端 (普通握手: basePort → basePort+1；Fast Open: basePort+2 → basePort+3)
+    std::vector<pid_t> children;
+    for (int i = 0; i < 2; ++i) {
+        children.push_back(spawn_server(basePort + 2 * i + 1));
+        children.push_back(spawn_relay(basePort + 2 * i, basePort + 2 * i + 1, rttMs / 2));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::ofstream devnull("/dev/null");
+    std::streambuf* coutBuf = std::cout.rdbuf(devnull.rdbuf());
+
+    int plainFailures = 0, tfoFailures = 0;
+    std::vector<double> plain = run_fetches(basePort, count, false, plainFailures);
+    // 第一次连接只能取得 cookie (仍是普通握手)，不计入
+    fetch_file("127.0.0.1", basePort + 2, FILE_NAME, true);
+    std::vector<double> tfo = run_fetches(basePort + 2, count, true, tfoFailures);
+
+    std::cout.rdbuf(coutBuf);
+
+    for (pid_t pid : children) kill(pid, SIGTERM);
+    for (pid_t pid : children) waitpid(pid, nullptr, 0);
+
+    report("handshake", plain, plainFailures);
+    report("fast-open", tfo, tfoFailures);
+
+    std::string cmd = std::string("rm -rf ") + dirTemplate;
+    if (system(cmd.c_str()) != 0) fprintf(stderr, "failed to remove %s\n", dirTemplate);
+    return plainFailures + tfoFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+// FEC 在不同丢包率下的有效吞吐 (goodput) 与冗余开销
+// 用法: ./bench_fec [每次传输MB] [RTT毫秒] [起始端口]
+//
+// 拓扑: sender → 丢包 + 延迟中继 (fork) → receiver (fork，逐字节校验内容)
+// 每个丢包率 (0/1/3/5/10%) 下依次跑: 不开 FEC、XOR (k=8，自适应)、RS (k=10, m<=4，自适应)，
+// 输出 goodput、校验段占数据段的比例、接收端用校验段恢复的段数。
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fec.h"
+#include "tcp_connection.h"
+#include "udp_relay.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const size_t SEGMENT = MAX_PACKET_SIZE - sizeof(TCPHeader);
+const int RUN_TIMEOUT_S = 60;
+
+struct ReceiverResult {
+    long long bytes = 0;
+    long long corrupt = 0;
+    long long recovered = 0;
+};
+
+uint8_t pattern(long long offset) { return uint8_t(offset * 131 + (offset >> 11)); }
+
+// 等到 socket 上有包或者 1ms 过去 (单核上不空转，给中继和对端让出 CPU)
+void wait_io(TCPConnection& conn) {
+    pollfd pfd{conn.native_handle(), POLLIN, 0};
+    poll(&pfd, 1, 1);
+}
+
+// 接收端：收满 total 字节 (或超时) 后把结果写进管道
+void run_receiver(int port, long long total, int resultFd) {
+    TCPConnection conn;
+    conn.bind(port);
+    ReceiverResult r;
+    std::vector<char> buf(64 * 1024);
+    auto deadline = Clock::now() + std::chrono::seconds(RUN_TIMEOUT_S);
+    while (r.bytes < total && Clock::now() < deadline) {
+        conn.update();
+        size_t n = conn.receive(buf.data(), buf.size());
+        if (n == (size_t)-1) break;
+        if (n == 0) {
+            wait_io(conn);
+            continue;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (uint8_t(buf[i]) != pattern(r.bytes + i)) ++r.corrupt;
+        }
+        r.bytes += n;
+    }
+    // 多留一会儿把最后的 ACK 发出去
+    auto linger = Clock::now() + std::chrono::milliseconds(300);
+    while (Clock::now() < linger) {
+        conn.update();
+        wait_io(conn);
+    }
+    r.recovered = conn.fec_stats().recovered_segments;
+    if (write(resultFd, &r, sizeof(r)) != sizeof(r)) perror("write");
+}
+
+struct RunResult {
+    double seconds = 0;
+    long long dataSegments = 0;
+    long long paritySent = 0;
+    ReceiverResult rx;
+    bool ok = false;
+};
+
+RunResult run_once(int basePort, double loss, int rttMs, long long total, const FecConfig& fec) {
+    RunResult res;
+    int fds[2];
+    if (pipe(fds) != 0) return res;
+
+    pid_t receiver = fork();
+    if (receiver == 0) {
+        close(fds[0]);
+        run_receiver(basePort + 1, total, fds[1]);
+        _exit(0);
+    }
+    pid_t relay = fork();
+    if (relay == 0) {
+        srand(getpid());
+        run_relay(basePort, basePort + 1, loss, rttMs / 2);
+        _exit(0);
+    }
+    close(fds[1]);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    TCPConnection conn;
+    conn.set_fec(fec);
+    conn.connect("127.0.0.1", basePort);
+    auto deadline = Clock::now() + std::chrono::seconds(RUN_TIMEOUT_S);
+    while (conn.get_state() != ESTABLISHED && Clock::now() < deadline) {
+        conn.update();
+        wait_io(conn);
+    }
+
+    std::vector<char> seg(SEGMENT);
+    long long sent = 0;
+    auto start = Clock::now();
+    while ((sent < total || !conn.is_send_complete()) && Clock::now() < deadline) {
+        conn.update();
+        bool progress = false;
+        while (sent < total) {
+            size_t n = std::min<long long>(SEGMENT, total - sent);
+            for (size_t i = 0; i < n; ++i) seg[i] = char(pattern(sent + i));
+            if (!conn.send(seg.data(), n)) break;
+            sent += n;
+            ++res.dataSegments;
+            progress = true;
+        }
+        if (!progress) wait_io(conn);
+    }
+    res.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    res.paritySent = conn.fec_stats().parity_sent;
+
+    // 接收端在收满后写结果
+    pollfd pfd{fds[0], POLLIN, 0};
+    if (poll(&pfd, 1, 2000) > 0 && read(fds[0], &res.rx, sizeof(res.rx)) == sizeof(res.rx)) {
+        res.ok = res.rx.bytes == total && res.rx.corrupt == 0;
+    }
+    close(fds[0]);
+    kill(relay, SIGTERM);
+    kill(receiver, SIGTERM);
+    waitpid(relay, nullptr, 0);
+    waitpid(receiver, nullptr, 0);
+    return res;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    double megabytes = (argc >= 2) ? std::atof(argv[1]) : 4;
+    int rttMs = (argc >= 3) ? std::atoi(argv[2]) : 20;
+    int port = (argc >= 4) ? std::atoi(argv[3]) : 19400;
+    long long total = (long long)(megabytes * 1024 * 1024);
+
+    struct Mode {
+        const char* name;
+        const char* spec;  // nullptr 表示不开 FEC
+    };
+    const Mode modes[] = {{"off", nullptr}, {"xor:8", "xor:8"}, {"rs:10,4", "rs:10,4"}};
+    const double losses[] = {0, 1, 3, 5, 10};
+
+    printf("%.1f MB per run, rtt %d ms, loss applied in both directions\n", megabytes, rttMs);
+    printf("%-6s %-8s %10s %10s %10s %8s\n", "loss%", "fec", "goodput", "overhead", "recovered", "verify");
+    fflush(stdout);
+
+    bool allOk = true;
+    for (double loss : losses) {
+        for (const Mode& mode : modes) {
+            FecConfig fec;
+            if (mode.spec) parse_fec_config(mode.spec, fec);
+            RunResult r = run_once(port, loss, rttMs, total, fec);
+            port += 2;
+            double goodput = r.seconds > 0 ? megabytes / r.seconds : 0;
+            double overhead = r.dataSegments > 0 ? 100.0 * r.paritySent / r.dataSegments : 0;
+            printf("%-6.1f %-8s %7.2f MB/s %9.1f%% %10lld %8s\n", loss, mode.name, goodput, overhead, r.rx.recovered,
+                   r.ok ? "ok" : "FAIL");
+            fflush(stdout);
+            allOk = allOk && r.ok;
+        }
+    }
+    return allOk ? 0 : 1;
+}
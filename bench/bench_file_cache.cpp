@@ -0,0 +1,160 @@
+// 热点文件缓存：同一个文件被反复下载时，服务端每个请求的开销与端到端耗时
+// 用法: ./bench_file_cache [文件MB] [请求数] [起始端口]
+//
+// 1. 进程内：逐个请求“打开 + 读文件 + 分段” (SparseFileReader) vs 从 FileCache 取出后遍历分段，只计服务端这一侧的工作
+// 2. 端到端：两个服务端 (缓存关闭 / 开启)，每个请求一条新连接 (fetch_file) 下载同一个文件
+// 3. 修改文件后再下载一次，验证缓存按 mtime / inode 失效，客户端拿到的是新内容
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "file_cache.h"
+#include "file_transfer.h"
+
+namespace {
+
+const char* FILE_NAME = "hot.bin";
+
+pid_t spawn_server(int port, size_t cacheBytes) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        freopen("/dev/null", "w", stdout);
+        freopen("/dev/null", "w", stderr);
+        FileCache::global().set_capacity(cacheBytes);
+        run_server(port);
+        _exit(0);
+    }
+    return pid;
+}
+
+void write_file(size_t bytes, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<char> content(bytes);
+    for (char& c : content) c = char(rng());
+    std::ofstream(FILE_NAME, std::ios::binary | std::ios::trunc).write(content.data(), content.size());
+}
+
+bool same_content(const std::string& a, const std::string& b) {
+    std::ifstream fa(a, std::ios::binary), fb(b, std::ios::binary);
+    if (!fa || !fb) return false;
+    return std::equal(std::istreambuf_iterator<char>(fa), std::istreambuf_iterator<char>(),
+                      std::istreambuf_iterator<char>(fb), std::istreambuf_iterator<char>());
+}
+
+// 模拟发送：把每个数据段拷进一个段大小的缓冲区 (send_app_msg 也要拷这一次)
+template <typename Reader>
+long long drain(Reader& reader) {
+    static char seg[1024];
+    long long total = 0;
+    SparseFileReader::Extent ext;
+    while (reader.next(ext)) {
+        for (long long off = 0; !ext.hole && off < ext.length; off += sizeof(seg)) {
+            std::copy_n(ext.data + off, std::min<long long>(sizeof(seg), ext.length - off), seg);
+        }
+        total += ext.length;
+    }
+    return total;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    size_t idx = std::min(v.size() - 1, (size_t)(p / 100.0 * v.size()));
+    std::nth_element(v.begin(), v.begin() + idx, v.end());
+    return v[idx];
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    size_t fileMB = (argc >= 2) ? std::atoll(argv[1]) : 4;
+    int requests = (argc >= 3) ? std::atoi(argv[2]) : 20;
+    int basePort = (argc >= 4) ? std::atoi(argv[3]) : 19500;
+
+    char dirTemplate[] = "/tmp/bench_file_cache_XXXXXX";
+    if (!mkdtemp(dirTemplate) || chdir(dirTemplate) != 0) {
+        perror("mkdtemp");
+        return 1;
+    }
+    write_file(fileMB * 1024 * 1024, 1);
+    printf("file %zu MB, %d requests\n", fileMB, requests);
+
+    // 1. 服务端每个请求的工作量 (文件在 page cache 里，这是磁盘路径最好的情况)
+    int rounds = requests * 10;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        SparseFileReader reader;
+        reader.open(FILE_NAME);
+        drain(reader);
+    }
+    double diskPerReq = seconds_since(t0) / rounds;
+    FileCache cache;
+    cache.get(FILE_NAME);  // 第一次加载不计入
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        CachedFileReader reader(cache.get(FILE_NAME));
+        drain(reader);
+    }
+    double cachePerReq = seconds_since(t0) / rounds;
+    printf("server work  disk %8.3f ms/req (%7.1f MB/s)   cache %8.3f ms/req (%7.1f MB/s)   hit ratio %.2f\n",
+           diskPerReq * 1000, fileMB / diskPerReq, cachePerReq * 1000, fileMB / cachePerReq,
+           cache.stats().hit_ratio());
+
+    // 2. 端到端
+    fflush(stdout);
+    pid_t servers[2] = {spawn_server(basePort, 0), spawn_server(basePort + 1, FileCache::DEFAULT_CAPACITY)};
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::ofstream devnull("/dev/null");
+    std::streambuf* coutBuf = std::cout.rdbuf(devnull.rdbuf());
+    std::vector<double> ms[2];
+    int failures = 0;
+    for (int i = 0; i < 2; ++i) {
+        fetch_file("127.0.0.1", basePort + i, FILE_NAME, true);  // 取 Fast Open cookie，缓存也在这次加载
+        for (int r = 0; r < requests; ++r) {
+            TransferStats stats = fetch_file("127.0.0.1", basePort + i, FILE_NAME, true);
+            if (stats.ok) {
+                ms[i].push_back(stats.seconds * 1000);
+            } else {
+                ++failures;
+            }
+        }
+    }
+
+    // 3. 改写文件后立即再下载
+    write_file(fileMB * 1024 * 1024, 2);
+    bool fresh = fetch_file("127.0.0.1", basePort + 1, FILE_NAME, true).ok &&
+                 same_content(FILE_NAME, std::string("downloaded_") + FILE_NAME);
+    std::cout.rdbuf(coutBuf);
+
+    for (pid_t pid : servers) kill(pid, SIGTERM);
+    for (pid_t pid : servers) waitpid(pid, nullptr, 0);
+
+    const char* names[2] = {"no cache", "cache"};
+    for (int i = 0; i < 2; ++i) {
+        double sum = 0;
+        for (double v : ms[i]) sum += v;
+        printf("fetch %-9s ok %4zu  mean %8.2f ms  p50 %8.2f ms  p90 %8.2f ms\n", names[i], ms[i].size(),
+               ms[i].empty() ? 0 : sum / ms[i].size(), percentile(ms[i], 50), percentile(ms[i], 90));
+    }
+    printf("after rewrite: %s\n", fresh ? "new content served (invalidated)" : "FAIL (stale or failed)");
+
+    std::string cmd = std::string("rm -rf ") + dirTemplate;
+    if (system(cmd.c_str()) != 0) fprintf(stderr, "failed to remove %s\n", dirTemplate);
+    return failures == 0 && fresh ? 0 : 1;
+}
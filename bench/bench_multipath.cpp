@@ -0,0 +1,249 @@
+// 多路径：几条损伤不同的路径上，单路径 vs 多路径 (两种调度器) 的上传吞吐
+// 用法: ./bench_multipath [选项]
+//   --path <spec>   一条路径两个方向的损伤 (格式见 include/netem.h)，可以重复，最多 8 条；
+//                   默认两条: delay=5,rate=40000 (10ms RTT, 40 Mbit/s) 和 delay=20,rate=16000 (40ms RTT, 16 Mbit/s)
+//   --mb <n>        上传的数据量 (默认 16)
+//   --port <n>      起始端口 (默认 19800，每个场景换一个)
+//
+// 拓扑 (都在本机的 127.0.0.0/8 上，第 i 条路径用三个不同的地址):
+//   client 127.0.1.<i+1> → netem_proxy (fork) 127.0.2.<i+1>:port → server (fork) 127.0.3.<i+1>:port
+// 客户端从每个本地地址各开一条子流，服务端在每个地址上各接受一条子流。
+// 场景: 每条路径单独跑一次 (只开这一条子流)，再所有路径一起跑 lowest-rtt 和 most-cwnd 两种调度器。
+// 服务端按偏移检查收到的每个字节 (连接级重组是否正确)，收完后回复字节数和错误数；
+// 客户端从开始写数据到读到回复计时。
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "multipath.h"
+#include "netem.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const int RUN_TIMEOUT_S = 60;
+
+std::string client_ip(size_t i) { return "127.0.1." + std::to_string(i + 1); }
+std::string proxy_ip(size_t i) { return "127.0.2." + std::to_string(i + 1); }
+std::string server_ip(size_t i) { return "127.0.3." + std::to_string(i + 1); }
+
+// 连接级字节流中第 offset 个字节的内容
+char pattern(uint64_t offset) { return char((offset * 131) ^ (offset >> 11)); }
+
+struct Reply {
+    uint64_t bytes;
+    uint64_t errors;  // 内容不对的字节数
+};
+
+// ---------------- 服务端 / 代理 ----------------
+
+[[noreturn]] void serve(size_t paths, int port) {
+    MultipathConnection mp(true);
+    for (size_t i = 0; i < paths; ++i) {
+        if (!mp.listen(server_ip(i), port)) _exit(1);
+    }
+    Reply r{0, 0};
+    char buf[64 * 1024];
+    while (true) {
+        mp.update();
+        size_t n = mp.read(buf, sizeof(buf));
+        if (n == (size_t)-1) break;
+        for (size_t k = 0; k < n; ++k) r.errors += buf[k] != pattern(r.bytes + k);
+        r.bytes += n;
+        if (n == 0) std::this_thread::yield();
+    }
+    mp.write(&r, sizeof(r));
+    mp.finish();
+    // 客户端读到回复后结束整个场景
+    while (true) {
+        mp.update();
+        std::this_thread::yield();
+    }
+}
+
+pid_t spawn_server(size_t paths, int port) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        freopen("/dev/null", "w", stdout);
+        serve(paths, port);
+    }
+    return pid;
+}
+
+pid_t spawn_proxy(size_t i, int port, const NetemConfig& link) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        freopen("/dev/null", "w", stderr);
+        run_netem_proxy(port, server_ip(i), port, link, link, i + 1, 0, proxy_ip(i));
+        _exit(0);
+    }
+    return pid;
+}
+
+// ---------------- 客户端 ----------------
+
+struct RunResult {
+    bool ok = false;
+    double seconds = 0;
+    std::vector<MultipathConnection::SubflowInfo> subflows;
+};
+
+RunResult run_client(const std::vector<size_t>& paths, int port, uint64_t total,
+                     MultipathConnection::Scheduler scheduler) {
+    RunResult result;
+    MultipathConnection mp(false);
+    mp.set_scheduler(scheduler);
+    for (size_t i : paths) {
+        if (!mp.add_subflow(client_ip(i), proxy_ip(i), port)) return result;
+    }
+    auto deadline = Clock::now() + std::chrono::seconds(RUN_TIMEOUT_S);
+
+    // 等所有子流都加入，否则开头的数据全走先建立的那条
+    auto joined = [&] {
+        for (size_t k = 0; k < mp.subflow_count(); ++k) {
+            if (!mp.subflow_info(k).joined) return false;
+        }
+        return true;
+    };
+    while (!joined()) {
+        if (Clock::now() > deadline) return result;
+        mp.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::vector<char> chunk(16 * 1024);
+    uint64_t written = 0;
+    Reply reply{};
+    size_t got = 0;
+    auto t0 = Clock::now();
+    while (got < sizeof(reply)) {
+        if (Clock::now() > deadline) return result;
+        while (written < total) {
+            size_t m = std::min<uint64_t>(chunk.size(), total - written);
+            for (size_t k = 0; k < m; ++k) chunk[k] = pattern(written + k);
+            size_t n = mp.write(chunk.data(), m);
+            written += n;
+            if (n < m) break;
+        }
+        if (written == total) mp.finish();
+        mp.update();
+        size_t n = mp.read(reinterpret_cast<char*>(&reply) + got, sizeof(reply) - got);
+        if (n == (size_t)-1) return result;
+        got += n;
+        if (n == 0) std::this_thread::yield();
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+    for (size_t k = 0; k < mp.subflow_count(); ++k) result.subflows.push_back(mp.subflow_info(k));
+    result.ok = reply.bytes == total && reply.errors == 0;
+    if (!result.ok) {
+        fprintf(stderr, "server received %llu bytes (%llu wrong), expected %llu\n", (unsigned long long)reply.bytes,
+                (unsigned long long)reply.errors, (unsigned long long)total);
+    }
+    mp.close();
+    return result;
+}
+
+// 一个场景：拉起服务端和所有代理，跑一次客户端，再全部结束
+RunResult run_scenario(const std::vector<NetemConfig>& links, const std::vector<size_t>& paths, int port,
+                       uint64_t total, MultipathConnection::Scheduler scheduler) {
+    fflush(stdout);  // 子进程不要再输出一遍缓冲里的内容
+    std::vector<pid_t> pids;
+    pids.push_back(spawn_server(links.size(), port));
+    for (size_t i = 0; i < links.size(); ++i) pids.push_back(spawn_proxy(i, port, links[i]));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    RunResult r = run_client(paths, port, total, scheduler);
+
+    for (pid_t pid : pids) kill(pid, SIGKILL);
+    for (pid_t pid : pids) waitpid(pid, nullptr, 0);
+    return r;
+}
+
+void print_result(const std::string& name, const RunResult& r, uint64_t total, const std::vector<size_t>& paths) {
+    if (!r.ok) {
+        printf("%-22s  FAILED\n", name.c_str());
+        return;
+    }
+    printf("%-22s %8.2f %8.2f   ", name.c_str(), total / r.seconds / (1024 * 1024), r.seconds);
+    for (size_t k = 0; k < r.subflows.size(); ++k) {
+        const MultipathConnection::SubflowInfo& s = r.subflows[k];
+        long long retx = s.tcp.fast_retransmits + s.tcp.rto_retransmits + s.tcp.tlp_probes;
+        printf(" p%zu %3.0f%% %5.1fms r%-4lld", paths[k], 100.0 * s.bytes / total, s.tcp.srtt_us / 1000.0, retx);
+    }
+    printf("\n");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> specs;
+    uint64_t mb = 16;
+    int port = 19800;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return 1;
+        }
+        std::string val = argv[++i];
+        if (arg == "--path") {
+            specs.push_back(val);
+        } else if (arg == "--mb") {
+            mb = std::strtoull(val.c_str(), nullptr, 10);
+        } else if (arg == "--port") {
+            port = std::atoi(val.c_str());
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+            return 1;
+        }
+    }
+    if (specs.empty()) specs = {"delay=5,rate=40000", "delay=20,rate=16000"};
+    if (specs.size() > MultipathConnection::MAX_SUBFLOWS) {
+        fprintf(stderr, "At most %zu paths\n", MultipathConnection::MAX_SUBFLOWS);
+        return 1;
+    }
+
+    std::vector<NetemConfig> links(specs.size());
+    for (size_t i = 0; i < specs.size(); ++i) {
+        if (!parse_netem_config(specs[i], links[i])) {
+            fprintf(stderr, "Invalid path spec: %s\n", specs[i].c_str());
+            return 1;
+        }
+        printf("path %zu: %s -> %s -> %s  %s\n", i, client_ip(i).c_str(), proxy_ip(i).c_str(), server_ip(i).c_str(),
+               describe_netem_config(links[i]).c_str());
+    }
+    uint64_t total = mb * 1024 * 1024;
+    printf("\n%-22s %8s %8s    per subflow: share of data, srtt, retransmits\n", "scenario", "MB/s", "time_s");
+
+    bool allOk = true;
+    double bestSingle = 0;
+    for (size_t i = 0; i < links.size(); ++i) {
+        RunResult r = run_scenario(links, {i}, port++, total, MultipathConnection::SCHED_LOWEST_RTT);
+        print_result("path " + std::to_string(i) + " only", r, total, {i});
+        if (r.ok) bestSingle = std::max(bestSingle, total / r.seconds);
+        allOk = allOk && r.ok;
+    }
+
+    std::vector<size_t> all(links.size());
+    for (size_t i = 0; i < all.size(); ++i) all[i] = i;
+    const std::pair<const char*, MultipathConnection::Scheduler> schedulers[] = {
+        {"multipath lowest-rtt", MultipathConnection::SCHED_LOWEST_RTT},
+        {"multipath most-cwnd", MultipathConnection::SCHED_MOST_CWND},
+    };
+    for (const auto& sc : schedulers) {
+        RunResult r = run_scenario(links, all, port++, total, sc.second);
+        print_result(sc.first, r, total, all);
+        if (r.ok && bestSingle > 0) printf("%-22s %7.2fx of the best single path\n", "", total / r.seconds / bestSingle);
+        allOk = allOk && r.ok;
+    }
+    return allOk ? 0 : 1;
+}
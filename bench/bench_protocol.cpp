@@ -0,0 +1,517 @@
+// 协议热路径微基准：不经过真实网络，把合成的包流直接喂给 TCPConnection 的内部函数
+// 用法: ./bench_protocol [--packets N] [--repeat R] [--filter 子串]
+//
+// 覆盖 calculate_checksum、process_packet 的接收和重组 (按序 / 乱序 / 丢包后重传)、send() 与 send_queue 的
+// ACK 清理、check_timeout 的扫描和超时重传、process_app_messages 的分帧，以及打开包级追踪后的额外开销。每项重复 R 次取中位数，输出
+// ns/op、每 op 的堆分配次数，以及 perf_event_open 可用时的 cache miss/op (不可用时为 n/a)
+//
+// 连接的 socket 被关掉，ACK 等发出的包仍然完整地拼装、算校验和，只在 TCPSocket::send 里直接返回 -1 (不进内核)；
+// 这一步本身的开销列在 floor/failed-send 一行，所以结果只反映协议代码，不含系统调用
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "app_framing.h"
+#include "batch_transfer.h"
+#include "tcp_connection.h"
+#include "tcp_protocol.h"
+
+// ---------------- 堆分配计数 ----------------
+
+namespace {
+uint64_t g_allocs = 0;
+}  // namespace
+
+void* operator new(size_t n) {
+    ++g_allocs;
+    if (void* p = malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+// TCPConnection 的友元：跳过 socket 和握手，直接操作内部状态
+struct TCPConnectionProbe {
+    // 进入 ESTABLISHED：下一个发送序号为 snd，期望收到的序号为 rcv；关掉 socket，之后发出的包都直接失败。
+    // 关掉 pacing：基准在一轮 ACK 之后立刻再发一窗，按墙钟放行的发送节奏会让 send() 随机地返回 false
+    static void establish(TCPConnection& c, uint32_t snd, uint32_t rcv) {
+        c.socket.close();
+        c.set_pacing(false);
+        c.state = ESTABLISHED;
+        c.snd_una = c.snd_nxt = snd;
+        c.rcv_nxt = c.rcv_wnd_edge = rcv;
+        c.rx.reset(rcv);
+    }
+    // 与 update() 收到一个包时的处理相同：校验和 + 状态机
+    static bool deliver(TCPConnection& c, const std::vector<char>& pkt) {
+        static const Endpoint src;
+        if (c.calculate_checksum(pkt.data(), pkt.size()) != 0) return false;
+        c.process_packet(*(const TCPHeader*)pkt.data(), pkt.data() + sizeof(TCPHeader),
+                         int(pkt.size() - sizeof(TCPHeader)), src);
+        return true;
+    }
+    static uint16_t checksum(TCPConnection& c, const void* data, size_t len) {
+        return c.calculate_checksum(data, len);
+    }
+    static void check_timeout(TCPConnection& c) { c.check_timeout(); }
+    // 让发送队列里的段全部超时
+    static void expire_all(TCPConnection& c) {
+        for (auto& seg : c.send_queue) seg.last_send_time -= std::chrono::seconds(1);
+    }
+    static size_t send_queue_size(const TCPConnection& c) { return c.send_queue.size(); }
+    static size_t buffered(const TCPConnection& c) { return c.rx.readable(); }
+    static uint32_t rcv_nxt(const TCPConnection& c) { return c.rcv_nxt; }
+    static uint32_t snd_nxt(const TCPConnection& c) { return c.snd_nxt; }
+    static int failed_send(TCPConnection& c, const void* data, int len) { return c.socket.send(data, len); }
+    static void trace_event(TCPConnection& c, uint32_t seq, uint32_t ack, uint32_t len) {
+        c.trace_event(TRACE_PACKET_SENT, FLAG_ACK, seq, ack, 65536, len);
+    }
+};
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Probe = TCPConnectionProbe;
+
+const size_t SEG = BATCH_SEGMENT_SIZE;  // 每个数据段的 payload
+const size_t ROUND = 1024;              // 接收测试每轮的段数 (每轮重新打上序号)
+const uint32_t RX_ISN = 1000;           // 对端的起始序号
+const uint32_t TX_ISN = 7000;           // 本端的起始序号
+
+struct Options {
+    size_t packets = 200000;
+    int repeat = 5;
+    std::string filter;
+};
+
+// ---------------- 计量 ----------------
+
+// cache miss 计数 (只统计用户态)；容器里 / perf_event_paranoid 太高时打不开，available() 为 false
+class PerfCounter {
+public:
+    PerfCounter() {
+        perf_event_attr attr{};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+    ~PerfCounter() {
+        if (fd >= 0) ::close(fd);
+    }
+    bool available() const { return fd >= 0; }
+    uint64_t read() const {
+        uint64_t v = 0;
+        if (fd >= 0 && ::read(fd, &v, sizeof(v)) != sizeof(v)) v = 0;
+        return v;
+    }
+
+private:
+    int fd = -1;
+};
+
+struct Result {
+    uint64_t ops = 0;
+    double ns = 0;
+    uint64_t allocs = 0;
+    uint64_t misses = 0;
+    double ns_per_op() const { return ops ? ns / ops : 0; }
+};
+
+// 只有 start() 和 stop() 之间的部分计入结果；准备数据 (打序号、算校验和) 放在外面
+class Meter {
+public:
+    explicit Meter(const PerfCounter& pc) : perf(pc) {}
+    void start() {
+        m0 = perf.read();
+        a0 = g_allocs;
+        t0 = Clock::now();
+    }
+    void stop(uint64_t ops) {
+        auto t1 = Clock::now();
+        uint64_t a1 = g_allocs;
+        uint64_t m1 = perf.read();
+        result.ns += std::chrono::duration<double, std::nano>(t1 - t0).count();
+        result.allocs += a1 - a0;
+        result.misses += m1 - m0;
+        result.ops += ops;
+    }
+    Result result;
+
+private:
+    const PerfCounter& perf;
+    Clock::time_point t0;
+    uint64_t a0 = 0, m0 = 0;
+};
+
+[[noreturn]] void fail(const char* bench, const char* what) {
+    fprintf(stderr, "%s: %s\n", bench, what);
+    exit(1);
+}
+
+// ---------------- 合成包流 ----------------
+
+// 给包打上序号 / 确认号并重新计算校验和 (payload 不变)
+void stamp(TCPConnection& c, std::vector<char>& pkt, uint32_t seq, uint32_t ack) {
+    TCPHeader h;
+    memcpy(&h, pkt.data(), sizeof(h));
+    h.seq_num = htonl(seq);
+    h.ack_num = htonl(ack);
+    h.checksum = 0;
+    memcpy(pkt.data(), &h, sizeof(h));
+    h.checksum = Probe::checksum(c, pkt.data(), pkt.size());
+    memcpy(pkt.data(), &h, sizeof(h));
+}
+
+std::vector<char> make_packet(TCPConnection& c, uint32_t seq, uint32_t ack, const char* data, size_t len) {
+    std::vector<char> pkt(sizeof(TCPHeader) + len);
+    TCPHeader h{};
+    h.flags = FLAG_ACK;
+    h.length = uint32_t(len);
+    h.window_size = htonl(4 * 1024 * 1024);
+    memcpy(pkt.data(), &h, sizeof(h));
+    if (len > 0) memcpy(pkt.data() + sizeof(h), data, len);
+    stamp(c, pkt, seq, ack);
+    return pkt;
+}
+
+// 一轮数据段的应用层内容：1KB 的 OP_DATA 帧首尾相接 (和单文件传输一样会跨段)，
+// 最后一帧补齐到轮末，所以每一轮都从帧边界开始。frames 返回一轮的帧数
+std::vector<char> build_app_stream(size_t& frames) {
+    std::vector<char> stream(ROUND * SEG);
+    size_t off = 0;
+    frames = 0;
+    while (off < stream.size()) {
+        size_t left = stream.size() - off - sizeof(AppHeader);
+        size_t len = left < 2 * 1024 ? left : 1024;
+        off += encode_app_header(stream.data() + off, OP_DATA, uint32_t(len));
+        memset(stream.data() + off, 'a' + int(frames % 26), len);
+        off += len;
+        ++frames;
+    }
+    return stream;
+}
+
+enum class Order { InOrder, Reordered, Lossy };
+
+// 一轮内段的到达顺序
+// - Reordered: 20% 的段和后一个段交换 (netem reorder 造成的那种相邻乱序)
+// - Lossy: 1% 的段丢失，重传在 100 个段之后到达 (约一个窗口，相当于快速重传 / RTO)
+std::vector<size_t> arrival_order(Order order, std::mt19937_64& rng) {
+    std::vector<size_t> out;
+    out.reserve(ROUND);
+    std::uniform_real_distribution<double> u(0, 1);
+    if (order == Order::InOrder) {
+        for (size_t i = 0; i < ROUND; ++i) out.push_back(i);
+    } else if (order == Order::Reordered) {
+        for (size_t i = 0; i < ROUND; ++i) {
+            if (i + 1 < ROUND && u(rng) < 0.2) {
+                out.push_back(i + 1);
+                out.push_back(i++);
+            } else {
+                out.push_back(i);
+            }
+        }
+    } else {
+        std::vector<std::pair<size_t, size_t>> delayed;  // (到达位置, 段号)
+        for (size_t i = 0; i < ROUND; ++i) {
+            if (u(rng) < 0.01) {
+                delayed.push_back({i + 100, i});
+            } else {
+                out.push_back(i);
+            }
+            while (!delayed.empty() && delayed.front().first <= i) {
+                out.push_back(delayed.front().second);
+                delayed.erase(delayed.begin());
+            }
+        }
+        for (auto& d : delayed) out.push_back(d.second);
+    }
+    return out;
+}
+
+// ---------------- 各项测试 ----------------
+
+void bench_checksum(Meter& m, const Options& opt) {
+    TCPConnection c;
+    std::vector<char> pkt(MAX_PACKET_SIZE);
+    std::mt19937_64 rng(1);
+    for (auto& b : pkt) b = char(rng());
+    uint64_t sink = 0;
+    m.start();
+    for (size_t i = 0; i < opt.packets; ++i) {
+        pkt[i % pkt.size()] ^= 1;
+        sink += Probe::checksum(c, pkt.data(), pkt.size());
+    }
+    m.stop(opt.packets);
+    if (sink == 1) fprintf(stderr, " ");  // 防止整个循环被优化掉
+}
+
+void bench_failed_send(Meter& m, const Options& opt) {
+    TCPConnection c;
+    Probe::establish(c, TX_ISN, RX_ISN);
+    char hdr[sizeof(TCPHeader)] = {};
+    m.start();
+    for (size_t i = 0; i < opt.packets; ++i) Probe::failed_send(c, hdr, sizeof(hdr));
+    m.stop(opt.packets);
+}
+
+// 接收端：process_packet 写入接收环 (按序 / 乱序)，应用每 8 个包用 receive() 取走一次
+void bench_receive(Meter& m, const Options& opt, Order order, const char* name) {
+    TCPConnection c;
+    Probe::establish(c, TX_ISN, RX_ISN);
+    size_t frames;
+    std::vector<char> stream = build_app_stream(frames);
+    std::vector<std::vector<char>> pkts;
+    for (size_t i = 0; i < ROUND; ++i) pkts.push_back(make_packet(c, 0, TX_ISN, stream.data() + i * SEG, SEG));
+    std::vector<char> appBuf(64 * 1024);
+    std::mt19937_64 rng(7);
+
+    uint32_t base = RX_ISN;
+    for (size_t done = 0; done < opt.packets; done += ROUND) {
+        for (size_t i = 0; i < ROUND; ++i) stamp(c, pkts[i], base + uint32_t(i * SEG), TX_ISN);
+        std::vector<size_t> arrival = arrival_order(order, rng);
+
+        m.start();
+        size_t n = 0;
+        for (size_t idx : arrival) {
+            if (!Probe::deliver(c, pkts[idx])) fail(name, "checksum mismatch");
+            if (++n % 8 == 0) {
+                while (c.receive(appBuf.data(), appBuf.size()) > 0) {
+                }
+            }
+        }
+        while (c.receive(appBuf.data(), appBuf.size()) > 0) {
+        }
+        m.stop(arrival.size());
+
+        base += uint32_t(ROUND * SEG);
+        if (Probe::rcv_nxt(c) != base) fail(name, "segments were dropped (rcv_nxt did not reach the end of the round)");
+    }
+}
+
+// 发送端：send() 填满拥塞窗口，然后逐个处理对端的 ACK，清理 send_queue
+// lossy: 1% 的段丢失，之后的段都回重复 ACK (触发快速重传)，最后补上的重传让 ACK 一次跳到窗口末尾
+// traced: 打开包级追踪 (写线程把记录丢进 /dev/null)，与不追踪的一行对比就是埋点的开销
+void bench_send_ack(Meter& m, const Options& opt, bool timeSend, bool lossy, const char* name, bool traced = false) {
+    TCPConnection c;
+    Probe::establish(c, TX_ISN, RX_ISN);
+    PacketTrace trace(1 << 20);
+    if (traced) {
+        if (!trace.open("/dev/null")) fail(name, "cannot open /dev/null for the trace");
+        c.set_trace(&trace);
+    }
+    std::vector<char> payload(SEG, 'x');
+    std::mt19937_64 rng(11);
+    std::uniform_real_distribution<double> u(0, 1);
+    std::vector<std::vector<char>> acks;
+
+    for (size_t done = 0; done < opt.packets;) {
+        uint32_t first = Probe::snd_nxt(c);
+        if (timeSend) m.start();
+        size_t sent = 0;
+        while (c.send(payload.data(), payload.size())) ++sent;
+        if (timeSend) m.stop(sent);
+        if (sent == 0) fail(name, "send window did not open");
+
+        // 对端按到达顺序回的累积 ACK
+        acks.clear();
+        std::vector<bool> received(sent, false);
+        std::vector<size_t> lost;
+        size_t hole = 0;
+        for (size_t i = 0; i < sent; ++i) {
+            if (lossy && u(rng) < 0.01) {
+                lost.push_back(i);
+                continue;
+            }
+            received[i] = true;
+            while (hole < sent && received[hole]) ++hole;
+            acks.push_back(make_packet(c, RX_ISN, first + uint32_t(hole * SEG), nullptr, 0));
+        }
+        for (size_t i : lost) {
+            received[i] = true;
+            while (hole < sent && received[hole]) ++hole;
+            acks.push_back(make_packet(c, RX_ISN, first + uint32_t(hole * SEG), nullptr, 0));
+        }
+
+        if (!timeSend) m.start();
+        for (auto& ack : acks) {
+            if (!Probe::deliver(c, ack)) fail(name, "checksum mismatch");
+        }
+        if (!timeSend) m.stop(acks.size());
+        if (Probe::send_queue_size(c) != 0) fail(name, "send_queue not drained");
+        done += sent;
+    }
+}
+
+void bench_send(Meter& m, const Options& opt) { bench_send_ack(m, opt, true, false, "send"); }
+void bench_send_traced(Meter& m, const Options& opt) { bench_send_ack(m, opt, true, false, "send/traced", true); }
+void bench_ack_in_order(Meter& m, const Options& opt) { bench_send_ack(m, opt, false, false, "ack/in-order"); }
+void bench_ack_lossy(Meter& m, const Options& opt) { bench_send_ack(m, opt, false, true, "ack/lossy"); }
+
+void fill_window(TCPConnection& c) {
+    std::vector<char> payload(SEG, 'x');
+    while (c.send(payload.data(), payload.size())) {
+    }
+}
+
+// 追踪打开时一条事件的开销：读时钟 + 往环里写 32 字节
+void bench_trace_event(Meter& m, const Options& opt) {
+    TCPConnection c;
+    Probe::establish(c, TX_ISN, RX_ISN);
+    PacketTrace trace(1 << 20);
+    if (!trace.open("/dev/null")) fail("trace/event", "cannot open /dev/null for the trace");
+    c.set_trace(&trace);
+    m.start();
+    for (size_t i = 0; i < opt.packets; ++i) Probe::trace_event(c, uint32_t(i * SEG), RX_ISN, SEG);
+    m.stop(opt.packets);
+    c.set_trace(nullptr);
+    if (trace.records_lost() > 0) fail("trace/event", "ring overflowed");
+}
+
+// 每次 update() 都会调用：窗口满 (约 100 个段) 且都没有超时
+void bench_check_timeout_idle(Meter& m, const Options& opt) {
+    TCPConnection c;
+    Probe::establish(c, TX_ISN, RX_ISN);
+    fill_window(c);
+    m.start();
+    for (size_t i = 0; i < opt.packets; ++i) Probe::check_timeout(c);
+    m.stop(opt.packets);
+}
+
+// 窗口里的段全部超时重传 (op = 一个重传的段)
+void bench_check_timeout_rto(Meter& m, const Options& opt) {
+    TCPConnection c;
+    Probe::establish(c, TX_ISN, RX_ISN);
+    fill_window(c);
+    size_t segs = Probe::send_queue_size(c);
+    for (size_t done = 0; done < opt.packets; done += segs) {
+        Probe::expire_all(c);
+        m.start();
+        Probe::check_timeout(c);
+        m.stop(segs);
+    }
+}
+
+// 接收端完整的应用路径：每到一个包调用一次 process_app_messages (update + receive + 分帧 + 回调)
+void bench_app(Meter& m, const Options& opt, Order order, const char* name) {
+    TCPConnection c;
+    Probe::establish(c, TX_ISN, RX_ISN);
+    size_t frames;
+    std::vector<char> stream = build_app_stream(frames);
+    std::vector<std::vector<char>> pkts;
+    for (size_t i = 0; i < ROUND; ++i) pkts.push_back(make_packet(c, 0, TX_ISN, stream.data() + i * SEG, SEG));
+    AppFrameParser parser;
+    std::mt19937_64 rng(13);
+    size_t gotFrames = 0;
+    uint64_t gotBytes = 0;
+    auto handler = [&](uint8_t op, std::string_view payload) {
+        if (op == OP_DATA) ++gotFrames;
+        gotBytes += payload.size();
+    };
+
+    uint32_t base = RX_ISN;
+    for (size_t done = 0; done < opt.packets; done += ROUND) {
+        for (size_t i = 0; i < ROUND; ++i) stamp(c, pkts[i], base + uint32_t(i * SEG), TX_ISN);
+        std::vector<size_t> arrival = arrival_order(order, rng);
+        gotFrames = 0;
+
+        m.start();
+        for (size_t idx : arrival) {
+            if (!Probe::deliver(c, pkts[idx])) fail(name, "checksum mismatch");
+            process_app_messages(c, parser, handler);
+        }
+        while (Probe::buffered(c) > 0) process_app_messages(c, parser, handler);
+        m.stop(arrival.size());
+
+        base += uint32_t(ROUND * SEG);
+        if (gotFrames != frames || parser.pending() != 0) fail(name, "frames lost or split across rounds");
+    }
+    if (gotBytes == 0) fail(name, "no payload delivered");
+}
+
+struct Bench {
+    const char* name;
+    void (*run)(Meter&, const Options&);
+};
+
+const Bench BENCHES[] = {
+    {"floor/failed-send", bench_failed_send},
+    {"checksum/1400B", bench_checksum},
+    {"receive/in-order", [](Meter& m, const Options& o) { bench_receive(m, o, Order::InOrder, "receive/in-order"); }},
+    {"receive/reordered",
+     [](Meter& m, const Options& o) { bench_receive(m, o, Order::Reordered, "receive/reordered"); }},
+    {"receive/lossy", [](Meter& m, const Options& o) { bench_receive(m, o, Order::Lossy, "receive/lossy"); }},
+    {"send", bench_send},
+    {"send/traced", bench_send_traced},
+    {"trace/event", bench_trace_event},
+    {"ack/in-order", bench_ack_in_order},
+    {"ack/lossy", bench_ack_lossy},
+    {"check_timeout/idle", bench_check_timeout_idle},
+    {"check_timeout/rto", bench_check_timeout_rto},
+    {"app/in-order", [](Meter& m, const Options& o) { bench_app(m, o, Order::InOrder, "app/in-order"); }},
+    {"app/lossy", [](Meter& m, const Options& o) { bench_app(m, o, Order::Lossy, "app/lossy"); }},
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Usage: %s [--packets N] [--repeat R] [--filter substring]\n", argv[0]);
+            return 1;
+        }
+        std::string val = argv[++i];
+        if (arg == "--packets") {
+            opt.packets = std::max<size_t>(ROUND, std::strtoull(val.c_str(), nullptr, 10));
+        } else if (arg == "--repeat") {
+            opt.repeat = std::max(1, std::atoi(val.c_str()));
+        } else if (arg == "--filter") {
+            opt.filter = val;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    PerfCounter perf;
+    printf("packets/run %zu, repeat %d (median), cache misses: %s\n\n", opt.packets, opt.repeat,
+           perf.available() ? "perf_event" : "n/a (perf_event_open unavailable)");
+    printf("%-22s %10s %10s %10s %10s\n", "benchmark", "ops", "ns/op", "allocs/op", "misses/op");
+    for (const Bench& b : BENCHES) {
+        if (!opt.filter.empty() && std::string(b.name).find(opt.filter) == std::string::npos) continue;
+        std::vector<Result> runs;
+        for (int r = 0; r < opt.repeat; ++r) {
+            Meter m(perf);
+            b.run(m, opt);
+            runs.push_back(m.result);
+        }
+        std::sort(runs.begin(), runs.end(),
+                  [](const Result& a, const Result& b) { return a.ns_per_op() < b.ns_per_op(); });
+        const Result& med = runs[runs.size() / 2];
+        char misses[32] = "n/a";
+        if (perf.available()) snprintf(misses, sizeof(misses), "%.2f", double(med.misses) / med.ops);
+        printf("%-22s %10llu %10.1f %10.2f %10s\n", b.name, (unsigned long long)med.ops, med.ns_per_op(),
+               double(med.allocs) / med.ops, misses);
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,265 @@
+// 队头阻塞：有丢包时，大流量旁边的小消息的尾延迟
+// 用法: ./bench_stream_mux [丢包率%] [时长秒] [起始端口]
+//
+// 拓扑: client → 丢包中继 (fork, 双向随机丢包) → server (fork, 回显小消息、丢弃大块数据)
+// - single: 小消息 (OP_MSG) 和大块数据 (OP_DATA) 在同一条有序字节流里，一个大块数据段丢了，
+//           后面所有的小消息都要等它重传
+// - mux:    小消息和大块数据各走一条 StreamMux 流
+// 客户端每 2ms 发一条带时间戳的小消息，统计从"计划发送"到"收到回显"的延迟分布。
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "app_framing.h"
+#include "stream_mux.h"
+#include "tcp_connection.h"
+#include "udp_relay.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const int PING_INTERVAL_US = 2000;
+const size_t BULK_CHUNK = 1024;
+
+struct Ping {
+    uint64_t seq;
+    int64_t sent_ns;  // 计划发送时间 (相对 steady_clock 纪元)
+};
+
+int64_t now_ns() { return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count(); }
+
+// ---------------- 服务端 ----------------
+
+bool send_frame(TCPConnection& conn, uint8_t op, std::string_view data) {
+    char frame[MAX_PACKET_SIZE];
+    size_t n = encode_app_header(frame, op, data.size());
+    memcpy(frame + n, data.data(), data.size());
+    return conn.send(frame, n + data.size());
+}
+
+void serve_single(int port) {
+    TCPConnection conn;
+    conn.bind(port);
+    AppFrameParser parser;
+    while (true) {
+        conn.update();
+        size_t n = conn.receive(parser.write_ptr(), std::min<size_t>(MAX_PACKET_SIZE * 2, parser.writable()));
+        if (n == (size_t)-1) return;
+        if (n == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        parser.commit(n);
+        parser.dispatch([&](uint8_t op, std::string_view data) {
+            if (op != OP_MSG) return;
+            while (!send_frame(conn, OP_MSG, data)) conn.update();
+        });
+    }
+}
+
+void serve_mux(int port) {
+    TCPConnection conn;
+    conn.bind(port);
+    StreamMux mux(conn, true);
+    std::map<uint32_t, char> kind;  // 流的第一个字节：'P' 回显，'B' 丢弃
+    char buf[64 * 1024];
+    while (true) {
+        mux.update();
+        uint32_t id;
+        while (mux.accept(id)) kind[id] = 0;
+        for (auto& kv : kind) {
+            size_t n;
+            while ((n = mux.read(kv.first, buf, sizeof(buf))) != 0 && n != (size_t)-1) {
+                const char* p = buf;
+                if (kv.second == 0) {
+                    kv.second = *p++;
+                    --n;
+                }
+                if (kv.second == 'P' && n > 0) mux.write(kv.first, p, n);
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+pid_t spawn(void (*fn)(int), int port) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        fn(port);
+        _exit(0);
+    }
+    return pid;
+}
+
+// ---------------- 客户端 ----------------
+
+struct Result {
+    std::vector<double> rtt_ms;
+    long long pings = 0;
+    long long bulkBytes = 0;
+    double seconds = 0;
+};
+
+bool wait_established(TCPConnection& conn, StreamMux* mux) {
+    for (int i = 0; i < 2000 && conn.get_state() != ESTABLISHED; ++i) {
+        if (mux)
+            mux->update();
+        else
+            conn.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return conn.get_state() == ESTABLISHED;
+}
+
+void record_echo(Result& r, const char* p) {
+    Ping ping;
+    memcpy(&ping, p, sizeof(ping));
+    r.rtt_ms.push_back((now_ns() - ping.sent_ns) / 1e6);
+}
+
+Result run_single(int port, double seconds) {
+    Result r;
+    TCPConnection conn;
+    conn.connect("127.0.0.1", port);
+    if (!wait_established(conn, nullptr)) return r;
+
+    AppFrameParser parser;
+    std::vector<char> bulk(BULK_CHUNK, 'x');
+    auto start = Clock::now();
+    auto end = start + std::chrono::duration<double>(seconds);
+    auto nextPing = start;
+    std::vector<Ping> queued;  // 到了发送时间但窗口满、还没发出去的小消息
+
+    while (Clock::now() < end) {
+        conn.update();
+        auto now = Clock::now();
+        while (nextPing <= now) {
+            queued.push_back({(uint64_t)r.pings++, (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                       nextPing.time_since_epoch())
+                                                       .count()});
+            nextPing += std::chrono::microseconds(PING_INTERVAL_US);
+        }
+        // 小消息优先，但它们和大块数据在同一条字节流里
+        size_t sent = 0;
+        while (sent < queued.size() &&
+               send_frame(conn, OP_MSG, std::string_view((const char*)&queued[sent], sizeof(Ping))))
+            ++sent;
+        queued.erase(queued.begin(), queued.begin() + sent);
+        if (queued.empty() && send_frame(conn, OP_DATA, std::string_view(bulk.data(), bulk.size())))
+            r.bulkBytes += bulk.size();
+
+        size_t n = conn.receive(parser.write_ptr(), std::min<size_t>(MAX_PACKET_SIZE * 2, parser.writable()));
+        if (n > 0 && n != (size_t)-1) {
+            parser.commit(n);
+            parser.dispatch([&](uint8_t op, std::string_view data) {
+                if (op == OP_MSG && data.size() == sizeof(Ping)) record_echo(r, data.data());
+            });
+        }
+    }
+    r.seconds = seconds;
+    return r;
+}
+
+Result run_mux(int port, double seconds) {
+    Result r;
+    TCPConnection conn;
+    conn.connect("127.0.0.1", port);
+    StreamMux mux(conn, false);
+    if (!wait_established(conn, &mux)) return r;
+
+    uint32_t bulkStream = mux.open_stream();
+    uint32_t pingStream = mux.open_stream();
+    mux.write(bulkStream, "B", 1);
+    mux.write(pingStream, "P", 1);
+
+    std::vector<char> bulk(BULK_CHUNK, 'x');
+    std::vector<char> echo;
+    char buf[4096];
+    auto start = Clock::now();
+    auto end = start + std::chrono::duration<double>(seconds);
+    auto nextPing = start;
+
+    while (Clock::now() < end) {
+        auto now = Clock::now();
+        while (nextPing <= now) {
+            Ping ping{(uint64_t)r.pings++,
+                      (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(nextPing.time_since_epoch())
+                          .count()};
+            mux.write(pingStream, &ping, sizeof(ping));
+            nextPing += std::chrono::microseconds(PING_INTERVAL_US);
+        }
+        while (mux.pending(bulkStream) < StreamMux::STREAM_SEND_BUFFER / 2)
+            r.bulkBytes += mux.write(bulkStream, bulk.data(), bulk.size());
+        mux.update();
+
+        size_t n;
+        while ((n = mux.read(pingStream, buf, sizeof(buf))) != 0 && n != (size_t)-1) {
+            echo.insert(echo.end(), buf, buf + n);
+        }
+        size_t off = 0;
+        for (; echo.size() - off >= sizeof(Ping); off += sizeof(Ping)) record_echo(r, echo.data() + off);
+        echo.erase(echo.begin(), echo.begin() + off);
+    }
+    // bulkBytes 只统计写进了发送缓冲的量，减去还没发出去的部分
+    r.bulkBytes -= mux.pending(bulkStream);
+    r.seconds = seconds;
+    return r;
+}
+
+double percentile(std::vector<double>& v, double p) {
+    if (v.empty()) return 0;
+    size_t idx = std::min(v.size() - 1, (size_t)(p / 100.0 * v.size()));
+    std::nth_element(v.begin(), v.begin() + idx, v.end());
+    return v[idx];
+}
+
+void report(const char* name, Result r) {
+    double maxRtt = r.rtt_ms.empty() ? 0 : *std::max_element(r.rtt_ms.begin(), r.rtt_ms.end());
+    printf("%-6s pings %5lld echoed %5zu  p50 %7.2f ms  p90 %7.2f ms  p99 %7.2f ms  max %7.2f ms  bulk %6.2f MB/s\n",
+           name, r.pings, r.rtt_ms.size(), percentile(r.rtt_ms, 50), percentile(r.rtt_ms, 90),
+           percentile(r.rtt_ms, 99), maxRtt, r.bulkBytes / 1048576.0 / (r.seconds > 0 ? r.seconds : 1));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    double loss = (argc >= 2) ? std::atof(argv[1]) : 1.0;
+    double seconds = (argc >= 3) ? std::atof(argv[2]) : 3.0;
+    int basePort = (argc >= 4) ? std::atoi(argv[3]) : 19200;
+
+    printf("loss %.2f%% each way, %.1f s per mode, ping every %d us\n", loss, seconds, PING_INTERVAL_US);
+    fflush(stdout);
+
+    // single: relay basePort → server basePort+1；mux: relay basePort+2 → server basePort+3
+    std::vector<pid_t> children;
+    children.push_back(spawn(serve_single, basePort + 1));
+    children.push_back(spawn(serve_mux, basePort + 3));
+    for (int i = 0; i < 2; ++i) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            srand(getpid());
+            run_relay(basePort + 2 * i, basePort + 2 * i + 1, loss);
+            _exit(0);
+        }
+        children.push_back(pid);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    report("single", run_single(basePort, seconds));
+    report("mux", run_mux(basePort + 2, seconds));
+
+    for (pid_t pid : children) kill(pid, SIGTERM);
+    for (pid_t pid : children) waitpid(pid, nullptr, 0);
+    return 0;
+}
@@ -0,0 +1,456 @@
+// 端到端基准套件：非交互地扫一遍 文件大小 x 丢包率 x RTT x 并发连接数，结果写成 JSON，并可与基线比较
+// 用法: ./bench_suite [选项]
+//   --sizes 1,8          文件大小 (MB)
+//   --loss 0,1           双向丢包率 (%)
+//   --rtt 0,40           RTT (ms)
+//   --streams 1,4        并发连接数 (每条连接一个服务端进程，各自上传同一个文件)
+//   --repeat 3           每个场景重复次数
+//   --out FILE           结果 JSON (默认 bench_results.json，写在当前目录)
+//   --baseline FILE      与之前的结果比较，吞吐 / p99 / CPU / 重传率变差超过阈值的场景标记为回归 (退出码 2)
+//   --threshold 15       回归阈值 (%)
+//   --port 19600         起始端口
+//   --pacing on|off      发送节奏 (默认 on，两端都生效)，用来对比 pacing 的效果
+//
+// 每次运行的拓扑: 客户端进程 (fork，每条连接一个线程) → netem_proxy 链路 (fork，有丢包 / 延迟时) → 服务端进程 (fork)
+// 客户端进程整体有超时，卡住的运行记为失败而不会拖住整个套件。
+// 指标:
+//   throughput_MBps   每次运行所有连接的总字节 / 最慢连接的耗时，取中位数
+//   p50_s / p99_s     单个文件传输耗时 (发出请求到服务端确认) 的分位数
+//   cpu_s_per_GB      客户端进程 (发送端) 的 user + sys CPU 时间，折算到每 GB
+//   retransmit_ratio  (快速重传 + 超时重传 + TLP) / 首次发送的数据段
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "file_transfer.h"
+#include "netem.h"
+#include "tcp_connection.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// 单次运行 (一个场景重复一次) 的客户端超时
+const int RUN_TIMEOUT_S = 180;
+
+struct Scenario {
+    int sizeMB;
+    double loss;
+    int rttMs;
+    int streams;
+
+    std::string name() const {
+        std::ostringstream os;
+        os << "size=" << sizeMB << "MB,loss=" << loss << ",rtt=" << rttMs << ",streams=" << streams;
+        return os.str();
+    }
+};
+
+// 客户端子进程通过管道回报的每条连接的结果
+struct StreamResult {
+    double seconds;
+    long long dataSegments;
+    long long retransmits;
+};
+
+struct Summary {
+    std::string name;
+    Scenario scenario;
+    int runs = 0;
+    int failures = 0;
+    double throughput = 0;  // MB/s
+    double p50 = 0, p99 = 0;
+    double cpuPerGB = 0;
+    double retransmitRatio = 0;
+};
+
+std::vector<double> parse_list(const char* text) {
+    std::vector<double> out;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) out.push_back(std::atof(item.c_str()));
+    }
+    return out;
+}
+
+double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t idx = std::min(v.size() - 1, (size_t)(p / 100.0 * v.size()));
+    return v[idx];
+}
+
+void write_random_file(const std::string& path, size_t bytes) {
+    std::mt19937_64 rng(bytes);
+    std::vector<char> buf(1 << 20);
+    std::ofstream out(path, std::ios::binary);
+    for (size_t done = 0; done < bytes; done += buf.size()) {
+        for (size_t i = 0; i + 8 <= buf.size(); i += 8) {
+            uint64_t v = rng();
+            memcpy(&buf[i], &v, 8);
+        }
+        out.write(buf.data(), std::min(buf.size(), bytes - done));
+    }
+}
+
+bool same_content(const std::string& a, const std::string& b) {
+    std::ifstream fa(a, std::ios::binary), fb(b, std::ios::binary);
+    if (!fa || !fb) return false;
+    return std::equal(std::istreambuf_iterator<char>(fa), std::istreambuf_iterator<char>(),
+                      std::istreambuf_iterator<char>(fb), std::istreambuf_iterator<char>());
+}
+
+pid_t spawn_server(int port, const std::string& dir) {
+    fs::create_directories(dir);
+    pid_t pid = fork();
+    if (pid == 0) {
+        freopen("/dev/null", "w", stdout);
+        freopen("/dev/null", "w", stderr);
+        if (chdir(dir.c_str()) != 0) _exit(1);
+        run_server(port);
+        _exit(0);
+    }
+    return pid;
+}
+
+pid_t spawn_proxy(int listenPort, int serverPort, const NetemConfig& link, uint64_t seed) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        freopen("/dev/null", "w", stderr);
+        run_netem_proxy(listenPort, "127.0.0.1", serverPort, link, link, seed);
+        _exit(0);
+    }
+    return pid;
+}
+
+// 客户端子进程：每条连接一个线程，各自上传 file，结果按连接顺序写进管道
+[[noreturn]] void run_clients(const std::vector<int>& ports, const std::string& file, int fd) {
+    freopen("/dev/null", "w", stdout);
+    std::vector<StreamResult> results(ports.size(), StreamResult{-1, 0, 0});
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < ports.size(); ++i) {
+        threads.emplace_back([&, i] {
+            TCPConnection conn;
+            conn.connect("127.0.0.1", ports[i]);
+            for (int t = 0; t < 5000 && conn.get_state() != ESTABLISHED; ++t) {
+                conn.update();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            if (conn.get_state() != ESTABLISHED) return;
+            auto t0 = std::chrono::steady_clock::now();
+            upload_file(conn, file);
+            results[i].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            results[i].dataSegments = conn.send_stats().data_segments;
+            results[i].retransmits = conn.send_stats().retransmits();
+        });
+    }
+    for (auto& t : threads) t.join();
+    ssize_t n = write(fd, results.data(), results.size() * sizeof(StreamResult));
+    _exit(n == (ssize_t)(results.size() * sizeof(StreamResult)) ? 0 : 1);
+}
+
+// 跑一次场景：成功时追加每条连接的耗时，返回 false 表示超时 / 校验失败
+bool run_once(const Scenario& sc, const std::string& file, int& nextPort, uint64_t seed,
+              std::vector<double>& transferSeconds, double& throughput, double& cpuSeconds, long long& segments,
+              long long& retransmits) {
+    bool impaired = sc.loss > 0 || sc.rttMs > 0;
+    NetemConfig link;
+    link.loss = sc.loss;
+    link.delay_ms = sc.rttMs / 2.0;
+
+    fflush(stdout);  // 子进程 freopen 时会把继承来的缓冲区再写一遍
+    std::vector<pid_t> helpers;
+    std::vector<int> clientPorts;
+    std::vector<std::string> dirs;
+    for (int i = 0; i < sc.streams; ++i) {
+        int serverPort = nextPort++;
+        dirs.push_back("srv_" + std::to_string(i));
+        fs::remove_all(dirs.back());
+        helpers.push_back(spawn_server(serverPort, dirs.back()));
+        if (impaired) {
+            int proxyPort = nextPort++;
+            helpers.push_back(spawn_proxy(proxyPort, serverPort, link, seed + i));
+            clientPorts.push_back(proxyPort);
+        } else {
+            clientPorts.push_back(serverPort);
+        }
+    }
+    if (nextPort > 60000) nextPort -= 30000;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    auto start = std::chrono::steady_clock::now();
+    pid_t client = fork();
+    if (client == 0) {
+        close(fds[0]);
+        run_clients(clientPorts, file, fds[1]);
+    }
+    close(fds[1]);
+
+    std::vector<StreamResult> results(sc.streams);
+    size_t want = results.size() * sizeof(StreamResult), got = 0;
+    pollfd pfd{fds[0], POLLIN, 0};
+    while (got < want) {
+        int left = RUN_TIMEOUT_S * 1000 -
+                   (int)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start)
+                       .count();
+        if (left <= 0 || poll(&pfd, 1, left) <= 0) break;
+        ssize_t n = read(fds[0], (char*)results.data() + got, want - got);
+        if (n <= 0) break;
+        got += n;
+    }
+    close(fds[0]);
+    if (got < want) kill(client, SIGKILL);
+    int status = 0;
+    rusage usage{};
+    wait4(client, &status, 0, &usage);
+    for (pid_t pid : helpers) kill(pid, SIGTERM);
+    for (pid_t pid : helpers) waitpid(pid, nullptr, 0);
+    if (got < want) return false;
+
+    std::string name = fs::path(file).filename().string();
+    double slowest = 0;
+    for (int i = 0; i < sc.streams; ++i) {
+        // 服务端把上传的文件存为 received_received_<文件名>
+        if (results[i].seconds < 0 || !same_content(file, dirs[i] + "/received_received_" + name)) return false;
+        slowest = std::max(slowest, results[i].seconds);
+        transferSeconds.push_back(results[i].seconds);
+        segments += results[i].dataSegments;
+        retransmits += results[i].retransmits;
+    }
+    throughput = slowest > 0 ? sc.sizeMB * sc.streams / slowest : 0;
+    cpuSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec +
+                 usage.ru_stime.tv_usec / 1e6;
+    return true;
+}
+
+// ---------------- JSON ----------------
+
+// 每个场景一行，基线比较时按行解析 (只需要读回本程序写出的文件)
+std::string to_json_line(const Summary& s) {
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "{\"name\": \"%s\", \"size_mb\": %d, \"loss\": %g, \"rtt_ms\": %d, \"streams\": %d, \"runs\": %d, "
+             "\"failures\": %d, \"throughput_MBps\": %.3f, \"p50_s\": %.4f, \"p99_s\": %.4f, \"cpu_s_per_GB\": %.2f, "
+             "\"retransmit_ratio\": %.5f}",
+             s.name.c_str(), s.scenario.sizeMB, s.scenario.loss, s.scenario.rttMs, s.scenario.streams, s.runs,
+             s.failures, s.throughput, s.p50, s.p99, s.cpuPerGB, s.retransmitRatio);
+    return buf;
+}
+
+bool json_number(const std::string& line, const char* key, double& out) {
+    std::string pat = std::string("\"") + key + "\": ";
+    size_t pos = line.find(pat);
+    if (pos == std::string::npos) return false;
+    out = std::atof(line.c_str() + pos + pat.size());
+    return true;
+}
+
+std::map<std::string, Summary> load_baseline(const std::string& path) {
+    std::map<std::string, Summary> out;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t pos = line.find("\"name\": \"");
+        if (pos == std::string::npos) continue;
+        pos += 9;
+        Summary s;
+        s.name = line.substr(pos, line.find('"', pos) - pos);
+        double runs = 0, failures = 0;
+        json_number(line, "runs", runs);
+        json_number(line, "failures", failures);
+        s.runs = (int)runs;
+        s.failures = (int)failures;
+        json_number(line, "throughput_MBps", s.throughput);
+        json_number(line, "p50_s", s.p50);
+        json_number(line, "p99_s", s.p99);
+        json_number(line, "cpu_s_per_GB", s.cpuPerGB);
+        json_number(line, "retransmit_ratio", s.retransmitRatio);
+        out[s.name] = s;
+    }
+    return out;
+}
+
+// 与基线比较，返回发现的回归条数
+int compare(const std::vector<Summary>& current, const std::map<std::string, Summary>& baseline, double threshold) {
+    int regressions = 0;
+    auto worse = [&](double base, double now, bool higherIsBetter) {
+        if (base <= 0) return false;
+        double change = (now - base) / base * 100;
+        return higherIsBetter ? change < -threshold : change > threshold;
+    };
+    printf("\ncompared with baseline (threshold %.0f%%):\n", threshold);
+    for (const Summary& s : current) {
+        auto it = baseline.find(s.name);
+        if (it == baseline.end()) {
+            printf("  %-40s (not in baseline)\n", s.name.c_str());
+            continue;
+        }
+        const Summary& b = it->second;
+        std::vector<std::string> flags;
+        if (s.failures > b.failures) flags.push_back("failures " + std::to_string(s.failures));
+        if (worse(b.throughput, s.throughput, true)) flags.push_back("throughput");
+        if (worse(b.p99, s.p99, false)) flags.push_back("p99");
+        if (worse(b.cpuPerGB, s.cpuPerGB, false)) flags.push_back("cpu");
+        // 重传率本身很小，另外要求绝对值至少增加 1 个百分点，避免 0.1% → 0.2% 这种噪声被当成回归
+        if (worse(b.retransmitRatio, s.retransmitRatio, false) && s.retransmitRatio - b.retransmitRatio > 0.01) {
+            flags.push_back("retransmits");
+        }
+        printf("  %-40s throughput %+6.1f%%  p99 %+6.1f%%  cpu %+6.1f%%  rtx %.3f -> %.3f  %s", s.name.c_str(),
+               b.throughput > 0 ? (s.throughput - b.throughput) / b.throughput * 100 : 0,
+               b.p99 > 0 ? (s.p99 - b.p99) / b.p99 * 100 : 0,
+               b.cpuPerGB > 0 ? (s.cpuPerGB - b.cpuPerGB) / b.cpuPerGB * 100 : 0, b.retransmitRatio,
+               s.retransmitRatio, flags.empty() ? "ok" : "REGRESSION:");
+        for (const std::string& f : flags) printf(" %s", f.c_str());
+        printf("\n");
+        if (!flags.empty()) ++regressions;
+    }
+    return regressions;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<double> sizes = {1, 8}, losses = {0, 1}, rtts = {0, 40}, streams = {1, 4};
+    int repeat = 3;
+    std::string outPath = "bench_results.json", baselinePath;
+    double threshold = 15;
+    int port = 19600;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return 1;
+        }
+        const char* val = argv[++i];
+        if (arg == "--sizes") {
+            sizes = parse_list(val);
+        } else if (arg == "--loss") {
+            losses = parse_list(val);
+        } else if (arg == "--rtt") {
+            rtts = parse_list(val);
+        } else if (arg == "--streams") {
+            streams = parse_list(val);
+        } else if (arg == "--repeat") {
+            repeat = std::max(1, std::atoi(val));
+        } else if (arg == "--out") {
+            outPath = val;
+        } else if (arg == "--baseline") {
+            baselinePath = val;
+        } else if (arg == "--threshold") {
+            threshold = std::atof(val);
+        } else if (arg == "--port") {
+            port = std::atoi(val);
+        } else if (arg == "--pacing") {
+            TransportOptions::defaults().pacing = strcmp(val, "off") != 0;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+            return 1;
+        }
+    }
+    // 输出和基线路径相对于启动目录，运行在临时目录里
+    outPath = fs::absolute(outPath).string();
+    if (!baselinePath.empty()) baselinePath = fs::absolute(baselinePath).string();
+
+    char dirTemplate[] = "/tmp/bench_suite_XXXXXX";
+    if (!mkdtemp(dirTemplate) || chdir(dirTemplate) != 0) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    std::vector<Summary> summaries;
+    printf("%-40s %5s %10s %9s %9s %10s %8s\n", "scenario", "runs", "MB/s", "p50 s", "p99 s", "cpu s/GB", "rtx");
+    for (double size : sizes) {
+        std::string file = "payload_" + std::to_string((int)size) + "MB.bin";
+        write_random_file(file, (size_t)size * 1024 * 1024);
+        for (double loss : losses) {
+            for (double rtt : rtts) {
+                for (double n : streams) {
+                    Scenario sc{(int)size, loss, (int)rtt, std::max(1, (int)n)};
+                    Summary sum;
+                    sum.name = sc.name();
+                    sum.scenario = sc;
+                    std::vector<double> seconds, throughputs;
+                    double cpu = 0;
+                    long long segments = 0, retransmits = 0;
+                    for (int r = 0; r < repeat; ++r) {
+                        double tp = 0, runCpu = 0;
+                        if (run_once(sc, fs::absolute(file).string(), port, 1000 * r + 1, seconds, tp, runCpu,
+                                     segments, retransmits)) {
+                            throughputs.push_back(tp);
+                            cpu += runCpu;
+                            ++sum.runs;
+                        } else {
+                            ++sum.failures;
+                        }
+                    }
+                    sum.throughput = percentile(throughputs, 50);
+                    sum.p50 = percentile(seconds, 50);
+                    sum.p99 = percentile(seconds, 99);
+                    double gb = sum.runs * sc.streams * sc.sizeMB / 1024.0;
+                    sum.cpuPerGB = gb > 0 ? cpu / gb : 0;
+                    sum.retransmitRatio = segments > 0 ? (double)retransmits / segments : 0;
+                    summaries.push_back(sum);
+                    printf("%-40s %2d/%-2d %10.2f %9.3f %9.3f %10.1f %8.4f\n", sum.name.c_str(), sum.runs, repeat,
+                           sum.throughput, sum.p50, sum.p99, sum.cpuPerGB, sum.retransmitRatio);
+                    fflush(stdout);
+                }
+            }
+        }
+        fs::remove(file);
+    }
+
+    // 写 JSON
+    {
+        std::ofstream out(outPath);
+        char stamp[64];
+        std::time_t t = std::time(nullptr);
+        std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", std::localtime(&t));
+        out << "{\n  \"suite\": \"bench_suite\",\n  \"timestamp\": \"" << stamp << "\",\n  \"repeat\": " << repeat
+            << ",\n  \"scenarios\": [\n";
+        for (size_t i = 0; i < summaries.size(); ++i) {
+            out << "    " << to_json_line(summaries[i]) << (i + 1 < summaries.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+    }
+    printf("results written to %s\n", outPath.c_str());
+
+    int failures = 0;
+    for (const Summary& s : summaries) failures += s.failures;
+    int regressions = 0;
+    if (!baselinePath.empty()) {
+        auto baseline = load_baseline(baselinePath);
+        if (baseline.empty()) {
+            fprintf(stderr, "baseline %s is missing or empty\n", baselinePath.c_str());
+        } else {
+            regressions = compare(summaries, baseline, threshold);
+            printf("%d regression(s)\n", regressions);
+        }
+    }
+
+    std::string cmd = std::string("rm -rf ") + dirTemplate;
+    if (system(cmd.c_str()) != 0) fprintf(stderr, "failed to remove %s\n", dirTemplate);
+    if (regressions > 0) return 2;
+    return failures == 0 ? 0 : 1;
+}
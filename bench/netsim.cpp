@@ -0,0 +1,263 @@
+// 离散事件模拟器的批量驱动：扫一遍 流数 x 瓶颈带宽 x RTT x 丢包率 x 队列长度 x 种子，全部在虚拟时间里运行
+// 用法: ./netsim [选项]
+//   --flows 1,4          共享瓶颈的并发流数
+//   --rate 10000,50000   瓶颈带宽 (kbit/s，两个方向相同)
+//   --rtt 20,100         RTT (ms，两个方向各一半)
+//   --loss 0,1           双向随机丢包率 (%)
+//   --queue 0            瓶颈队列长度 (字节，0 = 100 ms 的带宽)
+//   --mb 4               每条流上传的数据量 (MB)
+//   --stagger 0          第 i 条流在 i * stagger ms 时开始
+//   --flow-limit 0       每条流自己的发送限速 (kbit/s，0 = 不限)
+//   --shared-limit 0     所有流共享的发送限速 (kbit/s，0 = 不限)，按 --weights 分配
+//   --weights 1          第 i 条流的权重取第 i % n 个 (比如 1,3)
+//   --seeds 1            每个场景跑几个种子 (从 --seed 开始连续编号)
+//   --seed 1             第一个种子
+//   --up SPEC            直接指定上行链路 (netem_proxy 的格式，见 netem.h)，忽略 rate / rtt / loss / queue
+//   --down SPEC          直接指定下行链路 (不指定时与 --up 相同)
+//   --limit 300          每次运行的虚拟时间上限 (秒)
+//   --threads N          并行运行的场景数 (默认 CPU 核数)
+//   --out FILE           结果 JSON (每次运行一行)
+//   --verbose            打印每条流的结果
+//
+// 每一行的场景名带有种子，用同样的参数加 --seed <种子> --seeds 1 就能精确复现那一次运行
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "netem.h"
+#include "sim_network.h"
+
+namespace {
+
+std::vector<double> parse_list(const std::string& text) {
+    std::vector<double> out;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) out.push_back(std::atof(item.c_str()));
+    }
+    return out;
+}
+
+struct Job {
+    std::string name;
+    SimScenario scenario;
+    int flows;
+    double rateKbps, rttMs, loss, queueBytes;
+    SimResult result;
+};
+
+double retransmit_ratio(const SimResult& r) {
+    long long data = 0, rtx = 0;
+    for (auto& f : r.flows) {
+        data += f.send.data_segments;
+        rtx += f.send.retransmits();
+    }
+    return data > 0 ? double(rtx) / data : 0;
+}
+
+std::string to_json_line(const Job& j) {
+    const SimResult& r = j.result;
+    char buf[768];
+    snprintf(buf, sizeof(buf),
+             "{\"name\": \"%s\", \"flows\": %d, \"rate_kbps\": %.0f, \"rtt_ms\": %g, \"loss\": %g, \"queue_bytes\": %.0f, "
+             "\"seed\": %llu, \"completed\": %s, \"goodput_MBps\": %.4f, \"fairness\": %.4f, \"avg_queue_ms\": %.3f, "
+             "\"max_queue_ms\": %.3f, \"retransmit_ratio\": %.4f, \"sim_time_s\": %.3f, \"wall_s\": %.4f}",
+             j.name.c_str(), j.flows, j.rateKbps, j.rttMs, j.loss, j.queueBytes, (unsigned long long)j.scenario.seed,
+             r.completed ? "true" : "false", r.goodput_MBps, r.fairness, r.avg_queue_ms, r.max_queue_ms,
+             retransmit_ratio(r), r.sim_time_s, r.wall_s);
+    return buf;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<double> flowCounts = {1, 4}, rates = {10000, 50000}, rtts = {20, 100}, losses = {0, 1}, queues = {0};
+    double mb = 4, stagger = 0, limit = 300;
+    double flowLimitKbps = 0, sharedLimitKbps = 0;
+    std::vector<double> weights = {1};
+    int seeds = 1;
+    uint64_t firstSeed = 1;
+    std::string upSpec, downSpec, outPath;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    bool verbose = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--verbose") {
+            verbose = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return 1;
+        }
+        std::string val = argv[++i];
+        if (arg == "--flows") {
+            flowCounts = parse_list(val);
+        } else if (arg == "--rate") {
+            rates = parse_list(val);
+        } else if (arg == "--rtt") {
+            rtts = parse_list(val);
+        } else if (arg == "--loss") {
+            losses = parse_list(val);
+        } else if (arg == "--queue") {
+            queues = parse_list(val);
+        } else if (arg == "--mb") {
+            mb = std::atof(val.c_str());
+        } else if (arg == "--stagger") {
+            stagger = std::atof(val.c_str());
+        } else if (arg == "--flow-limit") {
+            flowLimitKbps = std::atof(val.c_str());
+        } else if (arg == "--shared-limit") {
+            sharedLimitKbps = std::atof(val.c_str());
+        } else if (arg == "--weights") {
+            weights = parse_list(val);
+            if (weights.empty()) weights = {1};
+        } else if (arg == "--seeds") {
+            seeds = std::max(1, std::atoi(val.c_str()));
+        } else if (arg == "--seed") {
+            firstSeed = std::strtoull(val.c_str(), nullptr, 10);
+        } else if (arg == "--up") {
+            upSpec = val;
+        } else if (arg == "--down") {
+            downSpec = val;
+        } else if (arg == "--limit") {
+            limit = std::atof(val.c_str());
+        } else if (arg == "--threads") {
+            threads = std::max(1, std::atoi(val.c_str()));
+        } else if (arg == "--out") {
+            outPath = val;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    NetemConfig fixedUp, fixedDown;
+    bool fixedLink = !upSpec.empty();
+    if (fixedLink && (!parse_netem_config(upSpec, fixedUp) ||
+                      !parse_netem_config(downSpec.empty() ? upSpec : downSpec, fixedDown))) {
+        fprintf(stderr, "Invalid link spec\n");
+        return 1;
+    }
+    // 指定了链路时，rate / rtt / loss / queue 不再参与组合
+    if (fixedLink) rates = rtts = losses = queues = {0};
+
+    std::vector<Job> jobs;
+    for (double flows : flowCounts) {
+        for (double rate : rates) {
+            for (double rtt : rtts) {
+                for (double loss : losses) {
+                    for (double queue : queues) {
+                        for (int s = 0; s < seeds; ++s) {
+                            Job j;
+                            j.flows = std::max(1, int(flows));
+                            j.rateKbps = rate;
+                            j.rttMs = rtt;
+                            j.loss = loss;
+                            j.queueBytes = queue;
+                            SimScenario& sc = j.scenario;
+                            if (fixedLink) {
+                                sc.up = fixedUp;
+                                sc.down = fixedDown;
+                            } else {
+                                sc.up.rate_kbps = sc.down.rate_kbps = rate;
+                                sc.up.delay_ms = sc.down.delay_ms = rtt / 2;
+                                sc.up.loss = sc.down.loss = loss;
+                                sc.up.queue_bytes = size_t(queue);
+                            }
+                            sc.seed = firstSeed + s;
+                            sc.time_limit_s = limit;
+                            sc.shared_rate_limit = uint64_t(sharedLimitKbps * 1000 / 8);
+                            for (int f = 0; f < j.flows; ++f) {
+                                unsigned w = unsigned(std::max(1.0, weights[f % weights.size()]));
+                                sc.flows.push_back(
+                                    {size_t(mb * 1024 * 1024), f * stagger, uint64_t(flowLimitKbps * 1000 / 8), w});
+                            }
+
+                            std::ostringstream os;
+                            os << "flows=" << j.flows;
+                            if (!fixedLink) {
+                                os << ",rate=" << rate << ",rtt=" << rtt << ",loss=" << loss;
+                                if (queue > 0) os << ",queue=" << queue;
+                            }
+                            if (flowLimitKbps > 0) os << ",flow-limit=" << flowLimitKbps;
+                            if (sharedLimitKbps > 0) os << ",shared-limit=" << sharedLimitKbps;
+                            os << ",seed=" << sc.seed;
+                            j.name = os.str();
+                            jobs.push_back(std::move(j));
+                        }
+                    }
+                }
+            }
+        }
+    }
+    if (fixedLink) {
+        printf("up:   %s\ndown: %s\n", describe_netem_config(fixedUp).c_str(),
+               describe_netem_config(fixedDown).c_str());
+    }
+    printf("%zu runs, %.1f MB per flow, %u threads\n\n", jobs.size(), mb, threads);
+
+    // 每个场景是独立的，多个线程各自取下一个
+    auto wallStart = std::chrono::steady_clock::now();
+    std::atomic<size_t> nextJob{0};
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < std::min<size_t>(threads, jobs.size()); ++t) {
+        workers.emplace_back([&] {
+            for (size_t i; (i = nextJob.fetch_add(1)) < jobs.size();) jobs[i].result = run_simulation(jobs[i].scenario);
+        });
+    }
+    for (auto& w : workers) w.join();
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+    printf("%-50s %5s %8s %6s %9s %9s %7s %8s %8s\n", "scenario", "done", "MB/s", "jain", "queue ms", "max ms", "rtx",
+           "sim s", "wall ms");
+    double simTotal = 0;
+    int incomplete = 0;
+    for (const Job& j : jobs) {
+        const SimResult& r = j.result;
+        simTotal += r.sim_time_s;
+        size_t done = std::count_if(r.flows.begin(), r.flows.end(), [](const SimFlowResult& f) { return f.completed; });
+        if (!r.completed) ++incomplete;
+        char doneStr[48];  // 两个 size_t 最多各 20 位
+        snprintf(doneStr, sizeof(doneStr), "%zu/%zu", done, r.flows.size());
+        printf("%-50s %5s %8.2f %6.3f %9.1f %9.1f %7.4f %8.2f %8.1f\n", j.name.c_str(), doneStr, r.goodput_MBps,
+               r.fairness, r.avg_queue_ms, r.max_queue_ms, retransmit_ratio(r), r.sim_time_s, r.wall_s * 1000);
+        if (verbose) {
+            for (size_t f = 0; f < r.flows.size(); ++f) {
+                const SimFlowResult& fr = r.flows[f];
+                printf("    flow %-3zu %s start %.3fs finish %.3fs  %.2f MB/s  segments %lld  fast-rtx %lld  rto %lld  tlp %lld",
+                       f, fr.completed ? "done" : "INCOMPLETE", fr.start_s, fr.finish_s, fr.throughput_MBps,
+                       fr.send.data_segments, fr.send.fast_retransmits, fr.send.rto_retransmits,
+                       fr.send.tlp_probes);
+                const SimFlow& cfg = j.scenario.flows[f];
+                if (cfg.rate_limit > 0 || j.scenario.shared_rate_limit > 0) {
+                    printf("  weight %u  limit %.2f MB/s", cfg.weight, cfg.rate_limit / (1024.0 * 1024));
+                }
+                printf("\n");
+            }
+        }
+    }
+    printf("\n%zu runs in %.2f s wall (%.0f runs/min), %.1f s simulated (%.0fx real time), %d incomplete\n",
+           jobs.size(), wall, wall > 0 ? jobs.size() * 60 / wall : 0, simTotal, wall > 0 ? simTotal / wall : 0,
+           incomplete);
+
+    if (!outPath.empty()) {
+        std::ofstream out(outPath);
+        out << "{\n  \"suite\": \"netsim\",\n  \"runs\": [\n";
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            out << "    " << to_json_line(jobs[i]) << (i + 1 < jobs.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+        printf("results written to %s\n", outPath.c_str());
+    }
+    return incomplete > 0 ? 2 : 0;
+}
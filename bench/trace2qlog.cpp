@@ -0,0 +1,235 @@
+// 把 --trace 记录的二进制包事件 (packet_trace.h) 转成 qlog (JSON)，可以直接拖进 qvis 看时序 / 序列号图
+// 用法: ./trace2qlog <trace 文件> [输出文件] [选项]
+//   --vantage client|server   观察点 (默认按第一条状态事件推断：LISTEN 为服务端，SYN_SENT 为客户端)
+//   --csv                     输出 CSV (time_ms,event,seq,ack,len,wnd,detail)，方便 gnuplot / pandas 画 seq-time 图
+// 不指定输出文件时写到 stdout；事件统计打印到 stderr
+//
+// 事件对应关系 (TCP 没有包号，packet_number 用序列号，图上的纵轴就是字节偏移)：
+//   PACKET_SENT / PACKET_RECEIVED  transport:packet_sent / transport:packet_received
+//   PACKET_DROPPED                 transport:packet_dropped (trigger = checksum / rcv_window / duplicate)
+//   RETRANSMIT                     recovery:packet_lost (trigger = dup_acks / time_threshold / pto_expired / rto)
+//   STATE_CHANGED                  connectivity:connection_state_updated
+//   WINDOW_UPDATED                 recovery:metrics_updated (congestion_window / bytes_in_flight / peer_rwnd)
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "packet_trace.h"
+#include "tcp_protocol.h"
+#include "transport_metrics.h"
+
+namespace {
+
+std::string flags_to_string(uint8_t f) {
+    static const struct {
+        uint8_t bit;
+        const char* name;
+    } names[] = {{FLAG_SYN, "SYN"}, {FLAG_ACK, "ACK"}, {FLAG_FIN, "FIN"}, {FLAG_RST, "RST"},
+                 {FLAG_PSH, "PSH"}, {FLAG_TFO, "TFO"}, {FLAG_FEC, "FEC"}, {FLAG_SACK, "SACK"}};
+    std::string s;
+    for (auto& n : names) {
+        if (!(f & n.bit)) continue;
+        if (!s.empty()) s += '|';
+        s += n.name;
+    }
+    return s.empty() ? "NONE" : s;
+}
+
+const char* drop_reason(uint8_t r) {
+    switch (r) {
+        case DROP_CHECKSUM:
+            return "checksum";
+        case DROP_RCV_WINDOW:
+            return "rcv_window";
+        case DROP_DUPLICATE:
+            return "duplicate";
+        case DROP_OOO_FULL:
+            return "ooo_full";
+        default:
+            return "unknown";
+    }
+}
+
+// qlog 的 packet_lost trigger：RACK 对应 time_threshold，TLP 对应 pto_expired
+const char* retransmit_trigger(uint8_t r) {
+    switch (r) {
+        case RETRANSMIT_FAST:
+            return "dup_acks";
+        case RETRANSMIT_RTO:
+            return "rto";
+        case RETRANSMIT_RACK:
+            return "time_threshold";
+        case RETRANSMIT_TLP:
+            return "pto_expired";
+        default:
+            return "unknown";
+    }
+}
+
+const char* event_name(uint8_t type) {
+    switch (type) {
+        case TRACE_PACKET_SENT:
+            return "transport:packet_sent";
+        case TRACE_PACKET_RECEIVED:
+            return "transport:packet_received";
+        case TRACE_PACKET_DROPPED:
+            return "transport:packet_dropped";
+        case TRACE_RETRANSMIT:
+            return "recovery:packet_lost";
+        case TRACE_STATE_CHANGED:
+            return "connectivity:connection_state_updated";
+        case TRACE_WINDOW_UPDATED:
+            return "recovery:metrics_updated";
+        case TRACE_RECORDS_LOST:
+            return "loglevel:warning";
+        default:
+            return nullptr;
+    }
+}
+
+// 一条事件的 data 部分 (JSON 对象)
+std::string event_data(const TraceRecord& r) {
+    char buf[256];
+    switch (r.type) {
+        case TRACE_PACKET_SENT:
+        case TRACE_PACKET_RECEIVED:
+            snprintf(buf, sizeof(buf),
+                     "{\"header\": {\"packet_type\": \"1RTT\", \"packet_number\": %u, \"flags\": \"%s\", \"ack\": %u, "
+                     "\"window\": %u}, \"raw\": {\"length\": %zu, \"payload_length\": %u}}",
+                     r.seq, flags_to_string(r.flags).c_str(), r.ack, r.wnd, r.len + sizeof(TCPHeader), r.len);
+            break;
+        case TRACE_PACKET_DROPPED:
+            snprintf(buf, sizeof(buf),
+                     "{\"header\": {\"packet_number\": %u}, \"raw\": {\"payload_length\": %u}, \"trigger\": \"%s\"}",
+                     r.seq, r.len, drop_reason(r.flags));
+            break;
+        case TRACE_RETRANSMIT:
+            snprintf(buf, sizeof(buf),
+                     "{\"header\": {\"packet_number\": %u}, \"raw\": {\"payload_length\": %u}, \"trigger\": \"%s\"%s}",
+                     r.seq, r.len, retransmit_trigger(r.flags),
+                     r.flags == RETRANSMIT_RTO ? (", \"rto_count\": " + std::to_string(r.a)).c_str() : "");
+            break;
+        case TRACE_STATE_CHANGED:
+            snprintf(buf, sizeof(buf), "{\"old\": \"%s\", \"new\": \"%s\"}", tcp_state_name(TCPState(r.a)),
+                     tcp_state_name(TCPState(r.flags)));
+            break;
+        case TRACE_WINDOW_UPDATED:
+            snprintf(buf, sizeof(buf),
+                     "{\"congestion_window\": %u, \"bytes_in_flight\": %u, \"peer_rwnd\": %u, \"snd_una\": %u}", r.a,
+                     r.b, r.wnd, r.ack);
+            break;
+        case TRACE_RECORDS_LOST:
+            snprintf(buf, sizeof(buf), "{\"message\": \"%llu trace records lost (ring full)\"}",
+                     (unsigned long long)r.a | ((unsigned long long)r.b << 32));
+            break;
+        default:
+            buf[0] = 0;
+    }
+    return buf;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string inPath, outPath, vantage;
+    bool csv = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--csv") {
+            csv = true;
+        } else if (arg == "--vantage" && i + 1 < argc) {
+            vantage = argv[++i];
+        } else if (inPath.empty()) {
+            inPath = arg;
+        } else if (outPath.empty()) {
+            outPath = arg;
+        } else {
+            fprintf(stderr, "Unexpected argument: %s\n", arg.c_str());
+            return 1;
+        }
+    }
+    if (inPath.empty()) {
+        fprintf(stderr, "Usage: %s <trace file> [output] [--vantage client|server] [--csv]\n", argv[0]);
+        return 1;
+    }
+
+    TraceFileHeader header;
+    std::vector<TraceRecord> records;
+    if (!read_trace_file(inPath, header, records)) {
+        fprintf(stderr, "%s: not a packet trace (or version mismatch)\n", inPath.c_str());
+        return 1;
+    }
+
+    if (vantage.empty()) {
+        vantage = "unknown";
+        for (const TraceRecord& r : records) {
+            if (r.type != TRACE_STATE_CHANGED) continue;
+            if (r.flags == LISTEN || r.flags == SYN_RCVD) vantage = "server";
+            if (r.flags == SYN_SENT) vantage = "client";
+            if (vantage != "unknown") break;
+        }
+    }
+
+    std::ofstream file;
+    if (!outPath.empty()) {
+        file.open(outPath);
+        if (!file) {
+            fprintf(stderr, "Cannot write %s\n", outPath.c_str());
+            return 1;
+        }
+    }
+    std::ostream& out = outPath.empty() ? std::cout : file;
+
+    // 时间相对第一条记录；reference_time 是打开追踪时的系统时间 (ms)
+    uint64_t t0 = records.empty() ? 0 : records.front().time_us;
+    long long counts[8] = {};
+    if (csv) {
+        out << "time_ms,event,seq,ack,len,wnd,detail\n";
+    } else {
+        out << "{\n  \"qlog_version\": \"0.3\",\n  \"qlog_format\": \"JSON\",\n  \"title\": \"" << inPath
+            << "\",\n  \"traces\": [{\n    \"vantage_point\": {\"type\": \"" << vantage
+            << "\"},\n    \"common_fields\": {\"time_format\": \"relative\", \"reference_time\": "
+            << header.wall_time_us / 1000 << ", \"protocol_type\": [\"MYTCP\"]},\n    \"events\": [";
+    }
+
+    bool first = true;
+    uint64_t tLast = t0;
+    char line[512];
+    for (const TraceRecord& r : records) {
+        const char* name = event_name(r.type);
+        if (!name) continue;
+        ++counts[r.type];
+        if (r.type != TRACE_RECORDS_LOST) tLast = std::max(tLast, r.time_us);
+        double t = r.type == TRACE_RECORDS_LOST ? (tLast - t0) / 1000.0 : (r.time_us - t0) / 1000.0;
+        if (csv) {
+            std::string detail = r.type == TRACE_PACKET_SENT || r.type == TRACE_PACKET_RECEIVED
+                                     ? flags_to_string(r.flags)
+                                 : r.type == TRACE_PACKET_DROPPED ? drop_reason(r.flags)
+                                 : r.type == TRACE_RETRANSMIT     ? retransmit_trigger(r.flags)
+                                 : r.type == TRACE_STATE_CHANGED  ? tcp_state_name(TCPState(r.flags))
+                                                                  : "";
+            snprintf(line, sizeof(line), "%.3f,%s,%u,%u,%u,%u,%s\n", t, strchr(name, ':') + 1, r.seq, r.ack, r.len,
+                     r.type == TRACE_WINDOW_UPDATED ? r.a : r.wnd, detail.c_str());
+            out << line;
+        } else {
+            out << (first ? "\n" : ",\n");
+            snprintf(line, sizeof(line), "      {\"time\": %.3f, \"name\": \"%s\", \"data\": ", t, name);
+            out << line << event_data(r) << "}";
+        }
+        first = false;
+    }
+    if (!csv) out << "\n    ]\n  }]\n}\n";
+
+    double span = (tLast - t0) / 1e6;
+    fprintf(stderr,
+            "%zu records over %.3f s (%s): %lld sent, %lld received, %lld dropped, %lld retransmits, "
+            "%lld state changes, %lld window updates%s\n",
+            records.size(), span, vantage.c_str(), counts[TRACE_PACKET_SENT], counts[TRACE_PACKET_RECEIVED],
+            counts[TRACE_PACKET_DROPPED], counts[TRACE_RETRANSMIT], counts[TRACE_STATE_CHANGED],
+            counts[TRACE_WINDOW_UPDATED], counts[TRACE_RECORDS_LOST] ? ", some records were lost (ring full)" : "");
+    return 0;
+}
@@ -0,0 +1,88 @@
+#ifndef BENCH_UDP_RELAY_H
+#define BENCH_UDP_RELAY_H
+
+// benchmark 用的 UDP 中继：模拟丢包和链路延迟
+// 客户端连 listenPort，中继转发给 serverPort；两个方向各自以 lossPercent 的概率丢包，
+// 每个包在中继里停留 delayMs 毫秒后再转发 (RTT 增加 2 * delayMs)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <vector>
+
+inline sockaddr_in relay_loopback(int port) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return addr;
+}
+
+// 阻塞运行，通常放在 fork 出的子进程里
+inline void run_relay(int listenPort, int serverPort, double lossPercent, int delayMs = 0) {
+    using Clock = std::chrono::steady_clock;
+    struct Pending {
+        Clock::time_point due;
+        bool toServer;
+        std::vector<char> data;
+    };
+
+    int front = socket(AF_INET, SOCK_DGRAM, 0);
+    int back = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in listenAddr = relay_loopback(listenPort);
+    sockaddr_in serverAddr = relay_loopback(serverPort);
+    if (bind(front, (sockaddr*)&listenAddr, sizeof(listenAddr)) != 0 ||
+        connect(back, (sockaddr*)&serverAddr, sizeof(serverAddr)) != 0) {
+        perror("relay");
+        return;
+    }
+
+    sockaddr_in client{};
+    socklen_t clientLen = 0;
+    char buf[2048];
+    pollfd fds[2] = {{front, POLLIN, 0}, {back, POLLIN, 0}};
+    std::deque<Pending> queue;  // 延迟固定，按到达顺序就是按到期顺序
+    auto drop = [&] { return rand() % 10000 < lossPercent * 100; };
+    auto forward = [&](bool toServer, const char* p, size_t n) {
+        if (toServer) {
+            send(back, p, n, 0);
+        } else if (clientLen > 0) {
+            sendto(front, p, n, 0, (sockaddr*)&client, clientLen);
+        }
+    };
+    auto relay = [&](bool toServer, const char* p, ssize_t n) {
+        if (n <= 0 || drop()) return;
+        if (delayMs <= 0) {
+            forward(toServer, p, n);
+        } else {
+            queue.push_back({Clock::now() + std::chrono::milliseconds(delayMs), toServer, std::vector<char>(p, p + n)});
+        }
+    };
+
+    while (true) {
+        int timeout = -1;
+        if (!queue.empty()) {
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(queue.front().due - Clock::now());
+            timeout = wait.count() > 0 ? (int)wait.count() : 0;
+        }
+        if (poll(fds, 2, timeout) > 0) {
+            if (fds[0].revents & POLLIN) {
+                clientLen = sizeof(client);
+                relay(true, buf, recvfrom(front, buf, sizeof(buf), 0, (sockaddr*)&client, &clientLen));
+            }
+            if (fds[1].revents & POLLIN) relay(false, buf, recv(back, buf, sizeof(buf), 0));
+        }
+        auto now = Clock::now();
+        while (!queue.empty() && queue.front().due <= now) {
+            forward(queue.front().toServer, queue.front().data.data(), queue.front().data.size());
+            queue.pop_front();
+        }
+    }
+}
+
+#endif  // BENCH_UDP_RELAY_H
@@ -0,0 +1,139 @@
+#ifndef APP_FRAMING_H
+#define APP_FRAMING_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "tcp_protocol.h"
+#include "tcp_socket.h"  // htonl / ntohl
+
+// 编码应用层帧头 (opCode + 网络字节序 length)，返回写入的字节数
+inline size_t encode_app_header(char* dst, uint8_t op, uint32_t length) {
+    AppHeader hdr;
+    hdr.opCode = op;
+    hdr.length = htonl(length);
+    memcpy(dst, &hdr, sizeof(hdr));
+    return sizeof(hdr);
+}
+
+// 解码应用层帧头 (src 可以未对齐)
+inline void decode_app_header(const char* src, uint8_t& op, uint32_t& length) {
+    AppHeader hdr;
+    memcpy(&hdr, src, sizeof(hdr));
+    op = hdr.opCode;
+    length = ntohl(hdr.length);
+}
+
+// 64 位字段按网络字节序读写 (dst / src 可以未对齐)，StreamMux 和 MultipathConnection 的帧头共用
+inline void store_be64(char* dst, uint64_t v) {
+    uint32_t hi = htonl(uint32_t(v >> 32));
+    uint32_t lo = htonl(uint32_t(v));
+    memcpy(dst, &hi, 4);
+    memcpy(dst + 4, &lo, 4);
+}
+
+inline uint64_t load_be64(const char* src) {
+    uint32_t hi, lo;
+    memcpy(&hi, src, 4);
+    memcpy(&lo, src + 4, 4);
+    return (uint64_t(ntohl(hi)) << 32) | ntohl(lo);
+}
+
+// 应用层分帧器 (处理粘包/半包)
+// - 数据直接 receive 进内部缓冲区的空闲尾部，不经过临时数组
+// - 完整帧以 std::string_view 的形式交给 handler，视图指向缓冲区本身，仅在回调期间有效
+// - 消费只移动读指针；只有尾部空间用完时才把残留的半包挪回开头 (均摊 O(1))
+// - 稳态下不做任何堆分配，只有遇到比缓冲区还大的帧时才扩容
+class AppFrameParser {
+public:
+    explicit AppFrameParser(size_t capacity = 64 * 1024) : buf(capacity) {}
+
+    // 可写区域：两者都保证至少有 MAX_PACKET_SIZE 字节可写
+    // (都会按需整理缓冲区，所以 receive(write_ptr(), writable()) 的参数求值顺序无关紧要)
+    char* write_ptr() {
+        reserve(MAX_PACKET_SIZE);
+        return buf.data() + tail;
+    }
+    size_t writable() {
+        reserve(MAX_PACKET_SIZE);
+        return buf.size() - tail;
+    }
+
+    // 确认写入了 n 字节
+    void commit(size_t n) { tail += n; }
+
+    // 解析所有完整帧，逐个回调 handler(uint8_t op, std::string_view payload)
+    // 返回本次处理的帧数
+    template <typename Handler>
+    size_t dispatch(Handler&& handler) {
+        size_t frames = 0;
+        while (tail - head >= sizeof(AppHeader)) {
+            uint8_t op;
+            uint32_t length;
+            decode_app_header(buf.data() + head, op, length);
+
+            size_t totalLen = sizeof(AppHeader) + length;
+            if (tail - head < totalLen) {
+                // 半包：如果整帧比缓冲区还大，提前扩容，让后续 receive 能放得下
+                if (totalLen > buf.size()) reserve(totalLen - (tail - head));
+                break;
+            }
+
+            const char* payload = buf.data() + head + sizeof(AppHeader);
+            head += totalLen;
+            ++frames;
+            handler(op, std::string_view(payload, length));
+        }
+        if (head == tail) head = tail = 0;  // 全部消费完，直接回到开头，不需要搬运
+        return frames;
+    }
+
+    // 缓冲区中尚未处理的字节数
+    size_t pending() const { return tail - head; }
+
+    void clear() { head = tail = 0; }
+
+private:
+    // 保证尾部至少有 n 字节可写：先尝试把残留数据挪到开头，不够再扩容
+    void reserve(size_t n) {
+        if (buf.size() - tail >= n) return;
+        if (head > 0) {
+            memmove(buf.data(), buf.data() + head, tail - head);
+            tail -= head;
+            head = 0;
+        }
+        if (buf.size() - tail < n) buf.resize(tail + n);
+    }
+
+    std::vector<char> buf;
+    size_t head = 0;  // 第一个未处理字节
+    size_t tail = 0;  // 第一个空闲字节
+};
+
+// 辅助函数：从连接取出数据交给 parser 分帧 (处理粘包/半包)
+// Conn 为 TCPConnection 或 TCPEngine (需要 update / receive)，返回 false 表示对端已关闭且数据已处理完
+// handler(uint8_t op, std::string_view payload)，payload 指向 parser 内部缓冲区，只在回调期间有效
+template <typename Conn, typename Handler>
+bool process_app_messages(Conn& conn, AppFrameParser& parser, Handler&& handler) {
+    conn.update();
+    // 每轮最多取 2 个 MSS：读得太多会拉长两次 update() 之间的间隔，内核 socket 缓冲区来不及排空就会丢包
+    size_t n = conn.receive(parser.write_ptr(), std::min<size_t>(MAX_PACKET_SIZE * 2, parser.writable()));
+
+    if (n == (size_t)-1) {
+        // 收到 EOF，且处理完了残余数据
+        return false;  // 告诉上层循环，该断开了
+    }
+
+    if (n > 0) {
+        parser.commit(n);
+        parser.dispatch(handler);
+    }
+    return true;
+}
+
+#endif  // APP_FRAMING_H
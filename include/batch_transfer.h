@@ -0,0 +1,127 @@
+#ifndef BATCH_TRANSFER_H
+#define BATCH_TRANSFER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "app_framing.h"
+#include "tcp_protocol.h"
+
+// 批量 (目录) 传输的公共部件
+// 协议: OP_BATCH_BEGIN(目录名) → 若干个 [OP_BATCH_FILE("相对路径|大小") + OP_DATA...] → OP_BATCH_END("文件数|字节数")
+// - 文件边界由文件头里的大小决定，不需要逐文件的 OP_END，也不等逐文件的确认
+// - 接收端每落盘 BATCH_ACK_EVERY 个文件异步回一个 OP_BATCH_ACK，发送端有空时顺手取走，从不阻塞等待
+// - 多个小帧合并进同一个数据段，小文件不会每个都占一个包
+
+// 单个数据段能装下的应用层字节数 (update() 的接收缓冲区是 MAX_PACKET_SIZE，要扣掉 TCPHeader)
+const size_t BATCH_SEGMENT_SIZE = MAX_PACKET_SIZE - sizeof(TCPHeader);
+// 接收端每落盘多少个文件回一次 OP_BATCH_ACK
+const long long BATCH_ACK_EVERY = 256;
+
+// "文件数|字节数" 的编解码 (OP_BATCH_ACK / OP_BATCH_END 共用)
+std::string format_batch_counts(long long files, long long bytes);
+bool parse_batch_counts(std::string_view payload, long long& files, long long& bytes);
+
+// 把对端给的相对路径规范化；绝对路径、含 ".." 或为空时返回 false
+bool sanitize_relative_path(std::string_view raw, std::filesystem::path& out);
+
+// 帧合并发送器：把多条应用层帧攒进一个 MSS 大小的段里再交给 conn.send()
+// Conn 同 file_transfer 中的传输逻辑 (TCPConnection / TCPEngine)
+template <typename Conn>
+class BatchSender {
+public:
+    explicit BatchSender(Conn& c) : conn(c) {}
+    ~BatchSender() { flush(); }
+
+    BatchSender(const BatchSender&) = delete;
+    BatchSender& operator=(const BatchSender&) = delete;
+
+    // 追加一条完整的帧 (帧头 + payload 必须能放进一个段)，当前段放不下时先发出去
+    bool frame(uint8_t op, std::string_view data) {
+        size_t totalLen = sizeof(AppHeader) + data.size();
+        if (totalLen > BATCH_SEGMENT_SIZE) return false;
+        if (used + totalLen > BATCH_SEGMENT_SIZE) flush();
+        used += encode_app_header(seg + used, op, data.size());
+        memcpy(seg + used, data.data(), data.size());
+        used += data.size();
+        return true;
+    }
+
+    // 追加文件内容：拆成若干 OP_DATA 帧，优先填满当前段的剩余空间
+    void data(std::string_view bytes) {
+        while (!bytes.empty()) {
+            size_t room = BATCH_SEGMENT_SIZE - used;
+            // 剩余空间太小就不值得再切一个帧头出来了
+            if (room < sizeof(AppHeader) + MIN_DATA_FRAME) {
+                flush();
+                continue;
+            }
+            size_t n = std::min(room - sizeof(AppHeader), bytes.size());
+            frame(OP_DATA, bytes.substr(0, n));
+            bytes.remove_prefix(n);
+        }
+    }
+
+    // 把当前段发出去 (阻塞直到放入发送窗口)
+    void flush() {
+        if (used == 0) return;
+        while (!conn.send(seg, used)) {
+            conn.update();
+            std::this_thread::yield();
+        }
+        used = 0;
+    }
+
+private:
+    static const size_t MIN_DATA_FRAME = 64;
+
+    Conn& conn;
+    char seg[BATCH_SEGMENT_SIZE];
+    size_t used = 0;
+};
+
+// 批量接收端：按文件头里的大小切分随后的 OP_DATA 流，逐个写到 base 目录下
+class BatchReceiver {
+public:
+    // 开始一个批次，文件落在 prefix + 目录名 下；目录名非法时返回 false
+    bool begin(std::string_view root, const std::string& prefix);
+    // 处理 OP_BATCH_FILE；路径非法时仍然要吞掉它的数据，只是不落盘
+    void on_file(std::string_view header);
+    // 处理属于当前文件的 OP_DATA
+    void on_data(std::string_view data);
+    // 结束批次 (关闭未写完的文件)
+    void finish();
+
+    bool active() const { return inBatch; }
+    // 当前是否有文件还在等数据 (此时 OP_DATA 属于批量流)
+    bool in_file() const { return inBatch && remaining > 0; }
+
+    long long files() const { return nFiles; }
+    long long bytes() const { return nBytes; }
+    const std::filesystem::path& base_dir() const { return base; }
+
+    // 距上次确认是否已经攒够 BATCH_ACK_EVERY 个文件；返回 true 时视为已确认
+    bool take_ack_due();
+
+private:
+    void open_file(const std::filesystem::path& rel);
+    void complete_file();
+
+    std::filesystem::path base;
+    std::filesystem::path lastDir;  // 上一个文件的父目录，同目录下的文件不再重复 create_directories
+    std::ofstream out;
+    bool inBatch = false;
+    bool skipping = false;  // 当前文件路径非法，只消费数据不写盘
+    long long remaining = 0;
+    long long nFiles = 0;
+    long long nBytes = 0;
+    long long ackedFiles = 0;
+};
+
+#endif  // BATCH_TRANSFER_H
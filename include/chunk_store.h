@@ -0,0 +1,65 @@
+#ifndef CHUNK_STORE_H
+#define CHUNK_STORE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 内容寻址的块存储 (服务端去重)
+// - 文件按内容切块 (FastCDC)：切点只取决于附近的内容，插入 / 删除只影响附近的一两个块，其余块的哈希不变
+// - 每块用 SHA-256 作为地址；块数据追加写进 chunks.dat，索引是内存映射的开放寻址哈希表 index.bin，
+//   服务器重启后直接 mmap，不需要重建
+
+// FastCDC 的块大小 (最小 / 期望 / 最大)
+const size_t CDC_MIN_SIZE = 2 * 1024;
+const size_t CDC_AVG_SIZE = 8 * 1024;
+const size_t CDC_MAX_SIZE = 64 * 1024;
+
+// 在 p[0, n) 中找第一个切点，返回块长度；n 不足 CDC_MAX_SIZE 且是文件末尾时调用方直接把剩下的作为最后一块
+size_t fastcdc_cut(const uint8_t* p, size_t n);
+
+using ChunkHash = std::array<uint8_t, 32>;
+ChunkHash sha256(const void* data, size_t len);
+
+class ChunkStore {
+public:
+    ChunkStore() = default;
+    ~ChunkStore();
+    ChunkStore(const ChunkStore&) = delete;
+    ChunkStore& operator=(const ChunkStore&) = delete;
+
+    // 打开 (或创建) dir 下的存储
+    bool open(const std::string& dir);
+    bool is_open() const { return index != nullptr; }
+
+    bool contains(const ChunkHash& h) const;
+    // 存入一个块，已存在时什么也不做
+    bool put(const ChunkHash& h, const char* data, size_t len);
+    // 读出一个块，不存在或数据文件损坏时返回 false
+    bool read(const ChunkHash& h, std::vector<char>& out) const;
+
+    uint64_t chunk_count() const;
+    uint64_t stored_bytes() const { return packSize; }
+
+private:
+    struct Header;
+    struct Slot;
+
+    // 返回 h 所在的槽，不存在时返回它应该插入的空槽
+    Slot* find_slot(const ChunkHash& h) const;
+    bool map_index(const std::string& path, uint64_t capacity);
+    void unmap_index();
+    // 容量翻倍：写一个新的索引文件再原子替换
+    bool grow();
+
+    std::string dirPath;
+    int packFd = -1;
+    uint64_t packSize = 0;
+    int indexFd = -1;
+    Header* index = nullptr;
+    size_t mappedBytes = 0;
+};
+
+#endif  // CHUNK_STORE_H
@@ -0,0 +1,82 @@
+#ifndef DEDUP_TRANSFER_H
+#define DEDUP_TRANSFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "chunk_store.h"
+
+// 去重上传 (upload_dedup) 的公共部件
+// 协议: OP_DEDUP_BEGIN("文件名|大小") → 若干个 OP_CHUNK_LIST(块清单)
+//       ← 每个清单一个 OP_CHUNK_NEED(位图，1 = 服务器没有这个块)
+//       → 按清单顺序发送需要的块 (OP_DATA，块之间没有分隔，长度由清单给出) → OP_END
+//       ← 服务器校验每个块的哈希、存入块存储、按清单拼出文件后回复 OP_END("文件字节数")
+// 清单只多花一个往返，服务器已有的块 (其它客户端传过的、同一文件里重复的) 不再传输
+
+// 清单中的一项：32 字节 SHA-256 + 4 字节块长度 (网络序)
+const size_t DEDUP_ENTRY_SIZE = 36;
+// 每个 OP_CHUNK_LIST 帧的项数 (整帧要放进一个数据段)
+const size_t DEDUP_ENTRIES_PER_FRAME = 32;
+
+struct FileChunk {
+    uint64_t offset;
+    uint32_t length;
+    ChunkHash hash;
+};
+
+// 客户端：把文件按 FastCDC 切块并计算哈希
+bool chunk_file(const std::string& path, std::vector<FileChunk>& out);
+std::string encode_chunk_list(const FileChunk* chunks, size_t n);
+
+// 服务端：一次去重上传的状态 (块存储在第一次使用时打开，之后一直复用)
+class DedupReceiver {
+public:
+    explicit DedupReceiver(std::string storeDir = "chunk_store") : storePath(std::move(storeDir)) {}
+
+    // 处理 OP_DEDUP_BEGIN，输出文件为 prefix + 文件名；失败返回 false
+    bool begin(std::string_view header, const std::string& prefix);
+    // 处理 OP_CHUNK_LIST，返回 OP_CHUNK_NEED 的 payload
+    std::string on_list(std::string_view payload);
+    // 还有需要的块没收齐 (此时 OP_DATA 属于块数据)
+    bool receiving() const { return inUpload && nextNeeded < needed.size(); }
+    void on_data(std::string_view data);
+    // 处理 OP_END：拼出文件，返回文件字节数；有块缺失或校验失败时返回 -1
+    long long finish();
+    // 连接断开时丢弃未完成的上传 (已经入库的块保留)
+    void cancel() { inUpload = false; }
+
+    bool active() const { return inUpload; }
+    const std::string& output_path() const { return outPath; }
+    long long chunks() const { return (long long)manifest.size(); }
+    long long new_chunks() const { return newChunks; }
+    long long new_bytes() const { return newBytes; }
+    const ChunkStore& store() const { return chunkStore; }
+
+private:
+    struct Entry {
+        ChunkHash hash;
+        uint32_t length;
+    };
+
+    std::string storePath;
+    ChunkStore chunkStore;
+    bool inUpload = false;
+    bool failed = false;
+    std::string outPath;
+    long long declaredSize = 0;
+    std::vector<Entry> manifest;
+    std::set<ChunkHash> requested;  // 本次上传中已经要过的块 (同一文件里的重复块只要一次)
+    std::vector<size_t> needed;     // 需要客户端发送的块在 manifest 中的下标
+    size_t nextNeeded = 0;
+    std::vector<char> cur;          // 正在接收的块
+    long long newChunks = 0;
+    long long newBytes = 0;
+};
+
+#endif  // DEDUP_TRANSFER_H
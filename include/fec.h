@@ -0,0 +1,137 @@
+#ifndef FEC_H
+#define FEC_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// 前向纠错 (FEC)：发送端每 k 个新数据段生成 m 个校验段，接收端丢了不超过 m 个段时直接用校验段恢复，
+// 不用等快速重传 / RTO (在高 RTT 的卫星、蜂窝链路上，每次丢包至少省一个 RTT)
+// - XOR: m 固定为 1，校验段是 k 个段的异或，能恢复组内任意 1 个丢失
+// - RS:  GF(256) 上的 Cauchy Reed-Solomon (系统码)，能恢复组内任意不超过 m 个丢失
+// - 自适应：接收端把测得的丢包率放在 TCPHeader::unused 里回传，发送端在组边界上调整冗余度
+//   (RS 调 m，XOR 调 k)，使 "组内丢失超过可恢复数量" 的概率不超过 FEC_TARGET_RESIDUAL
+//
+// 校验段的报文：TCPHeader (flags = FLAG_FEC | FLAG_ACK，seq = 组的起始序号) + FecHeader
+//               + n 个数据段长度 (uint16 网络序) + 校验数据 (symbol_len 字节，短的段按 0 补齐)
+
+enum class FecScheme : uint8_t { XOR = 0, RS = 1 };
+
+struct FecConfig {
+    bool enabled = false;
+    FecScheme scheme = FecScheme::XOR;
+    int k = 8;              // 每组数据段数 (XOR 自适应时为上限)
+    int m = 1;              // 每组校验段数 (RS 自适应时为上限；XOR 固定为 1)
+    bool adaptive = true;   // 按对端回传的丢包率调整冗余度
+};
+
+// 组大小上限：校验段 = TCPHeader + FecHeader + 2n + 最大段长，要放得进 MAX_DATAGRAM_SIZE
+const int FEC_MAX_K = 16;
+const int FEC_MAX_M = 8;
+// 自适应的目标：一组内丢失超过可恢复数量的概率
+const double FEC_TARGET_RESIDUAL = 0.01;
+// 组没攒满但这么久 (ms) 没有新数据时，把已有的段先出校验 (尾部丢包也能恢复)
+const int FEC_FLUSH_MS = 5;
+
+#pragma pack(push, 1)
+struct FecHeader {
+    uint32_t first_seq;   // 组内第一个数据段的序号 (网络序)
+    uint8_t scheme;       // FecScheme
+    uint8_t n;            // 组内数据段数 (提前出校验的组可能小于 k)
+    uint8_t m;            // 组内校验段数
+    uint8_t index;        // 本校验段的编号 [0, m)
+    uint16_t symbol_len;  // 校验数据长度 = 组内最长数据段的长度 (网络序)
+};
+#pragma pack(pop)
+
+// 解析 "xor:8" / "rs:10,4" 这样的配置，失败返回 false
+bool parse_fec_config(const char* text, FecConfig& out);
+
+// 发送端：逐段累加校验，组满时由连接取出校验段发出
+class FecEncoder {
+public:
+    void configure(const FecConfig& cfg);
+    bool enabled() const { return config.enabled; }
+
+    // 新数据段 (不含重传) 加入当前组；组必须由连续的序号组成。now 为发送时间 (连接的时钟)
+    void add(uint32_t seq, const char* data, size_t len, std::chrono::steady_clock::time_point now);
+    bool full() const { return count == k_cur; }
+    bool empty() const { return count == 0; }
+    std::chrono::steady_clock::time_point last_add_time() const { return last_add; }
+
+    // 当前组的校验段数，以及第 j 个校验段的 payload (写进 out，返回长度)
+    int parity_count() const { return m_cur; }
+    size_t build_parity(int j, char* out) const;
+    // 校验段发完后开始新的一组 (自适应时在这里调整 k / m)
+    void next_group();
+
+    // 对端回传的丢包率 (0-255 表示 0-100%)
+    void set_peer_loss(uint8_t loss) { peer_loss = loss; }
+    // 当前组一共会发出多少个段 (数据 + 校验)
+    int group_span() const { return k_cur + m_cur; }
+    // 窗口里留给数据段的部分：校验段同样占用链路，数据 + 校验一起不超过拥塞窗口
+    uint32_t data_share(uint32_t window) const { return uint32_t(uint64_t(window) * k_cur / (k_cur + m_cur)); }
+
+private:
+    FecConfig config;
+    int k_cur = 0;
+    int m_cur = 0;
+    uint8_t peer_loss = 0;
+
+    uint32_t first_seq = 0;
+    int count = 0;
+    uint16_t lens[FEC_MAX_K] = {};
+    size_t symbol_len = 0;
+    std::vector<std::vector<uint8_t>> parity;  // m_cur 个累加器
+    std::chrono::steady_clock::time_point last_add{};
+};
+
+// 接收端：缓存最近收到的数据段，收到校验段时尝试恢复丢失的段
+class FecDecoder {
+public:
+    struct Recovered {
+        uint32_t seq;
+        std::vector<char> data;
+    };
+
+    // 收到过校验段之后才开始缓存数据段 (对端没开 FEC 时没有额外开销)
+    bool active() const { return activated; }
+    void on_data(uint32_t seq, const char* data, size_t len);
+    // 处理一个校验段；恢复出来的数据段追加到 out (按序号从小到大)
+    void on_parity(const char* payload, size_t len, uint32_t rcv_nxt, std::vector<Recovered>& out);
+    // 丢掉不可能再用到的缓存 (rcv_nxt 之前超过一个最大组跨度的段)
+    void prune(uint32_t rcv_nxt);
+    void reset();
+
+    // 回传给对端的丢包率 (0-255)
+    uint8_t loss_feedback() const;
+    long long recovered_segments() const { return recovered; }
+
+private:
+    struct Group {
+        FecScheme scheme;
+        int n = 0;
+        int m = 0;
+        size_t symbol_len = 0;
+        std::vector<uint16_t> lens;
+        std::vector<std::vector<char>> parity;  // 没收到的为空
+        int parity_seen = 0;
+        bool decided = false;  // 数据已经完整 (收齐或已恢复)
+        int lost_data = 0;     // 最近一次检查时缺失的数据段数
+    };
+
+    // 组内数据齐了返回 true；缺的能恢复就恢复
+    bool try_decode(uint32_t first_seq, Group& g, uint32_t rcv_nxt, std::vector<Recovered>& out);
+    // 组结束，计入丢包率
+    void finalize(const Group& g);
+
+    bool activated = false;
+    std::map<uint32_t, std::vector<char>> cache;  // seq -> 数据段
+    std::map<uint32_t, Group> groups;              // first_seq -> 组
+    double loss = 0;
+    long long recovered = 0;
+};
+
+#endif  // FEC_H
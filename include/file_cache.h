@@ -0,0 +1,117 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "sparse_file.h"
+
+// 下载服务端的热点文件缓存 (很多客户端拉同一个发布包时，不必每次都重新打开、读文件)
+// - 文件第一次被下载时用 SparseFileReader 读一遍，数据区拷进内存、空洞只记长度，即预先分好段；
+//   之后的下载直接从这块内存发送
+// - 以 (设备号, inode, 大小, mtime) 识别文件版本，每次请求都 stat 一次，任何一项变了就重新加载
+// - 缓存的数据字节数超过容量时按 LRU 淘汰；正在发送的文件由 shared_ptr 持有，淘汰后等发送完才释放
+// 线程安全：表和统计都在一把互斥锁下，加载文件时不持锁
+
+// 一个已缓存的文件 (加载完成后只读)
+class CachedFile {
+public:
+    long long size() const { return fileSize; }
+    // 实际占用的内存 (空洞不占)
+    size_t data_bytes() const { return data.size(); }
+
+private:
+    friend class FileCache;
+    friend class CachedFileReader;
+
+    long long fileSize = 0;
+    std::vector<char> data;
+    std::vector<SparseFileReader::Extent> extents;  // 数据段的 data 指向上面的 data
+};
+
+// 按顺序遍历一个缓存文件的分段，接口与 SparseFileReader 相同
+class CachedFileReader {
+public:
+    explicit CachedFileReader(std::shared_ptr<const CachedFile> f) : file(std::move(f)) {}
+
+    long long size() const { return file->size(); }
+    bool next(SparseFileReader::Extent& out) {
+        if (index >= file->extents.size()) return false;
+        out = file->extents[index++];
+        return true;
+    }
+
+private:
+    std::shared_ptr<const CachedFile> file;
+    size_t index = 0;
+};
+
+class FileCache {
+public:
+    static const size_t DEFAULT_CAPACITY = 256 * 1024 * 1024;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;         // 包括加载失败和文件太大不缓存的请求
+        uint64_t evictions = 0;      // 因容量淘汰的条目
+        uint64_t invalidations = 0;  // 文件被修改 / 替换后丢弃的旧条目
+        size_t bytes = 0;            // 当前缓存的数据字节数
+        size_t files = 0;
+
+        double hit_ratio() const { return hits + misses > 0 ? double(hits) / (hits + misses) : 0; }
+    };
+
+    explicit FileCache(size_t capacity = DEFAULT_CAPACITY) : capacityBytes(capacity) {}
+
+    FileCache(const FileCache&) = delete;
+    FileCache& operator=(const FileCache&) = delete;
+
+    // 进程内的下载服务端默认共用的缓存
+    static FileCache& global();
+
+    // 设为 0 关闭缓存；缩小容量时立即淘汰到新容量以下
+    void set_capacity(size_t bytes);
+    size_t capacity() const;
+
+    // 取 path 的缓存内容，没有或已过期时加载；文件不存在、读取中被修改或单个文件超过容量的 1/4 时返回 nullptr，
+    // 调用方直接从磁盘发送
+    std::shared_ptr<const CachedFile> get(const std::string& path);
+
+    Stats stats() const;
+
+private:
+    struct Version {
+        uint64_t dev = 0, ino = 0;
+        long long size = 0;
+        int64_t mtimeNs = 0;
+        bool operator==(const Version& o) const {
+            return dev == o.dev && ino == o.ino && size == o.size && mtimeNs == o.mtimeNs;
+        }
+    };
+    struct Slot {
+        Version version;
+        std::shared_ptr<const CachedFile> file;
+        std::list<std::string>::iterator lru;
+    };
+
+    static bool stat_version(const std::string& path, Version& v, long long& allocated);
+    static std::shared_ptr<CachedFile> load(const std::string& path);
+    // 以下在持锁时调用
+    void erase(std::unordered_map<std::string, Slot>::iterator it);
+    void evict_to(size_t limit);
+
+    mutable std::mutex mutex;
+    size_t capacityBytes;
+    std::unordered_map<std::string, Slot> slots;
+    std::list<std::string> lruOrder;  // 头部最近使用
+    Stats counters;
+};
+
+#endif  // FILE_CACHE_H
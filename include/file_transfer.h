@@ -3,23 +3,64 @@
 
 #ifndef __APPLE__
 #include <cstring>     // 提供 memcpy
-#include <functional>  // 提供 std::function
 #endif
 
 #include <string>
 
+#include "tcp_async.h"
 #include "tcp_connection.h"
+#include "tcp_engine.h"
 
 // Constants
 const int SERVER_PORT = 8080;
 const std::string SERVER_IP = "127.0.0.1";
 
 // Entry points
-void run_server(int port);
-void run_client(const std::string& ip, int port);
+// engine = true 时由后台协议线程 (TCPEngine) 驱动连接，应用线程阻塞不会影响 ACK / 重传
+// fec: 本端发送的数据加 FEC 校验段 (默认不开，见 fec.h)
+// metrics: 定期导出传输统计的目标 (Prometheus 文本格式，见 transport_metrics.h)，为空时不导出
+// trace: 包级事件追踪文件 (见 packet_trace.h)，为空时不追踪
+void run_server(int port, bool engine = false, const FecConfig& fec = FecConfig(), const std::string& metrics = "",
+                int metrics_interval_ms = 1000, const std::string& trace = "");
+// async = true 时使用 C++20 协程版本 (Scheduler + AsyncTCPConnection)
+void run_client(const std::string& ip, int port, bool engine = false, bool async = false,
+                const FecConfig& fec = FecConfig(), const std::string& trace = "");
 
 // Core application logic exposed for potential reuse (optional)
 void upload_file(TCPConnection& conn, const std::string& filepath);
+void upload_file(TCPEngine& conn, const std::string& filepath);
 void download_file(TCPConnection& conn, const std::string& filename);
+void download_file(TCPEngine& conn, const std::string& filename);
+
+// 批量传输整个目录：所有文件在一条连接上连续发送，没有逐文件的往返，确认批量异步返回
+// 服务端保存到 received_<目录名>/，客户端下载保存到 downloaded_<目录名>/
+void upload_dir(TCPConnection& conn, const std::string& dirpath);
+void upload_dir(TCPEngine& conn, const std::string& dirpath);
+void download_dir(TCPConnection& conn, const std::string& dirname);
+void download_dir(TCPEngine& conn, const std::string& dirname);
+
+// 协程版本：由 Scheduler 驱动，可以在同一线程上并发运行多个传输
+struct TransferStats {
+    bool ok = false;        // 传输完成且字节数校验通过
+    long long bytes = 0;    // 传输的文件字节数
+    double seconds = 0;     // 耗时
+};
+
+// 去重上传：先发块清单，只传服务器块存储里没有的块，服务器拼出文件 (见 dedup_transfer.h)
+// 服务器保存为 received_<文件名>，块存储在服务器工作目录的 chunk_store/ 下
+struct DedupStats : TransferStats {
+    long long chunks = 0;       // 文件的块数
+    long long sent_chunks = 0;  // 实际发送的块数
+    long long sent_bytes = 0;   // 实际发送的块数据字节数
+};
+DedupStats upload_file_dedup(TCPConnection& conn, const std::string& filepath);
+DedupStats upload_file_dedup(TCPEngine& conn, const std::string& filepath);
+Task<TransferStats> upload_file_async(AsyncTCPConnection& conn, const std::string& filepath);
+Task<TransferStats> download_file_async(AsyncTCPConnection& conn, const std::string& filename);
+
+// 每个文件一条新连接下载 (短连接)，seconds 为从发起连接到收完文件的耗时
+// fast_open = true 时下载请求随 SYN 发出 (0-RTT)，服务器的第一个响应随 SYN-ACK 返回；
+// 第一次连接某个服务器时还没有 cookie，自动退化为普通握手并取得 cookie
+TransferStats fetch_file(const std::string& ip, int port, const std::string& filename, bool fast_open = true);
 
 #endif  // FILE_TRANSFER_H
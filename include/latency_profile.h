@@ -0,0 +1,114 @@
+#ifndef LATENCY_PROFILE_H
+#define LATENCY_PROFILE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// 热路径耗时剖析：作用域计时器把耗时记进 每个线程 x 每个埋点 的对数分桶直方图 (HDR 风格)，可以看到 p99 / p999
+// 这样的尾延迟，而不只是平均值。用来区分卡顿来自协议 (update / process_packet)、窗口 (等待发送)、磁盘还是调度。
+// - 埋点用 MYTCP_PROFILE_SCOPE(point)，只有编译时定义了 MYTCP_PROFILING (cmake -DMYTCP_ENABLE_PROFILING=ON)
+//   才会计时，否则展开为空语句，热路径上没有任何开销
+// - 每个线程写自己的直方图 (单写者，计数用 relaxed 原子量，不加锁)；汇报时按线程和合计分别输出
+// - 汇报：profile_report() 在每次传输结束时打印并清零，profile_dump_on_signal() 之后 kill -USR1 随时打印累计值
+
+enum ProfilePoint {
+    PROF_UPDATE,          // TCPConnection::update() 一次 (收包 + 状态机 + 超时检查)
+    PROF_PROCESS_PACKET,  // 处理一个收到的包 (process_packet)
+    PROF_SEND_WAIT,       // send_app_msg 等待发送窗口 (窗口有空间时接近 0)
+    PROF_DISK_WRITE,      // 接收端把一帧数据写进文件
+    PROF_DISK_READ,       // 发送端从文件 (或缓存) 取下一段
+    PROF_POINT_COUNT
+};
+
+const char* profile_point_name(ProfilePoint p);
+
+// 对数分桶直方图：值 (ns) 按 2 的幂分段，每段再均分成 SUB_BUCKETS 个线性子桶，相对误差不超过 1 / SUB_BUCKETS；
+// 记录是 O(1) 的 (一次 clz)，单线程写、任意线程读
+class LatencyHistogram {
+public:
+    static const int SUB_BITS = 5;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int MAX_EXPONENT = 40;  // 2^40 ns ≈ 18 分钟，更大的值记在最后一个桶
+    static const int BUCKETS = (MAX_EXPONENT - SUB_BITS + 2) * SUB_BUCKETS;  // 第一组是 0..SUB_BUCKETS-1 的精确值
+
+    void record(uint64_t ns) {
+        bump(counts[bucket_of(ns)], 1);
+        bump(total, 1);
+        bump(sum_ns, ns);
+        if (ns > max_ns.load(std::memory_order_relaxed)) max_ns.store(ns, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_ns.load(std::memory_order_relaxed); }
+    double mean() const { return count() ? double(sum_ns.load(std::memory_order_relaxed)) / count() : 0; }
+    // q 分位数 (0..1)，返回所在桶的中点
+    uint64_t percentile(double q) const;
+
+    // 累加到 dst (dst 只能由调用方一个线程使用)
+    void merge_into(LatencyHistogram& dst) const;
+    void reset();
+
+    static int bucket_of(uint64_t ns);
+    static uint64_t bucket_low(int b);
+
+private:
+    // 单写者：读改写不需要 lock 前缀，读者用 relaxed load 看到的是某个时刻的值
+    static void bump(std::atomic<uint64_t>& a, uint64_t d) {
+        a.store(a.load(std::memory_order_relaxed) + d, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> counts[BUCKETS] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sum_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+};
+
+// 当前线程的直方图里记一个值
+void profile_record(ProfilePoint p, uint64_t ns);
+// 给当前线程起个名字，输出里代替 thread-N；没有编译进剖析时什么都不做
+void profile_set_thread_name(const std::string& name);
+
+// 所有线程的 p50 / p99 / p999 / max / mean；reset 为 true 时输出后清零
+void profile_dump(std::ostream& out, bool reset = false);
+// 一次传输结束时调用：打印 (带上 label) 并清零，下一次传输重新统计；没有编译进剖析时什么都不做
+void profile_report(const std::string& label);
+// 收到 SIGUSR1 时把累计值打印到 stderr：在 main 里、启动其他线程之前调用 (由一个后台线程 sigwait，不在信号处理函数里输出)
+void profile_dump_on_signal();
+
+constexpr bool profile_enabled() {
+#ifdef MYTCP_PROFILING
+    return true;
+#else
+    return false;
+#endif
+}
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(ProfilePoint p) : point(p), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        profile_record(point, uint64_t(ns.count()));
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    ProfilePoint point;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define MYTCP_PROFILE_CONCAT_(a, b) a##b
+#define MYTCP_PROFILE_CONCAT(a, b) MYTCP_PROFILE_CONCAT_(a, b)
+#ifdef MYTCP_PROFILING
+#define MYTCP_PROFILE_SCOPE(point) ScopedTimer MYTCP_PROFILE_CONCAT(profile_scope_, __LINE__)(point)
+#else
+#define MYTCP_PROFILE_SCOPE(point) ((void)0)
+#endif
+
+#endif  // LATENCY_PROFILE_H
@@ -0,0 +1,42 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <atomic>
+#include <cstddef>
+
+// 进程级的接收缓冲区内存预算，所有连接共享
+// - 每条连接的接收缓冲上限 (rcvbuf) 都要先从这里预留，总和不超过 limit
+// - 最低额度 (TCPConnection::RCVBUF_MIN) 总是给的，保证每条连接都能推进；超出部分按需申请，申请不到就不增长
+// - 用量超过 limit 的 3/4 视为内存紧张，各连接逐步把 rcvbuf 收缩回最低额度 (类似 Linux 的 tcp_mem pressure)
+// 线程安全：计数器都是原子量，引擎线程 / 多个连接可以同时申请和归还
+class MemoryBudget {
+public:
+    static const size_t DEFAULT_LIMIT = 256 * 1024 * 1024;
+
+    explicit MemoryBudget(size_t limit = DEFAULT_LIMIT) : limit_bytes(limit) {}
+
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    // 进程内所有 TCPConnection 默认共用的预算
+    static MemoryBudget& global();
+
+    void set_limit(size_t bytes) { limit_bytes.store(bytes, std::memory_order_relaxed); }
+    size_t limit() const { return limit_bytes.load(std::memory_order_relaxed); }
+    size_t used() const { return used_bytes.load(std::memory_order_relaxed); }
+
+    // 最多预留 want 字节，返回实际预留到的字节数 (预算不足时可能为 0)
+    size_t reserve_up_to(size_t want);
+    // 不检查上限直接记账 (用于每条连接的最低额度)
+    void force_reserve(size_t bytes) { used_bytes.fetch_add(bytes, std::memory_order_relaxed); }
+    void release(size_t bytes) { used_bytes.fetch_sub(bytes, std::memory_order_relaxed); }
+
+    // 用量超过上限的 3/4：不再批准增长，已有连接应当收缩
+    bool under_pressure() const { return used() > limit() / 4 * 3; }
+
+private:
+    std::atomic<size_t> limit_bytes;
+    std::atomic<size_t> used_bytes{0};
+};
+
+#endif  // MEMORY_BUDGET_H
@@ -0,0 +1,124 @@
+#ifndef MULTIPATH_H
+#define MULTIPATH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "reassembly_buffer.h"
+#include "tcp_connection.h"
+#include "tcp_protocol.h"
+
+// 多路径连接 (类似 MPTCP)：一个连接级字节流分散到多条子流上发送，每条子流是一条普通的 TCPConnection，
+// 走自己的本地地址 -> 对端地址，有各自的拥塞窗口、RTT、pacing 和重传
+// - 客户端用 add_subflow 从多个本地地址连向多个服务端地址；每条子流建立后先发 JOIN 帧带上连接的 token，
+//   服务端用 listen 在自己的每个地址上各接受一条子流，token 和第一条子流不同的子流被拒绝 (关闭)
+// - 连接级序号 (DSN)：每个数据帧带着负载在整个字节流里的偏移，子流切到无序交付模式，段不管从哪条子流、
+//   以什么顺序到达都直接按 DSN 放进同一个重组缓冲；可靠性由各条子流自己保证
+// - 调度器决定每个段走哪条子流：
+//   SCHED_LOWEST_RTT  (默认) 按 SRTT 从小到大，挑第一条还能发的 (窗口、pacing、限速都允许)，快的路径发不动了
+//                     才溢出到慢的路径，重组缓冲里等慢路径的时间最短
+//   SCHED_MOST_CWND   挑拥塞窗口剩余空间最大的子流，各路径按窗口余量分摊，不看 RTT
+// - 连接级流量控制：接收方按应用读取的进度用 MAX_DATA 帧放开 MP_WINDOW 的额度，慢路径上的空洞
+//   让重组缓冲变大时，快路径也会被挡住，不会无限领先
+// 限制：子流中途断掉时，已经交给它、还没被确认的数据不会改走其他子流 (没有 reinjection)；
+// 服务端对象只承载一个连接 (第一条 JOIN 的 token)。
+//
+// 两端都必须使用 MultipathConnection。单线程使用，由调用方循环调用 update()。
+class MultipathConnection {
+public:
+    // 连接级接收窗口：要能盖住最慢路径的 RTT 内所有路径一共发出的数据 (重组缓冲最多这么大)
+    static const uint64_t MP_WINDOW = 8 * 1024 * 1024;
+    // 本端待发送缓冲区的上限，write() 超出部分不接收
+    static const size_t SEND_BUFFER = 1024 * 1024;
+    // 子流数的上限 (同 Linux MPTCP 的默认值)
+    static const size_t MAX_SUBFLOWS = 8;
+
+    enum Scheduler { SCHED_LOWEST_RTT, SCHED_MOST_CWND };
+
+    explicit MultipathConnection(bool is_server);
+    ~MultipathConnection();
+
+    MultipathConnection(const MultipathConnection&) = delete;
+    MultipathConnection& operator=(const MultipathConnection&) = delete;
+
+    // 服务端：在本机的 local_ip:port 上接受一条子流；每个地址调用一次
+    bool listen(const std::string& local_ip, int port);
+    // 客户端：从本机的 local_ip (空串表示由系统选择) 向 remote_ip:port 开一条子流
+    bool add_subflow(const std::string& local_ip, const std::string& remote_ip, int port);
+
+    void set_scheduler(Scheduler s) { scheduler = s; }
+    Scheduler get_scheduler() const { return scheduler; }
+
+    // 写入发送缓冲区，返回实际接收的字节数 (缓冲区满时可能小于 len)
+    size_t write(const void* data, size_t len);
+    // 缓冲区中的数据发完后结束发送方向
+    void finish();
+    // 非阻塞读：返回读取的字节数，暂无数据返回 0，对端已结束且数据读完返回 -1 (与 TCPConnection 一致)
+    size_t read(void* buffer, size_t maxLen);
+
+    // 驱动所有子流 + 调度发送
+    void update();
+    // 关闭所有子流 (之后的挥手由 update() 推进)
+    void close();
+
+    // 至少有一条子流已经加入，可以收发数据
+    bool established() const;
+    // 发送缓冲和 FIN 都交给了子流，并且所有子流上都没有未确认的数据
+    bool idle() const;
+
+    struct SubflowInfo {
+        std::string local;   // 本端地址：服务端是监听的 ip:port，客户端没指定时为空
+        std::string remote;  // 对端地址 (只有客户端知道)
+        bool joined = false;
+        uint64_t bytes = 0;  // 调度到这条子流上的连接级负载字节
+        TCPInfo tcp;
+    };
+    size_t subflow_count() const { return subflows.size(); }
+    SubflowInfo subflow_info(size_t i) const;
+
+private:
+    struct Subflow {
+        std::unique_ptr<TCPConnection> conn;
+        std::string local, remote;
+        bool joined = false;    // 客户端：JOIN 已经交给子流；服务端：收到了 token 正确的 JOIN
+        bool rejected = false;  // 服务端：token 不对，等 update() 关闭
+        std::vector<std::vector<char>> early;  // 服务端：JOIN 之前到达的段 (JOIN 丢了在重传)
+        size_t early_bytes = 0;                // 最多缓存 MP_WINDOW 字节，超过了说明对端不守规矩，拒绝这条子流
+        uint64_t bytes = 0;
+    };
+
+    Subflow& add(const std::string& local, const std::string& remote);
+    // 子流的无序交付回调
+    void on_segment(size_t index, const char* data, size_t len);
+    void on_frames(const char* data, size_t len);
+
+    bool usable(const Subflow& sf) const;
+    // 按调度器挑子流发一个段 (带 payload 字节的连接级数据)，都发不出去返回 false
+    bool send_segment(const char* data, size_t len, size_t payload);
+    void schedule();
+
+    bool server;
+    Scheduler scheduler = SCHED_LOWEST_RTT;
+    uint64_t token = 0;
+    bool have_token = false;  // 服务端：已经从第一条子流的 JOIN 拿到 token
+    std::vector<Subflow> subflows;
+
+    // 发送方向
+    std::deque<char> tx;            // 还没交给子流的数据
+    uint64_t tx_dsn = 0;            // 下一个要发送字节的 DSN
+    uint64_t tx_limit = MP_WINDOW;  // 对端允许发送到的上限
+    bool fin_pending = false;
+    bool fin_sent = false;
+
+    // 接收方向：按 DSN 重组，超出已通告额度的数据丢弃
+    ReassemblyBuffer rx{MP_WINDOW};
+    bool credit_pending = false;
+
+    std::vector<char> seg;  // 正在拼装的段
+};
+
+#endif  // MULTIPATH_H
@@ -0,0 +1,37 @@
+#ifndef NET_ENV_H
+#define NET_ENV_H
+
+#include <chrono>
+
+#include "tcp_socket.h"
+
+// TCPConnection 的运行环境：时钟 + 收发包
+// 默认 (不设置) 时连接用 steady_clock 和自己的 UDP socket；离散事件模拟器 (sim_network.h) 换成虚拟时钟和模拟链路，
+// 连接的代码完全不变，却可以比真实时间快很多地运行，并且同样的种子得到同样的结果
+class NetEnv {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    virtual ~NetEnv() = default;
+
+    // 当前时间 (连接里所有的计时、超时都以它为准)
+    virtual Clock::time_point now() const = 0;
+    // 发一个包给 target，返回发送的字节数，失败返回 -1
+    virtual int send_to(const void* data, int len, const Endpoint& target) = 0;
+    // 取一个到达本端的包，src 为发送方地址；没有包时返回 -1 (与非阻塞 socket 相同)
+    virtual int recv_from(void* buffer, int max_len, Endpoint& src) = 0;
+};
+
+// 收包来源：代替连接自己读 socket (TCPEngine 的 split 模式里由单独的收包线程收包、验证校验和后填充)
+// 包原地交给连接处理，不再拷贝一次
+class PacketSource {
+public:
+    virtual ~PacketSource() = default;
+
+    // 下一个包，没有包时返回 nullptr；返回的指针在 pop_packet() 之前有效 (至少按 8 字节对齐)
+    // checksum_ok：收包线程验证校验和的结果
+    virtual const char* front_packet(int& len, Endpoint& src, bool& checksum_ok) = 0;
+    virtual void pop_packet() = 0;
+};
+
+#endif  // NET_ENV_H
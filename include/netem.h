@@ -0,0 +1,102 @@
+#ifndef NETEM_H
+#define NETEM_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+// 用户态的网络损伤模拟 (类似 Linux netem，不需要 root)，供 netem_proxy 和各个基准程序使用
+// 一个 NetemLink 模拟一个方向的链路，包依次经过:
+//   丢包 (随机 / Gilbert-Elliott 突发) → 瓶颈队列 + 限速 (队列满尾丢) → 传播延迟 + 抖动 → 重排 / 重复 / 损坏
+// 所有随机决定都来自一个带种子的 mt19937_64：同样的种子和同样的到达顺序得到同样的丢包 / 重排序列
+
+struct NetemConfig {
+    double delay_ms = 0;   // 单向传播延迟
+    double jitter_ms = 0;  // 延迟在 [delay - jitter, delay + jitter] 内均匀分布；包之间保持先后顺序
+    double loss = 0;       // 随机丢包率 (%)
+    // Gilbert-Elliott 突发丢包：每个包先按 ge_p / ge_r 转移状态，再按所在状态的丢包率决定是否丢弃
+    bool ge = false;
+    double ge_p = 0;           // Good → Bad 的转移概率 (%)
+    double ge_r = 100;         // Bad → Good 的转移概率 (%)，平均突发长度 100 / ge_r
+    double ge_loss_bad = 100;  // Bad 状态的丢包率 (%)
+    double ge_loss_good = 0;   // Good 状态的丢包率 (%)
+    double reorder = 0;        // 该比例 (%) 的包不排队、不等延迟直接发出 (需要 delay > 0 才会超到前面)
+    double duplicate = 0;      // 复制一份的比例 (%)
+    double corrupt = 0;        // 随机翻转一位的比例 (%)
+    double rate_kbps = 0;      // 瓶颈带宽 (kbit/s)，0 = 不限速
+    size_t queue_bytes = 0;    // 瓶颈队列长度，0 = 按 100 ms 的带宽计算 (至少 64 KB)
+};
+
+// 解析 "delay=40,jitter=5,loss=1,ge=1:25,reorder=2,dup=0.5,corrupt=0.1,rate=20000,queue=200000"
+// 各项都可省略；ge=p:r[:lossBad[:lossGood]]；时间单位 ms，比例单位 %，rate 单位 kbit/s，queue 单位字节
+bool parse_netem_config(const std::string& text, NetemConfig& out);
+std::string describe_netem_config(const NetemConfig& cfg);
+
+struct NetemStats {
+    uint64_t packets = 0;      // 进入链路的包
+    uint64_t delivered = 0;    // 送达 (含重复出来的副本)
+    uint64_t lost = 0;         // 随机 / 突发丢包
+    uint64_t queue_drops = 0;  // 瓶颈队列满被尾丢
+    uint64_t reordered = 0;
+    uint64_t duplicated = 0;
+    uint64_t corrupted = 0;
+    uint64_t bytes = 0;  // 送达的字节数
+};
+
+class NetemLink {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit NetemLink(const NetemConfig& cfg = NetemConfig(), uint64_t seed = 1);
+
+    // 包在 now 到达链路入口
+    void submit(const char* data, size_t len, Clock::time_point now);
+    // 最早的包到期的时间；没有在途的包时返回 false
+    bool next_due(Clock::time_point& due) const;
+    // 取出一个到期的包 (now 之前到期的按到期顺序)，没有时返回 false
+    bool pop_due(Clock::time_point now, std::vector<char>& out);
+
+    const NetemConfig& config() const { return cfg; }
+    const NetemStats& stats() const { return counters; }
+    size_t in_flight() const { return pending.size(); }
+    // 瓶颈队列的排队时间 (现在进入链路的包要等多久才开始发送)，不限速时总是 0
+    Clock::duration backlog(Clock::time_point now) const {
+        return linkFree > now ? linkFree - now : Clock::duration::zero();
+    }
+
+private:
+    struct Packet {
+        Clock::time_point due;
+        uint64_t seq;  // 同时到期时保持提交顺序
+        std::vector<char> data;
+        bool operator>(const Packet& o) const { return due != o.due ? due > o.due : seq > o.seq; }
+    };
+
+    bool chance(double percent) { return percent > 0 && uniform(rng) * 100 < percent; }
+    bool should_drop();
+    void enqueue(Clock::time_point due, std::vector<char> data);
+
+    NetemConfig cfg;
+    std::mt19937_64 rng;
+    std::uniform_real_distribution<double> uniform{0.0, 1.0};
+    bool geBad = false;
+    Clock::time_point linkFree;  // 瓶颈链路空闲的时刻 (之前的包还在串行发送)
+    Clock::time_point lastDue;   // 上一个正常排队的包的到期时间 (抖动不打乱顺序)
+    size_t queueLimit = 0;
+    uint64_t nextSeq = 0;
+    std::priority_queue<Packet, std::vector<Packet>, std::greater<Packet>> pending;
+    NetemStats counters;
+};
+
+// 阻塞运行的 UDP 代理：客户端发到 listenPort 的包经 up 链路转给 serverPort，服务端的回包经 down 链路回到客户端
+// (最近一个发包的客户端地址)；statsIntervalS > 0 时每隔这么多秒在 stderr 打印一次两个方向的统计。
+// listenIp 非空时只在这个地址上监听 (多条路径各用一个代理、共用同一个端口时，见 bench_multipath)
+void run_netem_proxy(int listenPort, const std::string& serverIp, int serverPort, const NetemConfig& up,
+                     const NetemConfig& down, uint64_t seed = 1, int statsIntervalS = 0,
+                     const std::string& listenIp = "");
+
+#endif  // NETEM_H
@@ -0,0 +1,120 @@
+#ifndef PACKET_TRACE_H
+#define PACKET_TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 包级事件追踪：连接把 发包 / 收包 / 丢弃 / 重传 / 状态和窗口变化 写成定长二进制记录，
+// 放进每个连接自己的 SPSC 无锁环，由后台线程批量写入文件。
+// - 记录路径上只有一次 32 字节的槽位写入，不读时钟 (连接传入的时间戳)、不格式化、不加锁、不分配，也不碰文件
+// - 环按记录定长分槽，与 spsc_ring.h 的下标约定相同 (单调递增、容量为 2 的幂)；生产者缓存消费者的下标，
+//   环不满时不读对方的缓存行
+// - 运行时用 TCPConnection::set_trace() 打开 / 关闭；不追踪时每个埋点只是一次空指针判断
+// - 环满 (写线程跟不上) 时丢弃新记录并计数，不阻塞协议；丢弃数在关闭时写进文件末尾
+// 文件格式：TraceFileHeader + 若干 TraceRecord (本机字节序)；bench/trace2qlog 转成 qlog (JSON) 供 qvis 等工具画图
+
+enum TraceEventType : uint8_t {
+    TRACE_PACKET_SENT = 1,      // flags = TCP flags
+    TRACE_PACKET_RECEIVED = 2,  // flags = TCP flags (已通过校验和)
+    TRACE_PACKET_DROPPED = 3,   // flags = TraceDropReason
+    TRACE_RETRANSMIT = 4,       // flags = TraceRetransmitReason，a = 这个段第几次重传；紧接着是这个段的 PACKET_SENT
+    TRACE_STATE_CHANGED = 5,    // flags = 新状态，a = 旧状态
+    TRACE_WINDOW_UPDATED = 6,   // wnd = 对端通告的 rwnd，a = cwnd，b = 在途字节，ack = snd_una
+    TRACE_RECORDS_LOST = 7,     // 文件末尾：a / b = 因环满丢弃的记录数 (低 / 高 32 位)
+};
+
+enum TraceDropReason : uint8_t {
+    DROP_CHECKSUM = 1,    // 校验和错误或包太短
+    DROP_RCV_WINDOW = 2,  // 超出接收窗口
+    DROP_DUPLICATE = 3,   // 已经收过的数据
+    DROP_OOO_FULL = 4,    // 乱序块太多，接收缓冲记不下
+};
+
+enum TraceRetransmitReason : uint8_t {
+    RETRANSMIT_FAST = 1,  // 重复 ACK
+    RETRANSMIT_RTO = 2,   // 超时
+    RETRANSMIT_RACK = 3,  // RACK：后发的段已送达，超过重排窗口
+    RETRANSMIT_TLP = 4,   // 尾部丢包探测
+};
+
+// 一条事件记录 (32 字节)；seq / ack / wnd / len 对收发包是包头里的值 (主机字节序)
+struct TraceRecord {
+    uint64_t time_us;  // 连接的时钟 (steady_clock 或模拟器的虚拟时钟)
+    uint8_t type;      // TraceEventType
+    uint8_t flags;     // 含义见 TraceEventType
+    uint16_t len;      // payload 长度
+    uint32_t seq;
+    uint32_t ack;
+    uint32_t wnd;
+    uint32_t a;
+    uint32_t b;
+};
+static_assert(sizeof(TraceRecord) == 32, "trace records are fixed-size");
+
+struct TraceFileHeader {
+    char magic[8];          // "MYTCPTR1"
+    uint32_t version;       // 1
+    uint32_t record_size;   // sizeof(TraceRecord)
+    uint64_t wall_time_us;  // 打开追踪时的系统时间 (Unix 微秒)，qlog 的 reference_time
+    uint64_t reserved;
+};
+static_assert(sizeof(TraceFileHeader) == 32, "trace header is fixed-size");
+
+class PacketTrace {
+public:
+    static constexpr uint32_t VERSION = 1;
+
+    // capacity: 环能缓存的记录数 (默认 64K 条 = 2 MB，写线程每 10ms 清一次)
+    explicit PacketTrace(size_t capacity = 64 * 1024);
+    ~PacketTrace();
+
+    PacketTrace(const PacketTrace&) = delete;
+    PacketTrace& operator=(const PacketTrace&) = delete;
+
+    // 创建文件、写文件头并启动写线程；失败返回 false
+    bool open(const std::string& path);
+    // 写完环里剩下的记录和丢弃计数后关闭文件 (析构时自动调用)；调用前生产者必须已经停止记录
+    void close();
+    bool is_open() const { return file != nullptr; }
+
+    // 生产者 (驱动连接的线程)：环满时丢弃并计数
+    void record(const TraceRecord& r) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cached_head > mask) {
+            cached_head = head.load(std::memory_order_acquire);
+            if (t - cached_head > mask) {
+                lost.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        slots[t & mask] = r;
+        tail.store(t + 1, std::memory_order_release);
+    }
+
+    uint64_t records_lost() const { return lost.load(std::memory_order_relaxed); }
+
+private:
+    void writer_loop();
+    void drain();
+
+    std::vector<TraceRecord> slots;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> head{0};  // 写线程下标
+    alignas(64) std::atomic<size_t> tail{0};  // 生产者下标
+    size_t cached_head = 0;                   // 生产者上次看到的 head
+
+    FILE* file = nullptr;
+    std::thread writer;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> lost{0};
+};
+
+// 读取一个追踪文件；文件头不对时返回 false
+bool read_trace_file(const std::string& path, TraceFileHeader& header, std::vector<TraceRecord>& records);
+
+#endif  // PACKET_TRACE_H
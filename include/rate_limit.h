@@ -0,0 +1,77 @@
+#ifndef RATE_LIMIT_H
+#define RATE_LIMIT_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "tcp_protocol.h"
+
+// 发送限速：令牌桶 + 多个流之间按权重分配 (deficit round robin，DRR)
+// - 令牌按 rate 字节/秒持续补充，最多攒 burst 字节 (空闲之后允许的突发)；TCPConnection 只让首次发送的数据
+//   消耗令牌，重传补的是已经计过数的字节
+// - 一个限速器可以由多条连接共享 (比如服务端的总带宽)，每条连接注册成一个带权重的流。令牌不够分时按 DRR 轮流：
+//   每一轮每个活跃的流得到 weight x QUANTUM 字节的额度，额度用完的流要等其他活跃的流也用完才开始下一轮，
+//   长期看各流的速率之比等于权重之比；只有一个流在发时它独占全部速率 (不浪费带宽)
+// - IDLE_US 内没来要过令牌的流 (传完了、或者被窗口挡住) 视为空闲，不参与分配，剩下的额度作废
+// 线程安全：内部加锁，不同线程驱动的连接 (TCPEngine) 可以共享同一个限速器
+class RateLimiter {
+public:
+    static const size_t QUANTUM = MAX_PACKET_SIZE;  // DRR 每轮每单位权重的额度 (一个段)
+    static const int IDLE_US = 5000;
+    static const int DEFAULT_BURST_US = 10000;  // burst 不指定时按 10ms 的量，至少 BURST_MIN 字节
+    static const size_t BURST_MIN = 16 * 1024;
+
+    // rate: 字节/秒，0 表示不限速；burst: 桶的容量 (字节)，0 表示按默认值
+    explicit RateLimiter(uint64_t rate = 0, size_t burst = 0);
+
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+
+    void set_rate(uint64_t rate, size_t burst = 0);
+    uint64_t rate() const;
+
+    // 注册 / 注销一个流，返回流 ID；权重至少为 1
+    int add_flow(unsigned weight = 1);
+    void remove_flow(int flow);
+    void set_weight(int flow, unsigned weight);
+
+    // flow 现在要发 n 字节：可以发就扣掉令牌和额度，返回 0；否则什么都不扣，返回大约还要等多久
+    // flow < 0 表示不参与 DRR (限速器只有一个使用者时)
+    std::chrono::microseconds acquire(int flow, size_t n, std::chrono::steady_clock::time_point t);
+    // 只查询还要等多久 (不扣除，也不把流标记为活跃)，驱动循环用它决定睡多长
+    std::chrono::microseconds delay(int flow, size_t n, std::chrono::steady_clock::time_point t) const;
+
+    // 累计放行的字节数
+    uint64_t granted_bytes() const;
+
+private:
+    struct Flow {
+        bool registered = false;
+        bool active = false;
+        unsigned weight = 1;
+        size_t deficit = 0;  // 本轮还剩的额度
+        size_t want = 0;     // 最近一次要发的字节数
+        std::chrono::steady_clock::time_point last_seen{};
+    };
+
+    // 以下都在持锁时调用
+    double tokens_at(std::chrono::steady_clock::time_point t) const;
+    void expire_idle(std::chrono::steady_clock::time_point t);
+    // 其他活跃的流还有够发下一个段的额度 (本轮还没轮完)
+    bool others_pending(int flow, size_t& their_deficit) const;
+    std::chrono::microseconds wait_for(int flow, size_t n, std::chrono::steady_clock::time_point t) const;
+
+    mutable std::mutex mutex;
+    uint64_t rate_bps = 0;
+    double burst_bytes = 0;
+    double tokens = 0;
+    std::chrono::steady_clock::time_point refilled{};  // tokens 对应的时刻
+    bool started = false;                              // 第一次请求之前桶是满的
+    uint64_t granted = 0;
+    std::vector<Flow> flows;
+};
+
+#endif  // RATE_LIMIT_H
@@ -0,0 +1,49 @@
+#ifndef REASSEMBLY_BUFFER_H
+#define REASSEMBLY_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+
+// 按字节偏移重组的接收缓冲 + 额度式流量控制 (StreamMux 的每条流、MultipathConnection 的连接级字节流共用)
+// - 数据按 [offset, offset + n) 放入，可以乱序、重复、部分重叠；接上前面的部分按序进入待读队列，
+//   前面还有空洞的先按偏移存着 (只存还缺的部分，乱序块之间互不重叠)
+// - 对端最多只能发到已经通告的上限 (limit)，超出的数据当作流控错误丢弃，
+//   所以缓存的字节数 (按序 + 乱序) 不会超过 window
+// - 应用读走半个窗口以上时 credit_due() 为真：调用方把 next_limit() 发给对端 (MAX_DATA 帧)，
+//   发出后调用 credit_sent()
+class ReassemblyBuffer {
+public:
+    explicit ReassemblyBuffer(uint64_t window) : window(window), limit(window) {}
+
+    // 放入一段数据，fin 表示它是最后一段；超出额度、和已收到的 FIN 位置不符 (或 FIN 落在已收到的数据之前)
+    // 时丢弃并返回 false
+    bool insert(uint64_t offset, const char* p, size_t n, bool fin);
+    // 非阻塞读：返回读取的字节数，暂无数据返回 0，对端已结束且数据读完返回 -1 (与 TCPConnection 一致)
+    size_t read(void* buffer, size_t maxLen);
+
+    // 对端的数据已经全部被读走
+    bool finished() const { return consumed == fin_offset; }
+    // 按序可读的字节数
+    size_t readable() const { return ready.size(); }
+
+    // 需要给对端放额度了 (对端已经结束时不需要)
+    bool credit_due() const { return fin_offset == UINT64_MAX && consumed + window - limit >= window / 2; }
+    uint64_t next_limit() const { return consumed + window; }
+    void credit_sent(uint64_t new_limit) {
+        if (new_limit > limit) limit = new_limit;
+    }
+
+private:
+    uint64_t window;
+    uint64_t limit;                                 // 已告诉对端的上限
+    std::map<uint64_t, std::vector<char>> pending;  // 提前到达的数据 (按偏移，互不重叠)
+    std::deque<char> ready;                         // 已按序重组、等待应用读取
+    uint64_t next = 0;                              // 已按序重组到的偏移
+    uint64_t consumed = 0;                          // 应用已读取到的偏移
+    uint64_t fin_offset = UINT64_MAX;               // 对端 FIN 的位置
+};
+
+#endif  // REASSEMBLY_BUFFER_H
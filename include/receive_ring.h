@@ -0,0 +1,58 @@
+#ifndef RECEIVE_RING_H
+#define RECEIVE_RING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// TCPConnection 的接收缓冲：按序列号寻址的字节环，按序数据和乱序数据放在同一块存储里
+// - 字节 seq 存在 seq & mask 处；[read_seq, next) 是已按序收到、等应用读取的数据，
+//   next 之后已经收到的部分记在乱序块表里 (按序列号排好、互不重叠相邻的 [left, right))
+// - 乱序段直接写到它最终的位置，空洞补上时只需合并块表、推进 next，不再搬数据
+// - 存储按需翻倍增长 (只在窗口变大时发生，不在每个包上)，块表在构造时预留 MAX_RANGES 项，
+//   收包路径上不分配内存；块表满了、新段又接不上已有的块时丢弃该段 (对端会重传)
+// 序列号比较都相对 next 计算，所以要求所有数据都落在 next 之后 2^31 以内 (由接收窗口保证)
+class ReceiveRing {
+public:
+    static const size_t MAX_RANGES = 256;
+
+    ReceiveRing() { ranges.reserve(MAX_RANGES); }
+
+    // 清空并从序列号 seq 开始接收，释放存储 (连接结束时调用)
+    void reset(uint32_t seq);
+
+    // 放入 [seq, seq + n)，已经收过的部分忽略；p 为 nullptr 时只记录范围 (无序交付模式，数据已经交给了上层)
+    // 返回新收到的字节数 (0 表示整段重复)；块表已满放不下时返回 -1，什么也不做
+    int insert(uint32_t seq, const char* p, uint32_t n);
+    // 读出最多 len 字节的按序数据
+    size_t read(void* out, size_t len);
+    // 丢掉所有按序数据 (无序交付模式下它们在到达时已经交付过了)
+    void skip() { read_seq = next_seq; }
+
+    // 下一个期望按序收到的序列号
+    uint32_t next() const { return next_seq; }
+    size_t readable() const { return next_seq - read_seq; }
+    size_t ooo_bytes() const { return ooo; }
+    // 包含 seq 的乱序块，没有时返回 false
+    bool block(uint32_t seq, uint32_t& left, uint32_t& right) const;
+
+private:
+    struct Range {
+        uint32_t left, right;
+    };
+
+    uint32_t offset(uint32_t seq) const { return seq - next_seq; }
+    // 存储至少能放下 [read_seq, end)
+    void ensure(uint32_t end);
+    void copy_in(uint32_t seq, const char* src, size_t n);
+    void copy_out(uint32_t seq, char* dst, size_t n) const;
+
+    std::vector<char> buf;
+    uint32_t mask = 0;
+    uint32_t read_seq = 0;  // 应用读到的位置
+    uint32_t next_seq = 0;  // 按序收到的位置
+    std::vector<Range> ranges;
+    size_t ooo = 0;  // 块表里的字节数
+};
+
+#endif  // RECEIVE_RING_H
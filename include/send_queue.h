@@ -0,0 +1,98 @@
+#ifndef SEND_QUEUE_H
+#define SEND_QUEUE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 内部结构：发送段记录
+struct SendSegment {
+    uint32_t seq;
+    uint32_t len;
+    std::vector<char> data;
+    std::chrono::steady_clock::time_point last_send_time;
+    int retries = 0;
+    bool sacked = false;  // 对端用 SACK 告知已经收到 (乱序)，不再重传
+};
+
+// 发送队列 (SND.UNA -> SND.NXT)：SendSegment 的环形数组，段按序列号排列
+// 槽位和槽位里的 data 缓冲在段被确认后保留，下一个段原地复用，稳定状态下 push_back 不分配内存；
+// 在途的段数超过容量时翻倍，clear() 释放全部存储
+class SendQueue {
+public:
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    SendSegment& operator[](size_t i) { return slots[(head + i) & mask]; }
+    const SendSegment& operator[](size_t i) const { return slots[(head + i) & mask]; }
+    SendSegment& front() { return (*this)[0]; }
+    SendSegment& back() { return (*this)[count - 1]; }
+
+    // 在队尾放一个新段，payload 拷进复用的槽位
+    SendSegment& push_back(uint32_t seq, const void* data, size_t len, std::chrono::steady_clock::time_point t) {
+        if (count == slots.size()) grow();
+        SendSegment& seg = (*this)[count++];
+        const char* p = static_cast<const char*>(data);
+        seg.seq = seq;
+        seg.len = uint32_t(len);
+        seg.data.assign(p, p + len);
+        seg.last_send_time = t;
+        seg.retries = 0;
+        seg.sacked = false;
+        return seg;
+    }
+    void pop_front() {
+        head = (head + 1) & mask;
+        --count;
+    }
+    void clear() {
+        std::vector<SendSegment>().swap(slots);
+        head = count = mask = 0;
+    }
+
+    // 顺序遍历 (range-for)：指针走到数组末尾时绕回开头
+    template <typename T>
+    class Iter {
+    public:
+        Iter(T* p, T* first, T* last, size_t i) : p(p), first(first), last(last), i(i) {}
+        T& operator*() const { return *p; }
+        T* operator->() const { return p; }
+        Iter& operator++() {
+            if (++p == last) p = first;
+            ++i;
+            return *this;
+        }
+        bool operator!=(const Iter& o) const { return i != o.i; }
+
+    private:
+        T* p;
+        T* first;
+        T* last;
+        size_t i;
+    };
+    using iterator = Iter<SendSegment>;
+    using const_iterator = Iter<const SendSegment>;
+    iterator begin() { return iterator(slots.data() + head, slots.data(), slots.data() + slots.size(), 0); }
+    iterator end() { return iterator(nullptr, nullptr, nullptr, count); }
+    const_iterator begin() const {
+        return const_iterator(slots.data() + head, slots.data(), slots.data() + slots.size(), 0);
+    }
+    const_iterator end() const { return const_iterator(nullptr, nullptr, nullptr, count); }
+
+private:
+    void grow() {
+        std::vector<SendSegment> bigger(slots.empty() ? 64 : slots.size() * 2);
+        for (size_t i = 0; i < slots.size(); ++i) bigger[i] = std::move((*this)[i]);
+        slots.swap(bigger);
+        head = 0;
+        mask = slots.size() - 1;
+    }
+
+    std::vector<SendSegment> slots;  // 容量为 2 的幂
+    size_t mask = 0;
+    size_t head = 0;
+    size_t count = 0;
+};
+
+#endif  // SEND_QUEUE_H
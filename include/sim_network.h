@@ -0,0 +1,59 @@
+#ifndef SIM_NETWORK_H
+#define SIM_NETWORK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "netem.h"
+#include "tcp_connection.h"
+
+// 离散事件网络模拟器：多条真实的 TCPConnection 通过 NetEnv (见 net_env.h) 跑在模拟链路上，时钟是虚拟的
+// - 拓扑为哑铃型：每条流是一对 客户端 → 服务端 的上传，所有流共享同一条上行瓶颈链路和同一条下行链路
+//   (各为一个 NetemLink：带宽、传播延迟、队列长度、丢包等，见 netem.h)
+// - 有包到期就直接跳到那个时刻，否则时钟按 tick_ms 前进 (连接的定时器按这个粒度检查)，不等真实时间
+// - 链路的随机决定来自 seed，连接本身不依赖随机数和真实时间：同样的场景和种子得到完全相同的结果
+// 用来扫大量场景 (吞吐、公平性、瓶颈队列的排队延迟)，以及按种子精确复现一次异常
+struct SimFlow {
+    size_t bytes = 1024 * 1024;  // 上传的字节数
+    double start_ms = 0;         // 开始时间 (虚拟时间，从 0 算起)
+    uint64_t rate_limit = 0;     // 这条流自己的发送限速 (字节/秒，0 = 不限)
+    unsigned weight = 1;         // 在共享限速器里的权重
+};
+
+struct SimScenario {
+    NetemConfig up;    // 客户端 → 服务端 (数据方向) 的瓶颈链路
+    NetemConfig down;  // 服务端 → 客户端 (ACK 方向)
+    std::vector<SimFlow> flows;
+    uint64_t seed = 1;
+    double time_limit_s = 300;       // 虚拟时间上限，到时还没传完的流记为未完成
+    double tick_ms = 1;              // 没有包到期时时钟前进的步长
+    uint64_t shared_rate_limit = 0;  // 所有流共享的发送限速 (字节/秒，0 = 不限)，按各流的 weight 分配
+};
+
+struct SimFlowResult {
+    bool completed = false;
+    double start_s = 0;   // 虚拟时间
+    double finish_s = 0;  // 服务端收齐数据的时刻 (未完成时为模拟结束的时刻)
+    size_t bytes = 0;     // 服务端收到的字节数
+    double throughput_MBps = 0;
+    TCPConnection::SendStats send;  // 客户端的发送计数
+};
+
+struct SimResult {
+    std::vector<SimFlowResult> flows;
+    bool completed = false;   // 所有流都在时限内完成
+    double sim_time_s = 0;    // 模拟到的虚拟时间
+    double wall_s = 0;        // 实际耗时
+    double goodput_MBps = 0;  // 所有流的总字节 / (最后完成 - 最早开始)
+    double fairness = 0;      // 各流吞吐的 Jain 公平性指数 (1 = 完全公平)
+    double avg_queue_ms = 0;  // 上行瓶颈的排队延迟，按有流在传的时间加权平均
+    double max_queue_ms = 0;
+    uint64_t steps = 0;  // 事件循环的步数
+    NetemStats up, down;
+};
+
+// 运行一个场景直到所有流完成或到达时限；线程安全 (不同线程可以同时跑不同的场景)
+SimResult run_simulation(const SimScenario& scenario);
+
+#endif  // SIM_NETWORK_H
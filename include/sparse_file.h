@@ -0,0 +1,62 @@
+#ifndef SPARSE_FILE_H
+#define SPARSE_FILE_H
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 稀疏文件 / 全零块的省略传输 (虚拟机镜像、数据库文件大部分是空洞或零页)
+// - 发送端用 SEEK_DATA / SEEK_HOLE 跳过文件系统里的空洞，数据区内再按 SPARSE_BLOCK 扫描全零块
+// - 空洞和全零块合并成一条 OP_HOLE("字节数") 记录，不占数据段
+// - 接收端遇到 OP_HOLE 只移动写位置 (seekp)，末尾的空洞用 ftruncate 补齐文件长度，不写任何零
+
+// 全零检测的粒度 (与常见文件系统的块大小一致，零块省下来后接收端仍是对齐的空洞)
+const size_t SPARSE_BLOCK = 4096;
+
+// p[0, n) 是否全为 0 (SSE2 一次比较 64 字节，不支持时按 8 字节比较)
+bool is_zero_block(const char* p, size_t n);
+
+// 发送端：按文件顺序依次给出数据区和空洞
+class SparseFileReader {
+public:
+    struct Extent {
+        bool hole = false;
+        long long length = 0;
+        const char* data = nullptr;  // hole = false 时指向 length 字节，下一次 next() 之前有效
+    };
+
+    SparseFileReader() = default;
+    ~SparseFileReader();
+    SparseFileReader(const SparseFileReader&) = delete;
+    SparseFileReader& operator=(const SparseFileReader&) = delete;
+
+    bool open(const std::string& path);
+    long long size() const { return fileSize; }
+    // 取下一段，读完返回 false；连续的空洞和全零块合并成一段
+    bool next(Extent& out);
+
+private:
+    // 从 pos 起找下一个数据区，[pos, 数据区起点) 是空洞
+    long long seek_data(long long pos);
+    // 保证缓冲区里有 off 开始的数据 (不超过 dataEnd)，返回可用字节数
+    size_t fill(long long off);
+
+    int fd = -1;
+    long long fileSize = 0;
+    long long pos = 0;
+    long long dataEnd = 0;  // 当前数据区的终点 (SEEK_HOLE)
+    std::vector<char> buf;
+    long long bufStart = 0;
+    size_t bufLen = 0;
+};
+
+// OP_HOLE 的 payload：空洞的字节数 (十进制)
+bool parse_hole_length(std::string_view payload, long long& len);
+// 接收端：跳过一个空洞
+void skip_hole(std::ofstream& out, long long len);
+// 关闭后把文件长度补到 size (最后一段是空洞时，文件实际只写到了前一个数据区的末尾)
+bool finish_sparse_file(const std::string& path, long long size);
+
+#endif  // SPARSE_FILE_H
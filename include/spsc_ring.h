@@ -0,0 +1,87 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// 单生产者/单消费者无锁字节环形缓冲区
+// - 生产者只写 tail，消费者只写 head，两边各自 acquire 读取对方的下标，不需要互斥锁
+// - 容量向上取整到 2 的幂，下标单调递增，取模用位与
+// - head / tail 分别对齐到缓存行，避免两个线程互相踩 false sharing
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) {
+        size_t cap = 1;
+        while (cap < capacity) cap <<= 1;
+        buf.resize(cap);
+        mask = cap - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    size_t capacity() const { return buf.size(); }
+
+    // 可读字节数 (任一线程都可以调用，结果只是一个快照)
+    size_t size() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+
+    // 生产者：可写字节数
+    size_t free_space() const {
+        return buf.size() - (tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire));
+    }
+
+    // 生产者：写入最多 len 字节，返回实际写入的字节数
+    size_t write(const void* data, size_t len) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t h = head.load(std::memory_order_acquire);
+        size_t n = std::min(len, buf.size() - (t - h));
+        copy_in(t, static_cast<const char*>(data), n);
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+
+    // 消费者：拷贝出最多 len 字节但不移动读指针
+    size_t peek(void* out, size_t len) const {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t t = tail.load(std::memory_order_acquire);
+        size_t n = std::min(len, t - h);
+        copy_out(h, static_cast<char*>(out), n);
+        return n;
+    }
+
+    // 消费者：丢弃 len 字节 (len 不能超过 size())
+    void consume(size_t len) { head.store(head.load(std::memory_order_relaxed) + len, std::memory_order_release); }
+
+    // 消费者：读出最多 len 字节
+    size_t read(void* out, size_t len) {
+        size_t n = peek(out, len);
+        consume(n);
+        return n;
+    }
+
+private:
+    void copy_in(size_t pos, const char* src, size_t n) {
+        size_t off = pos & mask;
+        size_t first = std::min(n, buf.size() - off);
+        memcpy(buf.data() + off, src, first);
+        memcpy(buf.data(), src + first, n - first);
+    }
+
+    void copy_out(size_t pos, char* dst, size_t n) const {
+        size_t off = pos & mask;
+        size_t first = std::min(n, buf.size() - off);
+        memcpy(dst, buf.data() + off, first);
+        memcpy(dst + first, buf.data(), n - first);
+    }
+
+    std::vector<char> buf;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> head{0};  // 消费者下标
+    alignas(64) std::atomic<size_t> tail{0};  // 生产者下标
+};
+
+#endif  // SPSC_RING_H
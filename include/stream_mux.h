@@ -0,0 +1,110 @@
+#ifndef STREAM_MUX_H
+#define STREAM_MUX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "reassembly_buffer.h"
+#include "tcp_connection.h"
+#include "tcp_protocol.h"
+
+// 一条连接上的多路独立字节流 (类似 QUIC 的 stream)
+// - 连接切到无序交付模式：每个数据段一到就按帧头里的 (stream_id, offset) 放进对应流的重组缓冲，
+//   某个段丢了只会卡住它所在的那条流，其他流照常读 (消除队头阻塞)
+// - 每条流独立的流量控制 (MAX_DATA 帧放开额度)，一条流的接收方不读也不会占满整条连接
+// - 发送端按权重轮询 (deficit round robin)：每轮每条有数据的流得到 weight 个段的额度，按帧轮流装进段里，
+//   大文件不会把小消息挤在后面；权重高的流 (比如交互式下载) 按权重比例多分到连接的带宽
+// - 所有流共享同一条连接的重传和窗口状态
+//
+// 两端都必须使用 StreamMux，并且要在收到第一个数据段之前创建 (比如 bind / connect 之后立即创建)。
+// 单线程使用，由调用方循环调用 update()。
+class StreamMux {
+public:
+    // 每条流的接收窗口 (对端最多能领先应用层读取位置这么多字节)
+    // 比连接的发送窗口小：一条流卡在丢包空洞上时，连接窗口里仍有余量留给其他流
+    static const uint64_t STREAM_WINDOW = 64 * 1024;
+    // 每条流本端待发送缓冲区的上限，write() 超出部分不接收
+    static const size_t STREAM_SEND_BUFFER = 256 * 1024;
+    // 一端同时打开 (还没退役) 的流最多这么多条：接收方按它限制对端开流，超出的帧丢弃，
+    // 一个伪造的大流 ID 不会让本端建出几十亿条流；发送方 open_stream() 也按它限制自己
+    static const uint32_t MAX_OPEN_STREAMS = 1024;
+
+    StreamMux(TCPConnection& conn, bool is_server);
+    ~StreamMux();
+
+    StreamMux(const StreamMux&) = delete;
+    StreamMux& operator=(const StreamMux&) = delete;
+
+    // 本端新开一条流，返回流 ID；本端打开的流已经有 MAX_OPEN_STREAMS 条时返回 0
+    uint32_t open_stream();
+    // 取出对端新开的流，没有返回 false
+    bool accept(uint32_t& id);
+
+    // 写入流的发送缓冲区，返回实际接收的字节数 (缓冲区满时可能小于 len)
+    size_t write(uint32_t id, const void* data, size_t len);
+    // 缓冲区中的数据发完后结束该流的发送方向
+    void finish(uint32_t id);
+    // 非阻塞读：返回读取的字节数，暂无数据返回 0，对端已结束且数据读完返回 -1 (与 TCPConnection 一致)
+    size_t read(uint32_t id, void* buffer, size_t maxLen);
+
+    // 收包 (经由连接的无序交付回调) + 调度发送
+    void update();
+
+    // 流的发送权重 (默认 1，至少 1)：连接带宽不够分时各流按权重比例发送；只影响本端的发送方向
+    void set_weight(uint32_t id, unsigned weight);
+
+    // 该流还有多少字节没发出去
+    size_t pending(uint32_t id) const;
+    // 所有流都发完了，并且连接上没有未确认的数据
+    bool idle() const;
+    size_t stream_count() const { return streams.size(); }
+
+private:
+    struct Stream {
+        // 发送方向
+        std::deque<char> tx;                // 还没装进段的数据
+        uint64_t tx_offset = 0;             // 下一个要发送字节的流内偏移
+        uint64_t tx_limit = STREAM_WINDOW;  // 对端允许发送到的上限
+        bool fin_pending = false;
+        bool fin_sent = false;
+        unsigned weight = 1;
+        size_t deficit = 0;    // 本轮还能装的字节数 (DRR)
+        bool granted = false;  // 本轮的额度已经给过 (段发不出去中途返回时，下次接着用剩下的额度)
+
+        // 接收方向
+        ReassemblyBuffer rx{STREAM_WINDOW};
+        bool credit_queued = false;
+    };
+
+    // 连接的无序交付回调：解析段内的所有帧
+    void on_segment(const char* data, size_t len);
+    // 找到帧对应的流；对端新开的流自动创建并放进 accept 队列，已退役的流返回 nullptr
+    Stream* lookup_for_frame(uint32_t id);
+    // 两个方向都结束的流可以释放
+    void retire_if_done(uint32_t id);
+
+    // 轮询各条流，把帧装进段并交给连接
+    void schedule();
+    bool append_frame(uint8_t type, uint8_t flags, uint32_t id, uint64_t offset, const char* p, size_t n);
+    bool flush_segment();
+
+    TCPConnection& conn;
+    bool server;
+    uint32_t next_local_id;
+    uint32_t max_peer_id = 0;  // 对端开过的最大流 ID，比它小又不在表里的说明已经退役
+    uint32_t open_local = 0;   // 本端打开、还没退役的流
+    uint32_t open_peer = 0;    // 对端打开、还没退役的流
+
+    std::map<uint32_t, Stream> streams;
+    std::deque<uint32_t> accept_queue;
+    std::deque<uint32_t> credit_queue;  // 需要发送 MAX_DATA 的流
+    uint32_t rr_next = 0;               // 轮询起点 (当前轮到的流 ID)
+
+    std::vector<char> seg;  // 正在拼装的段
+    size_t seg_used = 0;
+};
+
+#endif  // STREAM_MUX_H
@@ -0,0 +1,274 @@
+#ifndef TCP_ASYNC_H
+#define TCP_ASYNC_H
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "tcp_connection.h"
+
+// C++20 协程异步接口
+// - Task<T>：惰性启动的协程返回类型，可以被 co_await (用对称转移 symmetric transfer 恢复调用方)
+// - Scheduler：单线程事件循环，每轮驱动所有连接的 update()，再恢复条件已满足的协程，
+//   没有协程可以继续时睡在 poll() 上 (等 socket 可读或最多 1ms 的重传检查间隔)
+// - AsyncTCPConnection：TCPConnection 的协程包装，提供 co_await 形式的 connect / send / receive
+//
+// 一个线程可以同时跑成百上千个传输，不需要回调，也不再忙等。
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+template <typename T>
+struct TaskPromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    // 协程结束时直接切回等待它的协程 (没有则回到 resume() 的调用者)
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept {
+            auto next = h.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { exception = std::current_exception(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase<T> {
+    T value{};
+    Task<T> get_return_object();
+    void return_value(T v) { value = std::move(v); }
+    T take() {
+        if (this->exception) std::rethrow_exception(this->exception);
+        return std::move(value);
+    }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase<void> {
+    Task<void> get_return_object();
+    void return_void() {}
+    void take() {
+        if (this->exception) std::rethrow_exception(this->exception);
+    }
+};
+
+}  // namespace detail
+
+template <typename T>
+class Task {
+public:
+    using promise_type = detail::TaskPromise<T>;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    Task() = default;
+    explicit Task(handle_type h) : handle(h) {}
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle) handle.destroy();
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        if (handle) handle.destroy();
+    }
+
+    bool done() const { return !handle || handle.done(); }
+
+    // 作为顶层任务启动 (由 Scheduler::spawn 调用)
+    void start() {
+        if (handle && !handle.done()) handle.resume();
+    }
+
+    // co_await 一个 Task：记录调用方，然后直接切换到被等待的协程
+    bool await_ready() const noexcept { return done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+        handle.promise().continuation = caller;
+        return handle;
+    }
+    T await_resume() { return handle.promise().take(); }
+
+private:
+    handle_type handle;
+};
+
+namespace detail {
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+inline Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+}  // namespace detail
+
+class Scheduler;
+class AsyncTCPConnection;
+
+// 挂起在 Scheduler 上的等待者：每轮事件循环调用 try_complete()，返回 true 时恢复对应协程
+class AsyncWaiter {
+public:
+    virtual ~AsyncWaiter() = default;
+    virtual bool try_complete() = 0;
+
+protected:
+    friend class Scheduler;
+    std::coroutine_handle<> handle;
+};
+
+class Scheduler {
+public:
+    Scheduler() = default;
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    // 提交一个顶层任务并立即运行到第一个挂起点，Scheduler 负责其生命周期
+    void spawn(Task<void> task);
+
+    // 运行到所有任务结束
+    void run();
+
+    // 运行一轮事件循环，没有协程可以继续时最多睡 timeout_ms 毫秒；返回是否还有未完成的任务
+    bool run_once(int timeout_ms = 1);
+
+    size_t active_tasks() const { return tasks.size(); }
+
+    // 以下由 awaiter / AsyncTCPConnection 内部使用
+    void suspend(AsyncWaiter* waiter, std::coroutine_handle<> h);
+    void attach(AsyncTCPConnection* conn);
+    void detach(AsyncTCPConnection* conn);
+
+    // 快速路径预算：条件已满足的 co_await 不挂起直接继续，但每轮最多允许这么多次，
+    // 防止一个协程一直不让出，导致 socket 长时间没人 drain、其他传输饿死
+    bool consume_fast_path() {
+        if (fast_path_budget <= 0) return false;
+        --fast_path_budget;
+        return true;
+    }
+
+private:
+    static const int FAST_PATH_PER_TICK = 4;
+
+    std::vector<Task<void>> tasks;
+    std::vector<AsyncWaiter*> waiters;
+    std::vector<AsyncWaiter*> ready;  // 复用，避免每轮分配
+    std::vector<AsyncTCPConnection*> conns;
+    int fast_path_budget = FAST_PATH_PER_TICK;
+};
+
+// co_await 形式的等待器：先尝试立即完成，否则挂到 Scheduler 上
+template <typename Derived, typename Result>
+class AsyncOp : public AsyncWaiter {
+public:
+    explicit AsyncOp(Scheduler& s) : sched(s) {}
+
+    bool await_ready() { return sched.consume_fast_path() && static_cast<Derived*>(this)->try_complete(); }
+    void await_suspend(std::coroutine_handle<> h) { sched.suspend(this, h); }
+    Result await_resume() { return static_cast<Derived*>(this)->result(); }
+
+protected:
+    Scheduler& sched;
+};
+
+class AsyncTCPConnection {
+public:
+    explicit AsyncTCPConnection(Scheduler& sched);
+    ~AsyncTCPConnection();
+
+    AsyncTCPConnection(const AsyncTCPConnection&) = delete;
+    AsyncTCPConnection& operator=(const AsyncTCPConnection&) = delete;
+
+    // 等待三次握手完成，成功返回 true，超时返回 false
+    class ConnectOp : public AsyncOp<ConnectOp, bool> {
+    public:
+        ConnectOp(AsyncTCPConnection& c, bool started, int timeout_ms);
+        bool try_complete() override;
+        bool result() const { return ok; }
+
+    private:
+        AsyncTCPConnection& conn;
+        std::chrono::steady_clock::time_point deadline;
+        bool ok = false;
+    };
+
+    // 等待整块数据都放入发送窗口 (按 MSS 切分)，连接已关闭返回 false
+    class SendOp : public AsyncOp<SendOp, bool> {
+    public:
+        SendOp(AsyncTCPConnection& c, const char* data, size_t len);
+        bool try_complete() override;
+        bool result() const { return ok; }
+
+    private:
+        AsyncTCPConnection& conn;
+        const char* data;
+        size_t len;
+        size_t offset = 0;
+        bool ok = true;
+    };
+
+    // 等待至少 1 字节可读；返回值同 TCPConnection::receive (EOF 为 -1)，超时返回 0
+    class ReceiveOp : public AsyncOp<ReceiveOp, size_t> {
+    public:
+        ReceiveOp(AsyncTCPConnection& c, void* buffer, size_t maxLen, int timeout_ms);
+        bool try_complete() override;
+        size_t result() const { return n; }
+
+    private:
+        AsyncTCPConnection& conn;
+        void* buffer;
+        size_t maxLen;
+        bool has_deadline;
+        std::chrono::steady_clock::time_point deadline;
+        size_t n = 0;
+    };
+
+    // 等待发送队列中所有数据都被 ACK
+    class FlushOp : public AsyncOp<FlushOp, bool> {
+    public:
+        FlushOp(AsyncTCPConnection& c, int timeout_ms);
+        bool try_complete() override;
+        bool result() const { return ok; }
+
+    private:
+        AsyncTCPConnection& conn;
+        std::chrono::steady_clock::time_point deadline;
+        bool ok = false;
+    };
+
+    ConnectOp async_connect(const std::string& ip, int port, int timeout_ms = 5000);
+    SendOp async_send(const void* data, size_t len) { return SendOp(*this, static_cast<const char*>(data), len); }
+    SendOp async_send(std::string_view data) { return SendOp(*this, data.data(), data.size()); }
+    ReceiveOp async_receive(void* buffer, size_t maxLen, int timeout_ms = -1) {
+        return ReceiveOp(*this, buffer, maxLen, timeout_ms);
+    }
+    FlushOp async_flush(int timeout_ms = 10000) { return FlushOp(*this, timeout_ms); }
+
+    void close() { conn.close(); }
+    TCPState get_state() const { return conn.get_state(); }
+    TCPConnection& raw() { return conn; }
+    Scheduler& scheduler() { return sched; }
+
+private:
+    Scheduler& sched;
+    TCPConnection conn;
+};
+
+#endif  // TCP_ASYNC_H
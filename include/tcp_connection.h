@@ -1,26 +1,25 @@
 #ifndef TCP_CONNECTION_H
 #define TCP_CONNECTION_H
 
+#include <algorithm>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
-#include <deque>
-#include <map>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "fec.h"
+#include "memory_budget.h"
+#include "net_env.h"
+#include "packet_trace.h"
+#include "rate_limit.h"
+#include "receive_ring.h"
+#include "send_queue.h"
 #include "tcp_protocol.h"
 #include "tcp_socket.h"
 
-// 内部结构：发送段记录
-struct SendSegment {
-    uint32_t seq;
-    uint32_t len;
-    std::vector<char> data;
-    std::chrono::steady_clock::time_point last_send_time;
-    int retries = 0;
-};
-
 // TCP 状态枚举
 enum TCPState {
     CLOSED,
@@ -36,6 +35,68 @@ enum TCPState {
     CLOSING
 };
 
+// 传输统计快照 (类似 Linux 的 TCP_INFO)，由 TCPConnection::info() 生成
+// 计数器从连接对象创建起累计 (reset() 不清零，方便导出成单调递增的 Prometheus counter)；其余为取快照时的当前值
+struct TCPInfo {
+    TCPState state = CLOSED;
+
+    // 发送
+    long long bytes_sent = 0;           // 首次发送的 payload 字节 (不含重传)
+    long long bytes_retransmitted = 0;  // 重传的 payload 字节
+    long long segments_sent = 0;        // 首次发送的数据段
+    long long fast_retransmits = 0;     // 重复 ACK / RACK 判定丢失后的重传
+    long long rto_retransmits = 0;      // 超时重传
+    long long tlp_probes = 0;           // 尾部丢包探测 (TLP) 重发的段
+    long long dup_acks_received = 0;    // 有数据在途时收到的、没有推进 snd_una 的纯 ACK
+
+    // 接收
+    long long bytes_received = 0;      // 按序交付给应用层 (或 segment handler) 的 payload 字节
+    long long segments_received = 0;   // 收到的数据段 (含乱序和重复)
+    long long duplicate_segments = 0;  // 已经收过的数据段 (对端的重传是多余的)
+    long long ooo_segments = 0;        // 乱序到达、先放进乱序缓冲的数据段
+    uint32_t ooo_bytes = 0;            // 乱序缓冲当前的字节数
+
+    // RTT (微秒)：发送端按 ACK 测量，只用没有重传过的段 (Karn)，按 RFC 6298 平滑；0 表示还没有样本
+    uint32_t srtt_us = 0;
+    uint32_t rttvar_us = 0;
+    uint32_t min_rtt_us = 0;
+    uint32_t rcv_rtt_us = 0;  // 接收端估计的 RTT (见 TCPConnection::receive_rtt_us)
+
+    // 窗口 (字节)
+    uint32_t cwnd = 0;
+    uint32_t rwnd = 0;         // 对端通告的接收窗口
+    uint32_t flight_size = 0;  // 已发送未确认 (snd_nxt - snd_una)
+    uint32_t rcv_wnd = 0;      // 本端可通告的接收窗口
+    uint32_t rcvbuf = 0;       // 本端接收缓冲上限
+
+    // 发送受限的时间 (微秒，累计)：发送队列为空的空闲时间不计
+    long long app_limited_us = 0;     // 窗口有余量，在等应用给数据
+    long long cwnd_limited_us = 0;    // 拥塞窗口满了
+    long long rwnd_limited_us = 0;    // 对端接收窗口满了 (接收方读得慢)
+    long long pacing_limited_us = 0;  // 窗口有余量，在等发送节奏 (pacing)
+    long long rate_limited_us = 0;    // 窗口有余量，被限速挡住 (见 TCPConnection::set_rate_limit)
+
+    // 发送节奏与 socket
+    uint64_t pacing_rate = 0;  // 字节/秒，0 表示不限速 (关闭或还没有 RTT 样本)
+    uint64_t rate_limit = 0;   // 本连接的限速 (字节/秒)，0 表示不限；不含共享限速器
+    int sock_rcvbuf = 0;       // 内核实际给的 SO_RCVBUF / SO_SNDBUF (Linux 上含簿记开销，是设置值的两倍)
+    int sock_sndbuf = 0;
+};
+
+// 新建连接的默认传输选项：进程内共享，tcp_app 的 --no-pacing / --sockbuf / --rate 等在 main 里修改，
+// 之后创建的连接按它初始化
+struct TransportOptions {
+    bool pacing = true;
+    uint64_t rate_limit = 0;                   // 每条连接的发送限速 (字节/秒)，0 表示不限
+    RateLimiter* shared_rate_limit = nullptr;  // 所有连接共享的限速器 (进程的总带宽)，nullptr 表示不限
+    unsigned rate_weight = 1;                  // 在共享限速器里的权重
+    int socket_rcvbuf = 4 * 1024 * 1024;       // SO_RCVBUF (<= 0 保持系统默认)，内核按 net.core.rmem_max 截断
+    int socket_sndbuf = 4 * 1024 * 1024;       // SO_SNDBUF，内核按 net.core.wmem_max 截断
+    bool split_io = false;                     // TCPEngine：收包放在单独的线程 (见 TCPEngine::set_split_io)
+
+    static TransportOptions& defaults();
+};
+
 class TCPConnection {
 public:
     TCPConnection();
@@ -43,9 +104,23 @@ public:
 
     // 作为 Server 启动监听
     bool bind(int port);
+    // 只在本机的某个地址上监听 (多网卡 / 多地址时每个地址一个连接，见 multipath.h)
+    bool bind(const std::string& ip, int port);
 
-    // 作为 Client 连接 Server
+    // 作为 Client 连接 Server；SYN 重发 MAX_SYN_RETRIES 次都没有回应时回到 CLOSED，调用方据此判断连接失败
     bool connect(const std::string& ip, int port);
+    // 客户端：从本机的指定地址发起连接 (选择出口网卡)，在 connect 之前调用；设置了 env 时不起作用
+    bool set_local_address(const std::string& ip);
+
+    // Fast Open (0-RTT)：第一个请求随 SYN 一起发出，服务器的第一个响应随 SYN-ACK 返回
+    // - 本进程之前从该服务器拿到过 cookie 时，early_data 直接放在 SYN 里，服务器校验 cookie 后立即交给应用
+    // - 没有 cookie (或 cookie 失效) 时 SYN 只用来申请 cookie，early_data 在握手完成后立即补发，退化为普通连接
+    // early_data 最多 TFO_MAX_DATA 字节，应当是可以安全重放的请求 (比如下载)
+    bool connect(const std::string& ip, int port, const void* early_data, size_t len);
+    static const size_t TFO_MAX_DATA = MAX_PACKET_SIZE - sizeof(TCPHeader) - TFO_COOKIE_LEN;
+
+    // 客户端：服务器是否接收了 SYN 里的数据 (true 表示这次连接真的省掉了一个 RTT)
+    bool fast_open_accepted() const { return tfo_accepted; }
 
     // 发送数据 (ARQ Stop-and-Wait)
     // 成功放入缓冲区返回 true，如果正在等待 ACK 则返回 false 或阻塞 (当前简单实现为返回 false)
@@ -65,46 +140,232 @@ public:
     // 获取当前状态
     TCPState get_state() const { return state; }
 
-    // 断开连接 (发送 FIN)
+    // 无序交付模式 (供 StreamMux 使用)：每个数据段第一次到达时就整段交给 handler，不等前面的空洞补齐。
+    // 可靠性 (累积 ACK、重传) 不变，但 receive() 不再有数据。要求上层的每个段都能独立解析。
+    using SegmentHandler = std::function<void(const char* data, size_t len)>;
+    void set_segment_handler(SegmentHandler handler) { segment_handler = std::move(handler); }
+
+    // 接收缓冲自动调整 (类似 Linux 的 receive buffer autotuning / DRS)
+    // - 接收缓冲上限 rcvbuf 从 RCVBUF_INIT 起步，每个接收端 RTT 统计一次应用取走的字节数，
+    //   按 2 倍 "带宽 x RTT" 增长，最多 RCVBUF_MAX；应用读得慢就不会增长
+    // - 按序和乱序缓存的数据都计入 rcvbuf，通告窗口 = rcvbuf - 已缓存字节，窗口右沿不回缩
+    // - rcvbuf 从 MemoryBudget 预留 (默认进程级共享)，预算紧张时逐步收缩回 RCVBUF_MIN
+    static const size_t RCVBUF_MIN = 64 * 1024;
+    static const size_t RCVBUF_INIT = 256 * 1024;
+    static const size_t RCVBUF_MAX = 32 * 1024 * 1024;
+    // 改用另一个预算 (当前预留的额度转移过去)
+    void set_memory_budget(MemoryBudget& b);
+    size_t receive_buffer_limit() const { return rcvbuf; }
+    // 接收端估计的 RTT (微秒)，0 表示还没有样本
+    uint32_t receive_rtt_us() const { return rcv_rtt_us; }
+
+    // 前向纠错 (见 fec.h)：在 connect / bind 之前设置。两端在握手时都声明能解校验段，
+    // 所以只需要发送方开启；对端不支持时不发校验段
+    void set_fec(const FecConfig& cfg);
+    struct FecStats {
+        long long parity_sent = 0;         // 本端发出的校验段数
+        long long recovered_segments = 0;  // 本端用校验段恢复的数据段数
+        uint8_t loss_feedback = 0;         // 本端测得的丢包率 (0-255)，回传给对端
+    };
+    FecStats fec_stats() const { return {fec_parity_sent, fec_rx.recovered_segments(), fec_rx.loss_feedback()}; }
+
+    // 数据段的发送计数 (连接对象生命周期内累计，不含纯 ACK 和校验段)
+    struct SendStats {
+        long long data_segments = 0;     // 首次发送的数据段
+        long long fast_retransmits = 0;  // 重复 ACK / RACK 判定丢失后的重传
+        long long rto_retransmits = 0;   // 超时重传
+        long long tlp_probes = 0;        // 尾部丢包探测
+        long long retransmits() const { return fast_retransmits + rto_retransmits + tlp_probes; }
+    };
+    const SendStats& send_stats() const { return send_counters; }
+
+    // 多路径调度用的廉价读数 (info() 会读 socket 选项，不适合每个段都调用)
+    uint32_t smoothed_rtt_us() const { return stats.srtt_us; }
+    // 拥塞窗口和对端接收窗口里还能再发的字节数
+    uint32_t send_window_available() const;
+
+    // 完整的传输统计快照 (见 TCPInfo)；开销很小，可以随时调用，但只能在驱动连接的线程里调用
+    TCPInfo info() const;
+
+    // 发送节奏 (pacing)：窗口一打开就把整窗数据背靠背发出去，浅缓冲的交换机和对端的 socket 接收缓冲会整段丢掉。
+    // 开启后数据段按 PACING_GAIN x cwnd / SRTT 的速率放出，空闲之后最多允许 PACING_BURST 个段 (至少 PACING_BURST_US
+    // 的量) 的突发；超时重传同样按这个速率分批发出，RACK / TLP 的重传只占用额度、不等待
+    // - send() 在节奏不允许时返回 false (与窗口满一样)，pacing_delay() 给出还要等多久 (也包括限速要等的时间)，
+    //   驱动循环据此决定睡多长
+    // - SRTT 还没有样本时不限速
+    void set_pacing(bool on) { pacing = on; }
+    bool pacing_enabled() const { return pacing; }
+    std::chrono::microseconds pacing_delay() const;
+    static const int PACING_BURST = 8;
+    static const int PACING_BURST_US = 1000;
+    // PACING_GAIN = 5 / 4：略高于 cwnd / SRTT，RTT 抖动时窗口仍能用满
+    static const int PACING_GAIN_NUM = 5;
+    static const int PACING_GAIN_DEN = 4;
+
+    // 发送限速 (见 rate_limit.h)：只限制首次发送的数据，重传、ACK 和握手不受限；两种可以同时使用
+    // - set_rate_limit：这条连接自己的令牌桶 (字节/秒，0 表示不限，burst 0 取默认)，即单个传输的限速
+    // - set_shared_rate_limit：加入多条连接共享的限速器 (比如服务端的总带宽)，按 weight 与其他连接加权分配；
+    //   nullptr 退出。limiter 由调用方持有，生命周期要长于连接；TCPEngine 要在启动协议线程之前设置
+    // send() 被限速挡住时返回 false，与窗口满一样
+    void set_rate_limit(uint64_t bytes_per_sec, size_t burst = 0);
+    uint64_t rate_limit() const { return own_limit ? own_limit->rate() : 0; }
+    void set_shared_rate_limit(RateLimiter* limiter, unsigned weight = 1);
+
+    // UDP socket 的内核缓冲 (字节，<= 0 保持不变)；默认取 TransportOptions::defaults()
+    void set_socket_buffers(int rcvbuf, int sndbuf) { socket.set_buffer_sizes(rcvbuf, sndbuf); }
+
+    // 换成注入的时钟和收发包接口 (见 net_env.h)，在 bind / connect 之前设置；env 由调用方持有，
+    // 生命周期要长于连接。设置后 socket 不再使用，bind 不占用端口，握手后也不 connect
+    void set_env(NetEnv* e) { env = e; }
+
+    // 分离收包：socket 由另一个线程读 (见 TCPEngine 的 split 模式)，update() 改从 source 取已经验证过校验和的包；
+    // 发包和时钟不变。source 由调用方持有，只能在驱动连接的线程不在 update() 里时切换
+    void set_packet_source(PacketSource* s) { source = s; }
+
+    // 包的校验和 (对整个包计算，结果为 0 表示正确)；不读写连接状态，任何线程都可以调用
+    static uint16_t calculate_checksum(const void* data, size_t len);
+
+    // 包级事件追踪 (见 packet_trace.h)，任何时候都可以打开 (传入已 open 的 trace) 或关闭 (nullptr)；
+    // trace 由调用方持有，只能在驱动连接的线程里切换 (TCPEngine 用它自己的 set_trace)
+    void set_trace(PacketTrace* t);
+
+    // 底层 UDP socket 句柄 (用于 poll 等待新包到达)
+    socket_t native_handle() const { return socket.native_handle(); }
+
+    // 断开连接 (发送 FIN)；之后的挥手由 update() 里的定时器推进：FIN 没被确认就按 RTO 退避重发，
+    // 两边都关闭后进入 TIME_WAIT，停留 time_wait 后结束 (服务端回到 LISTEN，客户端 CLOSED)。
+    // 服务端在等最后的 ACK / TIME_WAIT 期间收到新的 SYN 时直接放弃旧连接，接受新连接
     void close();
 
+    // TIME_WAIT 的时长 (默认 2 x MSL)，FIN_WAIT_2 等对端 FIN 也最多等这么久
+    static const int MSL = 1000;  // ms
+    void set_time_wait(std::chrono::milliseconds d) { time_wait = d; }
+
     // 重置状态 (用于 Server 重新进入 LISTEN)
     void reset();
 
 private:
+    // 微基准 (bench/bench_protocol.cpp) 绕过 socket 和握手，直接驱动下面的内部函数
+    friend struct TCPConnectionProbe;
+
     // 状态机处理函数
-    void process_packet(const TCPHeader& header, const char* data, int len, const std::string& src_ip, int src_port);
+    void process_packet(const TCPHeader& header, const char* data, int len, const Endpoint& src);
 
     // 检查是否超时重传
     void check_timeout();
 
+    // 丢包检测 (RACK-TLP，RFC 8985 的简化版，两端在握手时用 FLAG_SACK 声明支持)
+    // - 接收方对乱序到达的段回 SACK ACK (payload 为包含该段的连续乱序块 [left, right))
+    // - RACK：一个段被确认 (累积或 SACK) 时，比它先发出、还没被确认的段等过 RTT + 重排窗口 (min_rtt / 4)
+    //   就判为丢失并立即重传；还没到期的由 rack_timer 在 check_timeout 里再检查。不数重复 ACK，轻微重排不会误重传
+    // - TLP：有数据在途但 2 x SRTT (至少 TLP_MIN_MS) 没有任何确认时，重发最后一个段探测，
+    //   让尾部的丢包也能产生 SACK 走 RACK 恢复，而不用等 RTO
+    // 对端不支持时退回 重复 ACK 快速重传
+    void send_sack(uint32_t seq, uint32_t len);
+    // 标记 SACK 块里的段，返回是否有新确认的段
+    bool on_sack(uint32_t left, uint32_t right, std::chrono::steady_clock::time_point t);
+    // 一个段被确认 (第一次)：更新 RACK 的 "最近发出且已送达的段"
+    void rack_update(const SendSegment& seg, std::chrono::steady_clock::time_point t);
+    void rack_detect_loss(std::chrono::steady_clock::time_point t);
+    void retransmit(SendSegment& seg, uint8_t reason, std::chrono::steady_clock::time_point t);
+
+    // 连接建立后收到的 FEC 校验段 / ACK / 数据 (ESTABLISHED、CLOSE_WAIT 和半关闭的 FIN_WAIT_1/2 共用)；
+    // 返回 true 表示是不带数据的控制包，FIN 由调用方按状态处理
+    bool receive_segment(const TCPHeader& header, uint32_t seqNum, uint32_t ackNum, const char* data, int len);
+
+    // 挥手：FIN 占一个序列号 (fin_seq)，对端确认到 fin_seq + 1 才算收到
+    void send_fin();
+    // 收到对端的 FIN：正好接在已收数据之后才接受 (rcv_nxt 加一)；每次都回 ACK (对端重发的 FIN 说明上次的 ACK 丢了)
+    bool accept_fin(uint32_t seq);
+    // 挥手阶段收到 ACK：确认掉 FIN 之前的数据，返回 FIN 是否也被确认了
+    bool ack_fin(uint32_t ack);
+    void enter_time_wait();
+    // 挥手结束或放弃：清空连接，服务端回到 LISTEN，客户端 CLOSED
+    void finish_close();
+    // 清空连接的收发状态 (reset / finish_close 共用)
+    void clear_connection();
+
     // 发送包的辅助函数
     void send_packet(uint8_t flags, const char* data = nullptr, int len = 0);
     // 重载：指定 Seq 发送数据包 (用于重传/Sliding Window)
-    void send_packet(const char* data, int len, uint32_t seq);
+    void send_packet(const char* data, int len, uint32_t seq, uint8_t flags = FLAG_ACK);
+    // (重) 发 SYN，Fast Open 时带上 cookie + early data
+    void send_syn();
+    // 服务端回 SYN-ACK：客户端用了 Fast Open 时 payload 以 cookie 开头，后面可以搭载应用的第一个响应
+    void send_synack(const char* data = nullptr, int len = 0, uint32_t seq = 0);
+    // 服务端按客户端 IP 计算 cookie (SipHash-2-4，密钥每个进程随机生成一次，所有连接共用)
+    uint64_t make_cookie(const Endpoint& client) const;
+    // 组装 Header + Payload、计算校验和并交给 socket (复用 tx_buf，不做每包分配)
+    void transmit(TCPHeader& header, const char* data, int len);
+    // 处理收到的一个包 (socket 读到的，或 packet source 交来的)；verified 时 checksum_ok 是已经验证过的结果
+    void receive_datagram(const char* data, int bytes, const Endpoint& src, bool verified, bool checksum_ok);
+
+    // 追踪：记一条事件 (调用方先判断 trace 非空)；状态 / 窗口和上次记录的不同时补一条变化事件
+    // 事件的时间戳取 trace_time：读时钟比写一条记录贵得多，每个收到的包 / 每次 API 调用只读一次，
+    // 同一次处理里产生的事件 (收包、回 ACK、状态变化) 共用它
+    void trace_event(uint8_t type, uint8_t flags, uint32_t seq, uint32_t ack, uint32_t wnd, uint32_t len, uint32_t a = 0,
+                     uint32_t b = 0);
+    void trace_changes();
+    void trace_clock() {
+        if (trace) trace_time = now();
+    }
 
-    uint16_t calculate_checksum(const void* data, size_t len);
+    // 当前时间：设置了 env 时用它的虚拟时钟
+    std::chrono::steady_clock::time_point now() const { return env ? env->now() : std::chrono::steady_clock::now(); }
 
-    uint32_t get_window_size() noexcept { return MAX_RWND - in_buffer.size() * sizeof(char); }
+    // 当前可通告的接收窗口：rcvbuf 减去已缓存的字节，但不小于已经答应过对端的部分
+    uint32_t get_window_size() const noexcept {
+        size_t buffered = rx.readable() + rx.ooo_bytes();
+        uint32_t free_space = rcvbuf > buffered ? uint32_t(rcvbuf - buffered) : 0;
+        int32_t promised = int32_t(rcv_wnd_edge - rcv_nxt);
+        return std::max<uint32_t>(free_space, promised > 0 ? uint32_t(promised) : 0);
+    }
+    // 填进包头的窗口，同时记下通告的右沿
+    uint32_t advertise_window() noexcept {
+        uint32_t win = get_window_size();
+        rcv_wnd_edge = rcv_nxt + win;
+        return win;
+    }
+    // 应用取走了 copied 字节：够一个接收端 RTT 了就按取走的速度调整 rcvbuf
+    void rcv_space_adjust(size_t copied);
+    // 按到达的按序数据推进接收端 RTT 测量 (没有时间戳选项，用 "收满一个窗口的时间" 估计，同 Linux)
+    void rcv_rtt_measure();
+    void rcv_rtt_sample(int64_t us);
+    // 预算紧张时收缩 rcvbuf
+    void check_memory_pressure();
+    // FEC：发出当前组的校验段；处理收到的校验段
+    void emit_fec_group();
+    void on_fec_parity(const char* data, int len);
+    // 快速重传的重复 ACK 门限 (开启 FEC 时放宽到一组的长度，先让校验段恢复)
+    uint16_t dup_ack_threshold() const;
+    // 发送端 RTT 样本 (RFC 6298 平滑)
+    void rtt_sample(int64_t us);
+    // 发送受限状态切换，把上一段时间计入对应的受限时间
+    enum SendLimit { LIMIT_IDLE, LIMIT_APP, LIMIT_CWND, LIMIT_RWND, LIMIT_PACING, LIMIT_RATE };
+    void set_send_limit(SendLimit next);
 
 private:
     TCPSocket socket;
+    NetEnv* env = nullptr;           // 非空时代替 socket 和系统时钟
+    PacketSource* source = nullptr;  // 非空时代替 socket 收包
     TCPState state;
 
     // 对端信息
-    std::string peer_ip;
-    int peer_port;
+    Endpoint peer;
+    bool peer_connected = false;  // socket 是否已 connect() 到 peer (握手完成后的客户端)
+
+    std::vector<char> tx_buf;  // 发包时的拼装缓冲区 (只增长不释放)
 
     // Sliding Window 状态
-    std::deque<SendSegment> send_queue;                         // 发送队列 (SND.UNA -> SND.NXT)
-    std::map<uint32_t, std::vector<char>> out_of_order_buffer;  // 乱序接收缓冲
+    SendQueue send_queue;  // 发送队列 (SND.UNA -> SND.NXT)
+    ReceiveRing rx;        // 接收缓冲：已确认但应用层未取走的数据 + 乱序到达的数据
 
     // 简单流控 & 拥塞控制
     uint32_t MAX_RWND = INT32_MAX;
-    uint32_t rwnd = MAX_RWND;    // 对方的接收窗口 (默认 64KB)
+    uint32_t rwnd = MAX_RWND;    // 对方的接收窗口 (收到对方第一个包之前不限制)
     uint32_t cwnd = 100 * 1400;  // 拥塞窗口 (加大到 100 MSS 以测试吞吐)
 
-    std::deque<char> in_buffer;  // 接收缓冲区 (存放已确认但应用层未取走的数据)
+    SegmentHandler segment_handler;  // 非空时为无序交付模式
     uint16_t dup_ack_cnt = 0;
     uint16_t MAX_DUP_CNT = 3;
     const int RTO = 200;  // 超时时间 (ms)
@@ -118,10 +379,88 @@ private:
     uint32_t iss;  // Initial Send Sequence
     uint32_t irs;  // Initial Receive Sequence
 
+    // Fast Open
+    bool tfo_client = false;        // 客户端：这次 SYN 带了 FLAG_TFO
+    bool tfo_peer = false;          // 服务端：对端的 SYN 带了 FLAG_TFO
+    bool tfo_accepted = false;      // 客户端：服务器接收了 SYN 里的数据
+    bool synack_pending = false;    // 服务端：SYN-ACK 推迟发送，等应用的第一个响应搭车
+    std::vector<char> syn_payload;  // 客户端：SYN 的 payload (cookie + early data)，重传 SYN 时复用
+    std::chrono::steady_clock::time_point syn_time{};  // SYN 发出 / SYN-ACK 推迟开始的时间
+    int syn_retries = 0;                               // 客户端：SYN 已经重发了几次
+    static const int MAX_SYN_RETRIES = 5;              // SYN 重发几次 (200ms 起翻倍，约 12s) 都没有回应就放弃连接
+    static const int TFO_SYNACK_DELAY = 5;             // SYN-ACK 最多推迟多久 (ms)
+
+    // 接收缓冲自动调整
+    MemoryBudget* budget = &MemoryBudget::global();
+    size_t rcvbuf = 0;         // 接收缓冲上限 (已从 budget 预留)
+    uint32_t rcv_wnd_edge = 0;  // 已通告窗口的右沿 (rcv_nxt + window)
+    uint32_t rcv_rtt_us = 0;
+    uint32_t rcv_rtt_seq = 0;  // rcv_nxt 越过它时得到一个 RTT 样本
+    bool rcv_rtt_active = false;
+    bool syn_retransmitted = false;  // 重传过的 SYN / SYN-ACK 不取握手 RTT 样本 (Karn)
+    bool synack_sent = false;
+    std::chrono::steady_clock::time_point rcv_rtt_time{};
+    size_t rcv_space = 0;   // 一个 RTT 内应用取走字节数的最大值
+    size_t rcv_copied = 0;  // 本轮已取走的字节数
+    std::chrono::steady_clock::time_point rcv_space_time{};
+    std::chrono::steady_clock::time_point pressure_check_time{};
+
+    // RACK-TLP
+    bool peer_sack = false;  // 对端在握手时声明能解 SACK ACK
+    size_t sacked_count = 0;  // send_queue 里已被 SACK 的段数 (为 0 时没有空洞，不用做丢包检测)
+    std::chrono::steady_clock::time_point rack_xmit_time{};  // 已送达的段里最晚发出的那个的发送时间
+    uint32_t rack_end_seq = 0;                                 // 它的结束序列号
+    std::chrono::microseconds rack_rtt{0};                    // 它的 RTT
+    std::chrono::steady_clock::time_point rack_timer{};       // 重排窗口到期时再检查 (未设置时为 epoch)
+    std::chrono::steady_clock::time_point last_delivery{};    // 上次有段被确认的时间 (TLP 计时)
+    bool tlp_fired = false;                                   // 这一轮已经探测过，等新的确认
+    static const int TLP_MIN_MS = 10;
+
+    // FEC
+    FecEncoder fec_tx;
+    FecDecoder fec_rx;
+    bool peer_fec = false;  // 对端在握手时声明能解校验段
+    long long fec_parity_sent = 0;
+
+    PacketTrace* trace = nullptr;  // 非空时记录包级事件 (见 packet_trace.h)
+    TCPState traced_state = CLOSED;
+    uint32_t traced_rwnd = 0;
+    uint32_t traced_cwnd = 0;
+    std::chrono::steady_clock::time_point trace_time{};
+
+    SendStats send_counters;
+    TCPInfo stats;  // info() 的计数器部分 (发送段数 / 重传次数在 send_counters 里)
+    SendLimit send_limit = LIMIT_IDLE;
+    std::chrono::steady_clock::time_point send_limit_since{};
+    long long send_limit_us[6] = {};
+
+    // 发送节奏
+    bool pacing = TransportOptions::defaults().pacing;
+    std::chrono::steady_clock::time_point pacing_next{};  // 下一个段最早的发出时间
+    // len 字节按当前速率占用的发送时间；charge 记一笔发送，blocked 为 true 时还不能发新段
+    std::chrono::nanoseconds pacing_interval(uint32_t len) const;
+    void pacing_charge(uint32_t len, std::chrono::steady_clock::time_point t);
+    bool pacing_blocked(std::chrono::steady_clock::time_point t) const {
+        return pacing && stats.srtt_us > 0 && pacing_next > t;
+    }
+
+    // 发送限速
+    std::unique_ptr<RateLimiter> own_limit;
+    RateLimiter* shared_limit = nullptr;
+    int shared_flow = -1;
+    size_t rate_blocked_len = 0;  // 被限速挡住的段长 (pacing_delay 按它估计要等多久)，0 表示没被挡住
+    // 两个限速器都允许时扣掉 len 字节的令牌，返回 true
+    bool rate_acquire(size_t len, std::chrono::steady_clock::time_point t);
+
     std::chrono::steady_clock::time_point start_wait_time{};
-    std::chrono::steady_clock::time_point start_close_time{};
 
-    size_t MAX_CLOSE_WAIT_TIME = 10;  // s
+    // 挥手
+    bool listening = false;  // bind 过：挥手结束后回到 LISTEN
+    uint32_t fin_seq = 0;
+    int fin_retries = 0;
+    std::chrono::steady_clock::time_point close_timer{};  // FIN 上次发出 / 进入 FIN_WAIT_2 或 TIME_WAIT 的时间
+    std::chrono::milliseconds time_wait{2 * MSL};
+    static const int MAX_FIN_RETRIES = 4;  // FIN 重发几次 (200ms 起翻倍，约 6s) 都没被确认就放弃
 };
 
 #endif  // TCP_CONNECTION_H
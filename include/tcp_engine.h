@@ -0,0 +1,179 @@
+#ifndef TCP_ENGINE_H
+#define TCP_ENGINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spsc_ring.h"
+#include "tcp_connection.h"
+
+// 线程间唤醒器：Linux 上是 eventfd，其他平台退化为 pipe
+class WakeupFd {
+public:
+    WakeupFd();
+    ~WakeupFd();
+
+    WakeupFd(const WakeupFd&) = delete;
+    WakeupFd& operator=(const WakeupFd&) = delete;
+
+    void notify();
+    // 清掉已经累积的唤醒信号
+    void drain();
+    // 可以放进 poll() 的读端 fd
+    int fd() const { return read_fd; }
+
+private:
+    int read_fd = -1;
+    int write_fd = -1;
+};
+
+// split 模式的收包环：收包线程 (生产者) 把包直接 recv 进槽位并验证校验和，协议线程 (消费者) 经由 PacketSource
+// 接口原地处理，不再拷贝。下标约定与 spsc_ring.h 相同 (单调递增、容量为 2 的幂、head / tail 各占一个缓存行)
+class IngressRing : public PacketSource {
+public:
+    struct Slot {
+        alignas(64) char data[MAX_DATAGRAM_SIZE];
+        int len = 0;
+        bool checksum_ok = false;
+        Endpoint src;
+    };
+
+    // 分配 slots 个槽位 (向上取整到 2 的幂)；只能在两个线程启动之前调用
+    void init(size_t slots);
+
+    // 生产者：空闲槽位数；第 k 个空闲槽位 (k < free_slots())；把前 n 个空闲槽位发布给消费者
+    size_t free_slots() const {
+        return slots.size() - (tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire));
+    }
+    Slot& producer_slot(size_t k) { return slots[(tail.load(std::memory_order_relaxed) + k) & mask]; }
+    void push(size_t n) { tail.store(tail.load(std::memory_order_relaxed) + n, std::memory_order_release); }
+
+    // 任一线程：快照
+    bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+
+    // 消费者 (协议线程)
+    const char* front_packet(int& len, Endpoint& src, bool& checksum_ok) override;
+    void pop_packet() override { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+private:
+    std::vector<Slot> slots;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> head{0};  // 消费者下标
+    alignas(64) std::atomic<size_t> tail{0};  // 生产者下标
+};
+
+// 引擎模式：由一个专门的协议线程独占 TCPConnection 和 socket，不停地推进状态机 (收包、ACK、重传)
+// 应用线程只通过两个 SPSC 无锁环形缓冲区收发字节流，即使应用阻塞在磁盘 / 用户输入上，协议也不会停。
+//
+// split 模式 (set_split_io / TransportOptions::split_io) 再把收包拆到第二个线程：收包线程用 recvmmsg 批量读 socket、
+// 验证校验和，经 IngressRing 交给协议线程；协议线程只做状态机 (ACK / SACK 处理、重组)、分段、算校验和、发包和重传。
+// 状态机本身仍然只有一个线程读写，两个线程之间只有无锁环和唤醒。收包的系统调用和逐字节的校验和
+// 不再占用协议线程，单条连接的高速接收可以用上第二个核。
+//
+// 接口与 TCPConnection 保持一致 (send / receive / update / is_send_complete / get_state / close / reset)，
+// file_transfer 中的传输逻辑可以直接复用；另外提供阻塞版本的 send_all / receive_wait。
+class TCPEngine {
+public:
+    explicit TCPEngine(size_t ring_capacity = 4 * 1024 * 1024);
+    ~TCPEngine();
+
+    // 前向纠错配置，必须在 bind / connect 启动协议线程之前设置
+    void set_fec(const FecConfig& cfg) { conn.set_fec(cfg); }
+    // 包级事件追踪，同样必须在启动协议线程之前设置 (之后由协议线程记录)
+    void set_trace(PacketTrace* t) { conn.set_trace(t); }
+    // 发送限速 (见 TCPConnection::set_rate_limit)，同样必须在启动协议线程之前设置
+    void set_rate_limit(uint64_t bytes_per_sec, size_t burst = 0) { conn.set_rate_limit(bytes_per_sec, burst); }
+    void set_shared_rate_limit(RateLimiter* limiter, unsigned weight = 1) {
+        conn.set_shared_rate_limit(limiter, weight);
+    }
+    // 收包放到单独的线程 (见上)，必须在 bind / connect 之前设置；默认取 TransportOptions::defaults().split_io
+    void set_split_io(bool on) { split_io = on; }
+    bool split_io_enabled() const { return split_io; }
+
+    // 作为 Server 启动监听 (启动协议线程)
+    bool bind(int port);
+
+    // 作为 Client 连接 Server (启动协议线程，立即返回，用 get_state() 观察握手进度)
+    bool connect(const std::string& ip, int port);
+
+    // 非阻塞发送：整段放入发送环返回 true，空间不足返回 false (不会只写一部分)
+    bool send(const void* data, size_t len);
+
+    // 阻塞发送：直到全部放入发送环；连接已关闭时返回 false
+    bool send_all(const void* data, size_t len);
+
+    // 非阻塞接收：返回读取的字节数，没有数据返回 0，对端已关闭且数据读完返回 -1 (与 TCPConnection 一致)
+    size_t receive(void* buffer, size_t maxLen);
+
+    // 阻塞接收：最多等待 timeout_ms 毫秒 (< 0 表示一直等)，返回值含义同 receive()
+    size_t receive_wait(void* buffer, size_t maxLen, int timeout_ms = -1);
+
+    // 协议由后台线程推进，这里只是等待一次唤醒 (最多 1ms；接收环非空时立即返回)，
+    // 方便沿用 "while (...) conn.update();" 的写法
+    void update();
+
+    // 发送环已清空且所有数据都已收到 ACK
+    bool is_send_complete() const;
+
+    TCPState get_state() const { return state.load(std::memory_order_acquire); }
+
+    // 传输统计快照 (协议线程每 100ms 刷新一次，见 TCPConnection::info)
+    TCPInfo info() const;
+
+    // 请求断开：协议线程会先把发送环中剩余的数据发完并确认，再发送 FIN
+    void close();
+
+    // 重置连接并重新进入 LISTEN (Server 用)，阻塞直到协议线程完成重置
+    void reset();
+
+    // 停止协议线程 (析构时自动调用)
+    void stop();
+
+private:
+    void start();
+    void run();
+    void run_ingress();
+    void pump_tx();
+    void pump_rx();
+    void wait_for_io(std::chrono::microseconds timeout, size_t tx_seen);
+    void publish_info();
+
+    TCPConnection conn;
+    std::thread worker;
+
+    bool split_io = TransportOptions::defaults().split_io;
+    std::thread ingress_worker;
+    IngressRing ingress;      // 收包线程 -> 协议线程
+    WakeupFd ingress_wakeup;  // 唤醒收包线程 (收包环腾出了槽位 / 停止)
+
+    SpscRing tx_ring;  // 应用 -> 协议线程
+    SpscRing rx_ring;  // 协议线程 -> 应用
+
+    WakeupFd engine_wakeup;  // 唤醒协议线程 (有新数据要发 / 有控制请求)
+    WakeupFd app_wakeup;     // 唤醒应用线程 (有新数据可读 / 发送环腾出了空间 / 状态变化)
+
+    std::atomic<TCPState> state{CLOSED};
+    std::atomic<bool> running{false};
+    std::atomic<bool> eof{false};            // 对端已关闭，rx_ring 中是最后的数据
+    std::atomic<bool> send_complete{true};   // 协议线程侧的 conn.is_send_complete()
+    std::atomic<bool> close_requested{false};
+    // reset 握手：0 空闲 -> 1 应用请求 -> 2 协议线程已重置 (应用清空接收环后回到 0)
+    // 非 0 期间协议线程不读写两个环，避免新连接的数据被应用侧的清空操作误删
+    std::atomic<int> reset_phase{0};
+
+    // 对方是否正睡在 poll() 上：只在需要时才写 eventfd，省掉绝大多数唤醒系统调用
+    std::atomic<bool> engine_idle{false};
+    std::atomic<bool> app_waiting{false};
+    std::atomic<bool> ingress_waiting{false};  // 收包线程因收包环满而睡着
+
+    mutable std::mutex info_mutex;
+    TCPInfo info_snapshot;
+    std::chrono::steady_clock::time_point info_published{};
+};
+
+#endif  // TCP_ENGINE_H
@@ -7,6 +7,9 @@
 #define FLAG_FIN 0x04
 #define FLAG_RST 0x08
 #define FLAG_PSH 0x10
+#define FLAG_TFO 0x20  // Fast Open：SYN 带 cookie + 首个请求；SYN-ACK 的 payload 以新的 cookie 开头
+#define FLAG_FEC 0x40  // SYN / SYN-ACK 上表示本端能解 FEC 校验段；连接建立后表示这是一个校验段 (见 fec.h)
+#define FLAG_SACK 0x80  // SYN / SYN-ACK 上表示本端能解 SACK；连接建立后表示纯 ACK 带一个 SACK 块 (left, right)
 #include <cstdint>
 
 // 任务 1: 定义你的协议头
@@ -27,11 +30,45 @@ struct TCPHeader {
     uint32_t window_size;  // 窗口大小
 };
 
-// 应用层协议头
+// 应用层协议头 (紧凑布局 5 字节，length 固定为网络字节序，编解码见 app_framing.h)
+#pragma pack(push, 1)
 struct AppHeader {
     uint8_t opCode;   // 操作码
     uint32_t length;  // 数据长度 (仅 Payload, 不含 AppHeader)
 };
+#pragma pack(pop)
+
+// 多路复用流的帧头 (StreamMux，见 stream_mux.h)：每个帧完整地落在一个数据段内，
+// 所以任何一个段到达时都能独立解析，不依赖前面的段。多字节字段为网络字节序。
+#pragma pack(push, 1)
+struct StreamFrameHeader {
+    uint8_t type;        // STREAM_FRAME_*
+    uint8_t flags;       // STREAM_FLAG_FIN
+    uint32_t stream_id;  // 客户端发起的流为奇数，服务端发起的为偶数
+    uint64_t offset;     // DATA: 负载在流中的字节偏移；MAX_DATA: 对端允许发送到的偏移上限
+    uint16_t length;     // DATA: 负载长度；MAX_DATA: 0
+};
+#pragma pack(pop)
+
+#define STREAM_FRAME_DATA 0      // 流数据
+#define STREAM_FRAME_MAX_DATA 1  // 流级流量控制：放开对端的发送上限
+#define STREAM_FLAG_FIN 0x01     // 该流的最后一个数据帧
+
+// 多路径连接的帧头 (MultipathConnection，见 multipath.h)：每个帧完整地落在某条子流的一个数据段内，
+// 段从哪条子流、以什么顺序到达都能独立解析。多字节字段为网络字节序。
+#pragma pack(push, 1)
+struct MultipathFrameHeader {
+    uint8_t type;     // MP_FRAME_*
+    uint8_t flags;    // MP_FLAG_FIN
+    uint64_t dsn;     // DATA: 负载在连接级字节流中的偏移；MAX_DATA: 对端允许发送到的偏移上限；JOIN: 连接的 token
+    uint16_t length;  // DATA: 负载长度；其他: 0
+};
+#pragma pack(pop)
+
+#define MP_FRAME_DATA 0      // 连接级数据
+#define MP_FRAME_MAX_DATA 1  // 连接级流量控制：放开对端的发送上限
+#define MP_FRAME_JOIN 2      // 子流加入连接 (子流上的第一个帧)，服务端按 token 确认它属于同一个连接
+#define MP_FLAG_FIN 0x01     // 连接的最后一个数据帧
 
 // Operation Codes
 #define OP_MSG 0         // 普通文本消息
@@ -43,7 +80,27 @@ struct AppHeader {
 #define OP_ERROR 6
 #define OP_FILE_INFO 7  // 文件信息 (Payload = 文件大小字符串)
 
+// 批量 (目录) 传输：一条连接上连续发送多个文件，没有逐文件的往返
+#define OP_BATCH_BEGIN 8         // 批量开始 (Payload = 目录名)
+#define OP_BATCH_FILE 9          // 文件头 (Payload = "相对路径|文件大小")，随后紧跟恰好这么多字节的 OP_DATA
+#define OP_BATCH_ACK 10          // 接收端的批量确认，异步发送 (Payload = "已落盘文件数|字节数")
+#define OP_BATCH_END 11          // 批量结束 (Payload = "文件数|字节数")，接收端用同样的格式回复最终结果
+#define OP_BATCH_DOWNLOAD_REQ 12 // 请求下载整个目录 (Payload = 目录名)
+
+// 稀疏文件：空洞 / 全零块不发数据，只发长度 (见 sparse_file.h)
+#define OP_HOLE 13  // 文件中的一段空洞 (Payload = 字节数)，接收端跳过这么多字节不写
+
+// 去重上传：先交换块清单，只传服务器没有的块 (见 dedup_transfer.h)
+#define OP_DEDUP_BEGIN 14  // 开始去重上传 (Payload = "文件名|文件大小")
+#define OP_CHUNK_LIST 15   // 块清单 (Payload = 若干个 32 字节 SHA-256 + 4 字节长度)
+#define OP_CHUNK_NEED 16   // 服务器对一个清单的回复 (Payload = 位图，1 = 需要发送该块)
+
 // 最大的数据包大小 (MTU 限制通常是 1500，减去 IP/UDP 头，安全值设为 1400 左右)
 const int MAX_PACKET_SIZE = 1400;
+// 接收缓冲区的大小：FEC 校验段比数据段多出 FecHeader 和各段长度，允许用到以太网 MTU 下 UDP 的上限
+const int MAX_DATAGRAM_SIZE = 1472;
+
+// Fast Open cookie 长度 (字节)
+const int TFO_COOKIE_LEN = 8;
 
 #endif  // TCP_PROTOCOL_H
@@ -23,6 +23,26 @@ typedef int socket_t;
 #define SOCKET_ERROR -1
 #endif
 
+// 二进制形式的网络端点 (IP + 端口)
+// 收发包时直接使用 sockaddr_storage，避免每个包都做 inet_ntop / inet_addr 字符串转换
+struct Endpoint {
+    sockaddr_storage addr{};
+    socklen_t len = 0;
+
+    // 解析 "1.2.3.4" / "::1" 形式的地址，只在建立连接时调用一次
+    static bool resolve(const std::string& ip, int port, Endpoint& out);
+
+    bool empty() const { return len == 0; }
+    int family() const { return addr.ss_family; }
+
+    // 以下仅用于日志输出 (会分配字符串，不要在每包路径上调用)
+    std::string ip() const;
+    int port() const;
+
+    bool operator==(const Endpoint& other) const;
+    bool operator!=(const Endpoint& other) const { return !(*this == other); }
+};
+
 // Socket 封装框架
 class TCPSocket {
 public:
@@ -34,17 +54,29 @@ public:
 
     // 绑定端口 (用于接收方/服务器)
     bool bind(int port);
+    // 绑定到本机的某个 IPv4 地址 (多网卡 / 多地址时选择收发用的地址)，port 为 0 时由系统分配端口
+    bool bind(const std::string& ip, int port);
 
     // 发送数据到指定地址
     // 返回发送的字节数，失败返回 -1
-    int send_to(const void* data, int len, const std::string& target_ip, int target_port);
+    int send_to(const void* data, int len, const Endpoint& target);
 
     // 接收数据
     // buffer: 接收缓冲区
     // max_len: 缓冲区大小
-    // src_ip/src_port: 输出参数，记录发送者的信息
+    // src: 输出参数，记录发送者的地址 (二进制形式，不做字符串转换)
     // 返回接收的字节数，超时或无数据可能返回 0 或 -1 (取决于是否阻塞)
-    int recv_from(void* buffer, int max_len, std::string& src_ip, int& src_port);
+    int recv_from(void* buffer, int max_len, Endpoint& src);
+
+    // 将 UDP socket "连接" 到固定对端：之后可以用 send() 走内核的 connected 快速路径
+    // (省去每包的路由查找/地址校验)，内核也会丢弃其他来源的包
+    bool connect(const Endpoint& target);
+
+    // 解除 connect() 的绑定，恢复成可以与任意对端通信
+    void disconnect();
+
+    // 发送到 connect() 指定的对端
+    int send(const void* data, int len);
 
     // 关闭 Socket
     void close();
@@ -52,6 +84,16 @@ public:
     // 设置非阻塞模式 (可选，建议实现)
     void set_non_blocking(bool nonBlocking);
 
+    // 内核收 / 发缓冲 (SO_RCVBUF / SO_SNDBUF，<= 0 的保持不变)：超过 net.core.rmem_max / wmem_max 的部分被内核截断，
+    // 突发到达时接收缓冲满了的包会被内核直接丢掉
+    void set_buffer_sizes(int rcvbuf, int sndbuf);
+    // 实际生效的大小 (Linux 上是设置值的两倍，含内核的簿记开销)；失败返回 0
+    int receive_buffer_size() const;
+    int send_buffer_size() const;
+
+    // 底层句柄 (用于 poll / select 等待可读)
+    socket_t native_handle() const { return sock_fd; }
+
 private:
     socket_t sock_fd;
 };
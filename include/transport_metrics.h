@@ -0,0 +1,62 @@
+#ifndef TRANSPORT_METRICS_H
+#define TRANSPORT_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "tcp_connection.h"
+
+// 状态名 (与枚举名相同)
+const char* tcp_state_name(TCPState s);
+
+// 把一份 TCPInfo 格式化成 Prometheus 文本格式 (text/plain; version=0.0.4)
+// 指标名统一加 mytcp_ 前缀，计数器以 _total 结尾；labels 形如 port="8080"，会加到每个样本上
+std::string format_prometheus(const TCPInfo& info, const std::string& labels = "");
+
+// 服务端定期把传输统计导出给 Prometheus (或 node_exporter 的 textfile collector)
+// target 的格式：
+//   <path> 或 file:<path>  每次 publish 原子地重写这个文件 (先写临时文件再 rename)
+//   unix:<path>            在 unix socket 上应答 HTTP 请求 (curl --unix-socket <path> http://x/metrics)
+//   tcp:<port>             在 127.0.0.1:<port> 上应答 HTTP 请求 (只监听本机)
+// socket 方式由一个后台线程应答，每个请求都返回最近一次 publish 的内容，不会碰连接本身
+class MetricsExporter {
+public:
+    MetricsExporter() = default;
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    // 打开导出目标，失败返回 false (会打印原因)；interval_ms 为 publish 的最小间隔
+    bool open(const std::string& target, int interval_ms = 1000);
+    void close();
+
+    bool active() const { return kind != NONE; }
+    // 距上次 publish 已经超过间隔，调用方可以取一份新的快照了
+    bool due() const {
+        return active() && std::chrono::steady_clock::now() - last_publish >= std::chrono::milliseconds(interval);
+    }
+
+    void publish(const TCPInfo& info, const std::string& labels = "");
+
+private:
+    enum Kind { NONE, TO_FILE, TO_SOCKET };
+
+    void serve_loop();
+
+    Kind kind = NONE;
+    std::string path;  // 文件路径 / unix socket 路径 (关闭时删除)
+    int listen_fd = -1;
+    int interval = 1000;
+    std::chrono::steady_clock::time_point last_publish{};
+
+    std::thread server;
+    std::atomic<bool> running{false};
+    std::mutex body_mutex;
+    std::string body;  // 最近一次 publish 的内容
+};
+
+#endif  // TRANSPORT_METRICS_H
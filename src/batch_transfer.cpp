@@ -0,0 +1,127 @@
+#include "batch_transfer.h"
+
+#include <iostream>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+std::string format_batch_counts(long long files, long long bytes) {
+    return std::to_string(files) + "|" + std::to_string(bytes);
+}
+
+bool parse_batch_counts(std::string_view payload, long long& files, long long& bytes) {
+    size_t sep = payload.find('|');
+    if (sep == std::string_view::npos) return false;
+    try {
+        files = std::stoll(std::string(payload.substr(0, sep)));
+        bytes = std::stoll(std::string(payload.substr(sep + 1)));
+    } catch (...) {
+        return false;
+    }
+    return true;
+}
+
+bool sanitize_relative_path(std::string_view raw, fs::path& out) {
+    if (raw.empty()) return false;
+    fs::path p = fs::path(std::string(raw)).lexically_normal();
+    if (p.empty() || p.is_absolute() || p.has_root_name()) return false;
+    for (const fs::path& part : p) {
+        if (part == "..") return false;
+    }
+    if (p == ".") return false;
+    out = p;
+    return true;
+}
+
+bool BatchReceiver::begin(std::string_view root, const std::string& prefix) {
+    finish();
+    fs::path name;
+    // 目录名只取最后一段，和单文件上传只保留文件名的做法一致
+    if (!sanitize_relative_path(root, name)) return false;
+    name = name.filename();
+    if (name.empty()) return false;
+
+    base = prefix + name.string();
+    std::error_code ec;
+    fs::create_directories(base, ec);
+    if (ec) {
+        std::cerr << "[Batch] Cannot create " << base << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    lastDir = base;
+    inBatch = true;
+    skipping = false;
+    remaining = 0;
+    nFiles = nBytes = ackedFiles = 0;
+    return true;
+}
+
+void BatchReceiver::on_file(std::string_view header) {
+    if (!inBatch) return;
+    if (remaining > 0) complete_file();  // 上一个文件数据不完整，直接收尾
+
+    size_t sep = header.rfind('|');
+    long long size = 0;
+    if (sep != std::string_view::npos) {
+        try {
+            size = std::stoll(std::string(header.substr(sep + 1)));
+        } catch (...) {
+            size = 0;
+        }
+    }
+
+    fs::path rel;
+    skipping = sep == std::string_view::npos || size < 0 || !sanitize_relative_path(header.substr(0, sep), rel);
+    if (skipping) {
+        std::cerr << "[Batch] Rejected file header: " << header << std::endl;
+    } else {
+        open_file(rel);
+    }
+
+    remaining = std::max(size, 0LL);
+    if (remaining == 0) complete_file();
+}
+
+void BatchReceiver::on_data(std::string_view data) {
+    if (!in_file()) return;
+    size_t n = std::min<long long>(remaining, data.size());
+    if (!skipping) out.write(data.data(), n);
+    remaining -= n;
+    nBytes += n;
+    if (remaining == 0) complete_file();
+}
+
+void BatchReceiver::finish() {
+    if (out.is_open()) out.close();
+    inBatch = false;
+    remaining = 0;
+}
+
+bool BatchReceiver::take_ack_due() {
+    if (nFiles - ackedFiles < BATCH_ACK_EVERY) return false;
+    ackedFiles = nFiles;
+    return true;
+}
+
+void BatchReceiver::open_file(const fs::path& rel) {
+    fs::path target = base / rel;
+    fs::path dir = target.parent_path();
+    if (dir != lastDir) {
+        std::error_code ec;
+        fs::create_directories(dir, ec);
+        lastDir = dir;
+    }
+    out.open(target, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "[Batch] Cannot open " << target << std::endl;
+        skipping = true;
+    }
+}
+
+void BatchReceiver::complete_file() {
+    if (out.is_open()) out.close();
+    remaining = 0;
+    skipping = false;
+    ++nFiles;
+}
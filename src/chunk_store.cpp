@@ -0,0 +1,315 @@
+#include "chunk_store.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+// ---------------- FastCDC ----------------
+
+namespace {
+
+// Gear 表：固定种子生成，所有客户端切出的块边界一致 (否则跨客户端无法去重)
+struct GearTable {
+    uint64_t v[256];
+    GearTable() {
+        uint64_t x = 0x6a09e667f3bcc908ULL;
+        for (auto& g : v) {
+            // splitmix64
+            x += 0x9e3779b97f4a7c15ULL;
+            uint64_t z = x;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            g = z ^ (z >> 31);
+        }
+    }
+};
+const GearTable GEAR;
+
+// 归一化分块 (normalized chunking)：期望长度之前用更难命中的掩码 (15 个 1)，之后用更容易命中的 (11 个 1)，
+// 块长度集中在 CDC_AVG_SIZE 附近。掩码取自 FastCDC 论文
+const uint64_t MASK_S = 0x0003590703530000ULL;
+const uint64_t MASK_L = 0x0000d90003530000ULL;
+
+}  // namespace
+
+size_t fastcdc_cut(const uint8_t* p, size_t n) {
+    if (n <= CDC_MIN_SIZE) return n;
+    if (n > CDC_MAX_SIZE) n = CDC_MAX_SIZE;
+    size_t normal = std::min(n, CDC_AVG_SIZE);
+
+    uint64_t fp = 0;
+    size_t i = CDC_MIN_SIZE;
+    for (; i < normal; ++i) {
+        fp = (fp << 1) + GEAR.v[p[i]];
+        if (!(fp & MASK_S)) return i;
+    }
+    for (; i < n; ++i) {
+        fp = (fp << 1) + GEAR.v[p[i]];
+        if (!(fp & MASK_L)) return i;
+    }
+    return n;
+}
+
+// ---------------- SHA-256 ----------------
+
+namespace {
+
+const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+inline uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+void sha256_block(uint32_t st[8], const uint8_t* blk) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = uint32_t(blk[4 * i]) << 24 | uint32_t(blk[4 * i + 1]) << 16 | uint32_t(blk[4 * i + 2]) << 8 |
+               uint32_t(blk[4 * i + 3]);
+    }
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = st[0], b = st[1], c = st[2], d = st[3], e = st[4], f = st[5], g = st[6], h = st[7];
+    for (int i = 0; i < 64; ++i) {
+        uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+        uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    st[0] += a;
+    st[1] += b;
+    st[2] += c;
+    st[3] += d;
+    st[4] += e;
+    st[5] += f;
+    st[6] += g;
+    st[7] += h;
+}
+
+}  // namespace
+
+ChunkHash sha256(const void* data, size_t len) {
+    uint32_t st[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    size_t left = len;
+    for (; left >= 64; left -= 64, p += 64) sha256_block(st, p);
+
+    // 补位：0x80 + 0... + 64 位的比特长度 (大端)
+    uint8_t tail[128] = {};
+    memcpy(tail, p, left);
+    tail[left] = 0x80;
+    size_t tailLen = left + 1 + 8 <= 64 ? 64 : 128;
+    uint64_t bits = uint64_t(len) * 8;
+    for (int i = 0; i < 8; ++i) tail[tailLen - 1 - i] = uint8_t(bits >> (8 * i));
+    for (size_t off = 0; off < tailLen; off += 64) sha256_block(st, tail + off);
+
+    ChunkHash out;
+    for (int i = 0; i < 8; ++i) {
+        out[4 * i] = uint8_t(st[i] >> 24);
+        out[4 * i + 1] = uint8_t(st[i] >> 16);
+        out[4 * i + 2] = uint8_t(st[i] >> 8);
+        out[4 * i + 3] = uint8_t(st[i]);
+    }
+    return out;
+}
+
+// ---------------- ChunkStore ----------------
+
+// 索引文件 = Header + capacity 个 Slot，开放寻址 (线性探测)，槽位由哈希的前 8 字节决定
+struct ChunkStore::Header {
+    char magic[8];
+    uint64_t capacity;  // 槽数，2 的幂
+    uint64_t count;     // 已用槽数
+    uint64_t reserved;
+};
+
+struct ChunkStore::Slot {
+    ChunkHash hash;
+    uint64_t offset;  // 在 chunks.dat 中的偏移
+    uint32_t length;
+    uint32_t used;
+};
+
+namespace {
+
+const char INDEX_MAGIC[8] = {'C', 'H', 'U', 'N', 'K', 'I', 'X', '1'};
+const uint64_t INDEX_INIT_CAPACITY = 1 << 16;
+// 装载因子超过 0.7 时扩容
+const uint64_t INDEX_LOAD_NUM = 7;
+const uint64_t INDEX_LOAD_DEN = 10;
+
+uint64_t slot_of(const ChunkHash& h, uint64_t capacity) {
+    uint64_t v;
+    memcpy(&v, h.data(), sizeof(v));
+    return v & (capacity - 1);
+}
+
+}  // namespace
+
+ChunkStore::~ChunkStore() {
+    unmap_index();
+    if (packFd >= 0) ::close(packFd);
+}
+
+bool ChunkStore::open(const std::string& dir) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec) {
+        std::cerr << "[ChunkStore] Cannot create " << dir << ": " << ec.message() << std::endl;
+        return false;
+    }
+    dirPath = dir;
+
+    packFd = ::open((dir + "/chunks.dat").c_str(), O_RDWR | O_CREAT, 0644);
+    if (packFd < 0) return false;
+    struct stat st;
+    if (fstat(packFd, &st) != 0) return false;
+    packSize = st.st_size;
+
+    // 已有索引：按文件大小推出容量直接映射，不扫描、不重建
+    uint64_t capacity = INDEX_INIT_CAPACITY;
+    std::string indexPath = dir + "/index.bin";
+    if (stat(indexPath.c_str(), &st) == 0 && st.st_size > (off_t)sizeof(Header)) {
+        capacity = (st.st_size - sizeof(Header)) / sizeof(Slot);
+    }
+    return map_index(indexPath, capacity);
+}
+
+bool ChunkStore::map_index(const std::string& path, uint64_t capacity) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return false;
+    size_t bytes = sizeof(Header) + capacity * sizeof(Slot);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || ((size_t)st.st_size < bytes && ftruncate(fd, bytes) != 0)) {
+        ::close(fd);
+        return false;
+    }
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+
+    Header* h = static_cast<Header*>(p);
+    if (memcmp(h->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+        // 新文件 (ftruncate 出来的全 0)
+        memcpy(h->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        h->capacity = capacity;
+        h->count = 0;
+    } else if (h->capacity != capacity) {
+        std::cerr << "[ChunkStore] Corrupted index " << path << std::endl;
+        munmap(p, bytes);
+        ::close(fd);
+        return false;
+    }
+
+    unmap_index();
+    index = h;
+    indexFd = fd;
+    mappedBytes = bytes;
+    return true;
+}
+
+void ChunkStore::unmap_index() {
+    if (index) munmap(index, mappedBytes);
+    if (indexFd >= 0) ::close(indexFd);
+    index = nullptr;
+    indexFd = -1;
+    mappedBytes = 0;
+}
+
+ChunkStore::Slot* ChunkStore::find_slot(const ChunkHash& h) const {
+    Slot* slots = reinterpret_cast<Slot*>(index + 1);
+    uint64_t mask = index->capacity - 1;
+    for (uint64_t i = slot_of(h, index->capacity);; i = (i + 1) & mask) {
+        Slot& s = slots[i];
+        if (!s.used || s.hash == h) return &s;
+    }
+}
+
+bool ChunkStore::contains(const ChunkHash& h) const { return index && find_slot(h)->used; }
+
+bool ChunkStore::put(const ChunkHash& h, const char* data, size_t len) {
+    if (!index) return false;
+    if (find_slot(h)->used) return true;
+    if ((index->count + 1) * INDEX_LOAD_DEN > index->capacity * INDEX_LOAD_NUM && !grow()) return false;
+
+    // 先写数据再登记索引：中途崩溃最多在 chunks.dat 末尾留下一段没人引用的字节
+    size_t written = 0;
+    while (written < len) {
+        ssize_t n = pwrite(packFd, data + written, len - written, packSize + written);
+        if (n <= 0) return false;
+        written += n;
+    }
+    Slot* s = find_slot(h);
+    s->hash = h;
+    s->offset = packSize;
+    s->length = uint32_t(len);
+    s->used = 1;
+    ++index->count;
+    packSize += len;
+    return true;
+}
+
+bool ChunkStore::read(const ChunkHash& h, std::vector<char>& out) const {
+    if (!index) return false;
+    const Slot* s = find_slot(h);
+    if (!s->used || s->offset + s->length > packSize) return false;
+    out.resize(s->length);
+    return pread(packFd, out.data(), s->length, s->offset) == (ssize_t)s->length;
+}
+
+uint64_t ChunkStore::chunk_count() const { return index ? index->count : 0; }
+
+bool ChunkStore::grow() {
+    std::string path = dirPath + "/index.bin";
+    std::string tmpPath = path + ".tmp";
+    ::unlink(tmpPath.c_str());
+
+    Header* old = index;
+    int oldFd = indexFd;
+    size_t oldBytes = mappedBytes;
+    index = nullptr;
+    indexFd = -1;
+    if (!map_index(tmpPath, old->capacity * 2)) {
+        index = old;
+        indexFd = oldFd;
+        mappedBytes = oldBytes;
+        return false;
+    }
+
+    const Slot* oldSlots = reinterpret_cast<const Slot*>(old + 1);
+    for (uint64_t i = 0; i < old->capacity; ++i) {
+        if (!oldSlots[i].used) continue;
+        *find_slot(oldSlots[i].hash) = oldSlots[i];
+        ++index->count;
+    }
+    munmap(old, oldBytes);
+    ::close(oldFd);
+
+    // 新索引写完整之后再替换，任何时刻磁盘上的 index.bin 都是完整的
+    msync(index, mappedBytes, MS_SYNC);
+    return rename(tmpPath.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,136 @@
+#include "dedup_transfer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "batch_transfer.h"  // sanitize_relative_path
+#include "tcp_socket.h"      // htonl / ntohl
+
+// 切块时每次从文件读入的字节数 (至少要能放下一个最大块)
+const size_t CHUNK_READ_SIZE = 4 * 1024 * 1024;
+
+bool chunk_file(const std::string& path, std::vector<FileChunk>& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    out.clear();
+
+    std::vector<uint8_t> buf(CHUNK_READ_SIZE);
+    size_t start = 0, end = 0;
+    uint64_t offset = 0;
+    bool eof = false;
+    while (true) {
+        // 剩余不足一个最大块时补数据，否则切点可能落在缓冲区边界上
+        if (!eof && end - start < CDC_MAX_SIZE) {
+            memmove(buf.data(), buf.data() + start, end - start);
+            end -= start;
+            start = 0;
+            in.read(reinterpret_cast<char*>(buf.data()) + end, buf.size() - end);
+            end += in.gcount();
+            eof = in.gcount() == 0 || in.eof();
+        }
+        if (start == end) break;
+        size_t len = fastcdc_cut(buf.data() + start, end - start);
+        out.push_back(FileChunk{offset, uint32_t(len), sha256(buf.data() + start, len)});
+        start += len;
+        offset += len;
+    }
+    return true;
+}
+
+std::string encode_chunk_list(const FileChunk* chunks, size_t n) {
+    std::string payload(n * DEDUP_ENTRY_SIZE, '\0');
+    for (size_t i = 0; i < n; ++i) {
+        char* p = payload.data() + i * DEDUP_ENTRY_SIZE;
+        memcpy(p, chunks[i].hash.data(), chunks[i].hash.size());
+        uint32_t len = htonl(chunks[i].length);
+        memcpy(p + chunks[i].hash.size(), &len, sizeof(len));
+    }
+    return payload;
+}
+
+bool DedupReceiver::begin(std::string_view header, const std::string& prefix) {
+    inUpload = false;
+    if (!chunkStore.is_open() && !chunkStore.open(storePath)) return false;
+
+    size_t sep = header.rfind('|');
+    std::filesystem::path name;
+    if (sep == std::string_view::npos || !sanitize_relative_path(header.substr(0, sep), name)) return false;
+    try {
+        declaredSize = std::stoll(std::string(header.substr(sep + 1)));
+    } catch (...) {
+        return false;
+    }
+
+    outPath = prefix + name.filename().string();
+    manifest.clear();
+    requested.clear();
+    needed.clear();
+    nextNeeded = 0;
+    cur.clear();
+    failed = false;
+    newChunks = newBytes = 0;
+    inUpload = true;
+    return true;
+}
+
+std::string DedupReceiver::on_list(std::string_view payload) {
+    size_t n = payload.size() / DEDUP_ENTRY_SIZE;
+    std::string bitmap((n + 7) / 8, '\0');
+    if (!inUpload) return bitmap;
+    for (size_t i = 0; i < n; ++i) {
+        Entry e;
+        const char* p = payload.data() + i * DEDUP_ENTRY_SIZE;
+        memcpy(e.hash.data(), p, e.hash.size());
+        uint32_t len;
+        memcpy(&len, p + e.hash.size(), sizeof(len));
+        e.length = ntohl(len);
+        if (e.length == 0 || e.length > CDC_MAX_SIZE) {
+            failed = true;  // 不可能由 FastCDC 切出来的长度，不要它的数据
+        } else if (!chunkStore.contains(e.hash) && requested.insert(e.hash).second) {
+            bitmap[i / 8] |= char(1 << (i % 8));
+            needed.push_back(manifest.size());
+        }
+        manifest.push_back(e);
+    }
+    return bitmap;
+}
+
+void DedupReceiver::on_data(std::string_view data) {
+    while (!data.empty() && receiving()) {
+        const Entry& e = manifest[needed[nextNeeded]];
+        size_t n = std::min(data.size(), e.length - cur.size());
+        cur.insert(cur.end(), data.data(), data.data() + n);
+        data.remove_prefix(n);
+        if (cur.size() < e.length) break;
+
+        // 块收齐：哈希对得上才入库，否则这次上传作废 (不能让错误的数据占住这个地址)
+        if (sha256(cur.data(), cur.size()) == e.hash && chunkStore.put(e.hash, cur.data(), cur.size())) {
+            ++newChunks;
+            newBytes += cur.size();
+        } else {
+            failed = true;
+        }
+        cur.clear();
+        ++nextNeeded;
+    }
+}
+
+long long DedupReceiver::finish() {
+    inUpload = false;
+    if (failed || nextNeeded < needed.size()) return -1;
+
+    std::ofstream out(outPath, std::ios::binary | std::ios::trunc);
+    if (!out) return -1;
+    long long total = 0;
+    std::vector<char> chunk;
+    for (const Entry& e : manifest) {
+        if (!chunkStore.read(e.hash, chunk) || chunk.size() != e.length) {
+            std::cerr << "[Dedup] Chunk missing from store" << std::endl;
+            return -1;
+        }
+        out.write(chunk.data(), chunk.size());
+        total += chunk.size();
+    }
+    return total == declaredSize ? total : -1;
+}
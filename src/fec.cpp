@@ -0,0 +1,327 @@
+#include "fec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "tcp_socket.h"  // htonl / ntohl
+
+namespace {
+
+// ---------------- GF(256) ----------------
+// 本原多项式 x^8 + x^4 + x^3 + x^2 + 1 (0x11d)
+struct GfTables {
+    uint8_t exp[512];
+    uint8_t log[256];
+
+    GfTables() {
+        int x = 1;
+        for (int i = 0; i < 255; ++i) {
+            exp[i] = uint8_t(x);
+            log[x] = uint8_t(i);
+            x <<= 1;
+            if (x & 0x100) x ^= 0x11d;
+        }
+        for (int i = 255; i < 512; ++i) exp[i] = exp[i - 255];
+        log[0] = 0;
+    }
+};
+
+const GfTables& gf() {
+    static const GfTables tables;
+    return tables;
+}
+
+uint8_t gf_mul(uint8_t a, uint8_t b) {
+    if (a == 0 || b == 0) return 0;
+    return gf().exp[gf().log[a] + gf().log[b]];
+}
+
+uint8_t gf_inv(uint8_t a) { return gf().exp[255 - gf().log[a]]; }
+
+// dst[i] ^= c * src[i]
+void gf_mul_add(uint8_t c, const uint8_t* src, uint8_t* dst, size_t n) {
+    if (c == 0) return;
+    if (c == 1) {
+        for (size_t i = 0; i < n; ++i) dst[i] ^= src[i];
+        return;
+    }
+    uint8_t row[256];
+    for (int x = 0; x < 256; ++x) row[x] = gf_mul(c, uint8_t(x));
+    for (size_t i = 0; i < n; ++i) dst[i] ^= row[src[i]];
+}
+
+// 第 j 个校验段里第 i 个数据段的系数
+// RS 用 Cauchy 矩阵 1 / (x_j + y_i)，x_j = FEC_MAX_K + j 与 y_i = i 互不相同，任意方阵子矩阵都可逆
+uint8_t coef(FecScheme scheme, int j, int i) {
+    if (scheme == FecScheme::XOR) return 1;
+    return gf_inv(uint8_t((FEC_MAX_K + j) ^ i));
+}
+
+// 组内 n 个段里丢失超过 tolerate 个的概率 (二项分布尾部)
+double residual_loss(int n, int tolerate, double p) {
+    double pmf = std::pow(1 - p, n);  // P(X = 0)
+    double cdf = 0;
+    for (int x = 0; x <= tolerate && x <= n; ++x) {
+        cdf += pmf;
+        pmf = pmf * (n - x) / (x + 1) * (p / (1 - p));
+    }
+    return 1 - cdf;
+}
+
+}  // namespace
+
+bool parse_fec_config(const char* text, FecConfig& out) {
+    FecConfig cfg;
+    cfg.enabled = true;
+    int k = 0, m = 0;
+    if (strncmp(text, "xor", 3) == 0) {
+        cfg.scheme = FecScheme::XOR;
+        cfg.k = 8;
+        cfg.m = 1;
+        if (text[3] == ':' && sscanf(text + 4, "%d", &k) == 1) cfg.k = k;
+    } else if (strncmp(text, "rs", 2) == 0) {
+        cfg.scheme = FecScheme::RS;
+        cfg.k = 10;
+        cfg.m = 4;
+        if (text[2] == ':') {
+            int got = sscanf(text + 3, "%d,%d", &k, &m);
+            if (got >= 1) cfg.k = k;
+            if (got >= 2) cfg.m = m;
+        }
+    } else {
+        return false;
+    }
+    if (cfg.k < 1 || cfg.k > FEC_MAX_K || cfg.m < 1 || cfg.m > FEC_MAX_M) return false;
+    out = cfg;
+    return true;
+}
+
+// ---------------- FecEncoder ----------------
+
+void FecEncoder::configure(const FecConfig& cfg) {
+    config = cfg;
+    if (config.scheme == FecScheme::XOR) config.m = 1;
+    count = 0;
+    next_group();
+}
+
+void FecEncoder::add(uint32_t seq, const char* data, size_t len, std::chrono::steady_clock::time_point now) {
+    if (count == 0) {
+        first_seq = seq;
+        symbol_len = 0;
+        for (auto& p : parity) std::fill(p.begin(), p.end(), 0);
+    }
+    lens[count] = uint16_t(len);
+    symbol_len = std::max(symbol_len, len);
+    for (int j = 0; j < m_cur; ++j) {
+        if (parity[j].size() < len) parity[j].resize(len, 0);
+        gf_mul_add(coef(config.scheme, j, count), reinterpret_cast<const uint8_t*>(data), parity[j].data(), len);
+    }
+    ++count;
+    last_add = now;
+}
+
+size_t FecEncoder::build_parity(int j, char* out) const {
+    FecHeader hdr;
+    hdr.first_seq = htonl(first_seq);
+    hdr.scheme = uint8_t(config.scheme);
+    hdr.n = uint8_t(count);
+    hdr.m = uint8_t(m_cur);
+    hdr.index = uint8_t(j);
+    hdr.symbol_len = htons(uint16_t(symbol_len));
+    memcpy(out, &hdr, sizeof(hdr));
+    size_t off = sizeof(hdr);
+    for (int i = 0; i < count; ++i) {
+        uint16_t l = htons(lens[i]);
+        memcpy(out + off, &l, 2);
+        off += 2;
+    }
+    memcpy(out + off, parity[j].data(), symbol_len);
+    return off + symbol_len;
+}
+
+void FecEncoder::next_group() {
+    count = 0;
+    k_cur = config.k;
+    m_cur = config.m;
+    if (config.adaptive) {
+        double p = std::min(0.5, peer_loss / 255.0);
+        if (config.scheme == FecScheme::RS) {
+            // 满足目标的最小 m
+            m_cur = config.m;
+            for (int m = 1; m <= config.m; ++m) {
+                if (residual_loss(k_cur + m, m, p) <= FEC_TARGET_RESIDUAL) {
+                    m_cur = m;
+                    break;
+                }
+            }
+        } else {
+            // 满足目标的最大 k (丢包越多组越小)
+            k_cur = 2;
+            for (int k = config.k; k >= 2; --k) {
+                if (residual_loss(k + 1, 1, p) <= FEC_TARGET_RESIDUAL) {
+                    k_cur = k;
+                    break;
+                }
+            }
+        }
+    }
+    if (int(parity.size()) < m_cur) parity.resize(m_cur);
+}
+
+// ---------------- FecDecoder ----------------
+
+void FecDecoder::on_data(uint32_t seq, const char* data, size_t len) {
+    if (!activated || len == 0) return;
+    auto it = cache.find(seq);
+    if (it == cache.end()) cache.emplace(seq, std::vector<char>(data, data + len));
+}
+
+void FecDecoder::on_parity(const char* payload, size_t len, uint32_t rcv_nxt, std::vector<Recovered>& out) {
+    activated = true;
+    FecHeader hdr;
+    if (len < sizeof(hdr)) return;
+    memcpy(&hdr, payload, sizeof(hdr));
+    int n = hdr.n, m = hdr.m, index = hdr.index;
+    size_t symbolLen = ntohs(hdr.symbol_len);
+    if (n < 1 || n > FEC_MAX_K || m < 1 || m > FEC_MAX_M || index >= m) return;
+    if (len != sizeof(hdr) + 2 * size_t(n) + symbolLen) return;
+
+    uint32_t firstSeq = ntohl(hdr.first_seq);
+    auto [it, created] = groups.try_emplace(firstSeq);
+    Group& g = it->second;
+    if (created) {
+        g.scheme = FecScheme(hdr.scheme);
+        g.n = n;
+        g.m = m;
+        g.symbol_len = symbolLen;
+        g.lens.resize(n);
+        for (int i = 0; i < n; ++i) {
+            uint16_t l;
+            memcpy(&l, payload + sizeof(hdr) + 2 * i, 2);
+            g.lens[i] = ntohs(l);
+        }
+        g.parity.resize(m);
+    } else if (g.n != n || g.m != m || g.symbol_len != symbolLen) {
+        return;  // 和已有的组对不上，忽略
+    }
+    if (g.parity[index].empty()) {
+        const char* p = payload + sizeof(hdr) + 2 * n;
+        g.parity[index].assign(p, p + symbolLen);
+        ++g.parity_seen;
+    }
+
+    try_decode(firstSeq, g, rcv_nxt, out);
+
+    // 校验段按组的顺序发出：更早的组不会再有校验段到达了，结算它们的丢包
+    for (auto old = groups.begin(); old != groups.end() && old->first != firstSeq;) {
+        try_decode(old->first, old->second, rcv_nxt, out);
+        finalize(old->second);
+        old = groups.erase(old);
+    }
+    if (g.decided && g.parity_seen == g.m) {
+        finalize(g);
+        groups.erase(firstSeq);
+    }
+    std::sort(out.begin(), out.end(), [](const Recovered& a, const Recovered& b) { return a.seq < b.seq; });
+}
+
+bool FecDecoder::try_decode(uint32_t first_seq, Group& g, uint32_t rcv_nxt, std::vector<Recovered>& out) {
+    if (g.decided) return true;
+
+    std::vector<uint32_t> seqs(g.n);
+    std::vector<int> missing;
+    bool unavailable = false;  // 已经按序收到、但缓存里没有 (不能参与恢复)
+    uint32_t seq = first_seq;
+    for (int i = 0; i < g.n; ++i) {
+        seqs[i] = seq;
+        if (cache.find(seq) == cache.end()) {
+            if (int32_t(seq - rcv_nxt) >= 0) {
+                missing.push_back(i);
+            } else {
+                unavailable = true;
+            }
+        }
+        seq += g.lens[i];
+    }
+    g.lost_data = int(missing.size());
+    if (missing.empty()) {
+        g.decided = true;
+        return true;
+    }
+    if (unavailable || int(missing.size()) > g.parity_seen) return false;
+
+    // 选出 e 个收到的校验段，算出只含丢失段的 "综合值"：s_j = parity_j - sum(已收到的 coef * data)
+    size_t e = missing.size();
+    std::vector<int> rows;
+    for (int j = 0; j < g.m && rows.size() < e; ++j) {
+        if (!g.parity[j].empty()) rows.push_back(j);
+    }
+    std::vector<std::vector<uint8_t>> syn(e);
+    for (size_t r = 0; r < e; ++r) {
+        syn[r].assign(g.parity[rows[r]].begin(), g.parity[rows[r]].end());
+        for (int i = 0; i < g.n; ++i) {
+            if (std::find(missing.begin(), missing.end(), i) != missing.end()) continue;
+            const std::vector<char>& d = cache[seqs[i]];
+            gf_mul_add(coef(g.scheme, rows[r], i), reinterpret_cast<const uint8_t*>(d.data()), syn[r].data(),
+                       std::min(d.size(), g.symbol_len));
+        }
+    }
+
+    // 解 e x e 线性方程组 A x = s，A[r][c] = coef(rows[r], missing[c]) (高斯消元，行变换同时作用在综合值上)
+    std::vector<std::vector<uint8_t>> a(e, std::vector<uint8_t>(e));
+    for (size_t r = 0; r < e; ++r)
+        for (size_t c = 0; c < e; ++c) a[r][c] = coef(g.scheme, rows[r], missing[c]);
+    for (size_t c = 0; c < e; ++c) {
+        size_t pivot = c;
+        while (pivot < e && a[pivot][c] == 0) ++pivot;
+        if (pivot == e) return false;  // 不可逆 (XOR 同时丢了多个段)
+        std::swap(a[pivot], a[c]);
+        std::swap(syn[pivot], syn[c]);
+        uint8_t inv = gf_inv(a[c][c]);
+        for (size_t k = 0; k < e; ++k) a[c][k] = gf_mul(a[c][k], inv);
+        std::vector<uint8_t> scaled(g.symbol_len, 0);
+        gf_mul_add(inv, syn[c].data(), scaled.data(), g.symbol_len);
+        syn[c].swap(scaled);
+        for (size_t r = 0; r < e; ++r) {
+            if (r == c || a[r][c] == 0) continue;
+            uint8_t f = a[r][c];
+            for (size_t k = 0; k < e; ++k) a[r][k] ^= gf_mul(f, a[c][k]);
+            gf_mul_add(f, syn[c].data(), syn[r].data(), g.symbol_len);
+        }
+    }
+
+    for (size_t c = 0; c < e; ++c) {
+        int i = missing[c];
+        Recovered rec;
+        rec.seq = seqs[i];
+        rec.data.assign(syn[c].begin(), syn[c].begin() + g.lens[i]);
+        cache.emplace(rec.seq, rec.data);
+        out.push_back(std::move(rec));
+    }
+    recovered += e;
+    g.decided = true;
+    return true;
+}
+
+void FecDecoder::finalize(const Group& g) {
+    double sample = double(g.lost_data + (g.m - g.parity_seen)) / (g.n + g.m);
+    loss += (sample - loss) / 8;
+}
+
+void FecDecoder::prune(uint32_t rcv_nxt) {
+    // 丢失段所在的组最多向前跨 FEC_MAX_K 个满长度的段
+    const uint32_t span = FEC_MAX_K * 1500;
+    while (!cache.empty() && int32_t(rcv_nxt - cache.begin()->first) > int32_t(span)) cache.erase(cache.begin());
+}
+
+void FecDecoder::reset() {
+    activated = false;
+    cache.clear();
+    groups.clear();
+    loss = 0;
+}
+
+uint8_t FecDecoder::loss_feedback() const { return uint8_t(std::min(255.0, std::round(loss * 255))); }
@@ -0,0 +1,115 @@
+#include "file_cache.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+
+FileCache& FileCache::global() {
+    static FileCache cache;
+    return cache;
+}
+
+void FileCache::set_capacity(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    capacityBytes = bytes;
+    evict_to(capacityBytes);
+}
+
+size_t FileCache::capacity() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return capacityBytes;
+}
+
+FileCache::Stats FileCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+bool FileCache::stat_version(const std::string& path, Version& v, long long& allocated) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    v.dev = st.st_dev;
+    v.ino = st.st_ino;
+    v.size = st.st_size;
+    v.mtimeNs = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    // 稀疏文件只有分配了的块才会进缓存 (全零块还会再省掉一些，这里按上限估计)
+    allocated = std::min<long long>(st.st_size, (long long)st.st_blocks * 512);
+    return true;
+}
+
+std::shared_ptr<CachedFile> FileCache::load(const std::string& path) {
+    SparseFileReader reader;
+    if (!reader.open(path)) return nullptr;
+
+    auto file = std::make_shared<CachedFile>();
+    file->fileSize = reader.size();
+    // 先记每段在 data 里的偏移，读完再换成指针 (data 增长时会搬家)
+    std::vector<size_t> offsets;
+    SparseFileReader::Extent ext;
+    while (reader.next(ext)) {
+        offsets.push_back(file->data.size());
+        if (!ext.hole) file->data.insert(file->data.end(), ext.data, ext.data + ext.length);
+        file->extents.push_back(SparseFileReader::Extent{ext.hole, ext.length, nullptr});
+    }
+    file->data.shrink_to_fit();
+    for (size_t i = 0; i < file->extents.size(); ++i) {
+        if (!file->extents[i].hole) file->extents[i].data = file->data.data() + offsets[i];
+    }
+    return file;
+}
+
+std::shared_ptr<const CachedFile> FileCache::get(const std::string& path) {
+    Version version;
+    long long allocated = 0;
+    bool exists = stat_version(path, version, allocated);
+
+    size_t limit;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (capacityBytes == 0) return nullptr;
+        auto it = slots.find(path);
+        if (it != slots.end()) {
+            if (exists && it->second.version == version) {
+                ++counters.hits;
+                lruOrder.splice(lruOrder.begin(), lruOrder, it->second.lru);
+                return it->second.file;
+            }
+            ++counters.invalidations;
+            erase(it);
+        }
+        ++counters.misses;
+        limit = capacityBytes / 4;
+        if (!exists || (size_t)allocated > limit) return nullptr;
+    }
+
+    std::shared_ptr<CachedFile> file = load(path);
+    // 加载期间文件被修改过就不缓存 (内容可能是新旧混合的)，这次请求也回退到直接读磁盘
+    Version after;
+    if (!file || !stat_version(path, after, allocated) || !(after == version) || file->data_bytes() > limit) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = slots.find(path);
+    if (it != slots.end()) erase(it);  // 另一个线程同时加载了同一个文件
+    evict_to(capacityBytes - std::min(capacityBytes, file->data_bytes()));
+    lruOrder.push_front(path);
+    slots[path] = Slot{version, file, lruOrder.begin()};
+    counters.bytes += file->data_bytes();
+    ++counters.files;
+    return file;
+}
+
+void FileCache::erase(std::unordered_map<std::string, Slot>::iterator it) {
+    counters.bytes -= it->second.file->data_bytes();
+    --counters.files;
+    lruOrder.erase(it->second.lru);
+    slots.erase(it);
+}
+
+void FileCache::evict_to(size_t limit) {
+    while (counters.bytes > limit && !lruOrder.empty()) {
+        erase(slots.find(lruOrder.back()));
+        ++counters.evictions;
+    }
+}
@@ -1,74 +1,83 @@
 #include "file_transfer.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdio>
 #include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <string_view>
 #include <thread>
 #include <vector>
 
+#include "app_framing.h"
+#include "batch_transfer.h"
+#include "dedup_transfer.h"
+#include "file_cache.h"
+#include "latency_profile.h"
+#include "sparse_file.h"
+#include "tcp_engine.h"
 #include "tcp_protocol.h"
+#include "transport_metrics.h"
 
 // Helper functions (internal to this compilation unit mostly, but good to keep together)
 
-// 辅助函数：发送应用层消息 (阻塞直到从 buffer 发出)
-void send_app_msg(TCPConnection& conn, uint8_t op, const std::string& data) {
-    std::vector<char> packet;
-    packet.resize(sizeof(AppHeader) + data.size());
+// 以下传输逻辑对 TCPConnection (当前线程驱动协议) 和 TCPEngine (后台协议线程) 通用，
+// 两者提供相同的 send / receive / update / is_send_complete / get_state 接口
 
-    AppHeader* hdr = (AppHeader*)packet.data();
-    hdr->opCode = op;
-    hdr->length = data.size();
+// 辅助函数：发送应用层消息 (阻塞直到从 buffer 发出)
+template <typename Conn>
+void send_app_msg(Conn& conn, uint8_t op, std::string_view data) {
+    // 常见的帧 (<= 1 个 MSS) 直接在栈上拼装，避免每条消息一次堆分配
+    char stackBuf[MAX_PACKET_SIZE];
+    std::vector<char> heapBuf;
+    size_t totalLen = sizeof(AppHeader) + data.size();
+    char* packet = stackBuf;
+    if (totalLen > sizeof(stackBuf)) {
+        heapBuf.resize(totalLen);
+        packet = heapBuf.data();
+    }
 
-    memcpy(packet.data() + sizeof(AppHeader), data.data(), data.size());
+    encode_app_header(packet, op, data.size());
+    memcpy(packet + sizeof(AppHeader), data.data(), data.size());
 
-    while (!conn.send(packet.data(), packet.size())) {
+    MYTCP_PROFILE_SCOPE(PROF_SEND_WAIT);
+    while (!conn.send(packet, totalLen)) {
         conn.update();
         std::this_thread::yield();
     }
 }
 
-// 辅助函数：处理接收到的应用层数据 (处理粘包/半包)
-bool process_app_messages(TCPConnection& conn, std::vector<char>& appBuffer,
-                          std::function<void(uint8_t, const std::string&)> handler) {
-    conn.update();
-    char tempBuf[MAX_PACKET_SIZE * 2];
-    size_t n = conn.receive(tempBuf, sizeof(tempBuf));
-
-    if (n == -1) {
-        // 收到 EOF，且处理完了残余数据
-        return false;  // 告诉上层循环，该断开了
-    }
-
-    if (n > 0) {
-        appBuffer.insert(appBuffer.end(), tempBuf, tempBuf + n);
-
-        char* ptr = appBuffer.data();
-        size_t remaining = appBuffer.size();
-        size_t consumed = 0;
-
-        while (remaining >= sizeof(AppHeader)) {
-            AppHeader* appHdr = (AppHeader*)ptr;
-            size_t totalLen = sizeof(AppHeader) + appHdr->length;
-
-            if (remaining < totalLen) break;  // 半包
-
-            // 完整包，回调处理
-            std::string payload(ptr + sizeof(AppHeader), appHdr->length);
-            handler(appHdr->opCode, payload);
+// 单文件传输时每个 OP_DATA 帧携带的文件字节数
+const size_t FILE_CHUNK_SIZE = 1024;
 
-            ptr += totalLen;
-            remaining -= totalLen;
-            consumed += totalLen;
+// 辅助函数：按 SparseFileReader (或 CachedFileReader) 的分段发送整个文件
+// 数据区拆成 OP_DATA，空洞和全零块只发一条 OP_HOLE；totalBytes 计入空洞 (与文件大小对应)，holeBytes 为省略的字节
+// on_chunk() 在每帧之后调用，返回 false 时中止发送
+template <typename Conn, typename Reader, typename OnChunk>
+void send_file_extents(Conn& conn, Reader& reader, long long& totalBytes, long long& holeBytes, OnChunk&& on_chunk) {
+    SparseFileReader::Extent ext;
+    while (true) {
+        {
+            MYTCP_PROFILE_SCOPE(PROF_DISK_READ);
+            if (!reader.next(ext)) break;
         }
-
-        if (consumed > 0) {
-            appBuffer.erase(appBuffer.begin(), appBuffer.begin() + consumed);
+        if (ext.hole) {
+            send_app_msg(conn, OP_HOLE, std::to_string(ext.length));
+            totalBytes += ext.length;
+            holeBytes += ext.length;
+            if (!on_chunk()) return;
+            continue;
+        }
+        for (long long off = 0; off < ext.length; off += FILE_CHUNK_SIZE) {
+            std::string_view chunk(ext.data + off, std::min<long long>(FILE_CHUNK_SIZE, ext.length - off));
+            send_app_msg(conn, OP_DATA, chunk);
+            conn.update();
+            totalBytes += chunk.size();
+            if (!on_chunk()) return;
         }
-        return true;
     }
-    return true;
 }
 
 // Helper: 打印简单进度条
@@ -91,6 +100,17 @@ void print_progress(long long current, long long total) {
               << std::flush;
 }
 
+// 辅助函数：向 benchmark.log 追加一行 CSV 记录
+void append_benchmark_log(const std::string& filename, long long totalBytes, double duration, double speed,
+                          const std::string& verifyResult) {
+    std::ofstream log("benchmark.log", std::ios::app);
+    std::time_t t = std::time(nullptr);
+    char timeStr[100];
+    std::strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", std::localtime(&t));
+    log << timeStr << "," << filename << "," << totalBytes << "," << duration << "," << speed << "," << verifyResult
+        << "\n";
+}
+
 // 辅助函数：比较两个文件内容 (Deprecated for remote, kept for logical completeness if needed locally)
 bool check_files_equal(const std::string& f1, const std::string& f2) {
     std::ifstream s1(f1, std::ios::binary);
@@ -105,12 +125,99 @@ bool check_files_equal(const std::string& f1, const std::string& f2) {
     return std::equal(begin1, end, begin2);
 }
 
-void run_server(int port) {
-    TCPConnection conn;
+// ---------------- 批量 (目录) 传输 ----------------
+
+namespace fs = std::filesystem;
+
+// 发送端每发出多少个文件调用一次 poll (客户端借此取走服务器的 OP_BATCH_ACK)
+const long long BATCH_POLL_EVERY = 64;
+
+// 目录显示名：去掉末尾的 '/' 后取最后一段
+std::string batch_dir_name(const fs::path& dir) {
+    fs::path p = dir.lexically_normal();
+    if (p.filename().empty()) p = p.parent_path();
+    return p.filename().string();
+}
+
+// 把 dir 下所有普通文件按 OP_BATCH_FILE + OP_DATA 依次写进 out (不含 BEGIN / END)
+// 每个文件之间没有任何等待；每 BATCH_POLL_EVERY 个文件调用一次 poll()
+template <typename Conn, typename Poll>
+void send_dir_files(BatchSender<Conn>& out, const fs::path& dir, long long& files, long long& bytes, Poll&& poll) {
+    std::vector<char> buf(64 * 1024);
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        if (!it->is_regular_file(ec)) continue;
+        long long size = it->file_size(ec);
+        if (ec) continue;
+        std::ifstream file(it->path(), std::ios::binary);
+        if (!file) continue;
+
+        std::string rel = it->path().lexically_relative(dir).generic_string();
+        if (!out.frame(OP_BATCH_FILE, rel + "|" + std::to_string(size))) {
+            std::cerr << "[Batch] Path too long, skipped: " << rel << std::endl;
+            continue;
+        }
+
+        // 严格按文件头里的大小发送：文件在读取过程中被截短时补零，保证接收端的分帧不会错位
+        long long left = size;
+        while (left > 0) {
+            size_t want = std::min<long long>(left, buf.size());
+            file.read(buf.data(), want);
+            size_t got = file.gcount();
+            if (got == 0) {
+                memset(buf.data(), 0, want);
+                got = want;
+            }
+            out.data(std::string_view(buf.data(), got));
+            left -= got;
+        }
+
+        ++files;
+        bytes += size;
+        if (files % BATCH_POLL_EVERY == 0) poll();
+    }
+}
+
+// 服务端：把整个目录推给客户端
+template <typename Conn>
+void send_dir(Conn& conn, std::string_view request) {
+    fs::path dir;
+    if (!sanitize_relative_path(request, dir) || !fs::is_directory(dir)) {
+        send_app_msg(conn, OP_ERROR, "Directory not found");
+        return;
+    }
+    std::cout << "[Server] Start uploading directory " << dir.string() << std::endl;
+
+    auto startTime = std::chrono::steady_clock::now();
+    long long files = 0, bytes = 0;
+    {
+        BatchSender<Conn> out(conn);
+        out.frame(OP_BATCH_BEGIN, batch_dir_name(dir));
+        // 客户端的 OP_BATCH_ACK 留在接收缓冲里，等 serve() 的主循环再读出来丢掉：
+        // 这里另起一个 parser 读的话，可能把一个帧拆在两个 parser 之间
+        send_dir_files(out, dir, files, bytes, [] {});
+        out.frame(OP_BATCH_END, format_batch_counts(files, bytes));
+    }
+
+    double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "[Server] Directory sent: " << files << " files, " << bytes << " bytes, "
+              << (duration > 0 ? files / duration : 0) << " files/s" << std::endl;
+}
+
+// 连接上可以收发应用数据：握手中 (Fast Open 的请求已经到了)、已建立、对端已关闭但本端还没关
+bool connection_open(TCPState s) { return s == SYN_RCVD || s == ESTABLISHED || s == CLOSE_WAIT; }
+
+template <typename Conn>
+void serve(Conn& conn, int port, MetricsExporter& metrics) {
     if (!conn.bind(port)) {
         std::cerr << "[Server] Failed to bind to port " << port << std::endl;
         return;
     }
+    // 主循环和下载发送循环里都会调用，到了导出间隔才真的取快照
+    std::string metricLabels = "port=\"" + std::to_string(port) + "\"";
+    auto export_metrics = [&] {
+        if (metrics.due()) metrics.publish(conn.info(), metricLabels);
+    };
 
     std::cout << "[Server] Listening on port " << port << "..." << std::endl;
 
@@ -119,21 +226,70 @@ void run_server(int port) {
     long long receivedBytes = 0;
     std::string currentFileName;
     long long totalExpectedBytes = 0;
-    std::vector<char> appBuffer;
+    AppFrameParser appParser;
+    BatchReceiver batchRx;
+    DedupReceiver dedupRx;
+    auto startBatch = std::chrono::steady_clock::now();
+
+    // 把一个文件 (SparseFileReader 或 CachedFileReader) 作为下载响应发出去
+    auto send_download = [&](auto& file) {
+        long long fileSize = file.size();
+        send_app_msg(conn, OP_FILE_INFO, std::to_string(fileSize));
+
+        auto startTime = std::chrono::steady_clock::now();
+        long long totalBytes = 0;
+        long long holeBytes = 0;
+
+        send_file_extents(conn, file, totalBytes, holeBytes, [&] {
+            auto now = std::chrono::steady_clock::now();
+            if (std::chrono::duration_cast<std::chrono::seconds>(now - startTime).count() >= 180) {
+                std::cout << "\n[Server] Timeout!" << std::endl;
+                return false;
+            }
+            if (totalBytes % (1024 * 10) == 0) print_progress(totalBytes, fileSize);
+            export_metrics();
+            return true;
+        });
+        print_progress(totalBytes, fileSize);
+        std::cout << std::endl;
+        if (holeBytes > 0) {
+            std::cout << "[Server] Skipped " << (holeBytes / 1024) << " KB of holes / zero blocks" << std::endl;
+        }
 
+        auto endTime = std::chrono::steady_clock::now();
+        double duration = std::chrono::duration<double>(endTime - startTime).count();
+        if (duration > 0) {
+            double speed = (totalBytes / 1024.0) / duration;
+            std::cout << "[Server] Upload (Download for client) finished. Speed: " << speed << " KB/s" << std::endl;
+        }
+        send_app_msg(conn, OP_END, "");
+    };
+
+    // 批量接收时每攒够一批文件就异步回一个确认，客户端不会停下来等它
+    auto ack_batch_if_due = [&]() {
+        if (batchRx.take_ack_due()) {
+            send_app_msg(conn, OP_BATCH_ACK, format_batch_counts(batchRx.files(), batchRx.bytes()));
+        }
+    };
+
+    bool finSent = false;  // 已经对 EOF 调用了 close() (TCPEngine 的 close 是异步的，状态可能还停在 CLOSE_WAIT)
     while (true) {
-        // 1. 等待连接 (可选: 打印一下 waiting)
-        if (conn.get_state() == LISTEN) {
+        export_metrics();
+        // 1. 等待连接；上一个连接的挥手 (等最后的 ACK) 由协议的定时器在后台收尾，期间照样接受新的 SYN
+        TCPState state = conn.get_state();
+        if (finSent && state != CLOSE_WAIT) finSent = false;
+        if (finSent || !connection_open(state)) {
             conn.update();
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            // 收到 SYN 后立即往下走：Fast Open 的请求已经在接收缓冲里了，响应要赶在推迟的 SYN-ACK 之前发出
+            if (!connection_open(conn.get_state())) std::this_thread::sleep_for(std::chrono::milliseconds(1));
             continue;
         }
 
         // 2. 已连接，处理消息
-        bool ok = process_app_messages(conn, appBuffer, [&](uint8_t op, const std::string& data) {
+        bool ok = process_app_messages(conn, appParser, [&](uint8_t op, std::string_view data) {
             if (op == OP_UPLOAD_REQ) {
                 // Format: filename|filesize
-                std::string payload = data;
+                std::string payload(data);
                 std::string sizeStr = "0";
                 size_t sep = payload.find('|');
                 if (sep != std::string::npos) {
@@ -156,89 +312,122 @@ void run_server(int port) {
                 std::cout << "[Server] Start receiving file: " << currentFileName << " (Size: " << totalExpectedBytes
                           << " bytes)" << std::endl;
             } else if (op == OP_DOWNLOAD_REQ) {
-                std::string filePath = data.substr(data.find_last_of("/\\") + 1);
+                std::string filePath(data.substr(data.find_last_of("/\\") + 1));
                 std::cout << "[Server] Start uploading file " << filePath << std::endl;
-                std::ifstream file(filePath, std::ios::binary);
-                if (!file) {
-                    send_app_msg(conn, OP_ERROR, "File not found");
-                    return;
-                }
-
-                file.seekg(0, std::ios::end);
-                long long fileSize = file.tellg();
-                file.seekg(0, std::ios::beg);
-
-                send_app_msg(conn, OP_FILE_INFO, std::to_string(fileSize));
-
-                auto startTime = std::chrono::steady_clock::now();
-                char readBuf[1024];
-                long long totalBytes = 0;
-
-                while (file.read(readBuf, sizeof(readBuf)) || file.gcount() > 0) {
-                    auto now = std::chrono::steady_clock::now();
-                    if (std::chrono::duration_cast<std::chrono::seconds>(now - startTime).count() >= 180) {
-                        std::cout << "\n[Server] Timeout!" << std::endl;
-                        break;
+                // 热点文件直接从内存发送，缓存不了 (太大 / 正在被修改) 的才读磁盘
+                if (auto cached = FileCache::global().get(filePath)) {
+                    CachedFileReader file(std::move(cached));
+                    send_download(file);
+                } else {
+                    SparseFileReader file;
+                    if (!file.open(filePath)) {
+                        send_app_msg(conn, OP_ERROR, "File not found");
+                        return;
                     }
-
-                    std::string chunk(readBuf, file.gcount());
-                    send_app_msg(conn, OP_DATA, chunk);
-                    conn.update();
-                    totalBytes += chunk.size();
-
-                    if (totalBytes % (1024 * 10) == 0) print_progress(totalBytes, fileSize);
+                    send_download(file);
                 }
-                print_progress(totalBytes, fileSize);
-                std::cout << std::endl;
-
-                auto endTime = std::chrono::steady_clock::now();
-                double duration = std::chrono::duration<double>(endTime - startTime).count();
-                if (duration > 0) {
-                    double speed = (totalBytes / 1024.0) / duration;
-                    std::cout << "[Server] Upload (Download for client) finished. Speed: " << speed << " KB/s"
-                              << std::endl;
+                FileCache::Stats cache = FileCache::global().stats();
+                std::cout << "[Server] File cache: hit ratio " << int(cache.hit_ratio() * 100) << "% (" << cache.hits
+                          << " hits, " << cache.misses << " misses), " << (cache.bytes / 1024) << " KB in "
+                          << cache.files << " files" << std::endl;
+                profile_report("server send " + filePath);
+            } else if (op == OP_BATCH_DOWNLOAD_REQ) {
+                send_dir(conn, data);
+            } else if (op == OP_BATCH_BEGIN) {
+                if (batchRx.begin(data, "received_")) {
+                    startBatch = std::chrono::steady_clock::now();
+                    std::cout << "[Server] Start receiving directory: " << batchRx.base_dir().string() << std::endl;
+                } else {
+                    send_app_msg(conn, OP_ERROR, "Invalid directory name");
                 }
-                send_app_msg(conn, OP_END, "");
-
+            } else if (op == OP_BATCH_FILE) {
+                batchRx.on_file(data);
+                ack_batch_if_due();
+            } else if (op == OP_DATA && batchRx.in_file()) {
+                batchRx.on_data(data);
+                ack_batch_if_due();
+            } else if (op == OP_BATCH_END) {
+                batchRx.finish();
+                double duration =
+                    std::chrono::duration<double>(std::chrono::steady_clock::now() - startBatch).count();
+                std::cout << "[Server] Directory received: " << batchRx.files() << " files, " << batchRx.bytes()
+                          << " bytes, " << (duration > 0 ? batchRx.files() / duration : 0) << " files/s"
+                          << std::endl;
+                send_app_msg(conn, OP_BATCH_END, format_batch_counts(batchRx.files(), batchRx.bytes()));
+            } else if (op == OP_DEDUP_BEGIN) {
+                if (dedupRx.begin(data, "received_")) {
+                    std::cout << "[Server] Start receiving file (dedup): " << dedupRx.output_path() << std::endl;
+                } else {
+                    send_app_msg(conn, OP_ERROR, "Invalid dedup upload");
+                }
+            } else if (op == OP_CHUNK_LIST) {
+                send_app_msg(conn, OP_CHUNK_NEED, dedupRx.on_list(data));
+            } else if (op == OP_DATA && dedupRx.receiving()) {
+                dedupRx.on_data(data);
+            } else if (op == OP_END && dedupRx.active()) {
+                long long size = dedupRx.finish();
+                if (size < 0) {
+                    send_app_msg(conn, OP_ERROR, "Dedup upload incomplete or corrupted");
+                    return;
+                }
+                std::cout << "[Server] File received (dedup): " << dedupRx.output_path() << ", " << size << " bytes, "
+                          << dedupRx.chunks() << " chunks, " << dedupRx.new_chunks() << " new ("
+                          << (dedupRx.new_bytes() / 1024) << " KB); store: " << dedupRx.store().chunk_count()
+                          << " chunks, " << (dedupRx.store().stored_bytes() / 1024) << " KB" << std::endl;
+                send_app_msg(conn, OP_END, std::to_string(size));
             } else if (op == OP_DATA) {
                 if (receivingFile && outFile.is_open()) {
+                    MYTCP_PROFILE_SCOPE(PROF_DISK_WRITE);
                     outFile.write(data.data(), data.size());
                     receivedBytes += data.size();
                     if (totalExpectedBytes > 0 && receivedBytes % (1024 * 10) == 0) {
                         print_progress(receivedBytes, totalExpectedBytes);
                     }
                 }
+            } else if (op == OP_HOLE) {
+                long long holeLen = 0;
+                if (receivingFile && outFile.is_open() && parse_hole_length(data, holeLen)) {
+                    skip_hole(outFile, holeLen);
+                    receivedBytes += holeLen;
+                }
             } else if (op == OP_END) {
                 if (receivingFile) {
                     print_progress(receivedBytes, totalExpectedBytes > 0 ? totalExpectedBytes : receivedBytes);
                     std::cout << std::endl;
                     outFile.close();
+                    finish_sparse_file(currentFileName, receivedBytes);
                     receivingFile = false;
                     std::cout << "[Server] File received successfully! Size: " << receivedBytes << " bytes"
                               << std::endl;
                     send_app_msg(conn, OP_END, std::to_string(receivedBytes));
+                    profile_report("server receive " + currentFileName);
                 }
             }
         });
 
         // 3. 检查连接是否断开 (ok == false means EOF or Error)
         if (!ok) {
-            std::cout << "[Server] Connection closed. Resetting..." << std::endl;
-            conn.reset();
+            std::cout << "[Server] Connection closed by peer, waiting for the next client..." << std::endl;
+            // 回 FIN；剩下的挥手不阻塞主循环，新连接的 SYN 会直接取代它
+            conn.close();
+            finSent = true;
             // 重置应用层状态
             receivingFile = false;
             if (outFile.is_open()) outFile.close();
-            appBuffer.clear();
+            batchRx.finish();
+            dedupRx.cancel();
+            appParser.clear();
         }
 
         std::this_thread::yield();
     }
 }
 
-void upload_file(TCPConnection& conn, const std::string& filepath) {
+template <typename Conn>
+void upload_file_impl(Conn& conn, const std::string& filepath) {
     std::string filename = filepath.substr(filepath.find_last_of("/\\") + 1);
-    std::ifstream file(filepath, std::ios::binary);
-    if (!file) {
+    SparseFileReader file;
+    if (!file.open(filepath)) {
         std::cerr << "File not found: " << filepath << std::endl;
         return;
     }
@@ -246,9 +435,7 @@ void upload_file(TCPConnection& conn, const std::string& filepath) {
     std::string recvFilename = "received_" + filename;
 
     // 1. 发送 Upload Request
-    file.seekg(0, std::ios::end);
-    long long fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
+    long long fileSize = file.size();
 
     std::cout << "[Client] Uploading " << filepath << " (Size: " << fileSize << " bytes)..." << std::endl;
     // Send "filename|filesize"
@@ -257,17 +444,12 @@ void upload_file(TCPConnection& conn, const std::string& filepath) {
     // 2. 发送 Data (Benchmarking)
     auto startTime = std::chrono::steady_clock::now();
     long long totalBytes = 0;
-    char buffer[1024];
-
-    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
-        std::string chunk(buffer, file.gcount());
-        send_app_msg(conn, OP_DATA, chunk);
-
-        conn.update();
-        totalBytes += chunk.size();
+    long long holeBytes = 0;
 
+    send_file_extents(conn, file, totalBytes, holeBytes, [&] {
         if (totalBytes % (1024 * 10) == 0) print_progress(totalBytes, fileSize);
-    }
+        return true;
+    });
     print_progress(totalBytes, fileSize);
     std::cout << std::endl;
 
@@ -276,7 +458,7 @@ void upload_file(TCPConnection& conn, const std::string& filepath) {
 
     // 等待应用层确认 (Server 必须回复 OP_END 表示写盘完成)
     std::cout << "[Client] Waiting for Server Confirmation..." << std::endl;
-    std::vector<char> rxBuffer;
+    AppFrameParser rxParser;
     bool confirmed = false;
     long long serverReceivedBytes = -1;
     bool timeout = false;
@@ -295,12 +477,12 @@ void upload_file(TCPConnection& conn, const std::string& filepath) {
             std::this_thread::yield();
         }
 
-        bool ok = process_app_messages(conn, rxBuffer, [&](uint8_t op, const std::string& msg) {
+        bool ok = process_app_messages(conn, rxParser, [&](uint8_t op, std::string_view msg) {
             if (op == OP_END) {
                 confirmed = true;
                 // 解析服务器返回的字节数
                 try {
-                    serverReceivedBytes = std::stoll(msg);
+                    serverReceivedBytes = std::stoll(std::string(msg));
                     std::cout << "[Client] Server confirmed. Received size: " << serverReceivedBytes << " bytes."
                               << std::endl;
                 } catch (...) {
@@ -323,6 +505,7 @@ void upload_file(TCPConnection& conn, const std::string& filepath) {
     std::cout << "[Client] Upload finished." << std::endl;
     std::cout << "  - Duration: " << duration << " s" << std::endl;
     std::cout << "  - Sent: " << (totalBytes / 1024.0) << " KB" << std::endl;
+    if (holeBytes > 0) std::cout << "  - Holes / zero blocks (not sent): " << (holeBytes / 1024.0) << " KB" << std::endl;
     std::cout << "  - Speed: " << speed << " KB/s" << std::endl;
 
     // 4. 校验
@@ -342,32 +525,136 @@ void upload_file(TCPConnection& conn, const std::string& filepath) {
     }
 
     // 5. 记录日志 (benchmark.log)
-    std::ofstream log("benchmark.log", std::ios::app);
-    std::time_t t = std::time(nullptr);
-    char timeStr[100];
-    std::strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", std::localtime(&t));
-    log << timeStr << "," << filename << "," << totalBytes << "," << duration << "," << speed << "," << verifyResult
-        << "\n";
+    append_benchmark_log(filename, totalBytes, duration, speed, verifyResult);
+    profile_report("upload " + filename);
 }
 
-void download_file(TCPConnection& conn, const std::string& filename) {
+template <typename Conn>
+DedupStats upload_file_dedup_impl(Conn& conn, const std::string& filepath) {
+    DedupStats stats;
+    std::string filename = filepath.substr(filepath.find_last_of("/\\") + 1);
+    std::ifstream file(filepath, std::ios::binary);
+    std::vector<FileChunk> chunks;
+    auto startTime = std::chrono::steady_clock::now();
+    if (!file || !chunk_file(filepath, chunks)) {
+        std::cerr << "File not found: " << filepath << std::endl;
+        return stats;
+    }
+    long long fileSize = chunks.empty() ? 0 : chunks.back().offset + chunks.back().length;
+    stats.chunks = chunks.size();
+    std::cout << "[Client] Uploading " << filepath << " with dedup (Size: " << fileSize << " bytes, " << chunks.size()
+              << " chunks)..." << std::endl;
+
+    AppFrameParser rxParser;
+    std::string need;  // 所有 OP_CHUNK_NEED 位图拼在一起
+    size_t needFrames = 0;
+    long long serverBytes = -1;
+    bool failed = false, confirmed = false;
+    auto handle_reply = [&](uint8_t op, std::string_view msg) {
+        if (op == OP_CHUNK_NEED) {
+            need.append(msg);
+            ++needFrames;
+        } else if (op == OP_END) {
+            try {
+                serverBytes = std::stoll(std::string(msg));
+            } catch (...) {
+                serverBytes = -1;
+            }
+            confirmed = true;
+        } else if (op == OP_ERROR) {
+            std::cout << "[Client] Server Error: " << msg << std::endl;
+            failed = confirmed = true;
+        }
+    };
+    auto wait_until = [&](auto&& done) {
+        auto waitStart = std::chrono::steady_clock::now();
+        while (!done()) {
+            if (std::chrono::steady_clock::now() - waitStart > std::chrono::seconds(10)) {
+                std::cout << "[Client] Confirmation Timeout!" << std::endl;
+                return false;
+            }
+            if (!process_app_messages(conn, rxParser, handle_reply)) return false;
+            std::this_thread::yield();
+        }
+        return true;
+    };
+
+    // 1. 清单：每 DEDUP_ENTRIES_PER_FRAME 项一帧，服务器对每帧回一个位图
+    size_t listFrames = (chunks.size() + DEDUP_ENTRIES_PER_FRAME - 1) / DEDUP_ENTRIES_PER_FRAME;
+    {
+        BatchSender<Conn> out(conn);
+        out.frame(OP_DEDUP_BEGIN, filename + "|" + std::to_string(fileSize));
+        for (size_t i = 0; i < chunks.size(); i += DEDUP_ENTRIES_PER_FRAME) {
+            size_t n = std::min(DEDUP_ENTRIES_PER_FRAME, chunks.size() - i);
+            out.frame(OP_CHUNK_LIST, encode_chunk_list(chunks.data() + i, n));
+        }
+    }
+    if (!wait_until([&] { return needFrames >= listFrames || failed; }) || failed) return stats;
+
+    // 2. 按清单顺序发送服务器没有的块；位图按帧拼接，第 i 帧的第 j 项对应 chunks[i * 32 + j]
+    std::vector<char> buf;
+    {
+        BatchSender<Conn> out(conn);
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            size_t frame = i / DEDUP_ENTRIES_PER_FRAME, bit = i % DEDUP_ENTRIES_PER_FRAME;
+            size_t byte = frame * ((DEDUP_ENTRIES_PER_FRAME + 7) / 8) + bit / 8;
+            if (byte >= need.size() || !(need[byte] & (1 << (bit % 8)))) continue;
+            buf.resize(chunks[i].length);
+            file.seekg(chunks[i].offset);
+            if (!file.read(buf.data(), buf.size())) {
+                std::cerr << "[Client] File changed while uploading: " << filepath << std::endl;
+                return stats;
+            }
+            out.data(std::string_view(buf.data(), buf.size()));
+            ++stats.sent_chunks;
+            stats.sent_bytes += buf.size();
+        }
+        out.frame(OP_END, "");
+    }
+
+    // 3. 等服务器拼好文件后回复 OP_END
+    bool timeout = !wait_until([&] { return confirmed; });
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    stats.bytes = fileSize;
+    stats.ok = !timeout && !failed && serverBytes == fileSize;
+
+    std::cout << "[Client] Dedup upload finished." << std::endl;
+    std::cout << "  - Duration: " << stats.seconds << " s" << std::endl;
+    std::cout << "  - Chunks: " << stats.chunks << ", sent " << stats.sent_chunks << " ("
+              << (stats.sent_bytes / 1024.0) << " KB of " << (fileSize / 1024.0) << " KB)" << std::endl;
+    if (stats.sent_bytes > 0) {
+        std::cout << "  - Dedup ratio: " << (double)fileSize / stats.sent_bytes << "x" << std::endl;
+    }
+    std::cout << "  - Verification (Remote): " << (stats.ok ? "PASS" : "FAIL") << " (Server: " << serverBytes
+              << " bytes)" << std::endl;
+    double speed = stats.seconds > 0 ? (fileSize / 1024.0) / stats.seconds : 0;
+    append_benchmark_log(filename, fileSize, stats.seconds, speed,
+                         stats.ok ? "PASS_REMOTE" : (timeout ? "Timeout" : "FAIL_SIZE"));
+    return stats;
+}
+
+// request_sent: 请求已经随 SYN 发出 (Fast Open)，不用再发；返回是否收到了完整的文件
+template <typename Conn>
+bool download_file_impl(Conn& conn, const std::string& filename, bool request_sent = false,
+                        long long* bytes = nullptr) {
     std::cout << "[Client] Downloading " << filename << "..." << std::endl;
-    send_app_msg(conn, OP_DOWNLOAD_REQ, filename);
+    if (!request_sent) send_app_msg(conn, OP_DOWNLOAD_REQ, filename);
 
-    std::vector<char> appBuffer;
+    AppFrameParser appParser;
     std::ofstream outFile;
     bool receiving = false;
     long long totalBytesRecv = 0;
     long long totalExpectedSize = 0;
     bool done = false;
+    bool complete = false;
     auto startTime = std::chrono::steady_clock::now();
 
     // Wait for response
     while (!done) {
-        bool ok = process_app_messages(conn, appBuffer, [&](uint8_t op, const std::string& data) {
+        bool ok = process_app_messages(conn, appParser, [&](uint8_t op, std::string_view data) {
             if (op == OP_FILE_INFO) {
                 try {
-                    totalExpectedSize = std::stoll(data);
+                    totalExpectedSize = std::stoll(std::string(data));
                 } catch (...) {
                     totalExpectedSize = 0;
                 }
@@ -377,6 +664,7 @@ void download_file(TCPConnection& conn, const std::string& filename) {
                 startTime = std::chrono::steady_clock::now();  // Restart timer when data starts
             } else if (op == OP_DATA) {
                 if (receiving && outFile.is_open()) {
+                    MYTCP_PROFILE_SCOPE(PROF_DISK_WRITE);
                     outFile.write(data.data(), data.size());
                     totalBytesRecv += data.size();
                     if (totalExpectedSize > 0 && totalBytesRecv % (1024 * 10) == 0) {
@@ -390,9 +678,19 @@ void download_file(TCPConnection& conn, const std::string& filename) {
                     totalBytesRecv += data.size();
                     startTime = std::chrono::steady_clock::now();  // Restart timer
                 }
+            } else if (op == OP_HOLE) {
+                long long holeLen = 0;
+                if (receiving && outFile.is_open() && parse_hole_length(data, holeLen)) {
+                    skip_hole(outFile, holeLen);
+                    totalBytesRecv += holeLen;
+                }
             } else if (op == OP_END) {
                 print_progress(totalBytesRecv, totalExpectedSize > 0 ? totalExpectedSize : totalBytesRecv);
                 std::cout << std::endl;
+                if (outFile.is_open()) {
+                    outFile.close();
+                    finish_sparse_file("downloaded_" + filename, totalBytesRecv);
+                }
 
                 auto endTime = std::chrono::steady_clock::now();
                 double duration = std::chrono::duration<double>(endTime - startTime).count();
@@ -402,6 +700,7 @@ void download_file(TCPConnection& conn, const std::string& filename) {
                 std::cout << "  - Duration: " << duration << " s" << std::endl;
                 std::cout << "  - Speed: " << speed << " KB/s" << std::endl;
                 done = true;
+                complete = true;
             } else if (op == OP_ERROR) {
                 std::cerr << "[Client] Error: " << data << std::endl;
                 done = true;
@@ -410,10 +709,351 @@ void download_file(TCPConnection& conn, const std::string& filename) {
         if (!ok) break;
         std::this_thread::yield();
     }
+    if (bytes) *bytes = totalBytesRecv;
+    if (complete) profile_report("download " + filename);
+    return complete;
 }
 
-void run_client(const std::string& ip, int port) {
-    TCPConnection conn;
+template <typename Conn>
+void upload_dir_impl(Conn& conn, const std::string& dirpath) {
+    fs::path dir(dirpath);
+    if (!fs::is_directory(dir)) {
+        std::cerr << "Directory not found: " << dirpath << std::endl;
+        return;
+    }
+    std::string name = batch_dir_name(dir);
+    std::cout << "[Client] Uploading directory " << dirpath << "..." << std::endl;
+
+    AppFrameParser rxParser;
+    long long files = 0, bytes = 0;
+    long long ackedFiles = 0, ackedBytes = 0;
+    long long serverFiles = -1, serverBytes = -1;
+    bool confirmed = false;
+    auto handle_reply = [&](uint8_t op, std::string_view msg) {
+        if (op == OP_BATCH_ACK) {
+            parse_batch_counts(msg, ackedFiles, ackedBytes);
+        } else if (op == OP_BATCH_END) {
+            parse_batch_counts(msg, serverFiles, serverBytes);
+            confirmed = true;
+        } else if (op == OP_ERROR) {
+            std::cout << "[Client] Server Error: " << msg << std::endl;
+            confirmed = true;
+        }
+    };
+
+    // 1. 流式发送所有文件，期间只是顺手取走服务器的批量确认，从不停下来等
+    auto startTime = std::chrono::steady_clock::now();
+    {
+        BatchSender<Conn> out(conn);
+        out.frame(OP_BATCH_BEGIN, name);
+        send_dir_files(out, dir, files, bytes, [&] {
+            process_app_messages(conn, rxParser, handle_reply);
+            std::cout << "\r[Client] Sent " << files << " files, server acked " << ackedFiles << std::flush;
+        });
+        out.frame(OP_BATCH_END, format_batch_counts(files, bytes));
+    }
+    std::cout << "\r[Client] Sent " << files << " files, waiting for Server Confirmation..." << std::endl;
+
+    // 2. 等待最终确认
+    bool timeout = false;
+    auto waitStart = std::chrono::steady_clock::now();
+    while (!confirmed) {
+        if (std::chrono::steady_clock::now() - waitStart > std::chrono::seconds(10)) {
+            std::cout << "[Client] Confirmation Timeout!" << std::endl;
+            timeout = true;
+            break;
+        }
+        if (!process_app_messages(conn, rxParser, handle_reply)) break;
+        std::this_thread::yield();
+    }
+
+    double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    double speed = duration > 0 ? (bytes / 1024.0) / duration : 0;
+    std::cout << "[Client] Directory upload finished." << std::endl;
+    std::cout << "  - Duration: " << duration << " s" << std::endl;
+    std::cout << "  - Files: " << files << " (" << (duration > 0 ? files / duration : 0) << " files/s)" << std::endl;
+    std::cout << "  - Speed: " << speed << " KB/s" << std::endl;
+
+    std::string verifyResult = "Timeout";
+    if (!timeout) {
+        bool match = serverFiles == files && serverBytes == bytes;
+        std::cout << "  - Verification (Remote): " << (match ? "PASS" : "FAIL") << " (Server: " << serverFiles
+                  << " files, " << serverBytes << " bytes)" << std::endl;
+        verifyResult = match ? "PASS_REMOTE" : "FAIL_SIZE";
+    }
+    append_benchmark_log(name + "/", bytes, duration, speed, verifyResult);
+}
+
+template <typename Conn>
+void download_dir_impl(Conn& conn, const std::string& dirname) {
+    std::cout << "[Client] Downloading directory " << dirname << "..." << std::endl;
+    send_app_msg(conn, OP_BATCH_DOWNLOAD_REQ, dirname);
+
+    AppFrameParser appParser;
+    BatchReceiver batchRx;
+    long long serverFiles = -1, serverBytes = -1;
+    bool done = false;
+    auto startTime = std::chrono::steady_clock::now();
+
+    auto ack_if_due = [&]() {
+        if (batchRx.take_ack_due()) {
+            send_app_msg(conn, OP_BATCH_ACK, format_batch_counts(batchRx.files(), batchRx.bytes()));
+            std::cout << "\r[Client] Received " << batchRx.files() << " files" << std::flush;
+        }
+    };
+
+    while (!done) {
+        bool ok = process_app_messages(conn, appParser, [&](uint8_t op, std::string_view data) {
+            if (op == OP_BATCH_BEGIN) {
+                if (!batchRx.begin(data, "downloaded_")) {
+                    std::cerr << "[Client] Invalid directory name: " << data << std::endl;
+                }
+                startTime = std::chrono::steady_clock::now();
+            } else if (op == OP_BATCH_FILE) {
+                batchRx.on_file(data);
+                ack_if_due();
+            } else if (op == OP_DATA) {
+                batchRx.on_data(data);
+                ack_if_due();
+            } else if (op == OP_BATCH_END) {
+                parse_batch_counts(data, serverFiles, serverBytes);
+                batchRx.finish();
+                done = true;
+            } else if (op == OP_ERROR) {
+                std::cerr << "[Client] Error: " << data << std::endl;
+                done = true;
+            }
+        });
+        if (!ok) break;
+        std::this_thread::yield();
+    }
+    if (serverFiles < 0) return;
+
+    double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    bool match = serverFiles == batchRx.files() && serverBytes == batchRx.bytes();
+    std::cout << "\r[Client] Directory download complete! Saved to " << batchRx.base_dir().string() << std::endl;
+    std::cout << "  - Duration: " << duration << " s" << std::endl;
+    std::cout << "  - Files: " << batchRx.files() << " (" << (duration > 0 ? batchRx.files() / duration : 0)
+              << " files/s)" << std::endl;
+    std::cout << "  - Speed: " << (duration > 0 ? (batchRx.bytes() / 1024.0) / duration : 0) << " KB/s" << std::endl;
+    std::cout << "  - Verification: " << (match ? "PASS" : "FAIL") << std::endl;
+}
+
+void upload_file(TCPConnection& conn, const std::string& filepath) { upload_file_impl(conn, filepath); }
+void upload_file(TCPEngine& conn, const std::string& filepath) { upload_file_impl(conn, filepath); }
+void download_file(TCPConnection& conn, const std::string& filename) { download_file_impl(conn, filename); }
+void download_file(TCPEngine& conn, const std::string& filename) { download_file_impl(conn, filename); }
+DedupStats upload_file_dedup(TCPConnection& conn, const std::string& filepath) {
+    return upload_file_dedup_impl(conn, filepath);
+}
+DedupStats upload_file_dedup(TCPEngine& conn, const std::string& filepath) {
+    return upload_file_dedup_impl(conn, filepath);
+}
+void upload_dir(TCPConnection& conn, const std::string& dirpath) { upload_dir_impl(conn, dirpath); }
+void upload_dir(TCPEngine& conn, const std::string& dirpath) { upload_dir_impl(conn, dirpath); }
+void download_dir(TCPConnection& conn, const std::string& dirname) { download_dir_impl(conn, dirname); }
+void download_dir(TCPEngine& conn, const std::string& dirname) { download_dir_impl(conn, dirname); }
+
+// ---------------- 协程版本 ----------------
+// 与上面的轮询版本逻辑一致，但所有等待都是 co_await，由 Scheduler 统一驱动，
+// 一个线程上可以同时跑很多个传输
+
+// 把一条应用层消息编码进 frame (只增长不收缩，整个传输过程复用)，返回帧长度
+// 注意这里不是协程：协程帧是堆分配的，每条消息一个协程会带来每消息一次分配
+size_t encode_app_msg(std::vector<char>& frame, uint8_t op, std::string_view data) {
+    size_t totalLen = sizeof(AppHeader) + data.size();
+    if (frame.size() < totalLen) frame.resize(totalLen);
+    encode_app_header(frame.data(), op, data.size());
+    memcpy(frame.data() + sizeof(AppHeader), data.data(), data.size());
+    return totalLen;
+}
+
+Task<TransferStats> upload_file_async(AsyncTCPConnection& conn, const std::string& filepath) {
+    TransferStats stats;
+    std::string filename = filepath.substr(filepath.find_last_of("/\\") + 1);
+    SparseFileReader file;
+    if (!file.open(filepath)) {
+        std::cerr << "File not found: " << filepath << std::endl;
+        co_return stats;
+    }
+
+    long long fileSize = file.size();
+
+    std::vector<char> frame(MAX_PACKET_SIZE);
+    size_t n = encode_app_msg(frame, OP_UPLOAD_REQ, filename + "|" + std::to_string(fileSize));
+    if (!co_await conn.async_send(frame.data(), n)) co_return stats;
+
+    auto startTime = std::chrono::steady_clock::now();
+    SparseFileReader::Extent ext;
+    while (file.next(ext)) {
+        if (ext.hole) {
+            n = encode_app_msg(frame, OP_HOLE, std::to_string(ext.length));
+            if (!co_await conn.async_send(frame.data(), n)) co_return stats;
+            stats.bytes += ext.length;
+            continue;
+        }
+        for (long long off = 0; off < ext.length; off += FILE_CHUNK_SIZE) {
+            size_t len = std::min<long long>(FILE_CHUNK_SIZE, ext.length - off);
+            n = encode_app_msg(frame, OP_DATA, std::string_view(ext.data + off, len));
+            if (!co_await conn.async_send(frame.data(), n)) co_return stats;
+            stats.bytes += len;
+        }
+    }
+
+    n = encode_app_msg(frame, OP_END, "");
+    if (!co_await conn.async_send(frame.data(), n)) co_return stats;
+
+    // 等待应用层确认 (Server 回复 OP_END + 收到的字节数)
+    co_await conn.async_flush();
+    AppFrameParser parser;
+    bool confirmed = false;
+    long long serverReceivedBytes = -1;
+    auto waitDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!confirmed) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(waitDeadline -
+                                                                          std::chrono::steady_clock::now());
+        if (left.count() <= 0) {
+            std::cout << "[Client] Confirmation Timeout!" << std::endl;
+            break;
+        }
+        size_t r = co_await conn.async_receive(
+            parser.write_ptr(), std::min<size_t>(MAX_PACKET_SIZE * 2, parser.writable()), left.count());
+        if (r == (size_t)-1) break;
+        if (r == 0) continue;
+        parser.commit(r);
+        parser.dispatch([&](uint8_t op, std::string_view msg) {
+            if (op == OP_END) {
+                confirmed = true;
+                try {
+                    serverReceivedBytes = std::stoll(std::string(msg));
+                } catch (...) {
+                    serverReceivedBytes = -1;
+                }
+            } else if (op == OP_ERROR) {
+                std::cout << "[Client] Server Error: " << msg << std::endl;
+                confirmed = true;
+            }
+        });
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    stats.ok = confirmed && serverReceivedBytes == stats.bytes;
+    double speed = stats.seconds > 0 ? (stats.bytes / 1024.0) / stats.seconds : 0;
+    std::cout << "[Client] Upload " << filename << " finished: " << stats.bytes << " bytes, " << stats.seconds
+              << " s, " << speed << " KB/s, " << (stats.ok ? "PASS" : "FAIL") << std::endl;
+    append_benchmark_log(filename, stats.bytes, stats.seconds, speed, stats.ok ? "PASS_REMOTE" : "FAIL_SIZE");
+    co_return stats;
+}
+
+Task<TransferStats> download_file_async(AsyncTCPConnection& conn, const std::string& filename) {
+    TransferStats stats;
+    std::vector<char> frame(MAX_PACKET_SIZE);
+    size_t n = encode_app_msg(frame, OP_DOWNLOAD_REQ, filename);
+    if (!co_await conn.async_send(frame.data(), n)) co_return stats;
+
+    AppFrameParser parser;
+    std::ofstream outFile;
+    long long totalExpectedSize = -1;
+    bool done = false;
+    auto startTime = std::chrono::steady_clock::now();
+
+    while (!done) {
+        size_t r = co_await conn.async_receive(parser.write_ptr(),
+                                               std::min<size_t>(MAX_PACKET_SIZE * 2, parser.writable()));
+        if (r == (size_t)-1) break;
+        parser.commit(r);
+        parser.dispatch([&](uint8_t op, std::string_view data) {
+            if (op == OP_FILE_INFO) {
+                try {
+                    totalExpectedSize = std::stoll(std::string(data));
+                } catch (...) {
+                    totalExpectedSize = -1;
+                }
+                outFile.open("downloaded_" + filename, std::ios::binary);
+                startTime = std::chrono::steady_clock::now();
+            } else if (op == OP_DATA) {
+                if (!outFile.is_open()) outFile.open("downloaded_" + filename, std::ios::binary);
+                MYTCP_PROFILE_SCOPE(PROF_DISK_WRITE);
+                outFile.write(data.data(), data.size());
+                stats.bytes += data.size();
+            } else if (op == OP_HOLE) {
+                long long holeLen = 0;
+                if (outFile.is_open() && parse_hole_length(data, holeLen)) {
+                    skip_hole(outFile, holeLen);
+                    stats.bytes += holeLen;
+                }
+            } else if (op == OP_END) {
+                if (outFile.is_open()) {
+                    outFile.close();
+                    finish_sparse_file("downloaded_" + filename, stats.bytes);
+                }
+                done = true;
+                stats.ok = totalExpectedSize < 0 || totalExpectedSize == stats.bytes;
+            } else if (op == OP_ERROR) {
+                std::cerr << "[Client] Error: " << data << std::endl;
+                done = true;
+            }
+        });
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    double speed = stats.seconds > 0 ? (stats.bytes / 1024.0) / stats.seconds : 0;
+    std::cout << "[Client] Download " << filename << " finished: " << stats.bytes << " bytes, " << stats.seconds
+              << " s, " << speed << " KB/s" << std::endl;
+    co_return stats;
+}
+
+// 打开追踪文件；失败时打印原因并返回 nullptr (不追踪，传输照常)
+PacketTrace* open_trace(PacketTrace& trace, const std::string& path) {
+    if (path.empty()) return nullptr;
+    if (!trace.open(path)) {
+        std::cerr << "Failed to open trace file " << path << std::endl;
+        return nullptr;
+    }
+    std::cout << "Tracing packet events to " << path << std::endl;
+    return &trace;
+}
+
+void run_server(int port, bool engine, const FecConfig& fec, const std::string& metrics, int metrics_interval_ms,
+                const std::string& trace) {
+    MetricsExporter exporter;
+    if (!metrics.empty()) {
+        if (!exporter.open(metrics, metrics_interval_ms)) return;
+        std::cout << "[Server] Exporting transport metrics to " << metrics << " every " << metrics_interval_ms
+                  << " ms" << std::endl;
+    }
+    PacketTrace tracer;  // 比连接活得久：连接析构前一直可能在记录
+    PacketTrace* tr = open_trace(tracer, trace);
+    if (engine) {
+        std::cout << "[Server] Engine mode: protocol runs on a background thread" << std::endl;
+        TCPEngine conn;
+        conn.set_fec(fec);
+        conn.set_trace(tr);
+        serve(conn, port, exporter);
+    } else {
+        TCPConnection conn;
+        conn.set_fec(fec);
+        conn.set_trace(tr);
+        serve(conn, port, exporter);
+    }
+}
+
+// close() 之后等本端的挥手走完 (FIN 被确认、收到对端的 FIN)。FIN 丢了由协议按 RTO 重发，
+// 一直没有回应时连接自己放弃；进程随后退出，TIME_WAIT 里重发最后 ACK 的事交给对端的 FIN 重传上限兜底
+template <typename Conn>
+void wait_closed(Conn& conn) {
+    auto start = std::chrono::steady_clock::now();
+    while (true) {
+        TCPState s = conn.get_state();
+        if (s == TIME_WAIT || s == CLOSED || s == LISTEN) break;
+        if (std::chrono::steady_clock::now() - start > std::chrono::seconds(10)) break;
+        conn.update();
+        std::this_thread::yield();
+    }
+}
+
+template <typename Conn>
+void client_loop(Conn& conn, const std::string& ip, int port) {
     if (!conn.connect(ip, port)) {
         std::cerr << "[Client] Failed to connect to " << ip << ":" << port << std::endl;
         return;
@@ -421,10 +1061,16 @@ void run_client(const std::string& ip, int port) {
     std::cout << "[Client] Send SYN to Server";
     // Wait for ESTABLISHED
     while (conn.get_state() != ESTABLISHED) {
+        if (conn.get_state() == CLOSED) {
+            std::cerr << "[Client] No response from " << ip << ":" << port << std::endl;
+            return;
+        }
         conn.update();
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
-    std::cout << "[Client] Connected! Type 'upload <filename>' or 'download <filename>'" << std::endl;
+    std::cout << "[Client] Connected! Type 'upload <filename>' or 'download <filename>' "
+                 "('upload_dir' / 'download_dir' for directories, 'upload_dedup' to skip chunks the server has)"
+              << std::endl;
 
     while (true) {
         conn.update();
@@ -441,18 +1087,132 @@ void run_client(const std::string& ip, int port) {
             std::string path;
             std::cin >> path;
             download_file(conn, path);
+        } else if (cmd == "upload_dedup") {
+            std::string path;
+            std::cin >> path;
+            upload_file_dedup(conn, path);
+        } else if (cmd == "upload_dir") {
+            std::string path;
+            std::cin >> path;
+            upload_dir(conn, path);
+        } else if (cmd == "download_dir") {
+            std::string path;
+            std::cin >> path;
+            download_dir(conn, path);
         } else if (cmd == "exit") {
             conn.close();
             std::cout << "[Client] Closing connection..." << std::endl;
-            // 简单的等待，直到 socket 关闭 (Encapsulated wait)
-            for (int i = 0; i < 50; ++i) {              // 5s timeout
-                if (conn.get_state() == CLOSED) break;  // Keep this internal check for now or move to verify method
-                conn.update();
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            }
+            wait_closed(conn);
             break;
         } else {
             std::cout << "Unknown command" << std::endl;
         }
     }
 }
+
+// 协程版客户端：每条命令作为一个任务提交给 Scheduler 跑完
+Task<void> client_command_async(AsyncTCPConnection& conn, std::string cmd, std::string path) {
+    if (cmd == "upload") {
+        co_await upload_file_async(conn, path);
+    } else {
+        co_await download_file_async(conn, path);
+    }
+}
+
+Task<void> client_connect_async(AsyncTCPConnection& conn, std::string ip, int port, bool& ok) {
+    ok = co_await conn.async_connect(ip, port);
+}
+
+void client_loop_async(const std::string& ip, int port, const FecConfig& fec, PacketTrace* trace) {
+    Scheduler sched;
+    AsyncTCPConnection conn(sched);
+    conn.raw().set_fec(fec);
+    conn.raw().set_trace(trace);
+
+    bool connected = false;
+    sched.spawn(client_connect_async(conn, ip, port, connected));
+    sched.run();
+    if (!connected) {
+        std::cerr << "[Client] Failed to connect to " << ip << ":" << port << std::endl;
+        return;
+    }
+    std::cout << "[Client] Connected (async)! Type 'upload <filename>' or 'download <filename>'" << std::endl;
+
+    while (true) {
+        conn.raw().update();
+
+        std::cout << "> ";
+        std::string cmd;
+        if (!(std::cin >> cmd)) break;
+
+        if (cmd == "upload" || cmd == "download") {
+            std::string path;
+            std::cin >> path;
+            sched.spawn(client_command_async(conn, cmd, path));
+            sched.run();
+        } else if (cmd == "exit") {
+            conn.close();
+            std::cout << "[Client] Closing connection..." << std::endl;
+            wait_closed(conn.raw());
+            break;
+        } else {
+            std::cout << "Unknown command" << std::endl;
+        }
+    }
+}
+
+TransferStats fetch_file(const std::string& ip, int port, const std::string& filename, bool fast_open) {
+    TransferStats stats;
+    TCPConnection conn;
+    auto connectTime = std::chrono::steady_clock::now();
+    bool requestSent = false;
+    if (fast_open) {
+        // 下载请求直接放在 SYN 里：服务器认可 cookie 就立即处理，第一个响应随 SYN-ACK 回来
+        std::vector<char> frame;
+        size_t n = encode_app_msg(frame, OP_DOWNLOAD_REQ, filename);
+        requestSent = conn.connect(ip, port, frame.data(), n);
+    }
+    if (!requestSent && !conn.connect(ip, port)) {
+        std::cerr << "[Client] Failed to connect to " << ip << ":" << port << std::endl;
+        return stats;
+    }
+
+    while (conn.get_state() != ESTABLISHED) {
+        if (conn.get_state() == CLOSED || std::chrono::steady_clock::now() - connectTime > std::chrono::seconds(5)) {
+            std::cerr << "[Client] Connect timeout" << std::endl;
+            return stats;
+        }
+        conn.update();
+        std::this_thread::yield();
+    }
+    if (requestSent) {
+        std::cout << "[Client] Fast Open " << (conn.fast_open_accepted() ? "accepted" : "fallback") << std::endl;
+    }
+    stats.ok = download_file_impl(conn, filename, requestSent, &stats.bytes);
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - connectTime).count();
+
+    conn.close();
+    wait_closed(conn);
+    return stats;
+}
+
+void run_client(const std::string& ip, int port, bool engine, bool async, const FecConfig& fec,
+                const std::string& trace) {
+    PacketTrace tracer;
+    PacketTrace* tr = open_trace(tracer, trace);
+    if (async) {
+        client_loop_async(ip, port, fec, tr);
+    } else if (engine) {
+        // 引擎模式下协议线程独立运行，阻塞在 std::cin 上时 ACK / 重传也不会停
+        std::cout << "[Client] Engine mode: protocol runs on a background thread" << std::endl;
+        TCPEngine conn;
+        conn.set_fec(fec);
+        conn.set_trace(tr);
+        client_loop(conn, ip, port);
+    } else {
+        TCPConnection conn;
+        conn.set_fec(fec);
+        conn.set_trace(tr);
+        client_loop(conn, ip, port);
+    }
+}
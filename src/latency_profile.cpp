@@ -0,0 +1,190 @@
+#include "latency_profile.h"
+
+#include <pthread.h>
+#include <signal.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const char* profile_point_name(ProfilePoint p) {
+    static const char* const names[] = {"update", "process_packet", "send_wait", "disk_write", "disk_read"};
+    return unsigned(p) < PROF_POINT_COUNT ? names[p] : "unknown";
+}
+
+// ---------------- LatencyHistogram ----------------
+
+int LatencyHistogram::bucket_of(uint64_t ns) {
+    if (ns < uint64_t(SUB_BUCKETS)) return int(ns);
+    int e = 63 - __builtin_clzll(ns);  // ns 位于 [2^e, 2^(e+1))，e >= SUB_BITS
+    if (e > MAX_EXPONENT) return BUCKETS - 1;
+    return (e - SUB_BITS + 1) * SUB_BUCKETS + int((ns >> (e - SUB_BITS)) & (SUB_BUCKETS - 1));
+}
+
+uint64_t LatencyHistogram::bucket_low(int b) {
+    if (b < SUB_BUCKETS) return uint64_t(b);
+    int e = b / SUB_BUCKETS + SUB_BITS - 1;
+    return uint64_t(SUB_BUCKETS + b % SUB_BUCKETS) << (e - SUB_BITS);
+}
+
+uint64_t LatencyHistogram::percentile(double q) const {
+    uint64_t snapshot[BUCKETS];
+    uint64_t n = 0;
+    for (int b = 0; b < BUCKETS; ++b) {
+        snapshot[b] = counts[b].load(std::memory_order_relaxed);
+        n += snapshot[b];
+    }
+    if (n == 0) return 0;
+
+    uint64_t rank = uint64_t(q * n + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > n) rank = n;
+    uint64_t seen = 0;
+    for (int b = 0; b < BUCKETS; ++b) {
+        seen += snapshot[b];
+        if (seen < rank) continue;
+        uint64_t low = bucket_low(b);
+        uint64_t width = b + 1 < BUCKETS ? bucket_low(b + 1) - low : 1;
+        return std::min(low + width / 2, max());  // 桶的中点不会超过实际最大值
+    }
+    return max();
+}
+
+void LatencyHistogram::merge_into(LatencyHistogram& dst) const {
+    for (int b = 0; b < BUCKETS; ++b) bump(dst.counts[b], counts[b].load(std::memory_order_relaxed));
+    bump(dst.total, count());
+    bump(dst.sum_ns, sum_ns.load(std::memory_order_relaxed));
+    if (max() > dst.max()) dst.max_ns.store(max(), std::memory_order_relaxed);
+}
+
+void LatencyHistogram::reset() {
+    for (auto& c : counts) c.store(0, std::memory_order_relaxed);
+    total.store(0, std::memory_order_relaxed);
+    sum_ns.store(0, std::memory_order_relaxed);
+    max_ns.store(0, std::memory_order_relaxed);
+}
+
+// ---------------- 线程注册表 ----------------
+
+namespace {
+
+struct ThreadProfile {
+    std::string name;
+    LatencyHistogram points[PROF_POINT_COUNT];
+};
+
+// 线程退出后它的直方图仍留在表里，汇报时照样计入 (比如客户端每次传输一个的异步线程)
+std::mutex registry_mutex;
+std::vector<std::unique_ptr<ThreadProfile>> registry;
+thread_local ThreadProfile* current = nullptr;
+
+ThreadProfile* this_thread_profile() {
+    if (!current) {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry.emplace_back(new ThreadProfile);
+        current = registry.back().get();
+        current->name = "thread-" + std::to_string(registry.size());
+    }
+    return current;
+}
+
+std::string format_ns(uint64_t ns) {
+    char buf[32];
+    if (ns < 1000) {
+        snprintf(buf, sizeof(buf), "%lluns", (unsigned long long)ns);
+    } else if (ns < 1000000) {
+        snprintf(buf, sizeof(buf), "%.1fus", ns / 1e3);
+    } else if (ns < 1000000000) {
+        snprintf(buf, sizeof(buf), "%.2fms", ns / 1e6);
+    } else {
+        snprintf(buf, sizeof(buf), "%.2fs", ns / 1e9);
+    }
+    return buf;
+}
+
+void dump_points(std::ostream& out, const std::string& title, const LatencyHistogram* points) {
+    out << "  " << title << "\n";
+    char line[160];
+    for (int p = 0; p < PROF_POINT_COUNT; ++p) {
+        const LatencyHistogram& h = points[p];
+        if (h.count() == 0) continue;
+        snprintf(line, sizeof(line), "    %-15s %10llu %9s %9s %9s %9s %9s\n", profile_point_name(ProfilePoint(p)),
+                 (unsigned long long)h.count(), format_ns(h.percentile(0.5)).c_str(),
+                 format_ns(h.percentile(0.99)).c_str(), format_ns(h.percentile(0.999)).c_str(),
+                 format_ns(h.max()).c_str(), format_ns(uint64_t(h.mean())).c_str());
+        out << line;
+    }
+}
+
+bool has_samples(const LatencyHistogram* points) {
+    for (int p = 0; p < PROF_POINT_COUNT; ++p) {
+        if (points[p].count()) return true;
+    }
+    return false;
+}
+
+}  // namespace
+
+void profile_record(ProfilePoint p, uint64_t ns) { this_thread_profile()->points[p].record(ns); }
+
+void profile_set_thread_name(const std::string& name) {
+    if (!profile_enabled()) return;
+    ThreadProfile* t = this_thread_profile();
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    t->name = name;
+}
+
+void profile_dump(std::ostream& out, bool reset) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    char header[160];
+    snprintf(header, sizeof(header), "    %-15s %10s %9s %9s %9s %9s %9s\n", "point", "count", "p50", "p99", "p999",
+             "max", "mean");
+    out << header;
+
+    // 合计用的直方图有 40 多 KB，不放在栈上
+    std::unique_ptr<LatencyHistogram[]> total(new LatencyHistogram[PROF_POINT_COUNT]);
+    int threads = 0;
+    for (auto& t : registry) {
+        if (!has_samples(t->points)) continue;
+        ++threads;
+        dump_points(out, "[" + t->name + "]", t->points);
+        for (int p = 0; p < PROF_POINT_COUNT; ++p) {
+            t->points[p].merge_into(total[p]);
+            // 清零和记录线程的写可能交错，最多丢掉几个正在记录的样本
+            if (reset) t->points[p].reset();
+        }
+    }
+    if (threads == 0) {
+        out << "  (no samples)\n";
+    } else if (threads > 1) {
+        dump_points(out, "[all threads]", total.get());
+    }
+    out.flush();
+}
+
+void profile_report(const std::string& label) {
+    if (!profile_enabled()) return;
+    std::cerr << "[Profile] " << label << ":\n";
+    profile_dump(std::cerr, true);
+}
+
+void profile_dump_on_signal() {
+    if (!profile_enabled()) return;
+    // 之后创建的线程都继承这个屏蔽字，SIGUSR1 只会被下面的线程 sigwait 取走
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    if (pthread_sigmask(SIG_BLOCK, &set, nullptr) != 0) return;
+    std::thread([set]() {
+        while (true) {
+            int sig = 0;
+            if (sigwait(&set, &sig) != 0) continue;
+            std::cerr << "[Profile] SIGUSR1 (cumulative):\n";
+            profile_dump(std::cerr, false);
+        }
+    }).detach();
+}
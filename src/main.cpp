@@ -1,26 +1,167 @@
 #include <iostream>
 #include <string>
+#include <vector>
 
+#include "file_cache.h"
 #include "file_transfer.h"
+#include "latency_profile.h"
+#include "rate_limit.h"
+
+namespace {
+// 字节/秒，可以带 K / M / G 后缀 (1024 进制)，比如 512K、10M
+bool parse_rate(const std::string& text, uint64_t& out) {
+    size_t pos = 0;
+    double v;
+    try {
+        v = std::stod(text, &pos);
+    } catch (...) {
+        return false;
+    }
+    std::string suffix = text.substr(pos);
+    if (suffix == "K" || suffix == "k") {
+        v *= 1024;
+    } else if (suffix == "M" || suffix == "m") {
+        v *= 1024 * 1024;
+    } else if (suffix == "G" || suffix == "g") {
+        v *= 1024 * 1024 * 1024;
+    } else if (!suffix.empty()) {
+        return false;
+    }
+    if (v < 0) return false;
+    out = uint64_t(v);
+    return true;
+}
+}  // namespace
 
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cout << "Usage: ./tcp_app <mode> [args]\n"
+    // 编译进剖析时 (MYTCP_ENABLE_PROFILING)，kill -USR1 <pid> 打印各埋点的耗时分布；要在启动其他线程之前调用
+    profile_dump_on_signal();
+    profile_set_thread_name("main");
+
+    // 拆分位置参数与 --xxx 选项
+    std::vector<std::string> args;
+    bool engine = false;
+    bool async = false;
+    bool fastOpen = true;
+    bool fecStatic = false;
+    FecConfig fec;
+    std::string metrics;
+    int metricsInterval = 1000;
+    std::string trace;
+    RateLimiter totalRate;  // --rate-total：本进程所有连接共享
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--fec") {
+            if (i + 1 >= argc || !parse_fec_config(argv[++i], fec)) {
+                std::cerr << "Invalid --fec, expected xor[:k] or rs[:k[,m]]" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--sockbuf") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for --sockbuf" << std::endl;
+                return 1;
+            }
+            int bytes = std::stoi(argv[++i]);
+            TransportOptions::defaults().socket_rcvbuf = bytes;
+            TransportOptions::defaults().socket_sndbuf = bytes;
+        } else if (arg == "--rate" || arg == "--rate-total") {
+            uint64_t rate = 0;
+            if (i + 1 >= argc || !parse_rate(argv[++i], rate)) {
+                std::cerr << "Invalid " << arg << ", expected bytes per second (e.g. 512K, 10M)" << std::endl;
+                return 1;
+            }
+            if (arg == "--rate") {
+                TransportOptions::defaults().rate_limit = rate;
+            } else {
+                totalRate.set_rate(rate);
+                TransportOptions::defaults().shared_rate_limit = rate > 0 ? &totalRate : nullptr;
+            }
+        } else if (arg == "--no-pacing") {
+            TransportOptions::defaults().pacing = false;
+        } else if (arg == "--cache-mb") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for --cache-mb" << std::endl;
+                return 1;
+            }
+            FileCache::global().set_capacity(std::stoull(argv[++i]) * 1024 * 1024);
+        } else if (arg == "--trace") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for --trace" << std::endl;
+                return 1;
+            }
+            trace = argv[++i];
+        } else if (arg == "--metrics" || arg == "--metrics-interval") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                return 1;
+            }
+            if (arg == "--metrics") {
+                metrics = argv[++i];
+            } else {
+                metricsInterval = std::stoi(argv[++i]);
+            }
+        } else if (arg == "--fec-static") {
+            fecStatic = true;
+        } else if (arg == "--engine") {
+            engine = true;
+        } else if (arg == "--split-io") {
+            engine = true;
+            TransportOptions::defaults().split_io = true;
+        } else if (arg == "--async") {
+            async = true;
+        } else if (arg == "--no-tfo") {
+            fastOpen = false;
+        } else {
+            args.push_back(arg);
+        }
+    }
+    if (fecStatic) fec.adaptive = false;
+
+    if (args.empty()) {
+        std::cout << "Usage: ./tcp_app <mode> [args] [options]\n"
                   << " Modes:\n"
                   << "   server [port]       (default: 8080)\n"
-                  << "   client [ip] [port]  (default: 127.0.0.1 8080)\n";
+                  << "   client [ip] [port]  (default: 127.0.0.1 8080)\n"
+                  << "   fetch <ip> <port> <file...>  download each file on a new connection\n"
+                  << " Options:\n"
+                  << "   --engine            run the protocol on a background I/O thread\n"
+                  << "   --split-io          engine mode with packet receive + checksum on a second thread\n"
+                  << "   --async             client: drive transfers with C++20 coroutines\n"
+                  << "   --no-tfo            fetch: disable Fast Open (request waits for the handshake)\n"
+                  << "   --fec <spec>        add FEC parity to sent data: xor[:k] or rs[:k[,m]] (k<=16, m<=8)\n"
+                  << "   --fec-static        keep the configured FEC redundancy instead of adapting to loss\n"
+                  << "   --no-pacing         send a whole window back-to-back instead of spreading it over an RTT\n"
+                  << "   --sockbuf <bytes>   UDP socket SO_RCVBUF / SO_SNDBUF (default 4194304, capped by\n"
+                  << "                       net.core.rmem_max / wmem_max; 0 = system default)\n"
+                  << "   --rate <bytes/s>    limit each connection's send rate (suffix K / M / G, e.g. 10M)\n"
+                  << "   --rate-total <bytes/s>  limit the send rate of all connections of this process together\n"
+                  << "                       (shared fairly between concurrent connections)\n"
+                  << "   --cache-mb <n>      server: memory for the hot download file cache (default 256, 0 = off)\n"
+                  << "   --metrics <target>  server: export transport stats in Prometheus format to a file,\n"
+                  << "                       unix:<path> or tcp:<port> (HTTP on 127.0.0.1)\n"
+                  << "   --metrics-interval <ms>  server: how often the exported stats are refreshed (default 1000)\n"
+                  << "   --trace <file>      record packet events to a binary trace (convert with trace2qlog)\n";
         return 0;
     }
 
-    std::string mode = argv[1];
+    std::string mode = args[0];
 
     if (mode == "server") {
-        int port = (argc >= 3) ? std::stoi(argv[2]) : SERVER_PORT;
-        run_server(port);
+        int port = (args.size() >= 2) ? std::stoi(args[1]) : SERVER_PORT;
+        run_server(port, engine, fec, metrics, metricsInterval, trace);
     } else if (mode == "client") {
-        std::string ip = (argc >= 3) ? argv[2] : SERVER_IP;
-        int port = (argc >= 4) ? std::stoi(argv[3]) : SERVER_PORT;
-        run_client(ip, port);
+        std::string ip = (args.size() >= 2) ? args[1] : SERVER_IP;
+        int port = (args.size() >= 3) ? std::stoi(args[2]) : SERVER_PORT;
+        run_client(ip, port, engine, async, fec, trace);
+    } else if (mode == "fetch") {
+        if (args.size() < 4) {
+            std::cerr << "Usage: ./tcp_app fetch <ip> <port> <file...>" << std::endl;
+            return 1;
+        }
+        int port = std::stoi(args[2]);
+        bool allOk = true;
+        for (size_t i = 3; i < args.size(); ++i) allOk = fetch_file(args[1], port, args[i], fastOpen).ok && allOk;
+        return allOk ? 0 : 1;
     } else {
         std::cerr << "Unknown mode: " << mode << std::endl;
         return 1;
@@ -0,0 +1,18 @@
+#include "memory_budget.h"
+
+#include <algorithm>
+
+MemoryBudget& MemoryBudget::global() {
+    static MemoryBudget budget;
+    return budget;
+}
+
+size_t MemoryBudget::reserve_up_to(size_t want) {
+    size_t cur = used_bytes.load(std::memory_order_relaxed);
+    while (true) {
+        size_t cap = limit_bytes.load(std::memory_order_relaxed) / 4 * 3;  // 紧张线以上不再批准增长
+        if (cur >= cap) return 0;
+        size_t grant = std::min(want, cap - cur);
+        if (used_bytes.compare_exchange_weak(cur, cur + grant, std::memory_order_relaxed)) return grant;
+    }
+}
@@ -0,0 +1,273 @@
+#include "multipath.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+#include "app_framing.h"  // store_be64 / load_be64
+#include "tcp_socket.h"   // htonl / ntohl
+
+namespace {
+// 一个段能装下的连接级负载
+const size_t MP_PAYLOAD = MAX_PACKET_SIZE - sizeof(TCPHeader) - sizeof(MultipathFrameHeader);
+
+void encode_frame_header(char* dst, uint8_t type, uint8_t flags, uint64_t dsn, uint16_t length) {
+    MultipathFrameHeader hdr;
+    hdr.type = type;
+    hdr.flags = flags;
+    store_be64(reinterpret_cast<char*>(&hdr.dsn), dsn);
+    hdr.length = htons(length);
+    memcpy(dst, &hdr, sizeof(hdr));
+}
+
+void decode_frame_header(const char* src, uint8_t& type, uint8_t& flags, uint64_t& dsn, uint16_t& length) {
+    MultipathFrameHeader hdr;
+    memcpy(&hdr, src, sizeof(hdr));
+    type = hdr.type;
+    flags = hdr.flags;
+    dsn = load_be64(reinterpret_cast<const char*>(&hdr.dsn));
+    length = ntohs(hdr.length);
+}
+}  // namespace
+
+MultipathConnection::MultipathConnection(bool is_server) : server(is_server), seg(MAX_PACKET_SIZE) {
+    if (!server) {
+        std::random_device rd;
+        token = (uint64_t(rd()) << 32) | rd();
+    }
+}
+
+MultipathConnection::~MultipathConnection() {
+    for (Subflow& sf : subflows) sf.conn->set_segment_handler(nullptr);
+}
+
+MultipathConnection::Subflow& MultipathConnection::add(const std::string& local, const std::string& remote) {
+    size_t index = subflows.size();
+    subflows.emplace_back();
+    Subflow& sf = subflows.back();
+    sf.conn = std::make_unique<TCPConnection>();
+    sf.local = local;
+    sf.remote = remote;
+    sf.conn->set_segment_handler([this, index](const char* data, size_t len) { on_segment(index, data, len); });
+    return sf;
+}
+
+bool MultipathConnection::listen(const std::string& local_ip, int port) {
+    if (!server || subflows.size() >= MAX_SUBFLOWS) return false;
+    Subflow& sf = add(local_ip + ":" + std::to_string(port), "");
+    if (!sf.conn->bind(local_ip, port)) {
+        subflows.pop_back();
+        return false;
+    }
+    return true;
+}
+
+bool MultipathConnection::add_subflow(const std::string& local_ip, const std::string& remote_ip, int port) {
+    if (server || subflows.size() >= MAX_SUBFLOWS) return false;
+    Subflow& sf = add(local_ip, remote_ip + ":" + std::to_string(port));
+    if ((!local_ip.empty() && !sf.conn->set_local_address(local_ip)) || !sf.conn->connect(remote_ip, port)) {
+        subflows.pop_back();
+        return false;
+    }
+    return true;
+}
+
+size_t MultipathConnection::write(const void* data, size_t len) {
+    if (fin_pending) return 0;
+    size_t n = std::min(len, SEND_BUFFER - std::min(SEND_BUFFER, tx.size()));
+    const char* p = static_cast<const char*>(data);
+    tx.insert(tx.end(), p, p + n);
+    return n;
+}
+
+void MultipathConnection::finish() { fin_pending = true; }
+
+size_t MultipathConnection::read(void* buffer, size_t maxLen) {
+    size_t n = rx.read(buffer, maxLen);
+    // 应用读走了半个窗口以上就给对端放额度
+    if (n != (size_t)-1 && n > 0 && rx.credit_due()) credit_pending = true;
+    return n;
+}
+
+void MultipathConnection::update() {
+    for (Subflow& sf : subflows) {
+        sf.conn->update();
+        TCPState st = sf.conn->get_state();
+        if (server) {
+            if (sf.rejected && (st == ESTABLISHED || st == CLOSE_WAIT)) sf.conn->close();
+            if (st == LISTEN && (sf.joined || sf.rejected)) {
+                // 子流挥手结束回到 LISTEN，可以接受下一条
+                sf.joined = false;
+                sf.rejected = false;
+                sf.early.clear();
+                sf.early_bytes = 0;
+            }
+        } else if (!sf.joined && st == ESTABLISHED) {
+            // JOIN 是子流上的第一个段；发不出去 (pacing) 就下次再试，在那之前不往这条子流调度数据
+            char join[sizeof(MultipathFrameHeader)];
+            encode_frame_header(join, MP_FRAME_JOIN, 0, token, 0);
+            sf.joined = sf.conn->send(join, sizeof(join));
+        }
+    }
+    schedule();
+}
+
+void MultipathConnection::close() {
+    for (Subflow& sf : subflows) sf.conn->close();
+}
+
+bool MultipathConnection::established() const {
+    return std::any_of(subflows.begin(), subflows.end(), [this](const Subflow& sf) { return usable(sf); });
+}
+
+bool MultipathConnection::idle() const {
+    if (!tx.empty() || (fin_pending && !fin_sent) || credit_pending) return false;
+    return std::all_of(subflows.begin(), subflows.end(),
+                       [](const Subflow& sf) { return sf.conn->is_send_complete(); });
+}
+
+MultipathConnection::SubflowInfo MultipathConnection::subflow_info(size_t i) const {
+    const Subflow& sf = subflows.at(i);
+    SubflowInfo info;
+    info.local = sf.local;
+    info.remote = sf.remote;
+    info.joined = sf.joined;
+    info.bytes = sf.bytes;
+    info.tcp = sf.conn->info();
+    return info;
+}
+
+// ---------------- 接收 ----------------
+
+void MultipathConnection::on_segment(size_t index, const char* data, size_t len) {
+    Subflow& sf = subflows[index];
+    if (!server || sf.joined) {
+        on_frames(data, len);
+        return;
+    }
+    if (sf.rejected || len < sizeof(MultipathFrameHeader)) return;
+
+    uint8_t type, flags;
+    uint64_t value;
+    uint16_t length;
+    decode_frame_header(data, type, flags, value, length);
+    if (type != MP_FRAME_JOIN) {
+        // JOIN 丢了还在重传，后面的段先到：存起来，确认了这条子流属于本连接再处理
+        if (sf.early_bytes + len > MP_WINDOW) {
+            sf.rejected = true;
+            sf.early.clear();
+            sf.early_bytes = 0;
+            return;
+        }
+        sf.early.emplace_back(data, data + len);
+        sf.early_bytes += len;
+        return;
+    }
+    if (!have_token) {
+        token = value;
+        have_token = true;
+    }
+    if (value != token) {
+        // 别的客户端连到了本连接的地址上
+        sf.rejected = true;
+        sf.early.clear();
+        sf.early_bytes = 0;
+        return;
+    }
+    sf.joined = true;
+    size_t used = std::min(len, sizeof(MultipathFrameHeader) + length);
+    on_frames(data + used, len - used);
+    for (const std::vector<char>& e : sf.early) on_frames(e.data(), e.size());
+    sf.early.clear();
+    sf.early_bytes = 0;
+}
+
+void MultipathConnection::on_frames(const char* data, size_t len) {
+    while (len >= sizeof(MultipathFrameHeader)) {
+        uint8_t type, flags;
+        uint64_t dsn;
+        uint16_t length;
+        decode_frame_header(data, type, flags, dsn, length);
+        data += sizeof(MultipathFrameHeader);
+        len -= sizeof(MultipathFrameHeader);
+        if (length > len) break;  // 帧不完整，段已损坏
+
+        if (type == MP_FRAME_DATA) {
+            rx.insert(dsn, data, length, flags & MP_FLAG_FIN);
+        } else if (type == MP_FRAME_MAX_DATA) {
+            tx_limit = std::max(tx_limit, dsn);
+        }
+        data += length;
+        len -= length;
+    }
+}
+
+// ---------------- 发送调度 ----------------
+
+bool MultipathConnection::usable(const Subflow& sf) const {
+    TCPState st = sf.conn->get_state();
+    return sf.joined && (st == ESTABLISHED || st == CLOSE_WAIT);
+}
+
+bool MultipathConnection::send_segment(const char* data, size_t len, size_t payload) {
+    // 按调度器的偏好依次尝试：每次从还没试过的子流里挑最好的一条，它发不出去 (窗口满、pacing、限速) 就换下一条
+    uint32_t tried = 0;
+    for (size_t attempt = 0; attempt < subflows.size(); ++attempt) {
+        size_t best = subflows.size();
+        uint64_t best_key = 0;
+        for (size_t i = 0; i < subflows.size(); ++i) {
+            if ((tried & (1u << i)) || !usable(subflows[i])) continue;
+            const TCPConnection& c = *subflows[i].conn;
+            uint64_t key;
+            if (scheduler == SCHED_LOWEST_RTT) {
+                // 还没有 RTT 样本的排在最后
+                key = c.smoothed_rtt_us() > 0 ? c.smoothed_rtt_us() : UINT64_MAX;
+            } else {
+                key = UINT32_MAX - c.send_window_available();
+            }
+            if (best == subflows.size() || key < best_key) {
+                best = i;
+                best_key = key;
+            }
+        }
+        if (best == subflows.size()) return false;
+
+        tried |= 1u << best;
+        if (subflows[best].conn->send(data, len)) {
+            subflows[best].bytes += payload;
+            return true;
+        }
+    }
+    return false;
+}
+
+void MultipathConnection::schedule() {
+    // 1. 流控额度优先：对端可能正卡在上限上
+    if (credit_pending) {
+        uint64_t limit = rx.next_limit();
+        encode_frame_header(seg.data(), MP_FRAME_MAX_DATA, 0, limit, 0);
+        if (!send_segment(seg.data(), sizeof(MultipathFrameHeader), 0)) return;
+        rx.credit_sent(limit);
+        credit_pending = false;
+    }
+
+    // 2. 数据：每个段装一个帧，逐段交给调度器挑出的子流
+    while (true) {
+        size_t allowed = std::min<uint64_t>(tx.size(), tx_limit - std::min(tx_limit, tx_dsn));
+        bool fin_ready = fin_pending && !fin_sent && allowed == tx.size();
+        if (allowed == 0 && !fin_ready) return;
+
+        size_t n = std::min(allowed, MP_PAYLOAD);
+        bool fin = fin_ready && n == tx.size();
+        encode_frame_header(seg.data(), MP_FRAME_DATA, fin ? MP_FLAG_FIN : 0, tx_dsn, n);
+        std::copy(tx.begin(), tx.begin() + n, seg.data() + sizeof(MultipathFrameHeader));
+        if (!send_segment(seg.data(), sizeof(MultipathFrameHeader) + n, n)) return;
+
+        tx.erase(tx.begin(), tx.begin() + n);
+        tx_dsn += n;
+        if (fin) {
+            fin_sent = true;
+            return;
+        }
+    }
+}
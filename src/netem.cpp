@@ -0,0 +1,241 @@
+#include "netem.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+bool parse_netem_config(const std::string& text, NetemConfig& out) {
+    NetemConfig cfg;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) continue;
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) return false;
+        std::string key = item.substr(0, eq);
+        const char* val = item.c_str() + eq + 1;
+        char* end = nullptr;
+        double v = strtod(val, &end);
+        if (key == "ge") {
+            // p:r[:lossBad[:lossGood]]
+            double p = 0, r = 0, bad = 100, good = 0;
+            int got = sscanf(val, "%lf:%lf:%lf:%lf", &p, &r, &bad, &good);
+            if (got < 2 || r <= 0) return false;
+            cfg.ge = true;
+            cfg.ge_p = p;
+            cfg.ge_r = r;
+            cfg.ge_loss_bad = bad;
+            cfg.ge_loss_good = good;
+            continue;
+        }
+        if (end == val || *end != '\0' || v < 0) return false;
+        if (key == "delay") {
+            cfg.delay_ms = v;
+        } else if (key == "jitter") {
+            cfg.jitter_ms = v;
+        } else if (key == "loss") {
+            cfg.loss = v;
+        } else if (key == "reorder") {
+            cfg.reorder = v;
+        } else if (key == "dup") {
+            cfg.duplicate = v;
+        } else if (key == "corrupt") {
+            cfg.corrupt = v;
+        } else if (key == "rate") {
+            cfg.rate_kbps = v;
+        } else if (key == "queue") {
+            cfg.queue_bytes = (size_t)v;
+        } else {
+            return false;
+        }
+    }
+    out = cfg;
+    return true;
+}
+
+std::string describe_netem_config(const NetemConfig& cfg) {
+    char buf[256];
+    int n = snprintf(buf, sizeof(buf), "delay %.1fms jitter %.1fms loss %.2f%%", cfg.delay_ms, cfg.jitter_ms, cfg.loss);
+    if (cfg.ge) {
+        n += snprintf(buf + n, sizeof(buf) - n, " ge p=%.2f%% r=%.2f%% bad=%.0f%% good=%.2f%%", cfg.ge_p, cfg.ge_r,
+                      cfg.ge_loss_bad, cfg.ge_loss_good);
+    }
+    n += snprintf(buf + n, sizeof(buf) - n, " reorder %.2f%% dup %.2f%% corrupt %.2f%%", cfg.reorder, cfg.duplicate,
+                  cfg.corrupt);
+    if (cfg.rate_kbps > 0) snprintf(buf + n, sizeof(buf) - n, " rate %.0fkbit", cfg.rate_kbps);
+    return buf;
+}
+
+// ---------------- NetemLink ----------------
+
+NetemLink::NetemLink(const NetemConfig& config, uint64_t seed) : cfg(config), rng(seed) {
+    queueLimit = cfg.queue_bytes;
+    if (queueLimit == 0 && cfg.rate_kbps > 0) {
+        queueLimit = std::max<size_t>(64 * 1024, size_t(cfg.rate_kbps * 1000 / 8 * 0.1));
+    }
+}
+
+bool NetemLink::should_drop() {
+    if (cfg.ge) {
+        geBad = geBad ? !chance(cfg.ge_r) : chance(cfg.ge_p);
+        if (chance(geBad ? cfg.ge_loss_bad : cfg.ge_loss_good)) return true;
+    }
+    return chance(cfg.loss);
+}
+
+void NetemLink::enqueue(Clock::time_point due, std::vector<char> data) {
+    pending.push(Packet{due, nextSeq++, std::move(data)});
+}
+
+void NetemLink::submit(const char* data, size_t len, Clock::time_point now) {
+    ++counters.packets;
+    if (should_drop()) {
+        ++counters.lost;
+        return;
+    }
+
+    std::vector<char> pkt(data, data + len);
+    if (chance(cfg.corrupt) && len > 0) {
+        pkt[rng() % len] ^= char(1 << (rng() % 8));
+        ++counters.corrupted;
+    }
+
+    Clock::time_point due;
+    if (chance(cfg.reorder)) {
+        // 插队：不经过瓶颈队列和延迟，立即发出
+        ++counters.reordered;
+        due = now;
+    } else {
+        Clock::time_point departure = now;
+        if (cfg.rate_kbps > 0) {
+            // 瓶颈链路按字节串行发送，排在前面的包没发完时在队列里等；队列里的字节数超过上限就尾丢
+            Clock::time_point start = std::max(now, linkFree);
+            double queued = std::chrono::duration<double>(start - now).count() * cfg.rate_kbps * 1000 / 8;
+            if (queued + len > queueLimit) {
+                ++counters.queue_drops;
+                return;
+            }
+            auto txTime = std::chrono::duration<double>(len * 8 / (cfg.rate_kbps * 1000));
+            linkFree = start + std::chrono::duration_cast<Clock::duration>(txTime);
+            departure = linkFree;
+        }
+        double delay = cfg.delay_ms;
+        if (cfg.jitter_ms > 0) delay += (uniform(rng) * 2 - 1) * cfg.jitter_ms;
+        due = departure + std::chrono::microseconds((long long)(std::max(0.0, delay) * 1000));
+        due = std::max(due, lastDue);
+        lastDue = due;
+    }
+
+    if (chance(cfg.duplicate)) {
+        ++counters.duplicated;
+        enqueue(due, pkt);
+    }
+    enqueue(due, std::move(pkt));
+}
+
+bool NetemLink::next_due(Clock::time_point& due) const {
+    if (pending.empty()) return false;
+    due = pending.top().due;
+    return true;
+}
+
+bool NetemLink::pop_due(Clock::time_point now, std::vector<char>& out) {
+    if (pending.empty() || pending.top().due > now) return false;
+    // top() 是 const 的；紧接着就 pop，把数据移走是安全的
+    out = std::move(const_cast<Packet&>(pending.top()).data);
+    pending.pop();
+    ++counters.delivered;
+    counters.bytes += out.size();
+    return true;
+}
+
+// ---------------- UDP 代理 ----------------
+
+namespace {
+
+void print_link_stats(const char* name, const NetemStats& s) {
+    fprintf(stderr,
+            "[netem] %-4s in %llu  out %llu (%llu KB)  lost %llu  queue-drop %llu  reordered %llu  dup %llu  "
+            "corrupt %llu\n",
+            name, (unsigned long long)s.packets, (unsigned long long)s.delivered, (unsigned long long)(s.bytes / 1024),
+            (unsigned long long)s.lost, (unsigned long long)s.queue_drops, (unsigned long long)s.reordered,
+            (unsigned long long)s.duplicated, (unsigned long long)s.corrupted);
+}
+
+}  // namespace
+
+void run_netem_proxy(int listenPort, const std::string& serverIp, int serverPort, const NetemConfig& up,
+                     const NetemConfig& down, uint64_t seed, int statsIntervalS, const std::string& listenIp) {
+    using Clock = NetemLink::Clock;
+
+    int front = socket(AF_INET, SOCK_DGRAM, 0);
+    int back = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in listenAddr{}, serverAddr{};
+    listenAddr.sin_family = AF_INET;
+    listenAddr.sin_port = htons(listenPort);
+    listenAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(serverPort);
+    if ((!listenIp.empty() && inet_pton(AF_INET, listenIp.c_str(), &listenAddr.sin_addr) != 1) ||
+        inet_pton(AF_INET, serverIp.c_str(), &serverAddr.sin_addr) != 1 ||
+        bind(front, (sockaddr*)&listenAddr, sizeof(listenAddr)) != 0 ||
+        connect(back, (sockaddr*)&serverAddr, sizeof(serverAddr)) != 0) {
+        perror("[netem] proxy");
+        close(front);
+        close(back);
+        return;
+    }
+
+    // 两个方向用不同的种子，互不影响
+    NetemLink toServer(up, seed), toClient(down, seed ^ 0x9e3779b97f4a7c15ULL);
+    sockaddr_in client{};
+    socklen_t clientLen = 0;
+    char buf[65536];
+    std::vector<char> pkt;
+    pollfd fds[2] = {{front, POLLIN, 0}, {back, POLLIN, 0}};
+    auto nextStats = Clock::now() + std::chrono::seconds(statsIntervalS);
+
+    while (true) {
+        // 睡到最早的包到期 (亚毫秒的余数向上取整，宁可晚一点也不要空转)
+        int timeout = statsIntervalS > 0 ? 1000 : -1;
+        Clock::time_point due;
+        for (NetemLink* link : {&toServer, &toClient}) {
+            if (!link->next_due(due)) continue;
+            auto wait = std::chrono::duration_cast<std::chrono::microseconds>(due - Clock::now()).count();
+            int ms = wait > 0 ? int((wait + 999) / 1000) : 0;
+            timeout = timeout < 0 ? ms : std::min(timeout, ms);
+        }
+        if (poll(fds, 2, timeout) > 0) {
+            auto now = Clock::now();
+            if (fds[0].revents & POLLIN) {
+                clientLen = sizeof(client);
+                ssize_t n = recvfrom(front, buf, sizeof(buf), 0, (sockaddr*)&client, &clientLen);
+                if (n > 0) toServer.submit(buf, n, now);
+            }
+            if (fds[1].revents & POLLIN) {
+                ssize_t n = recv(back, buf, sizeof(buf), 0);
+                if (n > 0) toClient.submit(buf, n, now);
+            }
+        }
+
+        auto now = Clock::now();
+        while (toServer.pop_due(now, pkt)) send(back, pkt.data(), pkt.size(), 0);
+        while (toClient.pop_due(now, pkt)) {
+            if (clientLen > 0) sendto(front, pkt.data(), pkt.size(), 0, (sockaddr*)&client, clientLen);
+        }
+
+        if (statsIntervalS > 0 && now >= nextStats) {
+            print_link_stats("up", toServer.stats());
+            print_link_stats("down", toClient.stats());
+            nextStats = now + std::chrono::seconds(statsIntervalS);
+        }
+    }
+}
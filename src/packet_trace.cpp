@@ -0,0 +1,85 @@
+#include "packet_trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+PacketTrace::PacketTrace(size_t capacity) {
+    size_t cap = 1;
+    while (cap < capacity) cap <<= 1;
+    slots.resize(cap);
+    mask = cap - 1;
+}
+
+PacketTrace::~PacketTrace() { close(); }
+
+bool PacketTrace::open(const std::string& path) {
+    close();
+    file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+
+    TraceFileHeader header{};
+    memcpy(header.magic, "MYTCPTR1", sizeof(header.magic));
+    header.version = VERSION;
+    header.record_size = sizeof(TraceRecord);
+    header.wall_time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::system_clock::now().time_since_epoch())
+                              .count();
+    fwrite(&header, sizeof(header), 1, file);
+
+    lost.store(0, std::memory_order_relaxed);
+    running.store(true);
+    writer = std::thread(&PacketTrace::writer_loop, this);
+    return true;
+}
+
+void PacketTrace::close() {
+    if (!file) return;
+    running.store(false);
+    if (writer.joinable()) writer.join();
+    drain();
+
+    uint64_t n = lost.load(std::memory_order_relaxed);
+    if (n > 0) {
+        TraceRecord r{};
+        r.type = TRACE_RECORDS_LOST;
+        r.a = uint32_t(n);
+        r.b = uint32_t(n >> 32);
+        fwrite(&r, sizeof(r), 1, file);
+    }
+    fclose(file);
+    file = nullptr;
+}
+
+void PacketTrace::drain() {
+    // 已提交的记录在环里是连续的一段 (最多绕回一次)，直接从槽位写出
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t t = tail.load(std::memory_order_acquire);
+    while (h != t) {
+        size_t off = h & mask;
+        size_t n = std::min(t - h, slots.size() - off);
+        fwrite(&slots[off], sizeof(TraceRecord), n, file);
+        h += n;
+        head.store(h, std::memory_order_release);
+    }
+}
+
+void PacketTrace::writer_loop() {
+    while (running.load()) {
+        drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+bool read_trace_file(const std::string& path, TraceFileHeader& header, std::vector<TraceRecord>& records) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+    if (memcmp(header.magic, "MYTCPTR1", sizeof(header.magic)) != 0 || header.record_size != sizeof(TraceRecord)) {
+        return false;
+    }
+    records.clear();
+    TraceRecord r;
+    while (in.read(reinterpret_cast<char*>(&r), sizeof(r))) records.push_back(r);
+    return true;
+}
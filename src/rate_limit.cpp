@@ -0,0 +1,135 @@
+#include "rate_limit.h"
+
+#include <algorithm>
+
+namespace {
+std::chrono::microseconds bytes_to_wait(double bytes, uint64_t rate) {
+    // 向上取整，按它睡醒时令牌一定够了
+    return std::chrono::microseconds(int64_t(bytes * 1e6 / rate) + 1);
+}
+}  // namespace
+
+RateLimiter::RateLimiter(uint64_t rate, size_t burst) { set_rate(rate, burst); }
+
+void RateLimiter::set_rate(uint64_t rate, size_t burst) {
+    std::lock_guard<std::mutex> lock(mutex);
+    rate_bps = rate;
+    if (burst == 0) burst = std::max<size_t>(BURST_MIN, rate * DEFAULT_BURST_US / 1000000);
+    burst_bytes = double(burst);
+    tokens = std::min(tokens, burst_bytes);
+}
+
+uint64_t RateLimiter::rate() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return rate_bps;
+}
+
+uint64_t RateLimiter::granted_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return granted;
+}
+
+int RateLimiter::add_flow(unsigned weight) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // 复用注销过的位置
+    size_t id = 0;
+    while (id < flows.size() && flows[id].registered) ++id;
+    if (id == flows.size()) flows.emplace_back();
+    flows[id] = Flow();
+    flows[id].registered = true;
+    flows[id].weight = std::max(1u, weight);
+    return int(id);
+}
+
+void RateLimiter::remove_flow(int flow) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (flow >= 0 && size_t(flow) < flows.size()) flows[flow] = Flow();
+}
+
+void RateLimiter::set_weight(int flow, unsigned weight) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (flow >= 0 && size_t(flow) < flows.size()) flows[flow].weight = std::max(1u, weight);
+}
+
+double RateLimiter::tokens_at(std::chrono::steady_clock::time_point t) const {
+    if (!started) return burst_bytes;
+    if (t <= refilled) return tokens;
+    double elapsed = std::chrono::duration<double>(t - refilled).count();
+    return std::min(burst_bytes, tokens + elapsed * double(rate_bps));
+}
+
+void RateLimiter::expire_idle(std::chrono::steady_clock::time_point t) {
+    for (Flow& f : flows) {
+        if (f.active && t - f.last_seen > std::chrono::microseconds(IDLE_US)) {
+            f.active = false;
+            f.deficit = 0;
+        }
+    }
+}
+
+bool RateLimiter::others_pending(int flow, size_t& their_deficit) const {
+    their_deficit = 0;
+    for (size_t i = 0; i < flows.size(); ++i) {
+        const Flow& g = flows[i];
+        if (int(i) == flow || !g.active || g.deficit < g.want) continue;
+        their_deficit += g.deficit;
+    }
+    return their_deficit > 0;
+}
+
+std::chrono::microseconds RateLimiter::wait_for(int flow, size_t n, std::chrono::steady_clock::time_point t) const {
+    std::chrono::microseconds wait(0);
+    double have = tokens_at(t);
+    if (have < double(n)) wait = bytes_to_wait(double(n) - have, rate_bps);
+
+    bool valid = flow >= 0 && size_t(flow) < flows.size();
+    size_t theirs = 0;
+    if (valid && flows[flow].deficit < n && others_pending(flow, theirs)) {
+        // 本轮轮到别的流：等它们把额度用完，最多等到它们被当成空闲
+        auto drain = std::min(bytes_to_wait(double(theirs), rate_bps), std::chrono::microseconds(IDLE_US));
+        wait = std::max(wait, drain);
+    }
+    return wait;
+}
+
+std::chrono::microseconds RateLimiter::acquire(int flow, size_t n, std::chrono::steady_clock::time_point t) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (rate_bps == 0) {
+        granted += n;
+        return std::chrono::microseconds(0);
+    }
+    tokens = tokens_at(t);
+    refilled = std::max(refilled, t);
+    started = true;
+    expire_idle(t);
+
+    bool valid = flow >= 0 && size_t(flow) < flows.size() && flows[flow].registered;
+    if (valid) {
+        Flow& f = flows[flow];
+        f.active = true;
+        f.last_seen = t;
+        f.want = n;
+        if (f.deficit < n) {
+            size_t theirs = 0;
+            if (others_pending(flow, theirs)) return wait_for(flow, n, t);
+            // 所有活跃的流都用完了本轮的额度：开始新一轮
+            while (f.deficit < n) {
+                for (Flow& g : flows) {
+                    if (g.active) g.deficit += g.weight * QUANTUM;
+                }
+            }
+        }
+    }
+    if (tokens < double(n)) return wait_for(flow, n, t);
+
+    tokens -= double(n);
+    if (valid) flows[flow].deficit -= n;
+    granted += n;
+    return std::chrono::microseconds(0);
+}
+
+std::chrono::microseconds RateLimiter::delay(int flow, size_t n, std::chrono::steady_clock::time_point t) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (rate_bps == 0) return std::chrono::microseconds(0);
+    return wait_for(flow, n, t);
+}
@@ -0,0 +1,62 @@
+#include "reassembly_buffer.h"
+
+#include <algorithm>
+#include <iterator>
+
+bool ReassemblyBuffer::insert(uint64_t offset, const char* p, size_t n, bool fin) {
+    // 超出放给对端的额度 (或偏移溢出)：合规的对端不会这样发
+    uint64_t end = offset + n;
+    if (end > limit || end < offset) return false;
+    // 流的结尾只认第一个 FIN：之后的 FIN 必须落在同一位置，数据也不能越过它；
+    // 第一个 FIN 也不能落在已经收到的数据之前
+    if (fin_offset != UINT64_MAX) {
+        if (end > fin_offset || (fin && end != fin_offset)) return false;
+    } else if (fin) {
+        uint64_t received = pending.empty() ? next : pending.rbegin()->first + pending.rbegin()->second.size();
+        if (end < received) return false;
+        fin_offset = end;
+    }
+    if (end <= next) return true;  // 重复数据
+
+    if (offset > next) {
+        // 前面还有空洞：先存起来，只存已有的乱序块之间还缺的部分，
+        // 乱序块互不重叠，重叠的重复帧再多也不会让缓存超过 limit - next
+        uint64_t lo = offset, hi = offset + n;
+        auto it = pending.upper_bound(lo);
+        if (it != pending.begin()) lo = std::max(lo, std::prev(it)->first + std::prev(it)->second.size());
+        while (lo < hi) {
+            uint64_t gap_end = it == pending.end() ? hi : std::min(hi, it->first);
+            if (gap_end > lo) pending.emplace_hint(it, lo, std::vector<char>(p + (lo - offset), p + (gap_end - offset)));
+            if (it == pending.end()) break;
+            lo = std::max(lo, it->first + it->second.size());
+            ++it;
+        }
+        return true;
+    }
+
+    size_t skip = next - offset;
+    ready.insert(ready.end(), p + skip, p + n);
+    next = offset + n;
+
+    // 看看提前到达的数据能不能接上
+    auto it = pending.begin();
+    while (it != pending.end() && it->first <= next) {
+        uint64_t end = it->first + it->second.size();
+        if (end > next) {
+            ready.insert(ready.end(), it->second.begin() + (next - it->first), it->second.end());
+            next = end;
+        }
+        it = pending.erase(it);
+    }
+    return true;
+}
+
+size_t ReassemblyBuffer::read(void* buffer, size_t maxLen) {
+    if (ready.empty()) return finished() ? -1 : 0;
+
+    size_t n = std::min(maxLen, ready.size());
+    std::copy(ready.begin(), ready.begin() + n, static_cast<char*>(buffer));
+    ready.erase(ready.begin(), ready.begin() + n);
+    consumed += n;
+    return n;
+}
@@ -0,0 +1,128 @@
+#include "receive_ring.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// 第一次放数据时的存储大小，之后按需翻倍
+const size_t INITIAL_CAPACITY = 64 * 1024;
+}  // namespace
+
+void ReceiveRing::reset(uint32_t seq) {
+    std::vector<char>().swap(buf);
+    mask = 0;
+    read_seq = next_seq = seq;
+    ranges.clear();
+    ooo = 0;
+}
+
+int ReceiveRing::insert(uint32_t seq, const char* p, uint32_t n) {
+    // 裁掉已经按序收到的部分
+    if (int32_t(seq + n - next_seq) <= 0) return 0;
+    if (int32_t(seq - next_seq) < 0) {
+        uint32_t skip = next_seq - seq;
+        if (p) p += skip;
+        seq += skip;
+        n -= skip;
+    }
+    uint32_t lo = offset(seq), hi = lo + n;
+
+    // 快速路径：正好接在按序数据后面，也接不上任何乱序块
+    if (lo == 0 && (ranges.empty() || offset(ranges.front().left) > hi)) {
+        if (p) {
+            ensure(seq + n);
+            copy_in(seq, p, n);
+        }
+        next_seq += n;
+        return int(n);
+    }
+
+    // 和 [lo, hi] 重叠或相邻的块是 [first, last)
+    auto first = std::lower_bound(ranges.begin(), ranges.end(), lo,
+                                  [this](const Range& r, uint32_t o) { return offset(r.right) < o; });
+    auto last = std::upper_bound(first, ranges.end(), hi,
+                                 [this](uint32_t o, const Range& r) { return o < offset(r.left); });
+    uint32_t covered = 0;
+    for (auto it = first; it != last; ++it) {
+        uint32_t l = std::max(lo, offset(it->left)), r = std::min(hi, offset(it->right));
+        if (r > l) covered += r - l;
+    }
+    uint32_t added = n - covered;
+    if (added == 0) return 0;
+    if (first == last && ranges.size() >= MAX_RANGES) return -1;
+
+    if (p) {
+        ensure(seq + n);
+        copy_in(seq, p, n);
+    }
+    if (first == last) {
+        ranges.insert(first, Range{seq, seq + n});
+    } else {
+        Range merged{next_seq + std::min(lo, offset(first->left)), next_seq + std::max(hi, offset((last - 1)->right))};
+        *first = merged;
+        ranges.erase(first + 1, last);
+    }
+    ooo += added;
+
+    // 空洞补上了：第一个块并入按序数据
+    if (offset(ranges.front().left) == 0) {
+        ooo -= ranges.front().right - ranges.front().left;
+        next_seq = ranges.front().right;
+        ranges.erase(ranges.begin());
+    }
+    return int(added);
+}
+
+size_t ReceiveRing::read(void* out, size_t len) {
+    size_t n = std::min(len, readable());
+    copy_out(read_seq, static_cast<char*>(out), n);
+    read_seq += uint32_t(n);
+    return n;
+}
+
+bool ReceiveRing::block(uint32_t seq, uint32_t& left, uint32_t& right) const {
+    uint32_t o = offset(seq);
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), o,
+                               [this](uint32_t x, const Range& r) { return x < offset(r.right); });
+    if (it == ranges.end() || offset(it->left) > o) return false;
+    left = it->left;
+    right = it->right;
+    return true;
+}
+
+void ReceiveRing::ensure(uint32_t end) {
+    size_t span = uint32_t(end - read_seq);
+    if (span <= buf.size()) return;
+
+    size_t cap = std::max(buf.size() * 2, INITIAL_CAPACITY);
+    while (cap < span) cap <<= 1;
+    std::vector<char> grown(cap);
+    // 已有的数据 (含乱序块之间的空洞，内容无所谓) 搬到新存储里对应的位置
+    uint32_t stored_end = ranges.empty() ? next_seq : ranges.back().right;
+    uint32_t pos = read_seq;
+    size_t left = buf.empty() ? 0 : uint32_t(stored_end - read_seq);
+    while (left > 0) {
+        size_t from = pos & mask, to = pos & (cap - 1);
+        size_t chunk = std::min({left, buf.size() - from, cap - to});
+        memcpy(grown.data() + to, buf.data() + from, chunk);
+        pos += uint32_t(chunk);
+        left -= chunk;
+    }
+    buf.swap(grown);
+    mask = uint32_t(cap - 1);
+}
+
+void ReceiveRing::copy_in(uint32_t seq, const char* src, size_t n) {
+    size_t off = seq & mask;
+    size_t first = std::min(n, buf.size() - off);
+    memcpy(buf.data() + off, src, first);
+    memcpy(buf.data(), src + first, n - first);
+}
+
+void ReceiveRing::copy_out(uint32_t seq, char* dst, size_t n) const {
+    if (n == 0) return;
+    size_t off = seq & mask;
+    size_t first = std::min(n, buf.size() - off);
+    memcpy(dst, buf.data() + off, first);
+    memcpy(dst + first, buf.data(), n - first);
+}
@@ -0,0 +1,257 @@
+#include "sim_network.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "memory_budget.h"
+#include "net_env.h"
+
+namespace {
+
+using Clock = NetEnv::Clock;
+
+const int BASE_PORT = 10000;                                  // 主机 i 的端口为 BASE_PORT + i
+const size_t SEGMENT = MAX_PACKET_SIZE - sizeof(TCPHeader);  // 客户端每次 send() 的字节数
+const size_t LINK_TAG = 4;                                   // 链路上的包前面加上 源主机号 + 目的主机号
+
+class SimNetwork;
+
+// 模拟网络里的一个主机，一条 TCPConnection 通过它收发包
+class SimHost : public NetEnv {
+public:
+    SimHost(SimNetwork& n, uint16_t hostId);
+
+    Clock::time_point now() const override;
+    int send_to(const void* data, int len, const Endpoint& target) override;
+    int recv_from(void* buffer, int max_len, Endpoint& src) override;
+
+    const char* ip() const { return id % 2 == 0 ? "10.0.0.1" : "10.0.0.2"; }
+    int port() const { return BASE_PORT + id; }
+    // 链路送达的包 (带 LINK_TAG 前缀，取出时再去掉)
+    void deliver(std::vector<char> pkt) { inbox.push_back(std::move(pkt)); }
+
+private:
+    SimNetwork& net;
+    uint16_t id;
+    Endpoint addr;
+    std::deque<std::vector<char>> inbox;
+};
+
+// 虚拟时钟 + 主机 + 两条链路；偶数号主机是客户端，发出的包走上行链路，奇数号是服务端，走下行链路
+class SimNetwork {
+public:
+    explicit SimNetwork(const SimScenario& sc)
+        : up(sc.up, sc.seed), down(sc.down, sc.seed ^ 0x9e3779b97f4a7c15ULL) {}
+
+    SimHost& add_host() {
+        hosts.push_back(std::make_unique<SimHost>(*this, uint16_t(hosts.size())));
+        return *hosts.back();
+    }
+    const Endpoint& address_of(uint16_t id) const { return addresses[id]; }
+    void register_address(const Endpoint& addr) { addresses.push_back(addr); }
+
+    void transmit(uint16_t from, const Endpoint& to, const void* data, int len) {
+        int dst = to.port() - BASE_PORT;
+        if (dst < 0 || dst >= int(hosts.size()) || len < 0) return;
+        frame.resize(LINK_TAG + len);
+        uint16_t tag[2] = {from, uint16_t(dst)};
+        memcpy(frame.data(), tag, LINK_TAG);
+        memcpy(frame.data() + LINK_TAG, data, len);
+        (from % 2 == 0 ? up : down).submit(frame.data(), frame.size(), now);
+    }
+
+    // 把到期的包放进目的主机的收件箱
+    void deliver_due() {
+        for (NetemLink* link : {&up, &down}) {
+            while (link->pop_due(now, pkt)) {
+                uint16_t tag[2];
+                memcpy(tag, pkt.data(), LINK_TAG);
+                if (tag[1] < hosts.size()) hosts[tag[1]]->deliver(std::move(pkt));
+                pkt = std::vector<char>();
+            }
+        }
+    }
+
+    // 虚拟时钟从一个远离 0 的时刻开始：连接里默认构造的 time_point 表示 "很久以前"，和真实的 steady_clock 一样
+    const Clock::time_point epoch = Clock::time_point(std::chrono::hours(1));
+    Clock::time_point now = epoch;
+    NetemLink up, down;
+
+private:
+    std::vector<std::unique_ptr<SimHost>> hosts;
+    std::vector<Endpoint> addresses;
+    std::vector<char> frame, pkt;
+};
+
+SimHost::SimHost(SimNetwork& n, uint16_t hostId) : net(n), id(hostId) {
+    Endpoint::resolve(ip(), port(), addr);
+    net.register_address(addr);
+}
+
+Clock::time_point SimHost::now() const { return net.now; }
+
+int SimHost::send_to(const void* data, int len, const Endpoint& target) {
+    net.transmit(id, target, data, len);
+    return len;
+}
+
+int SimHost::recv_from(void* buffer, int max_len, Endpoint& src) {
+    if (inbox.empty()) return -1;
+    std::vector<char>& pkt = inbox.front();
+    uint16_t tag[2];
+    memcpy(tag, pkt.data(), LINK_TAG);
+    int len = std::min<int>(max_len, int(pkt.size() - LINK_TAG));
+    memcpy(buffer, pkt.data() + LINK_TAG, len);
+    src = net.address_of(tag[0]);
+    inbox.pop_front();
+    return len;
+}
+
+double seconds(Clock::duration d) { return std::chrono::duration<double>(d).count(); }
+
+struct FlowState {
+    SimHost* clientHost = nullptr;
+    SimHost* serverHost = nullptr;
+    std::unique_ptr<TCPConnection> client, server;
+    Clock::time_point start, finish;
+    size_t bytes = 0;
+    size_t sent = 0;
+    size_t received = 0;
+    bool started = false;
+    bool done = false;
+};
+
+}  // namespace
+
+SimResult run_simulation(const SimScenario& sc) {
+    auto wallStart = std::chrono::steady_clock::now();
+    SimNetwork net(sc);
+    MemoryBudget budget;  // 每个场景独立的预算，同一进程里并发的其他场景不会影响它
+    RateLimiter shared(sc.shared_rate_limit);  // 比连接活得久 (连接析构时注销)
+    std::vector<FlowState> flows(sc.flows.size());
+    for (size_t i = 0; i < flows.size(); ++i) {
+        FlowState& f = flows[i];
+        f.clientHost = &net.add_host();
+        f.serverHost = &net.add_host();
+        f.start = net.epoch + std::chrono::microseconds((long long)(sc.flows[i].start_ms * 1000));
+        f.bytes = sc.flows[i].bytes;
+        f.client = std::make_unique<TCPConnection>();
+        f.server = std::make_unique<TCPConnection>();
+        f.client->set_env(f.clientHost);
+        f.server->set_env(f.serverHost);
+        f.client->set_memory_budget(budget);
+        f.server->set_memory_budget(budget);
+        if (sc.flows[i].rate_limit > 0) f.client->set_rate_limit(sc.flows[i].rate_limit);
+        if (sc.shared_rate_limit > 0) f.client->set_shared_rate_limit(&shared, sc.flows[i].weight);
+    }
+
+    SimResult res;
+    std::vector<char> chunk(SEGMENT, 'x');
+    std::vector<char> buf(64 * 1024);
+    auto tick = std::chrono::microseconds((long long)(std::max(0.001, sc.tick_ms) * 1000));
+    auto limit = net.epoch + std::chrono::microseconds((long long)(sc.time_limit_s * 1e6));
+    size_t remaining = flows.size();
+    double queueWeighted = 0, activeTime = 0;
+
+    while (remaining > 0 && net.now < limit) {
+        net.deliver_due();
+
+        bool active = false;
+        for (FlowState& f : flows) {
+            if (f.done) continue;
+            if (!f.started) {
+                if (net.now < f.start) continue;
+                f.server->bind(f.serverHost->port());
+                f.client->connect(f.serverHost->ip(), f.serverHost->port());
+                f.started = true;
+            }
+            active = true;
+
+            f.client->update();
+            if (f.client->get_state() == ESTABLISHED) {
+                while (f.sent < f.bytes) {
+                    size_t n = std::min(SEGMENT, f.bytes - f.sent);
+                    if (!f.client->send(chunk.data(), n)) break;
+                    f.sent += n;
+                }
+            }
+            f.server->update();
+            size_t n;
+            while ((n = f.server->receive(buf.data(), buf.size())) > 0 && n != size_t(-1)) f.received += n;
+            if (f.received >= f.bytes) {
+                f.done = true;
+                f.finish = net.now;
+                --remaining;
+            }
+        }
+        ++res.steps;
+
+        // 下一个时刻：最早到期的包，否则前进一个 tick；没有流在传、链路也空着时直接跳到下一条流开始
+        Clock::time_point next = net.now + tick;
+        Clock::time_point due;
+        bool inFlight = false;
+        for (NetemLink* link : {&net.up, &net.down}) {
+            if (!link->next_due(due)) continue;
+            inFlight = true;
+            next = std::min(next, std::max(due, net.now));
+        }
+        // 被发送节奏或限速挡住的流在它可以发下一个段时醒来
+        for (FlowState& f : flows) {
+            if (!f.started || f.done || f.sent >= f.bytes) continue;
+            auto pace = f.client->pacing_delay();
+            if (pace.count() > 0) next = std::min(next, net.now + pace);
+        }
+        Clock::time_point nextStart = Clock::time_point::max();
+        for (FlowState& f : flows) {
+            if (!f.started) nextStart = std::min(nextStart, f.start);
+        }
+        next = (active || inFlight) ? std::min(next, nextStart) : nextStart;
+
+        if (active) {
+            double dt = seconds(next - net.now);
+            double queueMs = seconds(net.up.backlog(net.now)) * 1000;
+            queueWeighted += queueMs * dt;
+            activeTime += dt;
+            res.max_queue_ms = std::max(res.max_queue_ms, queueMs);
+        }
+        net.now = next;
+    }
+
+    res.sim_time_s = seconds(net.now - net.epoch);
+    res.completed = remaining == 0;
+    res.avg_queue_ms = activeTime > 0 ? queueWeighted / activeTime : 0;
+    res.up = net.up.stats();
+    res.down = net.down.stats();
+
+    Clock::time_point first = net.now, last = net.epoch;
+    size_t total = 0;
+    double sum = 0, sumSq = 0;
+    for (FlowState& f : flows) {
+        SimFlowResult r;
+        r.completed = f.done;
+        r.start_s = seconds(f.start - net.epoch);
+        Clock::time_point end = f.done ? f.finish : net.now;
+        r.finish_s = seconds(end - net.epoch);
+        r.bytes = f.received;
+        double dur = seconds(end - f.start);
+        r.throughput_MBps = dur > 0 ? f.received / dur / (1024 * 1024) : 0;
+        r.send = f.client->send_stats();
+        res.flows.push_back(r);
+
+        first = std::min(first, f.start);
+        last = std::max(last, end);
+        total += f.received;
+        sum += r.throughput_MBps;
+        sumSq += r.throughput_MBps * r.throughput_MBps;
+    }
+    double span = seconds(last - first);
+    res.goodput_MBps = span > 0 ? total / span / (1024 * 1024) : 0;
+    res.fairness = sumSq > 0 ? sum * sum / (flows.size() * sumSq) : 0;
+    res.wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    return res;
+}
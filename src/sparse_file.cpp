@@ -0,0 +1,156 @@
+#include "sparse_file.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// 每次从数据区读多少字节 (SPARSE_BLOCK 的整数倍)
+const size_t SPARSE_READ_SIZE = 64 * 1024;
+
+bool is_zero_block(const char* p, size_t n) {
+    size_t i = 0;
+#ifdef __SSE2__
+    // 4 个 16 字节向量先 OR 起来再和 0 比较，每 64 字节只有一次分支
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 64 <= n; i += 64) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + 16));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + 32));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + 48));
+        __m128i v = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) != 0xFFFF) return false;
+    }
+#endif
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        if (w != 0) return false;
+    }
+    for (; i < n; ++i) {
+        if (p[i] != 0) return false;
+    }
+    return true;
+}
+
+// ---------------- SparseFileReader ----------------
+
+SparseFileReader::~SparseFileReader() {
+    if (fd >= 0) ::close(fd);
+}
+
+bool SparseFileReader::open(const std::string& path) {
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) return false;
+    fileSize = st.st_size;
+    pos = dataEnd = 0;
+    bufStart = 0;
+    bufLen = 0;
+    buf.resize(SPARSE_READ_SIZE);
+    return true;
+}
+
+long long SparseFileReader::seek_data(long long from) {
+#ifdef SEEK_DATA
+    off_t data = lseek(fd, from, SEEK_DATA);
+    if (data < 0) {
+        // ENXIO: 后面全是空洞；其它错误 (文件系统不支持) 按整个文件都是数据处理
+        dataEnd = fileSize;
+        return errno == ENXIO ? fileSize : from;
+    }
+    off_t hole = lseek(fd, data, SEEK_HOLE);
+    dataEnd = hole < 0 ? fileSize : std::min<long long>(hole, fileSize);
+    return std::min<long long>(data, fileSize);
+#else
+    dataEnd = fileSize;
+    return from;
+#endif
+}
+
+size_t SparseFileReader::fill(long long off) {
+    if (off >= bufStart && off < bufStart + (long long)bufLen) return bufStart + bufLen - off;
+    size_t want = std::min<long long>(buf.size(), dataEnd - off);
+    ssize_t got = pread(fd, buf.data(), want, off);
+    bufStart = off;
+    bufLen = got > 0 ? got : 0;
+    return bufLen;
+}
+
+bool SparseFileReader::next(Extent& out) {
+    if (fd < 0 || pos >= fileSize) return false;
+
+    // 1. 文件系统里的空洞
+    if (pos >= dataEnd) {
+        long long data = seek_data(pos);
+        if (data > pos) {
+            out = Extent{true, data - pos, nullptr};
+            pos = data;
+            return true;
+        }
+    }
+
+    // 2. 数据区开头的全零块 (合并到下一个非零块或数据区结束为止)
+    long long zeros = 0;
+    while (pos + zeros < dataEnd) {
+        size_t avail = fill(pos + zeros);
+        if (avail == 0) {
+            // 文件在读取过程中被截短：剩下的部分按空洞补齐，保证对端收到的长度与声明的一致
+            zeros = dataEnd - pos;
+            break;
+        }
+        size_t n = std::min(avail, SPARSE_BLOCK);
+        if (!is_zero_block(buf.data() + (pos + zeros - bufStart), n)) break;
+        zeros += n;
+    }
+    if (zeros > 0) {
+        out = Extent{true, zeros, nullptr};
+        pos += zeros;
+        return true;
+    }
+
+    // 3. 非零数据：到缓冲区末尾或下一个全零块为止
+    size_t avail = fill(pos);
+    const char* start = buf.data() + (pos - bufStart);
+    size_t len = std::min(avail, SPARSE_BLOCK);
+    while (len < avail) {
+        size_t n = std::min(avail - len, SPARSE_BLOCK);
+        if (is_zero_block(start + len, n)) break;
+        len += n;
+    }
+    out = Extent{false, (long long)len, start};
+    pos += len;
+    return true;
+}
+
+// ---------------- 接收端 ----------------
+
+bool parse_hole_length(std::string_view payload, long long& len) {
+    try {
+        len = std::stoll(std::string(payload));
+    } catch (...) {
+        return false;
+    }
+    return len > 0;
+}
+
+void skip_hole(std::ofstream& out, long long len) { out.seekp(len, std::ios::cur); }
+
+bool finish_sparse_file(const std::string& path, long long size) {
+    std::error_code ec;
+    auto current = std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    if ((long long)current < size) std::filesystem::resize_file(path, size, ec);  // ftruncate，不占磁盘块
+    return !ec;
+}
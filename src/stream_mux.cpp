@@ -0,0 +1,276 @@
+#include "stream_mux.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "app_framing.h"  // store_be64 / load_be64
+#include "tcp_socket.h"   // htonl / ntohl
+
+namespace {
+// 一个段能装下的字节数 (帧头 + 负载)
+const size_t MUX_SEGMENT_SIZE = MAX_PACKET_SIZE - sizeof(TCPHeader);
+// 段里剩余的负载空间比这还小、而这条流还有更多数据时，先把当前段发出去
+const size_t MIN_FRAME_PAYLOAD = 64;
+// DRR 每轮每单位权重的额度：一个段的负载
+const size_t MUX_QUANTUM = MUX_SEGMENT_SIZE - sizeof(StreamFrameHeader);
+
+void encode_frame_header(char* dst, uint8_t type, uint8_t flags, uint32_t id, uint64_t offset, uint16_t length) {
+    StreamFrameHeader hdr;
+    hdr.type = type;
+    hdr.flags = flags;
+    hdr.stream_id = htonl(id);
+    store_be64(reinterpret_cast<char*>(&hdr.offset), offset);
+    hdr.length = htons(length);
+    memcpy(dst, &hdr, sizeof(hdr));
+}
+
+void decode_frame_header(const char* src, uint8_t& type, uint8_t& flags, uint32_t& id, uint64_t& offset,
+                         uint16_t& length) {
+    StreamFrameHeader hdr;
+    memcpy(&hdr, src, sizeof(hdr));
+    type = hdr.type;
+    flags = hdr.flags;
+    id = ntohl(hdr.stream_id);
+    offset = load_be64(reinterpret_cast<const char*>(&hdr.offset));
+    length = ntohs(hdr.length);
+}
+}  // namespace
+
+StreamMux::StreamMux(TCPConnection& c, bool is_server)
+    : conn(c), server(is_server), next_local_id(is_server ? 2 : 1), seg(MUX_SEGMENT_SIZE) {
+    conn.set_segment_handler([this](const char* data, size_t len) { on_segment(data, len); });
+}
+
+StreamMux::~StreamMux() { conn.set_segment_handler(nullptr); }
+
+uint32_t StreamMux::open_stream() {
+    if (open_local >= MAX_OPEN_STREAMS) return 0;
+    ++open_local;
+    uint32_t id = next_local_id;
+    next_local_id += 2;
+    streams[id];
+    return id;
+}
+
+bool StreamMux::accept(uint32_t& id) {
+    if (accept_queue.empty()) return false;
+    id = accept_queue.front();
+    accept_queue.pop_front();
+    return true;
+}
+
+size_t StreamMux::write(uint32_t id, const void* data, size_t len) {
+    auto it = streams.find(id);
+    if (it == streams.end() || it->second.fin_pending) return 0;
+    Stream& s = it->second;
+    size_t n = std::min(len, STREAM_SEND_BUFFER - std::min(STREAM_SEND_BUFFER, s.tx.size()));
+    const char* p = static_cast<const char*>(data);
+    s.tx.insert(s.tx.end(), p, p + n);
+    return n;
+}
+
+void StreamMux::finish(uint32_t id) {
+    auto it = streams.find(id);
+    if (it != streams.end()) it->second.fin_pending = true;
+}
+
+size_t StreamMux::read(uint32_t id, void* buffer, size_t maxLen) {
+    auto it = streams.find(id);
+    if (it == streams.end()) return -1;  // 已退役
+    Stream& s = it->second;
+
+    size_t n = s.rx.read(buffer, maxLen);
+    if (n == (size_t)-1) {
+        retire_if_done(id);
+        return n;
+    }
+    // 应用读走了半个窗口以上就给对端放额度 (对端已经 FIN 的流不需要了)
+    if (n > 0 && !s.credit_queued && s.rx.credit_due()) {
+        s.credit_queued = true;
+        credit_queue.push_back(id);
+    }
+    return n;
+}
+
+void StreamMux::update() {
+    conn.update();
+    schedule();
+}
+
+void StreamMux::set_weight(uint32_t id, unsigned weight) {
+    auto it = streams.find(id);
+    if (it != streams.end()) it->second.weight = std::max(1u, weight);
+}
+
+size_t StreamMux::pending(uint32_t id) const {
+    auto it = streams.find(id);
+    return it == streams.end() ? 0 : it->second.tx.size();
+}
+
+bool StreamMux::idle() const {
+    if (seg_used > 0 || !credit_queue.empty()) return false;
+    for (const auto& kv : streams) {
+        const Stream& s = kv.second;
+        if (!s.tx.empty() || (s.fin_pending && !s.fin_sent)) return false;
+    }
+    return conn.is_send_complete();
+}
+
+// ---------------- 接收 ----------------
+
+void StreamMux::on_segment(const char* data, size_t len) {
+    while (len >= sizeof(StreamFrameHeader)) {
+        uint8_t type, flags;
+        uint32_t id;
+        uint64_t offset;
+        uint16_t length;
+        decode_frame_header(data, type, flags, id, offset, length);
+        data += sizeof(StreamFrameHeader);
+        len -= sizeof(StreamFrameHeader);
+        if (length > len) break;  // 帧不完整，段已损坏
+
+        if (type == STREAM_FRAME_DATA) {
+            // 超出本端放给对端的额度的数据由 ReassemblyBuffer 丢弃 (否则对端可以让一条流缓存任意多的数据)
+            if (Stream* s = lookup_for_frame(id)) s->rx.insert(offset, data, length, flags & STREAM_FLAG_FIN);
+        } else if (type == STREAM_FRAME_MAX_DATA) {
+            auto it = streams.find(id);
+            if (it != streams.end()) it->second.tx_limit = std::max(it->second.tx_limit, offset);
+        }
+        data += length;
+        len -= length;
+    }
+}
+
+StreamMux::Stream* StreamMux::lookup_for_frame(uint32_t id) {
+    auto it = streams.find(id);
+    if (it != streams.end()) return &it->second;
+
+    // 只有对端发起的、比以前见过的都大的 ID 才是新流；
+    // 段是无序交付的，流 5 的数据可能比流 3 先到，所以中间的 ID 一并打开 (同 QUIC)
+    bool peer_initiated = (id & 1) == (server ? 1u : 0u);
+    if (!peer_initiated || id == 0 || id <= max_peer_id) return nullptr;
+
+    // 超出对端可以同时打开的流数：丢弃这个帧 (合规的对端不会这样发)
+    uint64_t first = max_peer_id ? uint64_t(max_peer_id) + 2 : (server ? 1 : 2);
+    uint64_t opened = (uint64_t(id) - first) / 2 + 1;
+    if (open_peer + opened > MAX_OPEN_STREAMS) return nullptr;
+
+    for (uint64_t k = first; k <= id; k += 2) {
+        streams[uint32_t(k)];
+        accept_queue.push_back(uint32_t(k));
+    }
+    open_peer += uint32_t(opened);
+    max_peer_id = id;
+    return &streams[id];
+}
+
+void StreamMux::retire_if_done(uint32_t id) {
+    auto it = streams.find(id);
+    if (it == streams.end()) return;
+    const Stream& s = it->second;
+    if (s.fin_sent && s.tx.empty() && s.rx.finished()) {
+        bool peer_initiated = (id & 1) == (server ? 1u : 0u);
+        --(peer_initiated ? open_peer : open_local);
+        streams.erase(it);
+    }
+}
+
+// ---------------- 发送调度 ----------------
+
+bool StreamMux::append_frame(uint8_t type, uint8_t flags, uint32_t id, uint64_t offset, const char* p, size_t n) {
+    if (seg_used + sizeof(StreamFrameHeader) + n > MUX_SEGMENT_SIZE) return false;
+    encode_frame_header(seg.data() + seg_used, type, flags, id, offset, n);
+    seg_used += sizeof(StreamFrameHeader);
+    if (n > 0) memcpy(seg.data() + seg_used, p, n);
+    seg_used += n;
+    return true;
+}
+
+bool StreamMux::flush_segment() {
+    if (seg_used == 0) return true;
+    if (!conn.send(seg.data(), seg_used)) return false;  // 连接窗口满了，段留着下次再发
+    seg_used = 0;
+    return true;
+}
+
+void StreamMux::schedule() {
+    if (!flush_segment()) return;
+
+    std::vector<uint32_t> finished;
+    bool progress = true;
+    while (progress) {
+        progress = false;
+
+        // 1. 流控额度优先：对端可能正卡在上限上
+        while (!credit_queue.empty()) {
+            uint32_t id = credit_queue.front();
+            auto it = streams.find(id);
+            if (it != streams.end()) {
+                uint64_t limit = it->second.rx.next_limit();
+                if (!append_frame(STREAM_FRAME_MAX_DATA, 0, id, limit, nullptr, 0)) {
+                    if (!flush_segment()) return;
+                    continue;
+                }
+                it->second.rx.credit_sent(limit);
+                it->second.credit_queued = false;
+            }
+            credit_queue.pop_front();
+        }
+
+        // 2. 加权轮询 (DRR)：轮到的流先得到 weight x MUX_QUANTUM 字节的额度，在额度内连续装帧，
+        //    用完了或者没有可发的数据了就轮到下一条；没有可发数据的流额度清零，不攒到下一轮
+        auto it = streams.lower_bound(rr_next);
+        for (size_t visited = 0; visited < streams.size(); ++visited, ++it) {
+            if (it == streams.end()) it = streams.begin();
+            Stream& s = it->second;
+            while (true) {
+                size_t allowed = std::min<uint64_t>(s.tx.size(), s.tx_limit - std::min(s.tx_limit, s.tx_offset));
+                bool fin_ready = s.fin_pending && !s.fin_sent && allowed == s.tx.size();
+                if (allowed == 0 && !fin_ready) {
+                    s.deficit = 0;
+                    break;
+                }
+                if (!s.granted) {
+                    s.deficit += s.weight * MUX_QUANTUM;
+                    s.granted = true;
+                }
+                if (s.deficit == 0 && !(fin_ready && allowed == 0)) break;
+
+                size_t room = MUX_SEGMENT_SIZE - seg_used;
+                room = room > sizeof(StreamFrameHeader) ? room - sizeof(StreamFrameHeader) : 0;
+                if (room == 0 || (room < allowed && room < MIN_FRAME_PAYLOAD)) {
+                    if (!flush_segment()) {
+                        rr_next = it->first;
+                        return;
+                    }
+                    room = MUX_SEGMENT_SIZE - sizeof(StreamFrameHeader);
+                }
+
+                size_t n = std::min({allowed, room, s.deficit});
+                bool fin = fin_ready && n == s.tx.size();
+                // 直接从发送缓冲拷进段，不经过中间数组
+                encode_frame_header(seg.data() + seg_used, STREAM_FRAME_DATA, fin ? STREAM_FLAG_FIN : 0, it->first,
+                                    s.tx_offset, n);
+                seg_used += sizeof(StreamFrameHeader);
+                std::copy(s.tx.begin(), s.tx.begin() + n, seg.data() + seg_used);
+                seg_used += n;
+                s.tx.erase(s.tx.begin(), s.tx.begin() + n);
+                s.tx_offset += n;
+                s.deficit -= n;
+                progress = true;
+                if (fin) {
+                    s.fin_sent = true;
+                    finished.push_back(it->first);
+                    s.deficit = 0;
+                    break;
+                }
+            }
+            s.granted = false;
+            rr_next = it->first + 1;
+        }
+    }
+
+    // 不攒满也立即发出去：小消息的延迟比多装几个字节重要
+    flush_segment();
+    for (uint32_t id : finished) retire_if_done(id);
+}
@@ -0,0 +1,151 @@
+#include "tcp_async.h"
+
+#include <poll.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "tcp_protocol.h"
+
+namespace {
+// 单个数据段的最大负载
+const size_t ASYNC_MSS = MAX_PACKET_SIZE - sizeof(TCPHeader);
+
+std::chrono::steady_clock::time_point deadline_after(int timeout_ms) {
+    return std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+}
+}  // namespace
+
+// ---------------- Scheduler ----------------
+
+void Scheduler::spawn(Task<void> task) {
+    task.start();
+    if (!task.done()) tasks.push_back(std::move(task));
+}
+
+void Scheduler::run() {
+    while (run_once()) {
+    }
+}
+
+bool Scheduler::run_once(int timeout_ms) {
+    fast_path_budget = FAST_PATH_PER_TICK;
+
+    // 1. 推进所有连接的协议状态机 (收包、处理 ACK、重传)
+    for (AsyncTCPConnection* c : conns) c->raw().update();
+
+    // 2. 找出条件已满足的等待者 (先收集再恢复：恢复过程中协程会再次挂起、修改 waiters)
+    ready.clear();
+    for (size_t i = 0; i < waiters.size();) {
+        if (waiters[i]->try_complete()) {
+            ready.push_back(waiters[i]);
+            waiters[i] = waiters.back();
+            waiters.pop_back();
+        } else {
+            ++i;
+        }
+    }
+    for (AsyncWaiter* w : ready) w->handle.resume();
+
+    // 3. 回收已经结束的顶层任务
+    tasks.erase(std::remove_if(tasks.begin(), tasks.end(), [](const Task<void>& t) { return t.done(); }),
+                tasks.end());
+    if (tasks.empty()) return false;
+
+    // 4. 这一轮没有任何协程能继续，睡到有包到达 (或重传检查间隔到了)
+    if (ready.empty() && !conns.empty()) {
+        std::vector<pollfd> pfds;
+        pfds.reserve(conns.size());
+        // 有连接在等发送节奏 (或限速) 时只睡到它可以发下一个段
+        std::chrono::microseconds timeout = std::chrono::milliseconds(timeout_ms);
+        bool forever = timeout_ms < 0;
+        for (AsyncTCPConnection* c : conns) {
+            pfds.push_back({(int)c->raw().native_handle(), POLLIN, 0});
+            auto pace = c->raw().pacing_delay();
+            if (pace.count() > 0 && (forever || pace < timeout)) {
+                timeout = pace;
+                forever = false;
+            }
+        }
+        timespec ts{time_t(timeout.count() / 1000000), long(timeout.count() % 1000000) * 1000};
+        ppoll(pfds.data(), pfds.size(), forever ? nullptr : &ts, nullptr);
+    }
+    return true;
+}
+
+void Scheduler::suspend(AsyncWaiter* waiter, std::coroutine_handle<> h) {
+    waiter->handle = h;
+    waiters.push_back(waiter);
+}
+
+void Scheduler::attach(AsyncTCPConnection* conn) { conns.push_back(conn); }
+
+void Scheduler::detach(AsyncTCPConnection* conn) { conns.erase(std::remove(conns.begin(), conns.end(), conn), conns.end()); }
+
+// ---------------- AsyncTCPConnection ----------------
+
+AsyncTCPConnection::AsyncTCPConnection(Scheduler& s) : sched(s) { sched.attach(this); }
+
+AsyncTCPConnection::~AsyncTCPConnection() { sched.detach(this); }
+
+AsyncTCPConnection::ConnectOp AsyncTCPConnection::async_connect(const std::string& ip, int port, int timeout_ms) {
+    bool started = conn.connect(ip, port);
+    return ConnectOp(*this, started, timeout_ms);
+}
+
+AsyncTCPConnection::ConnectOp::ConnectOp(AsyncTCPConnection& c, bool started, int timeout_ms)
+    : AsyncOp(c.sched), conn(c), deadline(deadline_after(started ? timeout_ms : 0)) {}
+
+bool AsyncTCPConnection::ConnectOp::try_complete() {
+    if (conn.get_state() == ESTABLISHED) {
+        ok = true;
+        return true;
+    }
+    // SYN 重发到上限仍没有回应，连接已经放弃
+    if (conn.get_state() == CLOSED) return true;
+    return std::chrono::steady_clock::now() >= deadline;
+}
+
+AsyncTCPConnection::SendOp::SendOp(AsyncTCPConnection& c, const char* d, size_t l)
+    : AsyncOp(c.sched), conn(c), data(d), len(l) {}
+
+bool AsyncTCPConnection::SendOp::try_complete() {
+    TCPState s = conn.get_state();
+    if (s != ESTABLISHED && s != CLOSE_WAIT) {
+        ok = false;
+        return true;
+    }
+    while (offset < len) {
+        size_t chunk = std::min(ASYNC_MSS, len - offset);
+        if (!conn.conn.send(data + offset, chunk)) return false;  // 窗口满了，等下一轮
+        offset += chunk;
+    }
+    return true;
+}
+
+AsyncTCPConnection::ReceiveOp::ReceiveOp(AsyncTCPConnection& c, void* buf, size_t max, int timeout_ms)
+    : AsyncOp(c.sched),
+      conn(c),
+      buffer(buf),
+      maxLen(max),
+      has_deadline(timeout_ms >= 0),
+      deadline(deadline_after(std::max(timeout_ms, 0))) {}
+
+bool AsyncTCPConnection::ReceiveOp::try_complete() {
+    n = conn.conn.receive(buffer, maxLen);
+    if (n != 0) return true;  // 有数据或 EOF
+    return has_deadline && std::chrono::steady_clock::now() >= deadline;
+}
+
+AsyncTCPConnection::FlushOp::FlushOp(AsyncTCPConnection& c, int timeout_ms)
+    : AsyncOp(c.sched), conn(c), deadline(deadline_after(timeout_ms)) {}
+
+bool AsyncTCPConnection::FlushOp::try_complete() {
+    if (conn.conn.is_send_complete()) {
+        ok = true;
+        return true;
+    }
+    // SYN 重发到上限仍没有回应，连接已经放弃
+    if (conn.get_state() == CLOSED) return true;
+    return std::chrono::steady_clock::now() >= deadline;
+}
@@ -1,73 +1,599 @@
 #include "tcp_connection.h"
 
-#include <unistd.h>
-
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
 #include <vector>
 
+#include "latency_profile.h"
 #include "tcp_protocol.h"
 
+namespace {
+// SipHash-2-4：短输入的带密钥哈希，用来签发 Fast Open cookie (不知道密钥就伪造不出别的 IP 的 cookie)
+uint64_t rotl(uint64_t x, int b) { return (x << b) | (x >> (64 - b)); }
+
+uint64_t siphash24(const uint8_t key[16], const void* data, size_t len) {
+    uint64_t k0, k1;
+    memcpy(&k0, key, 8);
+    memcpy(&k1, key + 8, 8);
+    uint64_t v0 = k0 ^ 0x736f6d6570736575ULL, v1 = k1 ^ 0x646f72616e646f6dULL;
+    uint64_t v2 = k0 ^ 0x6c7967656e657261ULL, v3 = k1 ^ 0x7465646279746573ULL;
+    auto round = [&] {
+        v0 += v1, v1 = rotl(v1, 13), v1 ^= v0, v0 = rotl(v0, 32);
+        v2 += v3, v3 = rotl(v3, 16), v3 ^= v2;
+        v0 += v3, v3 = rotl(v3, 21), v3 ^= v0;
+        v2 += v1, v1 = rotl(v1, 17), v1 ^= v2, v2 = rotl(v2, 32);
+    };
+
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    size_t blocks = len / 8;
+    for (size_t i = 0; i < blocks; ++i, p += 8) {
+        uint64_t m;
+        memcpy(&m, p, 8);
+        v3 ^= m;
+        round(), round();
+        v0 ^= m;
+    }
+    uint64_t last = uint64_t(len) << 56;
+    for (size_t i = 0; i < len % 8; ++i) last |= uint64_t(p[i]) << (8 * i);
+    v3 ^= last;
+    round(), round();
+    v0 ^= last;
+    v2 ^= 0xff;
+    round(), round(), round(), round();
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+// 校验 cookie 用的定长比较：不在第一个不同的字节处提前返回，耗时和内容无关，
+// 攻击者不能按响应时间逐字节猜出 cookie
+bool equal_constant_time(const void* a, const void* b, size_t len) {
+    const volatile uint8_t* x = static_cast<const volatile uint8_t*>(a);
+    const volatile uint8_t* y = static_cast<const volatile uint8_t*>(b);
+    uint8_t diff = 0;
+    for (size_t i = 0; i < len; ++i) diff |= x[i] ^ y[i];
+    return diff == 0;
+}
+
+// 服务端签发 cookie 的密钥：第一次用到时随机生成，进程内所有连接对象共用，
+// 一个连接对象签发的 cookie 在之后的连接 (包括别的监听对象) 上都能校验通过
+const uint8_t* server_cookie_key() {
+    static const auto key = [] {
+        std::array<uint8_t, 16> k;
+        std::random_device rd;
+        for (size_t i = 0; i < k.size(); i += 4) {
+            uint32_t r = rd();
+            memcpy(k.data() + i, &r, 4);
+        }
+        return k;
+    }();
+    return key.data();
+}
+
+// 客户端的 cookie 缓存 (进程内共享，key 为 "ip:port")
+std::mutex cookie_mutex;
+std::map<std::string, uint64_t> cookie_cache;
+
+std::string cookie_key_of(const Endpoint& server) { return server.ip() + ":" + std::to_string(server.port()); }
+}  // namespace
+
+TransportOptions& TransportOptions::defaults() {
+    static TransportOptions options;
+    return options;
+}
+
 TCPConnection::TCPConnection() : state(CLOSED), snd_una(0), snd_nxt(0), rcv_nxt(0) {
     srand(time(nullptr));
     socket.create();
     socket.set_non_blocking(true);
+    const TransportOptions& options = TransportOptions::defaults();
+    socket.set_buffer_sizes(options.socket_rcvbuf, options.socket_sndbuf);
+    if (options.rate_limit > 0) set_rate_limit(options.rate_limit);
+    if (options.shared_rate_limit) set_shared_rate_limit(options.shared_rate_limit, options.rate_weight);
+
+    // 最低额度总是给的，其余按预算尽量给到 RCVBUF_INIT
+    budget->force_reserve(RCVBUF_MIN);
+    rcvbuf = RCVBUF_MIN + budget->reserve_up_to(RCVBUF_INIT - RCVBUF_MIN);
+}
+
+TCPConnection::~TCPConnection() {
+    socket.close();
+    set_shared_rate_limit(nullptr);
+    budget->release(rcvbuf);
+}
+
+void TCPConnection::set_memory_budget(MemoryBudget& b) {
+    if (&b == budget) return;
+    budget->release(rcvbuf);
+    budget = &b;
+    budget->force_reserve(RCVBUF_MIN);
+    rcvbuf = RCVBUF_MIN + budget->reserve_up_to(std::max(rcvbuf, RCVBUF_MIN) - RCVBUF_MIN);
 }
 
-TCPConnection::~TCPConnection() { socket.close(); }
+bool TCPConnection::bind(int port) { return bind(std::string(), port); }
 
-bool TCPConnection::bind(int port) {
-    if (socket.bind(port)) {
+bool TCPConnection::bind(const std::string& ip, int port) {
+    trace_clock();
+    if (env) {
+        // 模拟环境里地址由 env 决定，不占用真实端口
+        listening = true;
+        state = LISTEN;
+        if (trace) trace_changes();
+        return true;
+    }
+    if (ip.empty() ? socket.bind(port) : socket.bind(ip, port)) {
+        listening = true;
         state = LISTEN;
+        if (trace) trace_changes();
         std::cout << "[TCP] State changed to LISTEN" << std::endl;
         return true;
     }
     return false;
 }
 
+bool TCPConnection::set_local_address(const std::string& ip) { return env || socket.bind(ip, 0); }
+
 bool TCPConnection::connect(const std::string& ip, int port) {
-    peer_ip = ip;
-    peer_port = port;
+    if (!Endpoint::resolve(ip, port, peer)) return false;
+    trace_clock();
 
     // TODO: 实现第一次握手
     // 1. 设置标志位 SYN
     // 2. 发送包
     // 3. 状态变更为 SYN_SENT
     // 3. 状态变更为 SYN_SENT
-    send_packet(FLAG_SYN);
+    tfo_client = false;
+    syn_payload.clear();
+    syn_retries = 0;
+    send_syn();
+    state = SYN_SENT;
+    if (trace) trace_changes();
+    return true;
+}
+
+bool TCPConnection::connect(const std::string& ip, int port, const void* early_data, size_t len) {
+    if (len > TFO_MAX_DATA) return false;
+    if (!Endpoint::resolve(ip, port, peer)) return false;
+    trace_clock();
+
+    tfo_client = true;
+    tfo_accepted = false;
+    syn_payload.clear();
+    const char* p = static_cast<const char*>(early_data);
+    {
+        std::lock_guard<std::mutex> lock(cookie_mutex);
+        auto it = cookie_cache.find(cookie_key_of(peer));
+        if (it != cookie_cache.end()) {
+            // 有 cookie：SYN = cookie + 请求；没有 cookie 时 payload 为空，表示申请 cookie
+            syn_payload.resize(TFO_COOKIE_LEN);
+            memcpy(syn_payload.data(), &it->second, TFO_COOKIE_LEN);
+            syn_payload.insert(syn_payload.end(), p, p + len);
+        }
+    }
+    syn_retries = 0;
+    send_syn();
     state = SYN_SENT;
+    if (trace) trace_changes();
+
+    // 请求同时按普通数据段放进发送队列 (seq 从 0 开始)：服务器接收了就会随 SYN-ACK 确认，
+    // 没接收就在握手完成后立即补发
+    if (len > 0) {
+        send_queue.push_back(snd_nxt, p, len, now());
+        snd_nxt += len;
+    }
     return true;
 }
 
+void TCPConnection::send_syn() {
+    syn_retransmitted = state == SYN_SENT;
+    // 总是声明能解 FEC 校验段和 SACK，对端开了 FEC 就可以发校验段过来
+    send_packet(FLAG_SYN | FLAG_FEC | FLAG_SACK | (tfo_client ? FLAG_TFO : 0), syn_payload.data(),
+                syn_payload.size());
+    syn_time = now();
+}
+
+void TCPConnection::send_synack(const char* data, int len, uint32_t seq) {
+    // 握手 RTT 从 (最后一次) SYN-ACK 发出算起
+    syn_retransmitted = synack_sent;
+    synack_sent = true;
+    syn_time = now();
+    if (!tfo_peer) {
+        send_packet(data, len, seq, FLAG_SYN | FLAG_ACK | FLAG_FEC | FLAG_SACK);
+        return;
+    }
+    // 每次都带上 cookie，客户端借此刷新缓存
+    char payload[MAX_PACKET_SIZE];
+    uint64_t cookie = make_cookie(peer);
+    memcpy(payload, &cookie, TFO_COOKIE_LEN);
+    if (len > 0) memcpy(payload + TFO_COOKIE_LEN, data, len);
+    send_packet(payload, TFO_COOKIE_LEN + len, seq, FLAG_SYN | FLAG_ACK | FLAG_TFO | FLAG_FEC | FLAG_SACK);
+}
+
+uint64_t TCPConnection::make_cookie(const Endpoint& client) const {
+    // 只绑定 IP 不绑定端口：客户端每次连接的源端口都不一样
+    std::string ip = client.ip();
+    return siphash24(server_cookie_key(), ip.data(), ip.size());
+}
+
 void TCPConnection::update() {
-    char buffer[MAX_PACKET_SIZE];
-    std::string src_ip;
-    int src_port;
+    MYTCP_PROFILE_SCOPE(PROF_UPDATE);
+    char buffer[MAX_DATAGRAM_SIZE];
+    Endpoint src;
 
     // 循环收取所有到达的包 (Drain the socket)
-    while (true) {
-        int bytes = socket.recv_from(buffer, MAX_PACKET_SIZE, src_ip, src_port);
-        if (bytes <= 0) break;  // 读完了 (EAGAIN)
+    if (source) {
+        // 收包线程已经读好并验证过校验和，包原地处理
+        int bytes;
+        bool ok;
+        while (const char* data = source->front_packet(bytes, src, ok)) {
+            receive_datagram(data, bytes, src, true, ok);
+            source->pop_packet();
+        }
+    } else {
+        while (true) {
+            int bytes = env ? env->recv_from(buffer, MAX_DATAGRAM_SIZE, src)
+                            : socket.recv_from(buffer, MAX_DATAGRAM_SIZE, src);
+            if (bytes <= 0) break;  // 读完了 (EAGAIN)
+            receive_datagram(buffer, bytes, src, false, false);
+        }
+    }
 
-        // 解析 Header
-        if (bytes < sizeof(TCPHeader)) continue;
+    // 检查重传
+    check_timeout();
+    check_memory_pressure();
+    if (trace) trace_changes();
+}
 
-        TCPHeader* header = (TCPHeader*)buffer;
+// ---------------- 接收缓冲自动调整 ----------------
 
-        // 0. 校验和检查
-        if (calculate_checksum(buffer, bytes) != 0) {
-            // std::cout << "[TCP] Checksum failed! Dropping packet." << std::endl;
-            continue;
+void TCPConnection::rcv_rtt_sample(int64_t us) {
+    if (us <= 0) us = 1;
+    uint32_t sample = uint32_t(std::min<int64_t>(us, UINT32_MAX));
+    // 样本更小就直接采用 (估计值只会偏大：发送方可能没有填满窗口)，否则按 1/8 平滑
+    if (rcv_rtt_us == 0 || sample < rcv_rtt_us) {
+        rcv_rtt_us = sample;
+    } else {
+        rcv_rtt_us = uint32_t((uint64_t(rcv_rtt_us) * 7 + sample) / 8);
+    }
+}
+
+void TCPConnection::rcv_rtt_measure() {
+    auto now = this->now();
+    if (rcv_rtt_active && int32_t(rcv_nxt - rcv_rtt_seq) < 0) return;
+    if (rcv_rtt_active) {
+        rcv_rtt_sample(std::chrono::duration_cast<std::chrono::microseconds>(now - rcv_rtt_time).count());
+    }
+    // 下一轮：收满当前通告的窗口需要多久
+    rcv_rtt_seq = rcv_nxt + get_window_size();
+    rcv_rtt_time = now;
+    rcv_rtt_active = true;
+}
+
+void TCPConnection::rcv_space_adjust(size_t copied) {
+    rcv_copied += copied;
+    auto now = this->now();
+    if (rcv_rtt_us == 0) return;
+    if (std::chrono::duration_cast<std::chrono::microseconds>(now - rcv_space_time).count() < rcv_rtt_us) return;
+
+    // 一个 RTT 内应用取走的字节数就是当前的 "带宽 x RTT"，留 2 倍余量给发送方的增长和丢包恢复
+    if (rcv_copied > rcv_space) {
+        rcv_space = rcv_copied;
+        size_t want = std::min(RCVBUF_MAX, 2 * rcv_space);
+        if (want > rcvbuf && !budget->under_pressure()) rcvbuf += budget->reserve_up_to(want - rcvbuf);
+    }
+    rcv_copied = 0;
+    rcv_space_time = now;
+}
+
+void TCPConnection::check_memory_pressure() {
+    if (rcvbuf <= RCVBUF_MIN || !budget->under_pressure()) return;
+    // 每 10ms 最多收缩 1/4，已缓存的数据和已通告的窗口不受影响，只是新窗口变小
+    auto now = this->now();
+    if (now - pressure_check_time < std::chrono::milliseconds(10)) return;
+    pressure_check_time = now;
+
+    size_t target = std::max(RCVBUF_MIN, rcvbuf - rcvbuf / 4);
+    budget->release(rcvbuf - target);
+    rcvbuf = target;
+    rcv_space = std::min(rcv_space, rcvbuf / 2);
+}
+
+// ---------------- 统计 ----------------
+
+void TCPConnection::rtt_sample(int64_t us) {
+    uint32_t r = uint32_t(std::clamp<int64_t>(us, 1, UINT32_MAX));
+    if (stats.srtt_us == 0) {
+        stats.srtt_us = r;
+        stats.rttvar_us = r / 2;
+    } else {
+        // RFC 6298: RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|，SRTT = 7/8 SRTT + 1/8 R
+        uint32_t delta = stats.srtt_us > r ? stats.srtt_us - r : r - stats.srtt_us;
+        stats.rttvar_us = uint32_t((uint64_t(stats.rttvar_us) * 3 + delta) / 4);
+        stats.srtt_us = uint32_t((uint64_t(stats.srtt_us) * 7 + r) / 8);
+    }
+    stats.min_rtt_us = stats.min_rtt_us == 0 ? r : std::min(stats.min_rtt_us, r);
+}
+
+void TCPConnection::set_send_limit(SendLimit next) {
+    if (next == send_limit) return;
+    auto t = now();
+    if (send_limit != LIMIT_IDLE) {
+        send_limit_us[send_limit] += std::chrono::duration_cast<std::chrono::microseconds>(t - send_limit_since).count();
+    }
+    send_limit = next;
+    send_limit_since = t;
+}
+
+TCPInfo TCPConnection::info() const {
+    TCPInfo i = stats;
+    i.state = state;
+    i.segments_sent = send_counters.data_segments;
+    i.fast_retransmits = send_counters.fast_retransmits;
+    i.rto_retransmits = send_counters.rto_retransmits;
+    i.tlp_probes = send_counters.tlp_probes;
+    i.ooo_bytes = uint32_t(rx.ooo_bytes());
+    i.rcv_rtt_us = rcv_rtt_us;
+    i.cwnd = cwnd;
+    i.rwnd = rwnd;
+    i.flight_size = snd_nxt - snd_una;
+    i.rcv_wnd = get_window_size();
+    i.rcvbuf = uint32_t(std::min<size_t>(rcvbuf, UINT32_MAX));
+
+    // 当前这一段受限时间还没结算，算到快照里
+    long long limited[6];
+    std::copy(std::begin(send_limit_us), std::end(send_limit_us), limited);
+    if (send_limit != LIMIT_IDLE) {
+        limited[send_limit] += std::chrono::duration_cast<std::chrono::microseconds>(now() - send_limit_since).count();
+    }
+    i.app_limited_us = limited[LIMIT_APP];
+    i.cwnd_limited_us = limited[LIMIT_CWND];
+    i.rwnd_limited_us = limited[LIMIT_RWND];
+    i.pacing_limited_us = limited[LIMIT_PACING];
+    i.rate_limited_us = limited[LIMIT_RATE];
+    i.rate_limit = rate_limit();
+
+    if (pacing && stats.srtt_us > 0) {
+        i.pacing_rate = uint64_t(cwnd) * PACING_GAIN_NUM * 1000000 / (uint64_t(stats.srtt_us) * PACING_GAIN_DEN);
+    }
+    if (!env) {
+        i.sock_rcvbuf = socket.receive_buffer_size();
+        i.sock_sndbuf = socket.send_buffer_size();
+    }
+    return i;
+}
+
+uint32_t TCPConnection::send_window_available() const {
+    uint32_t win = std::min(cwnd, rwnd);
+    if (fec_tx.enabled() && peer_fec) win = std::min(rwnd, fec_tx.data_share(cwnd));
+    uint32_t flight_size = snd_nxt - snd_una;
+    return win > flight_size ? win - flight_size : 0;
+}
+
+// ---------------- 发送节奏 ----------------
+
+std::chrono::nanoseconds TCPConnection::pacing_interval(uint32_t len) const {
+    // 速率 = PACING_GAIN x cwnd / SRTT
+    return std::chrono::nanoseconds(uint64_t(len) * stats.srtt_us * 1000 * PACING_GAIN_DEN /
+                                    (uint64_t(cwnd) * PACING_GAIN_NUM));
+}
+
+void TCPConnection::pacing_charge(uint32_t len, std::chrono::steady_clock::time_point t) {
+    if (!pacing || stats.srtt_us == 0) return;
+    // 空闲 (或落后于速率) 时最多攒下 PACING_BURST 个段 (或 1ms) 的额度，之后每个段把下一次发送时间往后推；
+    // 1ms 的下限让驱动线程被调度出去一个时间片后能补上，RTT 很小时节奏实际上不起作用 (本来也不会有成窗的突发)
+    auto credit = std::max<std::chrono::nanoseconds>(pacing_interval(PACING_BURST * MAX_PACKET_SIZE),
+                                                     std::chrono::microseconds(PACING_BURST_US));
+    auto earliest = t - credit;
+    pacing_next = std::max(pacing_next, earliest) + pacing_interval(len);
+}
+
+std::chrono::microseconds TCPConnection::pacing_delay() const {
+    auto t = now();
+    std::chrono::microseconds wait(0);
+    if (pacing && stats.srtt_us > 0 && pacing_next > t) {
+        // 向上取整，按它睡醒时一定可以发了
+        wait = std::chrono::duration_cast<std::chrono::microseconds>(pacing_next - t) + std::chrono::microseconds(1);
+    }
+    if (rate_blocked_len > 0) {
+        if (own_limit) wait = std::max(wait, own_limit->delay(-1, rate_blocked_len, t));
+        if (shared_limit) wait = std::max(wait, shared_limit->delay(shared_flow, rate_blocked_len, t));
+    }
+    return wait;
+}
+
+// ---------------- 发送限速 ----------------
+
+void TCPConnection::set_rate_limit(uint64_t bytes_per_sec, size_t burst) {
+    if (bytes_per_sec == 0) {
+        own_limit.reset();
+    } else if (own_limit) {
+        own_limit->set_rate(bytes_per_sec, burst);
+    } else {
+        own_limit = std::make_unique<RateLimiter>(bytes_per_sec, burst);
+    }
+    rate_blocked_len = 0;
+}
+
+void TCPConnection::set_shared_rate_limit(RateLimiter* limiter, unsigned weight) {
+    if (shared_limit) shared_limit->remove_flow(shared_flow);
+    shared_limit = limiter;
+    shared_flow = limiter ? limiter->add_flow(weight) : -1;
+    rate_blocked_len = 0;
+}
+
+bool TCPConnection::rate_acquire(size_t len, std::chrono::steady_clock::time_point t) {
+    // 先只查询自己的桶：共享限速器扣了令牌之后这个段就一定要发出去
+    if (own_limit && own_limit->delay(-1, len, t).count() > 0) return false;
+    if (shared_limit && shared_limit->acquire(shared_flow, len, t).count() > 0) return false;
+    if (own_limit) own_limit->acquire(-1, len, t);
+    return true;
+}
+
+// ---------------- 追踪 ----------------
+
+void TCPConnection::set_trace(PacketTrace* t) {
+    trace = t;
+    if (!trace) return;
+    trace_time = now();
+    // 先记一条当前状态和窗口，后面的变化事件都相对它
+    trace_event(TRACE_STATE_CHANGED, uint8_t(state), 0, 0, 0, 0, uint32_t(state));
+    traced_state = state;
+    traced_rwnd = rwnd;
+    traced_cwnd = cwnd;
+    trace_event(TRACE_WINDOW_UPDATED, 0, 0, snd_una, rwnd, 0, cwnd, snd_nxt - snd_una);
+}
+
+void TCPConnection::trace_event(uint8_t type, uint8_t flags, uint32_t seq, uint32_t ack, uint32_t wnd, uint32_t len,
+                                uint32_t a, uint32_t b) {
+    TraceRecord r;
+    r.time_us = std::chrono::duration_cast<std::chrono::microseconds>(trace_time.time_since_epoch()).count();
+    r.type = type;
+    r.flags = flags;
+    r.len = uint16_t(std::min<uint32_t>(len, UINT16_MAX));
+    r.seq = seq;
+    r.ack = ack;
+    r.wnd = wnd;
+    r.a = a;
+    r.b = b;
+    trace->record(r);
+}
+
+void TCPConnection::trace_changes() {
+    if (state != traced_state) {
+        trace_event(TRACE_STATE_CHANGED, uint8_t(state), 0, 0, 0, 0, uint32_t(traced_state));
+        traced_state = state;
+    }
+    if (rwnd != traced_rwnd || cwnd != traced_cwnd) {
+        trace_event(TRACE_WINDOW_UPDATED, 0, 0, snd_una, rwnd, 0, cwnd, snd_nxt - snd_una);
+        traced_rwnd = rwnd;
+        traced_cwnd = cwnd;
+    }
+}
+
+// ---------------- FEC ----------------
+
+void TCPConnection::set_fec(const FecConfig& cfg) { fec_tx.configure(cfg); }
+
+uint16_t TCPConnection::dup_ack_threshold() const {
+    // 组内的丢失交给校验段恢复：一组段发完、校验段到达之前收到的重复 ACK 不触发快速重传
+    if (fec_tx.enabled() && peer_fec) return std::max<int>(MAX_DUP_CNT, fec_tx.group_span());
+    return MAX_DUP_CNT;
+}
+
+void TCPConnection::emit_fec_group() {
+    char payload[MAX_DATAGRAM_SIZE];
+    for (int j = 0; j < fec_tx.parity_count(); ++j) {
+        size_t n = fec_tx.build_parity(j, payload);
+        send_packet(payload, n, snd_una, FLAG_FEC | FLAG_ACK);
+        ++fec_parity_sent;
+    }
+    fec_tx.next_group();
+}
+
+void TCPConnection::on_fec_parity(const char* data, int len) {
+    std::vector<FecDecoder::Recovered> recovered;
+    fec_rx.on_parity(data, len, rcv_nxt, recovered);
+    // 恢复出来的段按普通数据段处理 (不带新的 ACK 信息)
+    for (auto& seg : recovered) {
+        TCPHeader h;
+        memset(&h, 0, sizeof(h));
+        h.seq_num = htonl(seg.seq);
+        h.ack_num = htonl(snd_una);
+        h.flags = FLAG_ACK;
+        h.window_size = htonl(rwnd);
+        process_packet(h, seg.data.data(), seg.data.size(), peer);
+    }
+    fec_rx.prune(rcv_nxt);
+}
+
+// ---------------- RACK-TLP ----------------
+
+void TCPConnection::send_sack(uint32_t seq, uint32_t len) {
+    // 报告包含这个段的连续乱序块，前面的 SACK 丢了也能一次补上
+    uint32_t left = seq, right = seq + len;
+    rx.block(seq, left, right);
+    uint32_t block[2] = {htonl(left), htonl(right)};
+    send_packet(reinterpret_cast<const char*>(block), sizeof(block), snd_nxt, FLAG_ACK | FLAG_SACK);
+}
+
+bool TCPConnection::on_sack(uint32_t left, uint32_t right, std::chrono::steady_clock::time_point t) {
+    // 二分找到第一个 seq >= left 的段
+    size_t lo = 0, hi = send_queue.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (int32_t(send_queue[mid].seq - left) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
+    }
+    bool delivered = false;
+    for (size_t i = lo; i < send_queue.size() && int32_t(send_queue[i].seq + send_queue[i].len - right) <= 0; ++i) {
+        SendSegment& seg = send_queue[i];
+        if (seg.sacked) continue;
+        seg.sacked = true;
+        ++sacked_count;
+        rack_update(seg, t);
+        delivered = true;
+    }
+    return delivered;
+}
 
-        // 调用状态机
-        process_packet(*header, buffer + sizeof(TCPHeader), bytes - sizeof(TCPHeader), src_ip, src_port);
+void TCPConnection::rack_update(const SendSegment& seg, std::chrono::steady_clock::time_point t) {
+    auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(t - seg.last_send_time);
+    // 重传过的段确认得比最小 RTT 还快，多半是对原始段的确认，不能说明重传那一刻之前发的段丢了
+    if (seg.retries > 0 && rtt.count() < int64_t(stats.min_rtt_us)) return;
+    if (seg.last_send_time > rack_xmit_time ||
+        (seg.last_send_time == rack_xmit_time && int32_t(seg.seq + seg.len - rack_end_seq) > 0)) {
+        rack_xmit_time = seg.last_send_time;
+        rack_end_seq = seg.seq + seg.len;
+        rack_rtt = rtt;
     }
+}
 
-    // 检查重传
-    check_timeout();
+void TCPConnection::rack_detect_loss(std::chrono::steady_clock::time_point t) {
+    rack_timer = {};
+    // 重排窗口：min_rtt / 4；开启 FEC 时再留出校验段赶到的时间，组内的丢失优先由校验段恢复
+    auto reo_wnd = std::chrono::microseconds(stats.min_rtt_us / 4);
+    if (fec_tx.enabled() && peer_fec) reo_wnd += std::chrono::milliseconds(FEC_FLUSH_MS);
+    auto wait = rack_rtt + reo_wnd;
+    for (auto& seg : send_queue) {
+        if (seg.sacked) continue;
+        bool sentBefore = seg.last_send_time < rack_xmit_time ||
+                          (seg.last_send_time == rack_xmit_time && int32_t(seg.seq + seg.len - rack_end_seq) < 0);
+        if (!sentBefore) {
+            // 原始段按序列号顺序发出，后面的原始段都更晚
+            if (seg.retries == 0) break;
+            continue;
+        }
+        auto deadline = seg.last_send_time + wait;
+        if (t >= deadline) {
+            retransmit(seg, RETRANSMIT_RACK, t);
+        } else if (rack_timer == std::chrono::steady_clock::time_point{} || deadline < rack_timer) {
+            rack_timer = deadline;
+        }
+    }
+}
+
+void TCPConnection::retransmit(SendSegment& seg, uint8_t reason, std::chrono::steady_clock::time_point t) {
+    if (trace) trace_event(TRACE_RETRANSMIT, reason, seg.seq, 0, 0, seg.len, seg.retries + 1);
+    send_packet(seg.data.data(), seg.len, seg.seq);
+    pacing_charge(seg.len, t);
+    stats.bytes_retransmitted += seg.len;
+    seg.last_send_time = t;
+    seg.retries++;
+    if (reason == RETRANSMIT_RTO) {
+        ++send_counters.rto_retransmits;
+    } else if (reason == RETRANSMIT_TLP) {
+        ++send_counters.tlp_probes;
+    } else {
+        ++send_counters.fast_retransmits;
+    }
 }
 
 std::string stateToString(TCPState state) {
@@ -104,20 +630,26 @@ std::string flagsToString(uint8_t flags) {
     if (flags & FLAG_FIN) s += "FIN ";
     if (flags & FLAG_RST) s += "RST ";
     if (flags & FLAG_PSH) s += "PSH ";
+    if (flags & FLAG_SACK) s += "SACK ";
     if (s.empty()) return "NONE";
     return s;
 }
 
-void TCPConnection::process_packet(const TCPHeader& header, const char* data, int len, const std::string& src_ip,
-                                   int src_port) {
+void TCPConnection::process_packet(const TCPHeader& header, const char* data, int len, const Endpoint& src) {
     // 转换网络字节序为主机字节序
     uint32_t seqNum = ntohl(header.seq_num);
     uint32_t ackNum = ntohl(header.ack_num);
     uint32_t codeFlags = header.flags;  // flags is uint8_t, no endian conversion needed
 
-    // 打印收到的包作为调试 (高频日志严重影响性能，注释掉)
-    // std::cout << "[TCP] Recv Flags: [" << flagsToString(codeFlags) << "] State: " << stateToString(state)
-    //           << " Seq=" << seqNum << " Ack=" << ackNum << " Len=" << len << std::endl;
+    // 调试收发包用 set_trace() (packet_trace.h)：逐包打印日志会严重影响性能
+
+    // 服务端在挥手收尾 (等最后的 ACK / TIME_WAIT) 时来了新连接的 SYN：旧连接剩下的只是确认和防旧包的等待，
+    // 直接放弃它，按 LISTEN 处理，下一个客户端不用等挥手结束
+    if (listening && (codeFlags & FLAG_SYN) && !(codeFlags & FLAG_ACK) &&
+        (state == LAST_ACK || state == TIME_WAIT || state == CLOSING || state == FIN_WAIT_1 || state == FIN_WAIT_2)) {
+        clear_connection();
+        state = LISTEN;
+    }
 
     switch (state) {
         case CLOSED:
@@ -128,183 +660,142 @@ void TCPConnection::process_packet(const TCPHeader& header, const char* data, in
             // TODO: Server 收到 SYN -> 发送 SYN+ACK -> 变为 SYN_RCVD
             // if (header.flags & FLAG_SYN) ...
             if (codeFlags & FLAG_SYN) {
-                peer_ip = src_ip;
-                peer_port = src_port;
-                send_packet(FLAG_SYN | FLAG_ACK, data, len);
+                peer = src;
                 state = SYN_RCVD;
+                tfo_peer = codeFlags & FLAG_TFO;
+                peer_fec = codeFlags & FLAG_FEC;
+                peer_sack = codeFlags & FLAG_SACK;
+
+                uint64_t cookie = make_cookie(src);
+                if (tfo_peer && len > TFO_COOKIE_LEN && equal_constant_time(data, &cookie, TFO_COOKIE_LEN)) {
+                    // cookie 有效：SYN 里的请求直接交给应用；SYN-ACK 推迟一下，等应用的第一个响应搭车
+                    const char* req = data + TFO_COOKIE_LEN;
+                    int reqLen = len - TFO_COOKIE_LEN;
+                    if (segment_handler) {
+                        segment_handler(req, reqLen);
+                        rx.insert(rcv_nxt, nullptr, reqLen);
+                        rx.skip();
+                    } else {
+                        rx.insert(rcv_nxt, req, reqLen);
+                    }
+                    rcv_nxt += reqLen;
+                    stats.bytes_received += reqLen;
+                    synack_pending = true;
+                    syn_time = now();
+                } else {
+                    // 普通 SYN / 申请 cookie / cookie 无效：SYN 里的数据丢弃，等客户端握手后补发
+                    send_synack();
+                }
             }
             break;
 
         case SYN_SENT:
             // TODO: Client 收到 SYN+ACK -> 发送 ACK -> 变为 ESTABLISHED
             if (codeFlags & (FLAG_SYN | FLAG_ACK)) {
-                send_packet(FLAG_ACK, data, len);
+                if ((codeFlags & FLAG_SYN) && (codeFlags & FLAG_TFO) && len >= TFO_COOKIE_LEN) {
+                    // 缓存服务器签发的 cookie，剩下的是搭车的第一个响应
+                    uint64_t cookie;
+                    memcpy(&cookie, data, TFO_COOKIE_LEN);
+                    std::lock_guard<std::mutex> lock(cookie_mutex);
+                    cookie_cache[cookie_key_of(peer)] = cookie;
+                    data += TFO_COOKIE_LEN;
+                    len -= TFO_COOKIE_LEN;
+                }
+                tfo_accepted = tfo_client && snd_nxt > 0 && ackNum == snd_nxt;
+                peer_fec = codeFlags & FLAG_FEC;
+                peer_sack = codeFlags & FLAG_SACK;
+                if (!syn_retransmitted) {
+                    rcv_rtt_sample(std::chrono::duration_cast<std::chrono::microseconds>(now() - syn_time).count());
+                }
                 state = ESTABLISHED;
+                syn_payload.clear();
+                // 握手完成后把 UDP socket connect 到服务器，后续走 send() 快速路径
+                peer_connected = !env && socket.connect(peer);
+
+                // 按 ESTABLISHED 处理这个包：确认 SYN 里的请求、接收搭车的响应 (有数据时会回 ACK)
+                TCPHeader established = header;
+                established.flags = codeFlags & ~(FLAG_SYN | FLAG_TFO | FLAG_FEC | FLAG_SACK);
+                process_packet(established, data, len, src);
+                if (len == 0) send_packet(FLAG_ACK);
+
+                // 服务器没有接收 SYN 里的请求：立即补发，不等 RTO
+                auto now = this->now();
+                for (auto& seg : send_queue) {
+                    send_packet(seg.data.data(), seg.len, seg.seq);
+                    seg.last_send_time = now;
+                }
             }
             break;
 
         case SYN_RCVD:
+            if (codeFlags & FLAG_SYN) {
+                // 客户端没收到 SYN-ACK 又重发了 SYN
+                if (!synack_pending) send_synack();
+                break;
+            }
             // TODO: Server 收到 ACK -> 变为 ESTABLISHED
             if (codeFlags & FLAG_ACK) {
+                if (synack_sent && !syn_retransmitted) {
+                    rcv_rtt_sample(std::chrono::duration_cast<std::chrono::microseconds>(now() - syn_time).count());
+                }
                 state = ESTABLISHED;
+                synack_pending = false;
+                // 这个包可能已经带了数据 (比如补发的请求)，按 ESTABLISHED 处理，不要丢掉
+                process_packet(header, data, len, src);
             }
             break;
 
-        case ESTABLISHED: {
-            // --- 1. 处理 ACK (推动发送窗口) ---
-            uint32_t ack = ackNum;  // 使用已转换的本地变量
-            if (ack > snd_una) {
-                // 累积确认：清理掉所有 seq + len <= ack 的包
-                while (!send_queue.empty()) {
-                    auto& head = send_queue.front();
-                    uint32_t endSeq = head.seq + head.len;
-                    // 注意：序列号回绕 (Wrap Around) 先不考虑，假设足够大
-                    if (endSeq <= ack) {
-                        send_queue.pop_front();
-                    } else {
-                        break;
-                    }
-                }
-                snd_una = ack;
-                dup_ack_cnt = 0;
-            }
-
-            if (ack == snd_una) {
-                if (len == 0 && ++dup_ack_cnt >= MAX_DUP_CNT) {
-                    // std::cout << "[TCP] Fast Retransmit: seq=" << snd_una << std::endl;
-
-                    if (!send_queue.empty()) {
-                        auto& seg = send_queue.front();
-                        if (seg.seq == snd_una) {
-                            send_packet(seg.data.data(), seg.len, seg.seq);
-                        }
-                    }
-                    dup_ack_cnt = 0;  // 为了简单，重传后可以清零
-                }
-            }
-            // 关键修复：无论 ACK 是否推进，都要更新 rwnd (处理 Window Update 包)
-            rwnd = ntohl(header.window_size);
-
-            // --- 2. 处理接收数据 (写入接收缓冲) ---
-            uint32_t seq = seqNum;  // 使用已转换的本地变量
-            int32_t diff = (int32_t)(seq - rcv_nxt);
-
-            if (len > 0) {
-                if (diff == 0) {
-                    // 正好是期望的包 (seq == rcv_nxt)
-                    if (get_window_size() < len * sizeof(char)) {
-                        // 接收窗口不足，丢弃包，但必须回复 ACK 告诉对方现在的窗口大小
-                        // 接收窗口不足，丢弃包，但必须回复 ACK 告诉对方现在的窗口大小
-                        send_packet(FLAG_ACK);
-                        return;
-                    }
-                    const char* p = static_cast<const char*>(data);
-                    in_buffer.insert(in_buffer.end(), p, p + len);
-                    rcv_nxt += len;
-
-                    // 检查乱序缓冲里有没有能接上的
-                    auto it = out_of_order_buffer.begin();
-                    while (it != out_of_order_buffer.end()) {
-                        int32_t bufDiff = (int32_t)(it->first - rcv_nxt);
-
-                        if (bufDiff == 0) {
-                            if (get_window_size() < it->second.size() * sizeof(char)) break;
-                            in_buffer.insert(in_buffer.end(), it->second.begin(), it->second.end());
-                            rcv_nxt += it->second.size();
-
-                            it = out_of_order_buffer.erase(it);
-                        } else if (bufDiff < 0) {
-                            // 这是一个已经处理过的包 (Partially overlapping or Duplicate)
-                            // 简单起见，如果它完全被 rcv_nxt 覆盖，直接删除
-                            uint32_t endOfPkt = it->first + it->second.size();
-                            int32_t endDiff = (int32_t)(endOfPkt - rcv_nxt);
-
-                            if (endDiff <= 0) {
-                                it = out_of_order_buffer.erase(it);
-                            } else {
-                                // 部分重叠：裁剪头部
-                                // 由于 bufDiff < 0, overlapStart = rcv_nxt
-                                uint32_t overlap =
-                                    rcv_nxt - it->first;  // 这是安全的因为 bufDiff < 0 implies rcv_nxt > it->first
-                                if (overlap < it->second.size()) {
-                                    std::vector<char> remainingData(it->second.begin() + overlap, it->second.end());
-                                    // 插入 remaining
-                                    in_buffer.insert(in_buffer.end(), remainingData.begin(), remainingData.end());
-                                    rcv_nxt += remainingData.size();
-                                    it = out_of_order_buffer.erase(it);
-                                } else {
-                                    it = out_of_order_buffer.erase(it);
-                                }
-                            }
-                        } else {
-                            break;  // 接不上了 (bufDiff > 0)
-                        }
-                    }
-                    // 只有真的收到了数据才回复 ACK
-                    send_packet(FLAG_ACK);
-                } else if (diff > 0) {
-                    // 未来的包（乱序），存起来
-                    std::vector<char> data_vec(data, data + len);
-                    out_of_order_buffer[seq] = data_vec;
-                    // 回复我们期望的 seq (即 rcv_nxt)，触发对方快重传
-                    send_packet(FLAG_ACK);
-                }
-                // diff < 0 的是重复包，直接丢弃，但也要回 ACK 确认
-                else {
-                    send_packet(FLAG_ACK);
-                }
-            } else if (codeFlags & FLAG_FIN) {
-                // TODO: 处理对端发送的 FIN
-                // 1. 回复 ACK
-                // 2. 状态变更: ESTABLISHED -> CLOSE_WAIT
-                // 3. (可选) 通知应用层
-                send_packet(FLAG_ACK);
+        // CLOSE_WAIT：对端不会再发数据，但本端还可以发，ACK 照常处理
+        case ESTABLISHED:
+        case CLOSE_WAIT: {
+            // 对端关闭：数据都收齐了才接受 FIN，进入 CLOSE_WAIT；应用读完剩下的数据后 receive() 返回 EOF
+            if (receive_segment(header, seqNum, ackNum, data, len) && (codeFlags & FLAG_FIN) && accept_fin(seqNum)) {
                 state = CLOSE_WAIT;
             }
         } break;
 
+        // 以下是挥手的各个状态，超时 (FIN 重发、FIN_WAIT_2 / TIME_WAIT 到期) 在 check_timeout 里
+        // FIN_WAIT_1 / FIN_WAIT_2：本端不再发新数据，但对端还可以继续发 (半关闭)，数据和 ACK 照 ESTABLISHED 处理
         case FIN_WAIT_1: {
-            if ((header.flags & FLAG_FIN) && (header.flags & FLAG_ACK)) {
-                state = TIME_WAIT;
-            } else if (header.flags & FLAG_FIN) {
-                state = CLOSING;
-                send_packet(FLAG_ACK);
-            } else if (header.flags & FLAG_ACK) {
+            bool control = receive_segment(header, seqNum, ackNum, data, len);
+            bool acked = snd_una == snd_nxt;  // 确认到了 FIN (fin_seq + 1)
+            if (control && (codeFlags & FLAG_FIN) && accept_fin(seqNum)) {
+                if (acked) {
+                    enter_time_wait();
+                } else {
+                    state = CLOSING;  // 同时关闭
+                }
+            } else if (acked) {
                 state = FIN_WAIT_2;
+                close_timer = now();
             }
         } break;
 
         case FIN_WAIT_2: {
-            if (header.flags & FLAG_FIN) {
-                state = TIME_WAIT;
-                send_packet(FLAG_ACK);
+            uint32_t before = rcv_nxt;
+            if (receive_segment(header, seqNum, ackNum, data, len)) {
+                if ((codeFlags & FLAG_FIN) && accept_fin(seqNum)) enter_time_wait();
+            } else if (rcv_nxt != before) {
+                close_timer = now();  // 对端还在发数据，等 FIN 的期限重新计时
             }
         } break;
 
         case CLOSING: {
-            if (header.flags & FLAG_ACK) {
-                state = TIME_WAIT;
-            }
+            if (codeFlags & FLAG_FIN) accept_fin(seqNum);
+            if ((codeFlags & FLAG_ACK) && ack_fin(ackNum)) enter_time_wait();
         } break;
 
         case TIME_WAIT: {
-            // MSL 听说是内核设置，这里我需要做吗。先不做了
-            sleep(2000);
-            reset();
-            state = CLOSED;
-        }
-
-        case CLOSE_WAIT: {
-            // 我觉得 主动断开连接后，两边都不应该发除了 fin or fin_ack ack 的数据包。
-            // 所以在被动关闭的这方，不应该继续发包了，应该等待 in_buffer 接收完后，返回 fin。
-            // 所以我使用 while 循环，直接将接收方的程序阻塞在这里。
-
+            // 对端又发来 FIN：说明最后的 ACK 丢了，再确认一次并重新计时
+            if (codeFlags & FLAG_FIN) {
+                accept_fin(seqNum);
+                close_timer = now();
+            }
         } break;
 
         case LAST_ACK: {
-            if (header.flags & FLAG_ACK) {
-                close();
-            }
+            if (codeFlags & FLAG_FIN) accept_fin(seqNum);
+            if ((codeFlags & FLAG_ACK) && ack_fin(ackNum)) finish_close();
         } break;
 
         default:
@@ -312,6 +803,165 @@ void TCPConnection::process_packet(const TCPHeader& header, const char* data, in
     }
 }
 
+bool TCPConnection::receive_segment(const TCPHeader& header, uint32_t seqNum, uint32_t ackNum, const char* data,
+                                    int len) {
+    uint32_t codeFlags = header.flags;
+    // FEC 校验段：不走 ACK / 数据逻辑，能恢复出丢失的段就当作刚收到
+    if (codeFlags & FLAG_FEC) {
+        on_fec_parity(data, len);
+        return false;
+    }
+    // 对端回传的丢包率 (只有它收到过我们的校验段时才非 0)
+    if (fec_tx.enabled()) fec_tx.set_peer_loss(header.unused);
+
+    // SACK ACK：payload 是 SACK 块，不是数据
+    bool sackAck = codeFlags & FLAG_SACK;
+    uint32_t sackLeft = 0, sackRight = 0;
+    if (sackAck) {
+        if (len >= 8) {
+            memcpy(&sackLeft, data, 4);
+            memcpy(&sackRight, data + 4, 4);
+            sackLeft = ntohl(sackLeft);
+            sackRight = ntohl(sackRight);
+        }
+        len = 0;
+    }
+
+    // --- 1. 处理 ACK (推动发送窗口) ---
+    uint32_t ack = ackNum;  // 使用已转换的本地变量
+    bool delivered = false;
+    std::chrono::steady_clock::time_point t;
+    if (ack > snd_una) {
+        // 累积确认：清理掉所有 seq + len <= ack 的包
+        // 确认到的最后一个段没有重传过时，用它的发送时间取一个 RTT 样本 (Karn)
+        t = now();
+        bool rttValid = false;
+        std::chrono::steady_clock::time_point sentAt;
+        while (!send_queue.empty()) {
+            auto& head = send_queue.front();
+            uint32_t endSeq = head.seq + head.len;
+            // 注意：序列号回绕 (Wrap Around) 先不考虑，假设足够大
+            if (endSeq <= ack) {
+                rttValid = head.retries == 0;
+                sentAt = head.last_send_time;
+                if (head.sacked) {
+                    --sacked_count;
+                } else {
+                    rack_update(head, t);
+                }
+                send_queue.pop_front();
+            } else {
+                break;
+            }
+        }
+        snd_una = ack;
+        dup_ack_cnt = 0;
+        delivered = true;
+        if (rttValid) {
+            rtt_sample(std::chrono::duration_cast<std::chrono::microseconds>(t - sentAt).count());
+        }
+        if (send_queue.empty() && send_limit == LIMIT_APP) set_send_limit(LIMIT_IDLE);
+    }
+    if (peer_sack && sackRight != sackLeft && !send_queue.empty()) {
+        if (!delivered) t = now();
+        delivered |= on_sack(sackLeft, sackRight, t);
+    }
+    if (delivered) {
+        last_delivery = t;
+        tlp_fired = false;
+        // 队头比最近送达的段发得早 (或有段被 SACK 越过) 时才需要检查，按序确认时不扫描
+        if (peer_sack && !send_queue.empty() &&
+            (sacked_count > 0 || send_queue.front().last_send_time < rack_xmit_time)) {
+            rack_detect_loss(t);
+        }
+    }
+
+    if (ack == snd_una && len == 0 && !send_queue.empty()) {
+        // 只有窗口没变的纯 ACK 才是重复 ACK；接收方读走数据后发的窗口更新不算
+        bool dupAck = sackAck || ntohl(header.window_size) == rwnd;
+        if (dupAck) ++stats.dup_acks_received;
+        // 对端不支持 SACK 时退回按重复 ACK 计数的快速重传
+        if (dupAck && !peer_sack && ++dup_ack_cnt >= dup_ack_threshold()) {
+            auto& seg = send_queue.front();
+            if (seg.seq == snd_una) retransmit(seg, RETRANSMIT_FAST, now());
+            dup_ack_cnt = 0;  // 为了简单，重传后可以清零
+        }
+    }
+    // 关键修复：无论 ACK 是否推进，都要更新 rwnd (处理 Window Update 包)
+    rwnd = ntohl(header.window_size);
+
+    // --- 2. 处理接收数据 (写入接收缓冲) ---
+    if (len == 0) return true;
+    uint32_t seq = seqNum;  // 使用已转换的本地变量
+    int32_t diff = (int32_t)(seq - rcv_nxt);
+
+    ++stats.segments_received;
+    if (diff == 0) {
+        // 正好是期望的包 (seq == rcv_nxt)
+        if (get_window_size() < len * sizeof(char)) {
+            // 接收窗口不足，丢弃包，但必须回复 ACK 告诉对方现在的窗口大小
+            if (trace) trace_event(TRACE_PACKET_DROPPED, DROP_RCV_WINDOW, seq, 0, get_window_size(), len);
+            send_packet(FLAG_ACK);
+            return false;
+        }
+        if (fec_rx.active()) fec_rx.on_data(seq, data, len);
+        uint32_t deliveredFrom = rcv_nxt;
+        // 乱序缓冲里接得上的数据已经在环里的位置上，insert 合并块表推进 rx.next()；
+        // 无序交付模式下数据段一到就交给上层，环里只记范围
+        uint32_t before = rx.next();
+        if (segment_handler) {
+            segment_handler(data, len);
+            rcv_space_adjust(len);
+            rx.insert(seq, nullptr, len);
+            rx.skip();
+        } else {
+            rx.insert(seq, data, len);
+        }
+        // 接收端 RTT 按这个段本身推进 (不算接上的乱序数据)
+        rcv_nxt += len;
+        rcv_rtt_measure();
+        rcv_nxt = deliveredFrom + (rx.next() - before);
+        stats.bytes_received += rcv_nxt - deliveredFrom;
+        // 只有真的收到了数据才回复 ACK
+        send_packet(FLAG_ACK);
+    } else if (diff > 0) {
+        // 未来的包（乱序），存起来；超出通告窗口的不收 (否则乱序缓冲可以无限增长)
+        if (uint32_t(diff) + len > get_window_size()) {
+            if (trace) trace_event(TRACE_PACKET_DROPPED, DROP_RCV_WINDOW, seq, 0, get_window_size(), len);
+            send_packet(FLAG_ACK);
+            return false;
+        }
+        int added = rx.insert(seq, segment_handler ? nullptr : data, len);
+        if (added < 0) {
+            // 空洞太多，乱序块表满了：当作没收到，等对端重传
+            if (trace) trace_event(TRACE_PACKET_DROPPED, DROP_OOO_FULL, seq, 0, get_window_size(), len);
+            send_packet(FLAG_ACK);
+            return false;
+        }
+        // 无序交付模式：第一次收到就立即交给上层 (重传的重复段不再交付)，不被前面的空洞挡住
+        if (added > 0) {
+            if (segment_handler) segment_handler(data, len);
+            ++stats.ooo_segments;
+        } else {
+            ++stats.duplicate_segments;
+        }
+        if (fec_rx.active()) fec_rx.on_data(seq, data, len);
+        // 回复我们期望的 seq (即 rcv_nxt)，带上收到的乱序块，触发对方重传空洞
+        if (peer_sack) {
+            send_sack(seq, len);
+        } else {
+            send_packet(FLAG_ACK);
+        }
+    }
+    // diff < 0 的是重复包，直接丢弃，但也要回 ACK 确认
+    else {
+        ++stats.duplicate_segments;
+        if (trace) trace_event(TRACE_PACKET_DROPPED, DROP_DUPLICATE, seq, 0, 0, len);
+        send_packet(FLAG_ACK);
+    }
+    return false;
+}
+
 void TCPConnection::send_packet(uint8_t flags, const char* data, int len) {
     TCPHeader header;
     memset(&header, 0, sizeof(header));
@@ -320,46 +970,81 @@ void TCPConnection::send_packet(uint8_t flags, const char* data, int len) {
     header.ack_num = htonl(rcv_nxt);
     header.flags = flags;
     header.length = len;
-    header.window_size = htonl(get_window_size());  // TODO: 实现接收窗口通告
-
-    std::vector<char> packet;
-    packet.resize(sizeof(TCPHeader) + len);
+    header.window_size = htonl(advertise_window());
+    header.unused = fec_rx.loss_feedback();
 
-    memcpy(packet.data(), &header, sizeof(header));
-    if (data && len > 0) {
-        memcpy(packet.data() + sizeof(TCPHeader), data, len);
-    }
-
-    header.checksum = calculate_checksum(packet.data(), packet.size());
-    TCPHeader* h = (TCPHeader*)packet.data();
-    h->checksum = header.checksum;
-
-    socket.send_to(packet.data(), packet.size(), peer_ip, peer_port);
+    transmit(header, data, len);
 }
 
 // 重载：指定 Seq 发送数据包 (用于重传/Sliding Window)
-void TCPConnection::send_packet(const char* data, int len, uint32_t seq) {
+void TCPConnection::send_packet(const char* data, int len, uint32_t seq, uint8_t flags) {
     TCPHeader header;
     memset(&header, 0, sizeof(header));
 
     header.seq_num = htonl(seq);      // 指定 SEQ
     header.ack_num = htonl(rcv_nxt);  // 永远带上最新的 ACK
-    header.flags = FLAG_ACK;          // 数据包通常带 ACK
+    header.flags = flags;             // 数据包通常带 ACK
     header.length = len;
-    header.window_size = htonl(get_window_size());
+    header.window_size = htonl(advertise_window());
+    header.unused = fec_rx.loss_feedback();
 
-    std::vector<char> packet;
-    packet.resize(sizeof(TCPHeader) + len);
-    memcpy(packet.data(), &header, sizeof(header));
+    transmit(header, data, len);
+}
+
+void TCPConnection::transmit(TCPHeader& header, const char* data, int len) {
+    size_t total = sizeof(TCPHeader) + len;
+    if (tx_buf.size() < total) tx_buf.resize(std::max<size_t>(total, MAX_PACKET_SIZE));
+
+    memcpy(tx_buf.data(), &header, sizeof(header));
     if (data && len > 0) {
-        memcpy(packet.data() + sizeof(TCPHeader), data, len);
+        memcpy(tx_buf.data() + sizeof(TCPHeader), data, len);
     }
 
-    header.checksum = calculate_checksum(packet.data(), packet.size());
-    TCPHeader* h = (TCPHeader*)packet.data();
+    header.checksum = calculate_checksum(tx_buf.data(), total);
+    TCPHeader* h = (TCPHeader*)tx_buf.data();
     h->checksum = header.checksum;
 
-    socket.send_to(packet.data(), packet.size(), peer_ip, peer_port);
+    if (trace) {
+        trace_event(TRACE_PACKET_SENT, header.flags, ntohl(header.seq_num), ntohl(header.ack_num),
+                    ntohl(header.window_size), len);
+    }
+    if (env) {
+        env->send_to(tx_buf.data(), total, peer);
+    } else if (peer_connected) {
+        socket.send(tx_buf.data(), total);
+    } else {
+        socket.send_to(tx_buf.data(), total, peer);
+    }
+}
+
+void TCPConnection::receive_datagram(const char* data, int bytes, const Endpoint& src, bool verified,
+                                     bool checksum_ok) {
+    trace_clock();
+
+    // 解析 Header
+    if (bytes < int(sizeof(TCPHeader))) {
+        if (trace) trace_event(TRACE_PACKET_DROPPED, DROP_CHECKSUM, 0, 0, 0, bytes);
+        return;
+    }
+
+    const TCPHeader* header = (const TCPHeader*)data;
+
+    // 0. 校验和检查
+    if (verified ? !checksum_ok : calculate_checksum(data, bytes) != 0) {
+        if (trace) trace_event(TRACE_PACKET_DROPPED, DROP_CHECKSUM, 0, 0, 0, bytes - sizeof(TCPHeader));
+        return;
+    }
+
+    // 调用状态机
+    if (trace) {
+        trace_event(TRACE_PACKET_RECEIVED, header->flags, ntohl(header->seq_num), ntohl(header->ack_num),
+                    ntohl(header->window_size), bytes - sizeof(TCPHeader));
+    }
+    {
+        MYTCP_PROFILE_SCOPE(PROF_PROCESS_PACKET);
+        process_packet(*header, data + sizeof(TCPHeader), bytes - sizeof(TCPHeader), src);
+    }
+    if (trace) trace_changes();
 }
 
 uint16_t TCPConnection::calculate_checksum(const void* data, size_t len) {
@@ -391,24 +1076,52 @@ bool TCPConnection::send(const void* data, size_t len) {
 
     // 2. 计算有效发送窗口
     uint32_t win = std::min(cwnd, rwnd);
-    if (flight_size >= win) return false;  // 窗口满了
-
-    uint32_t effective_window = win - flight_size;
-
-    // 3. 判断该包是否可发
-    if (effective_window < len) return false;
-
-    // 4. 创建这个包的缓存，并且发出
-    std::vector<char> data_vec;
-    const char* p = static_cast<const char*>(data);
-    data_vec.assign(p, p + len);
+    // 开启 FEC 时校验段也占拥塞窗口，数据段只能用其中 k / (k + m)
+    if (fec_tx.enabled() && peer_fec) win = std::min(rwnd, fec_tx.data_share(cwnd));
+    // 3. 判断该包是否可发 (窗口满了或放不下这个包时，记下是哪个窗口挡住的)
+    if (flight_size >= win || win - flight_size < len) {
+        set_send_limit(rwnd <= win ? LIMIT_RWND : LIMIT_CWND);
+        return false;
+    }
+    // 窗口有余量，但还没到这个段的发送时间
+    auto t = now();
+    if (pacing_blocked(t)) {
+        set_send_limit(LIMIT_PACING);
+        return false;
+    }
+    if ((own_limit || shared_limit) && !rate_acquire(len, t)) {
+        rate_blocked_len = len;
+        set_send_limit(LIMIT_RATE);
+        return false;
+    }
+    rate_blocked_len = 0;
 
-    // 构造段，使用当前的 snd_nxt
-    SendSegment segment{snd_nxt, uint32_t(len), data_vec, std::chrono::steady_clock::now()};
-    send_queue.emplace_back(segment);
+    // 4. 在发送队列里原地构造这个段 (复用已确认段的槽位和缓冲)，使用当前的 snd_nxt，并且发出
+    SendSegment& segment = send_queue.push_back(snd_nxt, data, len, t);
+    if (trace) trace_time = segment.last_send_time;
 
     // 发送 (使用带 seq 的重载)
-    send_packet(segment.data.data(), len, segment.seq);
+    if (synack_pending && len + TFO_COOKIE_LEN <= MAX_PACKET_SIZE - sizeof(TCPHeader)) {
+        // Fast Open：第一个响应搭在推迟的 SYN-ACK 上
+        send_synack(segment.data.data(), len, segment.seq);
+        synack_pending = false;
+    } else {
+        if (synack_pending) {
+            send_synack();
+            synack_pending = false;
+        }
+        send_packet(segment.data.data(), len, segment.seq);
+    }
+    ++send_counters.data_segments;
+    stats.bytes_sent += len;
+    pacing_charge(uint32_t(len), t);
+    set_send_limit(LIMIT_APP);
+
+    // FEC：新数据段累加进当前组，组满就发校验段
+    if (fec_tx.enabled() && peer_fec && state == ESTABLISHED) {
+        fec_tx.add(segment.seq, segment.data.data(), len, segment.last_send_time);
+        if (fec_tx.full()) emit_fec_group();
+    }
 
     // 推进 snd_nxt
     snd_nxt += len;
@@ -417,44 +1130,106 @@ bool TCPConnection::send(const void* data, size_t len) {
 }
 
 void TCPConnection::check_timeout() {
-    auto current_time = std::chrono::steady_clock::now();
+    auto current_time = now();
+    if (trace) trace_time = current_time;
+    auto since_syn = std::chrono::duration_cast<std::chrono::milliseconds>(current_time - syn_time).count();
+
+    // 挥手：FIN 没被确认就按 RTO 退避重发，重发 MAX_FIN_RETRIES 次后放弃；FIN_WAIT_2 / TIME_WAIT 到期后结束
+    if (state == FIN_WAIT_1 || state == CLOSING || state == LAST_ACK) {
+        if (current_time - close_timer >= std::chrono::milliseconds(RTO << fin_retries)) {
+            if (fin_retries >= MAX_FIN_RETRIES) {
+                finish_close();
+                return;
+            }
+            ++fin_retries;
+            if (trace) trace_event(TRACE_RETRANSMIT, RETRANSMIT_RTO, fin_seq, 0, 0, 0, fin_retries);
+            send_fin();
+        }
+    } else if (state == FIN_WAIT_2 || state == TIME_WAIT) {
+        if (current_time - close_timer >= time_wait) {
+            finish_close();
+            return;
+        }
+    }
+
+    // 握手阶段：SYN 丢了按 RTO 退避重发，重发 MAX_SYN_RETRIES 次还没有回应就放弃连接；
+    // 队列里的 early data 在握手完成前不能按普通数据段重传
+    if (state == SYN_SENT) {
+        if (since_syn >= (RTO << syn_retries)) {
+            if (syn_retries >= MAX_SYN_RETRIES) {
+                finish_close();
+                return;
+            }
+            ++syn_retries;
+            send_syn();
+        }
+        return;
+    }
+    // 应用在推迟期限内没有响应，SYN-ACK 单独发出
+    if (synack_pending && since_syn >= TFO_SYNACK_DELAY) {
+        send_synack();
+        synack_pending = false;
+    }
+    // 一段时间没有新数据，没攒满的组先出校验，尾部的丢包也能恢复
+    if (!fec_tx.empty() && current_time - fec_tx.last_add_time() >= std::chrono::milliseconds(FEC_FLUSH_MS)) {
+        emit_fec_group();
+    }
 
+    // RACK：重排窗口到期，再判一次
+    if (rack_timer != std::chrono::steady_clock::time_point{} && current_time >= rack_timer) {
+        rack_detect_loss(current_time);
+    }
     // 必须用引用 auto&，否则修改无效！
+    bool rto_fired = false;
     for (auto& seg : send_queue) {
+        if (seg.sacked) continue;
         auto pass_time =
             std::chrono::duration_cast<std::chrono::milliseconds>(current_time - seg.last_send_time).count();
-        if (pass_time >= RTO) {
-            // std::cout << "[TCP] Timeout! Retransmit seq=" << seg.seq << " len=" << seg.len << std::endl;
-            // 重传：必须使用当时原本的 SEQ
-            send_packet(seg.data.data(), seg.len, seg.seq);
+        if (pass_time < RTO) continue;
+        rto_fired = true;
+        // 整窗超时时按发送节奏分批重传，剩下的留给下一次 check_timeout
+        if (pacing_blocked(current_time)) break;
+        // 重传：必须使用当时原本的 SEQ
+        retransmit(seg, RETRANSMIT_RTO, current_time);
+    }
 
-            seg.last_send_time = current_time;
-            seg.retries++;
+    // TLP：在途的数据 2 x SRTT 没有任何确认，重发最后一个段，引出 SACK 让 RACK 接手，不用等 RTO；
+    // PTO 不受 RTO 大小限制 (高 RTT 路径上也探测)，同一时刻 RTO 也到期时由 RTO 重传，不再探测
+    if (peer_sack && !tlp_fired && !rto_fired && !send_queue.empty() && stats.srtt_us > 0) {
+        auto pto = std::max(std::chrono::microseconds(2 * uint64_t(stats.srtt_us)),
+                            std::chrono::microseconds(TLP_MIN_MS * 1000));
+        auto last = std::max(last_delivery, send_queue.back().last_send_time);
+        if (current_time - last >= pto) {
+            for (size_t i = send_queue.size(); i-- > 0;) {
+                if (send_queue[i].sacked) continue;
+                retransmit(send_queue[i], RETRANSMIT_TLP, current_time);
+                break;
+            }
+            tlp_fired = true;
         }
     }
 }
 
 size_t TCPConnection::receive(void* buffer, size_t maxLen) {
-    if (in_buffer.empty()) {
-        // 如果buffer空了，而且处于 CLOSE_WAIT，说明对方发过 FIN 了，我们也读完了
-        if (state == CLOSE_WAIT) {
+    if (rx.readable() == 0) {
+        // 如果buffer空了，而且对方发过 FIN 了 (CLOSE_WAIT，或本端先关闭后的 CLOSING / TIME_WAIT)，说明我们也读完了
+        if (state == CLOSE_WAIT || state == CLOSING || state == TIME_WAIT) {
             return -1;  // EOF 信号
         }
         return 0;
     }
 
-    size_t copyLen = std::min(maxLen, in_buffer.size());
-    std::copy(in_buffer.begin(), in_buffer.begin() + copyLen, (char*)buffer);
-
-    // 移除已读取的数据
     auto old_window_size = get_window_size();
-    in_buffer.erase(in_buffer.begin(), in_buffer.begin() + copyLen);
+    size_t copyLen = rx.read(buffer, maxLen);
+    rcv_space_adjust(copyLen);
     auto new_window_size = get_window_size();
 
     // Clark算法简化版：或者从 0 变有，或者腾出了显著空间 (MSS)
     if (old_window_size == 0 && new_window_size > 0) {
+        trace_clock();
         send_packet(FLAG_ACK);
     } else if (new_window_size - old_window_size >= 1400) {
+        trace_clock();
         send_packet(FLAG_ACK);
     }
 
@@ -462,33 +1237,108 @@ size_t TCPConnection::receive(void* buffer, size_t maxLen) {
 }
 
 void TCPConnection::close() {
-    // 1. 发送 FIN 包
-    send_packet(FLAG_FIN | FLAG_ACK);
-
-    // 2. 状态变更
+    trace_clock();
+    // 只有连接还开着时才需要发 FIN；重复调用不再发，丢了由 check_timeout 重发
     if (state == ESTABLISHED) {
         state = FIN_WAIT_1;  // 主动关闭
     } else if (state == CLOSE_WAIT) {
         state = LAST_ACK;  // 被动关闭
+    } else {
+        return;
     }
+    fin_seq = snd_nxt++;
+    fin_retries = 0;
+    send_fin();
+    if (trace) trace_changes();
+}
+
+void TCPConnection::send_fin() {
+    send_packet(nullptr, 0, fin_seq, FLAG_FIN | FLAG_ACK);
+    close_timer = now();
+}
+
+bool TCPConnection::accept_fin(uint32_t seq) {
+    bool accepted = seq == rcv_nxt;
+    if (accepted) rcv_nxt += 1;
+    // 数据还没收齐 (FIN 比最后的数据段先到) 时回的是重复 ACK，对端补发数据后会重发 FIN
+    send_packet(FLAG_ACK);
+    return accepted;
+}
+
+bool TCPConnection::ack_fin(uint32_t ack) {
+    if (int32_t(ack - snd_una) <= 0 || int32_t(ack - snd_nxt) > 0) return false;
+    while (!send_queue.empty() && int32_t(send_queue.front().seq + send_queue.front().len - ack) <= 0) {
+        if (send_queue.front().sacked) --sacked_count;
+        send_queue.pop_front();
+    }
+    snd_una = ack;
+    return ack == snd_nxt;
+}
+
+void TCPConnection::enter_time_wait() {
+    state = TIME_WAIT;
+    close_timer = now();
+}
+
+void TCPConnection::finish_close() {
+    clear_connection();
+    state = listening ? LISTEN : CLOSED;
+    if (trace) trace_changes();
 }
 
 void TCPConnection::reset() {
-    // TODO: 实现状态重置逻辑 (用于 Server 重用 Connection)
-    // 1. 清空发送/接收队列
-    // 2. 重置 seq, ack, window 等变量
-    // 3. state = LISTEN
-    in_buffer.clear();
+    trace_clock();
+    clear_connection();
+    state = LISTEN;
+    if (trace) trace_changes();
+}
+
+void TCPConnection::clear_connection() {
     send_queue.clear();
-    out_of_order_buffer.clear();
+    rx.reset(0);
+    peer_fec = false;
+    peer_sack = false;
+    sacked_count = 0;
+    rack_xmit_time = rack_timer = last_delivery = {};
+    rack_end_seq = 0;
+    rack_rtt = {};
+    tlp_fired = false;
+    fec_rx.reset();
+    fec_tx.next_group();
     snd_una = 0;
     snd_nxt = 0;
     rcv_nxt = 0;
     dup_ack_cnt = 0;
     rwnd = MAX_RWND;
-
-    peer_ip = {};
-    peer_port = {};
-
-    state = LISTEN;
+    tfo_peer = false;
+    synack_pending = false;
+    syn_payload.clear();
+    syn_retries = 0;
+
+    // 接收缓冲回到初始大小，RTT 估计从头开始
+    if (rcvbuf > RCVBUF_INIT) {
+        budget->release(rcvbuf - RCVBUF_INIT);
+        rcvbuf = RCVBUF_INIT;
+    } else if (rcvbuf < RCVBUF_INIT) {
+        rcvbuf += budget->reserve_up_to(RCVBUF_INIT - rcvbuf);
+    }
+    rcv_wnd_edge = 0;
+    rcv_rtt_us = 0;
+    rcv_rtt_active = false;
+    syn_retransmitted = false;
+    synack_sent = false;
+    rcv_space = 0;
+    rcv_copied = 0;
+    pacing_next = {};
+    rate_blocked_len = 0;
+    // 计数器跨连接累计，RTT 估计属于上一个对端
+    stats.srtt_us = stats.rttvar_us = stats.min_rtt_us = 0;
+    set_send_limit(LIMIT_IDLE);
+
+    if (peer_connected) {
+        socket.disconnect();
+        peer_connected = false;
+    }
+    peer = {};
+    fin_retries = 0;
 }
@@ -0,0 +1,419 @@
+#include "tcp_engine.h"
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#else
+#include <fcntl.h>
+#endif
+
+#include "latency_profile.h"
+#include "tcp_protocol.h"
+
+// ---------------- WakeupFd ----------------
+
+WakeupFd::WakeupFd() {
+#ifdef __linux__
+    read_fd = write_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+    int fds[2];
+    if (pipe(fds) == 0) {
+        read_fd = fds[0];
+        write_fd = fds[1];
+        fcntl(read_fd, F_SETFL, fcntl(read_fd, F_GETFL, 0) | O_NONBLOCK);
+        fcntl(write_fd, F_SETFL, fcntl(write_fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+#endif
+}
+
+WakeupFd::~WakeupFd() {
+    if (read_fd >= 0) ::close(read_fd);
+    if (write_fd >= 0 && write_fd != read_fd) ::close(write_fd);
+}
+
+void WakeupFd::notify() {
+#ifdef __linux__
+    uint64_t one = 1;
+    ssize_t ret = ::write(write_fd, &one, sizeof(one));
+#else
+    char one = 1;
+    ssize_t ret = ::write(write_fd, &one, sizeof(one));
+#endif
+    (void)ret;  // 计数器溢出 / pipe 写满都说明对方已经有待处理的唤醒，忽略即可
+}
+
+void WakeupFd::drain() {
+    char buf[64];
+    while (::read(read_fd, buf, sizeof(buf)) > 0) {
+    }
+}
+
+// ---------------- IngressRing ----------------
+
+void IngressRing::init(size_t count) {
+    size_t cap = 1;
+    while (cap < count) cap <<= 1;
+    slots.resize(cap);
+    mask = cap - 1;
+}
+
+const char* IngressRing::front_packet(int& len, Endpoint& src, bool& checksum_ok) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) return nullptr;
+    const Slot& s = slots[h & mask];
+    len = s.len;
+    src = s.src;
+    checksum_ok = s.checksum_ok;
+    return s.data;
+}
+
+// ---------------- TCPEngine ----------------
+
+namespace {
+// 单个数据段的最大负载
+const size_t ENGINE_MSS = MAX_PACKET_SIZE - sizeof(TCPHeader);
+// 收包环的槽位数 (每个约 1.7 KB)；满了收包线程就不再读 socket，包留在内核缓冲里
+const size_t INGRESS_SLOTS = 1024;
+// 收包线程一次系统调用最多收的包数
+const size_t INGRESS_BATCH = 32;
+
+// 把最多 n 个包收进收包环的前 n 个空闲槽位，返回收到的包数 (没有包时为 0)
+size_t receive_batch(socket_t fd, IngressRing& ring, size_t n) {
+#ifdef __linux__
+    mmsghdr msgs[INGRESS_BATCH];
+    iovec iovs[INGRESS_BATCH];
+    n = std::min(n, INGRESS_BATCH);
+    for (size_t i = 0; i < n; ++i) {
+        IngressRing::Slot& s = ring.producer_slot(i);
+        iovs[i] = {s.data, sizeof(s.data)};
+        msgs[i] = {};
+        msgs[i].msg_hdr.msg_name = &s.src.addr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(s.src.addr);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int got = recvmmsg(fd, msgs, unsigned(n), MSG_DONTWAIT, nullptr);
+    if (got <= 0) return 0;
+    for (int i = 0; i < got; ++i) {
+        IngressRing::Slot& s = ring.producer_slot(i);
+        s.len = int(msgs[i].msg_len);
+        s.src.len = msgs[i].msg_hdr.msg_namelen;
+    }
+    return size_t(got);
+#else
+    size_t got = 0;
+    for (; got < n && got < INGRESS_BATCH; ++got) {
+        IngressRing::Slot& s = ring.producer_slot(got);
+        s.src.len = sizeof(s.src.addr);
+        int ret = recvfrom(fd, s.data, sizeof(s.data), 0, (sockaddr*)&s.src.addr, &s.src.len);
+        if (ret < 0) break;
+        s.len = ret;
+    }
+    return got;
+#endif
+}
+}  // namespace
+
+TCPEngine::TCPEngine(size_t ring_capacity) : tx_ring(ring_capacity), rx_ring(ring_capacity) {}
+
+TCPEngine::~TCPEngine() { stop(); }
+
+bool TCPEngine::bind(int port) {
+    if (running.load()) return false;
+    if (!conn.bind(port)) return false;
+    start();
+    return true;
+}
+
+bool TCPEngine::connect(const std::string& ip, int port) {
+    if (running.load()) return false;
+    if (!conn.connect(ip, port)) return false;
+    start();
+    return true;
+}
+
+void TCPEngine::start() {
+    state.store(conn.get_state(), std::memory_order_release);
+    running.store(true);
+    if (split_io) {
+        ingress.init(INGRESS_SLOTS);
+        conn.set_packet_source(&ingress);
+        ingress_worker = std::thread(&TCPEngine::run_ingress, this);
+    }
+    worker = std::thread(&TCPEngine::run, this);
+}
+
+void TCPEngine::stop() {
+    if (!running.exchange(false)) return;
+    engine_wakeup.notify();
+    ingress_wakeup.notify();
+    if (worker.joinable()) worker.join();
+    if (ingress_worker.joinable()) ingress_worker.join();
+    state.store(CLOSED, std::memory_order_release);
+}
+
+bool TCPEngine::send(const void* data, size_t len) {
+    if (tx_ring.free_space() < len) return false;
+    tx_ring.write(data, len);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (engine_idle.load(std::memory_order_relaxed)) engine_wakeup.notify();
+    return true;
+}
+
+bool TCPEngine::send_all(const void* data, size_t len) {
+    const char* p = static_cast<const char*>(data);
+    while (len > 0) {
+        if (!running.load() || get_state() == CLOSED) return false;
+
+        size_t n = tx_ring.write(p, len);
+        p += n;
+        len -= n;
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (n > 0 && engine_idle.load(std::memory_order_relaxed)) engine_wakeup.notify();
+        if (len > 0) update();
+    }
+    return true;
+}
+
+size_t TCPEngine::receive(void* buffer, size_t maxLen) {
+    size_t n = rx_ring.read(buffer, maxLen);
+    if (n == 0 && eof.load(std::memory_order_acquire)) {
+        // 协议线程先写完数据再置 eof，这里再读一次确保不漏掉最后一批数据
+        n = rx_ring.read(buffer, maxLen);
+        if (n == 0) return -1;  // EOF 信号
+    }
+    if (n > 0) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (engine_idle.load(std::memory_order_relaxed)) engine_wakeup.notify();  // 接收环腾出了空间
+    }
+    return n;
+}
+
+size_t TCPEngine::receive_wait(void* buffer, size_t maxLen, int timeout_ms) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true) {
+        size_t n = receive(buffer, maxLen);
+        if (n != 0) return n;
+        if (!running.load()) return 0;
+        if (timeout_ms >= 0 && std::chrono::steady_clock::now() >= deadline) return 0;
+        update();
+    }
+}
+
+void TCPEngine::update() {
+    // 接收环里还有数据没读，说明应用有活可干，不睡
+    if (!rx_ring.empty()) return;
+
+    app_waiting.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    pollfd pfd{app_wakeup.fd(), POLLIN, 0};
+    poll(&pfd, 1, 1);
+    app_wakeup.drain();
+
+    app_waiting.store(false, std::memory_order_relaxed);
+}
+
+bool TCPEngine::is_send_complete() const {
+    return tx_ring.empty() && send_complete.load(std::memory_order_acquire);
+}
+
+void TCPEngine::close() {
+    close_requested.store(true, std::memory_order_release);
+    engine_wakeup.notify();
+}
+
+void TCPEngine::reset() {
+    if (!running.load()) {
+        conn.reset();
+        return;
+    }
+
+    reset_phase.store(1, std::memory_order_release);
+    engine_wakeup.notify();
+    while (reset_phase.load(std::memory_order_acquire) != 2) update();
+
+    // 协议线程已经重置了连接并清空了发送环，由我们 (接收环的消费者) 清空接收环
+    rx_ring.consume(rx_ring.size());
+    reset_phase.store(0, std::memory_order_release);
+    engine_wakeup.notify();
+}
+
+void TCPEngine::pump_tx() {
+    TCPState s = conn.get_state();
+    if (s != ESTABLISHED && s != CLOSE_WAIT) return;
+
+    char chunk[ENGINE_MSS];
+    while (true) {
+        size_t n = tx_ring.peek(chunk, sizeof(chunk));
+        if (n == 0) break;
+        if (!conn.send(chunk, n)) break;  // 窗口满了，等 ACK
+
+        // 先标记 "有未确认数据" 再从环中移除，保证应用侧 is_send_complete() 不会看到两边同时为空
+        send_complete.store(false, std::memory_order_release);
+        tx_ring.consume(n);
+    }
+}
+
+void TCPEngine::pump_rx() {
+    char buf[16 * 1024];
+    while (true) {
+        size_t room = std::min(sizeof(buf), rx_ring.free_space());
+        if (room == 0) break;
+
+        size_t n = conn.receive(buf, room);
+        if (n == (size_t)-1) {
+            eof.store(true, std::memory_order_release);
+            break;
+        }
+        if (n == 0) break;
+        rx_ring.write(buf, n);
+    }
+}
+
+void TCPEngine::wait_for_io(std::chrono::microseconds timeout, size_t tx_seen) {
+    engine_idle.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // 睡前再确认一次没有新的请求 (应用可能在 engine_idle 置位前写入了数据，那时它不会发通知；
+    // split 模式下收包线程同理)
+    bool has_work = tx_ring.size() != tx_seen || close_requested.load() || reset_phase.load() == 1 ||
+                    !running.load() || (split_io && !ingress.empty());
+    if (!has_work) {
+        // split 模式下 socket 归收包线程读，新包到达由它唤醒
+        pollfd pfds[2] = {{engine_wakeup.fd(), POLLIN, 0}, {(int)conn.native_handle(), POLLIN, 0}};
+        // 微秒精度：发送节奏要求在两个段之间只睡几十到几百微秒
+        timespec ts{time_t(timeout.count() / 1000000), long(timeout.count() % 1000000) * 1000};
+        ppoll(pfds, split_io ? 1 : 2, &ts, nullptr);
+    }
+    engine_wakeup.drain();
+
+    engine_idle.store(false, std::memory_order_relaxed);
+}
+
+void TCPEngine::publish_info() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - info_published < std::chrono::milliseconds(100)) return;
+    info_published = now;
+    TCPInfo snapshot = conn.info();
+    std::lock_guard<std::mutex> lock(info_mutex);
+    info_snapshot = snapshot;
+}
+
+TCPInfo TCPEngine::info() const {
+    std::lock_guard<std::mutex> lock(info_mutex);
+    return info_snapshot;
+}
+
+void TCPEngine::run() {
+    profile_set_thread_name("engine");
+    while (running.load()) {
+        int phase = reset_phase.load(std::memory_order_acquire);
+        if (phase == 1) {
+            conn.reset();
+            tx_ring.consume(tx_ring.size());
+            eof.store(false);
+            close_requested.store(false);
+            send_complete.store(true);
+            reset_phase.store(2, std::memory_order_release);
+            app_wakeup.notify();
+        }
+
+        size_t rx_before = rx_ring.size();
+        size_t tx_before = tx_ring.size();
+        TCPState before = conn.get_state();
+
+        if (phase == 0) pump_tx();
+        conn.update();
+        if (phase == 0) {
+            pump_rx();
+            pump_tx();  // update() 处理了 ACK，窗口可能已经打开
+        }
+
+        if (close_requested.load(std::memory_order_acquire) && tx_ring.empty() && conn.is_send_complete()) {
+            TCPState s = conn.get_state();
+            if (s == ESTABLISHED || s == CLOSE_WAIT) {
+                conn.close();
+                close_requested.store(false);
+            } else if (s != SYN_SENT && s != SYN_RCVD) {
+                close_requested.store(false);
+            }
+        }
+
+        TCPState after = conn.get_state();
+        // 上一个连接挥手结束 (或被新的 SYN 取代)：应用已经读到过它的 EOF，新连接从头开始
+        if (after != before && (after == LISTEN || after == SYN_RCVD)) eof.store(false, std::memory_order_release);
+        bool idle_conn = conn.is_send_complete();
+        bool became_complete = idle_conn && !send_complete.load(std::memory_order_relaxed);
+        if (idle_conn) send_complete.store(true, std::memory_order_release);
+        state.store(after, std::memory_order_release);
+        publish_info();
+
+        size_t tx_after = tx_ring.size();
+        bool progressed = rx_ring.size() != rx_before || tx_after != tx_before || after != before ||
+                          eof.load(std::memory_order_relaxed) || became_complete;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (progressed && app_waiting.load(std::memory_order_relaxed)) app_wakeup.notify();
+        // update() 处理掉了收包环里的包：收包线程如果在等槽位，叫醒它
+        if (ingress_waiting.load(std::memory_order_relaxed) && ingress.free_slots() > 0) ingress_wakeup.notify();
+
+        // 有未确认数据时需要按 ms 粒度检查重传，否则可以睡得久一点 (新包到达会立即唤醒)；
+        // 被发送节奏或限速挡住时只睡到下一个段可以发出的时刻
+        std::chrono::microseconds timeout = std::chrono::milliseconds(idle_conn && tx_after == 0 ? 20 : 1);
+        if (!idle_conn || tx_after > 0) {
+            auto pace = conn.pacing_delay();
+            if (pace.count() > 0) timeout = std::min(timeout, pace);
+        }
+        wait_for_io(timeout, tx_after);
+    }
+}
+
+void TCPEngine::run_ingress() {
+    profile_set_thread_name("ingress");
+    socket_t fd = conn.native_handle();
+    while (running.load(std::memory_order_relaxed)) {
+        size_t room = ingress.free_slots();
+        if (room == 0) {
+            // 协议线程跟不上：先不读 socket (包留在内核缓冲里)，睡到它处理完一批、腾出槽位。
+            // 置位后再检查一次，避免协议线程在置位之前腾出了槽位、没有发通知 (同 wait_for_io)
+            ingress_waiting.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (ingress.free_slots() == 0 && running.load(std::memory_order_relaxed)) {
+                pollfd pfd = {ingress_wakeup.fd(), POLLIN, 0};
+                poll(&pfd, 1, 100);
+            }
+            ingress_waiting.store(false, std::memory_order_relaxed);
+            ingress_wakeup.drain();
+            continue;
+        }
+
+        size_t got = receive_batch(fd, ingress, room);
+        if (got > 0) {
+            // 校验和在这里算，协议线程只看结果
+            for (size_t i = 0; i < got; ++i) {
+                IngressRing::Slot& s = ingress.producer_slot(i);
+                s.checksum_ok =
+                    s.len >= int(sizeof(TCPHeader)) && TCPConnection::calculate_checksum(s.data, s.len) == 0;
+            }
+            ingress.push(got);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (engine_idle.load(std::memory_order_relaxed)) engine_wakeup.notify();
+            continue;
+        }
+
+        // socket 空了：睡到有包到达 (或 stop 唤醒)
+        pollfd pfds[2] = {{(int)fd, POLLIN, 0}, {ingress_wakeup.fd(), POLLIN, 0}};
+        poll(pfds, 2, 100);
+        ingress_wakeup.drain();
+    }
+}
@@ -7,6 +7,61 @@
 
 #include <cstring>
 
+bool Endpoint::resolve(const std::string &ip, int port, Endpoint &out) {
+    out = Endpoint{};
+
+    sockaddr_in *v4 = (sockaddr_in *)&out.addr;
+    if (inet_pton(AF_INET, ip.c_str(), &v4->sin_addr) == 1) {
+        v4->sin_family = AF_INET;
+        v4->sin_port = htons(port);
+        out.len = sizeof(sockaddr_in);
+        return true;
+    }
+
+    out = Endpoint{};
+    sockaddr_in6 *v6 = (sockaddr_in6 *)&out.addr;
+    if (inet_pton(AF_INET6, ip.c_str(), &v6->sin6_addr) == 1) {
+        v6->sin6_family = AF_INET6;
+        v6->sin6_port = htons(port);
+        out.len = sizeof(sockaddr_in6);
+        return true;
+    }
+
+    out = Endpoint{};
+    return false;
+}
+
+std::string Endpoint::ip() const {
+    char buf[INET6_ADDRSTRLEN] = {0};
+    if (family() == AF_INET) {
+        inet_ntop(AF_INET, &((const sockaddr_in *)&addr)->sin_addr, buf, sizeof(buf));
+    } else if (family() == AF_INET6) {
+        inet_ntop(AF_INET6, &((const sockaddr_in6 *)&addr)->sin6_addr, buf, sizeof(buf));
+    }
+    return buf;
+}
+
+int Endpoint::port() const {
+    if (family() == AF_INET) return ntohs(((const sockaddr_in *)&addr)->sin_port);
+    if (family() == AF_INET6) return ntohs(((const sockaddr_in6 *)&addr)->sin6_port);
+    return 0;
+}
+
+bool Endpoint::operator==(const Endpoint &other) const {
+    if (family() != other.family()) return false;
+    if (family() == AF_INET) {
+        const sockaddr_in *a = (const sockaddr_in *)&addr;
+        const sockaddr_in *b = (const sockaddr_in *)&other.addr;
+        return a->sin_port == b->sin_port && a->sin_addr.s_addr == b->sin_addr.s_addr;
+    }
+    if (family() == AF_INET6) {
+        const sockaddr_in6 *a = (const sockaddr_in6 *)&addr;
+        const sockaddr_in6 *b = (const sockaddr_in6 *)&other.addr;
+        return a->sin6_port == b->sin6_port && memcmp(&a->sin6_addr, &b->sin6_addr, sizeof(a->sin6_addr)) == 0;
+    }
+    return len == other.len && memcmp(&addr, &other.addr, len) == 0;
+}
+
 TCPSocket::TCPSocket() {
     sock_fd = INVALID_SOCKET;
 #ifdef _WIN32
@@ -31,8 +86,6 @@ bool TCPSocket::create() {
     // 记得检查是否 == INVALID_SOCKET
     sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
     if (sock_fd == INVALID_SOCKET) return false;
-    // int opt = 4 * 1024 * 1024;  // 4MB Buffer
-    // setsockopt(sock_fd, SOL_SOCKET, SO_RCVBUF, (const char *)&opt, sizeof(opt));
     return true;
 }
 
@@ -51,38 +104,55 @@ bool TCPSocket::bind(int port) {
     return true;
 }
 
-int TCPSocket::send_to(const void *data, int len, const std::string &target_ip, int target_port) {
+bool TCPSocket::bind(const std::string &ip, int port) {
+    if (sock_fd == INVALID_SOCKET) return false;
+
+    // socket 按 AF_INET 创建，只能绑 IPv4 地址
+    Endpoint local;
+    if (!Endpoint::resolve(ip, port, local) || local.family() != AF_INET) return false;
+    return ::bind(sock_fd, (const struct sockaddr *)&local.addr, local.len) != SOCKET_ERROR;
+}
+
+int TCPSocket::send_to(const void *data, int len, const Endpoint &target) {
     if (sock_fd == INVALID_SOCKET) return -1;
 
-    // TODO: 填写目标地址 sockaddr_in 并调用 sendto
-    sockaddr_in addr;
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(target_port);
-    addr.sin_addr.s_addr = inet_addr(target_ip.c_str());
-    if (sendto(sock_fd, (const char *)data, len, 0, (struct sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR) {
+    if (sendto(sock_fd, (const char *)data, len, 0, (const struct sockaddr *)&target.addr, target.len) ==
+        SOCKET_ERROR) {
         return -1;
     }
     return len;
 }
 
-int TCPSocket::recv_from(void *buffer, int max_len, std::string &src_ip, int &src_port) {
+int TCPSocket::recv_from(void *buffer, int max_len, Endpoint &src) {
     if (sock_fd == INVALID_SOCKET) return -1;
 
-    // TODO: 调用 recvfrom 接收数据
-    // 记得把网络字节序转换回主机字节序 (ntohs, inet_ntop 等)
-    // 更新 src_ip 和 src_port
-    sockaddr_in addr;
-    socklen_t sock_len = sizeof(addr);
-
-    int ret = recvfrom(sock_fd, buffer, max_len, 0, (struct sockaddr *)&addr, &sock_len);
+    // 地址直接写进 Endpoint，不做 inet_ntop / ntohs
+    src.len = sizeof(src.addr);
+    int ret = recvfrom(sock_fd, (char *)buffer, max_len, 0, (struct sockaddr *)&src.addr, &src.len);
     if (ret == SOCKET_ERROR) return -1;
+    return ret;
+}
+
+bool TCPSocket::connect(const Endpoint &target) {
+    if (sock_fd == INVALID_SOCKET) return false;
+    return ::connect(sock_fd, (const struct sockaddr *)&target.addr, target.len) != SOCKET_ERROR;
+}
 
-    char src_ip_n[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, (const void *)&addr.sin_addr, (char *)&src_ip_n, INET_ADDRSTRLEN);
+void TCPSocket::disconnect() {
+    if (sock_fd == INVALID_SOCKET) return;
+    // connect 到 AF_UNSPEC 会解除 UDP socket 的对端绑定
+    sockaddr_storage addr{};
+    addr.ss_family = AF_UNSPEC;
+    ::connect(sock_fd, (const struct sockaddr *)&addr, sizeof(addr));
+}
 
-    src_ip = std::string(src_ip_n);
-    src_port = ntohs(addr.sin_port);
-    return ret;
+int TCPSocket::send(const void *data, int len) {
+    if (sock_fd == INVALID_SOCKET) return -1;
+
+    if (::send(sock_fd, (const char *)data, len, 0) == SOCKET_ERROR) {
+        return -1;
+    }
+    return len;
 }
 
 void TCPSocket::close() {
@@ -96,13 +166,33 @@ void TCPSocket::close() {
     }
 }
 
+void TCPSocket::set_buffer_sizes(int rcvbuf, int sndbuf) {
+    if (sock_fd == INVALID_SOCKET) return;
+    if (rcvbuf > 0) setsockopt(sock_fd, SOL_SOCKET, SO_RCVBUF, (const char *)&rcvbuf, sizeof(rcvbuf));
+    if (sndbuf > 0) setsockopt(sock_fd, SOL_SOCKET, SO_SNDBUF, (const char *)&sndbuf, sizeof(sndbuf));
+}
+
+namespace {
+int get_buffer_option(socket_t fd, int opt) {
+    if (fd == INVALID_SOCKET) return 0;
+    int value = 0;
+    socklen_t len = sizeof(value);
+    if (getsockopt(fd, SOL_SOCKET, opt, (char *)&value, &len) == SOCKET_ERROR) return 0;
+    return value;
+}
+}  // namespace
+
+int TCPSocket::receive_buffer_size() const { return get_buffer_option(sock_fd, SO_RCVBUF); }
+
+int TCPSocket::send_buffer_size() const { return get_buffer_option(sock_fd, SO_SNDBUF); }
+
 void TCPSocket::set_non_blocking(bool nonBlocking) {
     // TODO: 选做，设置 socket 为非阻塞模式
 #ifdef _WIN32
-    u_long mode = 1;  // 1: 非阻塞, 0: 阻塞
+    u_long mode = nonBlocking ? 1 : 0;  // 1: 非阻塞, 0: 阻塞
     ioctlsocket(sock_fd, FIONBIO, &mode);
 #else
     int flags = fcntl(sock_fd, F_GETFL, 0);
-    fcntl(sock_fd, F_SETFL, flags | O_NONBLOCK);
+    fcntl(sock_fd, F_SETFL, nonBlocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK));
 #endif
 }
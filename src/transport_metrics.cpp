@@ -0,0 +1,236 @@
+#include "transport_metrics.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+const char* tcp_state_name(TCPState s) {
+    static const char* const names[] = {"CLOSED",    "LISTEN",    "SYN_SENT",   "SYN_RCVD", "ESTABLISHED", "FIN_WAIT_1",
+                                        "FIN_WAIT_2", "TIME_WAIT", "CLOSE_WAIT", "LAST_ACK", "CLOSING"};
+    return unsigned(s) < sizeof(names) / sizeof(names[0]) ? names[s] : "UNKNOWN";
+}
+
+namespace {
+
+class PromWriter {
+public:
+    explicit PromWriter(const std::string& l) : labels(l) {}
+
+    void metric(const char* name, const char* type, const char* help, double value) {
+        out += "# HELP mytcp_";
+        out += name;
+        out += ' ';
+        out += help;
+        out += "\n# TYPE mytcp_";
+        out += name;
+        out += ' ';
+        out += type;
+        out += '\n';
+        sample(name, "", value);
+    }
+    void sample(const char* name, const std::string& extra, double value) {
+        char num[32];
+        snprintf(num, sizeof(num), "%.15g", value);
+        out += "mytcp_";
+        out += name;
+        std::string all = labels.empty() ? extra : (extra.empty() ? labels : labels + "," + extra);
+        if (!all.empty()) out += "{" + all + "}";
+        out += ' ';
+        out += num;
+        out += '\n';
+    }
+    void counter(const char* name, const char* help, double v) { metric(name, "counter", help, v); }
+    void gauge(const char* name, const char* help, double v) { metric(name, "gauge", help, v); }
+
+    std::string out;
+
+private:
+    std::string labels;
+};
+
+}  // namespace
+
+std::string format_prometheus(const TCPInfo& i, const std::string& labels) {
+    PromWriter w(labels);
+    w.out += "# HELP mytcp_state Current connection state (1 for the active state)\n# TYPE mytcp_state gauge\n";
+    for (int s = CLOSED; s <= CLOSING; ++s) {
+        w.sample("state", std::string("state=\"") + tcp_state_name(TCPState(s)) + "\"", s == i.state ? 1 : 0);
+    }
+
+    w.counter("sent_bytes_total", "Payload bytes sent for the first time", i.bytes_sent);
+    w.counter("retransmitted_bytes_total", "Payload bytes retransmitted", i.bytes_retransmitted);
+    w.counter("sent_segments_total", "Data segments sent for the first time", i.segments_sent);
+    w.counter("fast_retransmits_total", "Segments retransmitted after duplicate ACKs or RACK loss detection",
+              i.fast_retransmits);
+    w.counter("rto_retransmits_total", "Segments retransmitted after a retransmission timeout", i.rto_retransmits);
+    w.counter("tlp_probes_total", "Tail loss probes sent", i.tlp_probes);
+    w.counter("dup_acks_received_total", "Duplicate ACKs received while data was in flight", i.dup_acks_received);
+
+    w.counter("received_bytes_total", "Payload bytes delivered in order", i.bytes_received);
+    w.counter("received_segments_total", "Data segments received", i.segments_received);
+    w.counter("duplicate_segments_total", "Data segments received more than once", i.duplicate_segments);
+    w.counter("ooo_segments_total", "Data segments received out of order", i.ooo_segments);
+    w.gauge("ooo_bytes", "Bytes held in the out-of-order buffer", i.ooo_bytes);
+
+    w.gauge("srtt_seconds", "Smoothed round-trip time", i.srtt_us / 1e6);
+    w.gauge("rttvar_seconds", "Round-trip time variation", i.rttvar_us / 1e6);
+    w.gauge("min_rtt_seconds", "Minimum round-trip time sample", i.min_rtt_us / 1e6);
+    w.gauge("rcv_rtt_seconds", "Receiver-side round-trip time estimate", i.rcv_rtt_us / 1e6);
+
+    w.gauge("cwnd_bytes", "Congestion window", i.cwnd);
+    w.gauge("rwnd_bytes", "Receive window advertised by the peer", i.rwnd);
+    w.gauge("flight_size_bytes", "Bytes sent but not yet acknowledged", i.flight_size);
+    w.gauge("rcv_wnd_bytes", "Receive window this end can advertise", i.rcv_wnd);
+    w.gauge("rcvbuf_bytes", "Receive buffer limit", i.rcvbuf);
+    w.gauge("pacing_rate_bytes_per_second", "Sender pacing rate (0 when unpaced)", i.pacing_rate);
+    w.gauge("rate_limit_bytes_per_second", "Configured send rate limit of the connection (0 when unlimited)",
+            i.rate_limit);
+    w.gauge("socket_rcvbuf_bytes", "Kernel UDP receive buffer (SO_RCVBUF)", i.sock_rcvbuf);
+    w.gauge("socket_sndbuf_bytes", "Kernel UDP send buffer (SO_SNDBUF)", i.sock_sndbuf);
+
+    w.counter("app_limited_seconds_total", "Time the sender waited for the application", i.app_limited_us / 1e6);
+    w.counter("cwnd_limited_seconds_total", "Time the sender was blocked by the congestion window",
+              i.cwnd_limited_us / 1e6);
+    w.counter("rwnd_limited_seconds_total", "Time the sender was blocked by the peer receive window",
+              i.rwnd_limited_us / 1e6);
+    w.counter("pacing_limited_seconds_total", "Time the sender waited for the pacing schedule",
+              i.pacing_limited_us / 1e6);
+    w.counter("rate_limited_seconds_total", "Time the sender was held back by a send rate limit",
+              i.rate_limited_us / 1e6);
+    return w.out;
+}
+
+// ---------------- MetricsExporter ----------------
+
+MetricsExporter::~MetricsExporter() { close(); }
+
+bool MetricsExporter::open(const std::string& target, int interval_ms) {
+    close();
+    interval = interval_ms > 0 ? interval_ms : 1000;
+
+    if (target.rfind("unix:", 0) == 0) {
+        path = target.substr(5);
+        sockaddr_un addr{};
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            std::cerr << "[Metrics] Invalid unix socket path: " << path << std::endl;
+            return false;
+        }
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, path.c_str(), path.size());
+        ::unlink(path.c_str());  // 上次没清理掉的 socket 文件
+        listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0 || ::bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(listen_fd, 8) != 0) {
+            std::cerr << "[Metrics] Failed to listen on " << target << ": " << strerror(errno) << std::endl;
+            close();
+            return false;
+        }
+    } else if (target.rfind("tcp:", 0) == 0) {
+        int port = std::atoi(target.c_str() + 4);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        if (listen_fd >= 0) setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (port <= 0 || port > 65535 || listen_fd < 0 || ::bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+            ::listen(listen_fd, 8) != 0) {
+            std::cerr << "[Metrics] Failed to listen on " << target << ": " << strerror(errno) << std::endl;
+            close();
+            return false;
+        }
+    } else {
+        path = target.rfind("file:", 0) == 0 ? target.substr(5) : target;
+        if (path.empty()) {
+            std::cerr << "[Metrics] Empty metrics file path" << std::endl;
+            return false;
+        }
+        kind = TO_FILE;
+        return true;
+    }
+
+    kind = TO_SOCKET;
+    running = true;
+    server = std::thread(&MetricsExporter::serve_loop, this);
+    return true;
+}
+
+void MetricsExporter::close() {
+    if (kind == TO_SOCKET) {
+        running = false;
+        if (server.joinable()) server.join();
+    }
+    if (listen_fd >= 0) {
+        ::close(listen_fd);
+        listen_fd = -1;
+        if (!path.empty()) ::unlink(path.c_str());  // tcp: 时 path 为空
+    }
+    kind = NONE;
+    path.clear();
+}
+
+void MetricsExporter::publish(const TCPInfo& info, const std::string& labels) {
+    if (!active()) return;
+    last_publish = std::chrono::steady_clock::now();
+    std::string text = format_prometheus(info, labels);
+
+    if (kind == TO_FILE) {
+        // 抓取方随时可能来读，先写临时文件再 rename，不会读到写了一半的内容
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            out << text;
+            if (!out) return;
+        }
+        std::rename(tmp.c_str(), path.c_str());
+        return;
+    }
+    std::lock_guard<std::mutex> lock(body_mutex);
+    body = std::move(text);
+}
+
+void MetricsExporter::serve_loop() {
+    while (running) {
+        pollfd pfd{listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) continue;  // 超时醒来检查 running
+        int fd = ::accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) continue;
+
+        // 读完请求头 (空行) 再应答，客户端发得慢时最多等 500ms；请求的路径不区分，都返回指标
+        std::string req;
+        char buf[1024];
+        while (req.find("\r\n\r\n") == std::string::npos && req.find("\n\n") == std::string::npos &&
+               req.size() < 8192) {
+            pollfd rfd{fd, POLLIN, 0};
+            if (poll(&rfd, 1, 500) <= 0) break;
+            ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0) break;
+            req.append(buf, n);
+        }
+
+        std::string text;
+        {
+            std::lock_guard<std::mutex> lock(body_mutex);
+            text = body;
+        }
+        std::string resp = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                           std::to_string(text.size()) + "\r\nConnection: close\r\n\r\n" + text;
+        size_t off = 0;
+        while (off < resp.size()) {
+            ssize_t n = ::send(fd, resp.data() + off, resp.size() - off, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            off += n;
+        }
+        ::close(fd);
+    }
+}